@@ -0,0 +1,137 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Minimal Arduino compatibility layer: just what the library uses (String, Print, Stream, Serial,
+ * millis/micros/delay/yield) so it builds and runs on a workstation. Time comes from HostClock.
+ */
+
+#ifndef ARDUINO_HOST_H
+#define ARDUINO_HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+
+#include "HostClock.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+class String {
+public:
+  String() {}
+  String(const char* cstr) : _s(cstr ? cstr : "") {}
+  String(const std::string& s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = DEC);
+  explicit String(int value, unsigned char base = DEC);
+  explicit String(unsigned int value, unsigned char base = DEC);
+  explicit String(long value, unsigned char base = DEC);
+  explicit String(unsigned long value, unsigned char base = DEC);
+  explicit String(double value, unsigned char decimals = 2);
+
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  char operator[](unsigned int index) const { return index < _s.length() ? _s[index] : 0; }
+  char charAt(unsigned int index) const { return (*this)[index]; }
+  String substring(unsigned int from) const { return substring(from, length()); }
+  String substring(unsigned int from, unsigned int to) const;
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String& s, unsigned int from = 0) const;
+  bool startsWith(const String& s) const { return _s.compare(0, s._s.length(), s._s) == 0; }
+  void toUpperCase();
+  void trim();
+  long toInt() const { return strtol(_s.c_str(), NULL, 10); }
+
+  String& operator+=(const String& rhs) { _s += rhs._s; return *this; }
+  String& operator+=(const char* rhs) { _s += rhs; return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  bool operator==(const String& rhs) const { return _s == rhs._s; }
+  bool operator==(const char* rhs) const { return _s == rhs; }
+  bool operator!=(const String& rhs) const { return _s != rhs._s; }
+
+  friend String operator+(const String& lhs, const String& rhs) { return String(lhs._s + rhs._s); }
+  friend String operator+(const String& lhs, const char* rhs) { return String(lhs._s + rhs); }
+  friend String operator+(const char* lhs, const String& rhs) { return String(lhs + rhs._s); }
+
+private:
+  std::string _s;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+
+  size_t print(const char* str) { return write(str); }
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(const T& value) { size_t n = print(value); return n + println(); }
+  template<typename T> size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+//Serial writes to stdout (or nowhere), reads nothing
+class HardwareSerial : public Stream {
+public:
+  using Print::write;
+  void begin(unsigned long /*baud*/) {}
+  void end() {}
+  void setOutput(FILE* out) { _out = out; } //NULL to mute
+  size_t write(uint8_t c) override { if (_out) fputc(c, _out); return 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { if (_out) fwrite(buffer, 1, size, _out); return size; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override { if (_out) fflush(_out); }
+  operator bool() const { return true; }
+
+private:
+  FILE* _out = stdout;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include <stdarg.h>
+#include <chrono>
+#include <thread>
+
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+// clock
+
+static uint64_t steadyMicros(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SystemClock::SystemClock() : _origin(steadyMicros())
+{
+}
+
+uint64_t SystemClock::now()
+{
+  return steadyMicros() - _origin;
+}
+
+void SystemClock::sleep(uint64_t us)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+uint64_t VirtualClock::now()
+{
+  uint64_t t = _now;
+  _now += _autoAdvance;
+  return t;
+}
+
+void VirtualClock::advance(uint64_t us)
+{
+  uint64_t target = _now + us;
+
+  while (!_timers.empty() && _timers.begin()->first <= target) {
+    auto timer = _timers.begin();
+    std::function<void()> callback = timer->second;
+
+    if (timer->first > _now) _now = timer->first;
+    _timers.erase(timer);
+
+    callback();
+  }
+
+  if (target > _now) _now = target;
+}
+
+void VirtualClock::schedule(uint64_t at, std::function<void()> callback)
+{
+  _timers.emplace(at, callback);
+}
+
+static SystemClock systemClock;
+static HostClock* currentClock = &systemClock;
+
+void setHostClock(HostClock* clock)
+{
+  currentClock = clock ? clock : &systemClock;
+}
+
+HostClock& hostClock()
+{
+  return *currentClock;
+}
+
+unsigned long millis()
+{
+  return (unsigned long)(currentClock->now() / 1000);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)currentClock->now();
+}
+
+void delay(unsigned long ms)
+{
+  currentClock->sleep((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  currentClock->sleep(us);
+}
+
+void yield()
+{
+}
+
+// String
+
+static std::string formatNumber(unsigned long value, unsigned char base, bool negative)
+{
+  if (base < 2 || base > 36) base = 10;
+
+  char buffer[8 * sizeof(long) + 2];
+  char* p = &buffer[sizeof(buffer) - 1];
+  *p = '\0';
+
+  do {
+    unsigned long digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+
+  if (negative) *--p = '-';
+
+  return std::string(p);
+}
+
+String::String(unsigned char value, unsigned char base) : _s(formatNumber(value, base, false)) {}
+String::String(unsigned int value, unsigned char base) : _s(formatNumber(value, base, false)) {}
+String::String(unsigned long value, unsigned char base) : _s(formatNumber(value, base, false)) {}
+
+String::String(int value, unsigned char base) : String((long)value, base) {}
+
+String::String(long value, unsigned char base)
+{
+  //like Arduino: negative only in base 10, other bases print the two's complement
+  if (base == DEC && value < 0) {
+    _s = formatNumber(-(unsigned long)value, base, true);
+  } else {
+    _s = formatNumber((unsigned long)value, base, false);
+  }
+}
+
+String::String(double value, unsigned char decimals)
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+  _s = buffer;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if (from > to) std::swap(from, to);
+  if (from >= _s.length()) return String();
+  if (to > _s.length()) to = _s.length();
+
+  return String(_s.substr(from, to - from));
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  size_t i = _s.find(c, from);
+  return i == std::string::npos ? -1 : (int)i;
+}
+
+int String::indexOf(const String& s, unsigned int from) const
+{
+  size_t i = _s.find(s._s, from);
+  return i == std::string::npos ? -1 : (int)i;
+}
+
+void String::toUpperCase()
+{
+  for (size_t i = 0; i < _s.length(); i++) {
+    _s[i] = toupper((unsigned char)_s[i]);
+  }
+}
+
+void String::trim()
+{
+  size_t begin = _s.find_first_not_of(" \t\r\n");
+  size_t end = _s.find_last_not_of(" \t\r\n");
+  _s = begin == std::string::npos ? std::string() : _s.substr(begin, end - begin + 1);
+}
+
+// Print
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value, int base)
+{
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(double value, int digits)
+{
+  return print(String(value, (unsigned char)digits));
+}
+
+size_t Print::printf(const char* format, ...)
+{
+  char small[128];
+  va_list args;
+
+  va_start(args, format);
+  int len = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+
+  if (len < 0) return 0;
+  if ((size_t)len < sizeof(small)) return write((const uint8_t*)small, len);
+
+  std::string large(len + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&large[0], large.size(), format, args);
+  va_end(args);
+
+  return write((const uint8_t*)large.data(), len);
+}
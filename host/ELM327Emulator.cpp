@@ -0,0 +1,534 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "ELM327Emulator.h"
+
+ELM327Emulator::ELM327Emulator(VirtualClock& clock, const ELM327EmulatorConfig& config) :
+  _clock(clock),
+  _config(config),
+  _random(config.Seed ? config.Seed : 1)
+{
+  resetStats();
+  reset();
+}
+
+ELM327Emulator::~ELM327Emulator()
+{
+  detach();
+}
+
+void ELM327Emulator::attach(VirtualCANBus& bus)
+{
+  detach();
+
+  _bus = &bus;
+  _bus->attach(this);
+}
+
+void ELM327Emulator::detach()
+{
+  if (_bus) {
+    _bus->detach(this);
+    _bus = nullptr;
+  }
+}
+
+void ELM327Emulator::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+//power-on settings
+void ELM327Emulator::reset()
+{
+  _echo = true;
+  _spaces = true;
+  _headers = false;
+  _linefeeds = false;
+  _autoFormat = true;
+  _header = 0x7DF;
+  _extended = false;
+  _timeout = 0x32;
+  _protocol = 0;
+
+  _busy = false;
+  _generation++;
+  _line.clear();
+}
+
+// serial side
+
+size_t ELM327Emulator::write(uint8_t c)
+{
+  uint64_t now = _clock.now();
+  uint64_t arrival = std::max(now + _config.LinkLatency, _inputFree) + byteTime();
+
+  _inputFree = arrival;
+  _stats.BytesIn++;
+
+  schedule(arrival - now, [this, c]() { receive((char)c); });
+
+  return 1;
+}
+
+int ELM327Emulator::available()
+{
+  _clock.runDue();
+
+  uint64_t now = _clock.now();
+  int n = 0;
+
+  for (const Byte& b : _output) {
+    if (b.Time > now) break;
+    n++;
+  }
+
+  return n;
+}
+
+int ELM327Emulator::read()
+{
+  int c = peek();
+
+  if (c >= 0) {
+    _output.pop_front();
+  }
+
+  return c;
+}
+
+int ELM327Emulator::peek()
+{
+  _clock.runDue();
+
+  if (_output.empty() || _output.front().Time > _clock.now()) {
+    return -1;
+  }
+
+  return (uint8_t)_output.front().Value;
+}
+
+void ELM327Emulator::emit(const std::string& text)
+{
+  uint64_t now = _clock.now();
+
+  for (char c : text) {
+    _outputFree = std::max(now + _config.LinkLatency, _outputFree) + byteTime();
+    _output.push_back({ _outputFree, c });
+    _stats.BytesOut++;
+  }
+}
+
+void ELM327Emulator::printLine(const std::string& line)
+{
+  emit(line + newline());
+  _received = true;
+}
+
+void ELM327Emulator::reply(const std::string& text)
+{
+  emit(text + newline() + newline() + ">");
+}
+
+void ELM327Emulator::receive(char c)
+{
+  if (_resetting) {
+    return;
+  }
+
+  //any byte aborts a running request
+  if (_busy) {
+    finishRequest(true);
+    return;
+  }
+
+  if (c == '\r') {
+    if (_echo) emit(newline());
+
+    std::string command = _line;
+    _line.clear();
+
+    schedule(_config.CommandTime, [this, command]() { execute(command); });
+    return;
+  }
+
+  if (_echo) emit(std::string(1, c));
+
+  if (c != '\n' && c >= ' ') {
+    _line += toupper((unsigned char)c);
+  }
+}
+
+void ELM327Emulator::execute(std::string command)
+{
+  command.erase(std::remove(command.begin(), command.end(), ' '), command.end());
+
+  _stats.Commands++;
+
+  if (command.empty()) {
+    emit(">");
+    return;
+  }
+
+  if (command.compare(0, 2, "AT") == 0) {
+    executeAt(command.substr(2));
+    return;
+  }
+
+  if (command.find_first_not_of("0123456789ABCDEF") != std::string::npos) {
+    reply("?");
+    return;
+  }
+
+  sendRequest(command);
+}
+
+void ELM327Emulator::executeAt(const std::string& command)
+{
+  auto flag = [&](const char* name, bool& setting) {
+    size_t n = strlen(name);
+    if (command.length() != n + 1 || command.compare(0, n, name) != 0 || (command[n] != '0' && command[n] != '1')) {
+      return false;
+    }
+    setting = command[n] == '1';
+    reply("OK");
+    return true;
+  };
+
+  if (command == "Z" || command == "WS") {
+    reset();
+    _resetting = command == "Z";
+
+    uint32_t delay = _resetting ? _config.ResetTime : 0;
+    schedule(delay, [this]() {
+      _resetting = false;
+      emit(newline() + newline());
+      reply(_config.Version);
+    });
+    return;
+  }
+
+  if (command == "D") {
+    bool echo = _echo;
+    reset();
+    _echo = echo;
+    reply("OK");
+    return;
+  }
+
+  if (flag("E", _echo) || flag("S", _spaces) || flag("H", _headers) || flag("L", _linefeeds) || flag("CAF", _autoFormat)) {
+    return;
+  }
+
+  if (command == "I") {
+    reply(_config.Version);
+    return;
+  }
+
+  if (command == "@1") {
+    reply("OBDII to RS232 Interpreter");
+    return;
+  }
+
+  if (command == "RV") {
+    reply("12.6V");
+    return;
+  }
+
+  if (command == "DP" || command == "DPN") {
+    const char* names[] = { "AUTO", "ISO 15765-4 (CAN 11/500)", "ISO 15765-4 (CAN 29/500)" };
+    if (command == "DPN") {
+      reply(_extended ? "7" : "6");
+    } else {
+      reply(names[_extended ? 2 : 1]);
+    }
+    return;
+  }
+
+  if (command.compare(0, 2, "SH") == 0) {
+    std::string value = command.substr(2);
+
+    if ((value.length() != 3 && value.length() != 6 && value.length() != 8) ||
+        value.find_first_not_of("0123456789ABCDEF") != std::string::npos) {
+      reply("?");
+      return;
+    }
+
+    long header = strtol(value.c_str(), NULL, 16);
+
+    //3 digits: 11 bit, 6 digits: 29 bit with default priority 18, 8 digits: full 29 bit
+    _extended = value.length() > 3;
+    _header = value.length() == 3 ? header & 0x7FF : value.length() == 6 ? 0x18000000 | header : header & 0x1FFFFFFF;
+
+    reply("OK");
+    return;
+  }
+
+  if (command.compare(0, 2, "ST") == 0 && command.length() == 4) {
+    _timeout = strtol(command.c_str() + 2, NULL, 16);
+    if (!_timeout) _timeout = 0x32;
+    reply("OK");
+    return;
+  }
+
+  if (command.compare(0, 3, "SPA") == 0 || command.compare(0, 3, "TPA") == 0) {
+    _protocol = strtol(command.c_str() + 3, NULL, 16);
+    reply("OK");
+    return;
+  }
+
+  if (command.compare(0, 2, "SP") == 0 || command.compare(0, 2, "TP") == 0) {
+    _protocol = strtol(command.c_str() + 2, NULL, 16);
+    reply("OK");
+    return;
+  }
+
+  //accepted without effect on the emulation
+  static const char* accepted[] = { "AT0", "AT1", "AT2", "CFC0", "CFC1", "M0", "M1", "PC", "CRA", "CP", "FCSM", "SW", "V0", "V1", "R0", "R1" };
+  for (const char* prefix : accepted) {
+    if (command.compare(0, strlen(prefix), prefix) == 0) {
+      reply("OK");
+      return;
+    }
+  }
+
+  reply("?");
+}
+
+// can side
+
+void ELM327Emulator::sendRequest(const std::string& hex)
+{
+  //odd digit count: the last one is the number of responses to wait for
+  std::string bytes = hex;
+  uint8_t expected = 0;
+
+  if (bytes.length() % 2) {
+    expected = strtol(bytes.substr(bytes.length() - 1).c_str(), NULL, 16);
+    bytes.erase(bytes.length() - 1);
+  }
+
+  if (bytes.empty() || bytes.length() > 14) {
+    reply("?");
+    return;
+  }
+
+  _stats.Requests++;
+
+  if (!_bus) {
+    reply("UNABLE TO CONNECT");
+    return;
+  }
+
+  if (_config.CanErrorRate > 0 && (random() >> 8) * (1.0f / 16777216.0f) < _config.CanErrorRate) {
+    _stats.CanErrors++;
+    reply("CAN ERROR");
+    return;
+  }
+
+  VirtualCANFrame frame;
+  frame.id = _header;
+  frame.extended = _extended;
+  frame.rtr = false;
+  frame.dlc = 8;
+  memset(frame.data, 0, sizeof(frame.data));
+  frame.data[0] = bytes.length() / 2;
+
+  for (size_t i = 0; i < bytes.length() / 2; i++) {
+    frame.data[i + 1] = strtol(bytes.substr(i * 2, 2).c_str(), NULL, 16);
+  }
+
+  _busy = true;
+  _generation++;
+  _expectedResponses = expected;
+  _responses = 0;
+  _received = false;
+  _remaining = 0;
+
+  restartResponseTimer();
+  _bus->transmit(frame, this);
+}
+
+//AT ST: the chip gives up this long after the request or the last frame received
+void ELM327Emulator::restartResponseTimer()
+{
+  uint32_t generation = ++_generation;
+
+  schedule(_timeout * 4000UL, [this, generation]() {
+    if (_busy && generation == _generation) {
+      finishRequest(false);
+    }
+  });
+}
+
+void ELM327Emulator::finishRequest(bool stopped)
+{
+  _busy = false;
+  _generation++;
+
+  if (stopped) {
+    _stats.Stopped++;
+    reply("STOPPED");
+  } else if (!_received) {
+    _stats.NoData++;
+    reply("NO DATA");
+  } else {
+    emit(newline() + ">");
+  }
+}
+
+bool ELM327Emulator::acceptResponse(const VirtualCANFrame& frame) const
+{
+  if (frame.extended) {
+    return _extended && (frame.id & 0x1FFFFF00) == 0x18DAF100;
+  }
+
+  return !_extended && ((frame.id >= 0x7E8 && frame.id <= 0x7EF) || frame.id == _header + 8);
+}
+
+void ELM327Emulator::onBusFrame(const VirtualCANFrame& frame)
+{
+  if (!_busy || frame.rtr || frame.dlc < 1 || !acceptResponse(frame)) {
+    return;
+  }
+
+  uint8_t pci = frame.data[0] >> 4;
+  bool complete = false;
+
+  if (pci == 0x0) {
+    uint8_t length = std::min<uint8_t>(frame.data[0] & 0x0F, frame.dlc - 1);
+
+    //response pending: printed like the chip does, then it keeps waiting for the answer
+    if (length >= 3 && frame.data[1] == 0x7F && frame.data[3] == 0x78) {
+      if (_headers || !_autoFormat) {
+        printFrame(frame, _autoFormat ? length + 1 : frame.dlc);
+      } else {
+        printLine(hex(frame.data + 1, length));
+      }
+      restartResponseTimer();
+      return;
+    }
+
+    if (_headers || !_autoFormat) {
+      printFrame(frame, _autoFormat ? length + 1 : frame.dlc);
+    } else {
+      printLine(hex(frame.data + 1, length));
+    }
+    complete = true;
+  } else if (pci == 0x1) {
+    size_t total = ((frame.data[0] & 0x0F) << 8) | frame.data[1];
+
+    flowControl(frame.id);
+
+    if (_headers || !_autoFormat) {
+      printFrame(frame, frame.dlc);
+    } else {
+      char count[8];
+      snprintf(count, sizeof(count), "%03X", (unsigned)total);
+      printLine(count);
+      printLine("0:" + std::string(_spaces ? " " : "") + hex(frame.data + 2, 6));
+    }
+
+    _remaining = total > 6 ? total - 6 : 0;
+    _lineIndex = 1;
+  } else if (pci == 0x2 && _remaining > 0) {
+    if (_headers || !_autoFormat) {
+      printFrame(frame, frame.dlc);
+    } else {
+      //like the chip, the last line shows the padding too
+      char index[4];
+      snprintf(index, sizeof(index), "%X:", _lineIndex);
+      printLine(index + std::string(_spaces ? " " : "") + hex(frame.data + 1, frame.dlc - 1));
+    }
+
+    _lineIndex = (_lineIndex + 1) & 0x0F;
+    _remaining -= std::min<size_t>(7, _remaining);
+    complete = _remaining == 0;
+  } else {
+    return;
+  }
+
+  if (complete) {
+    _responses++;
+    _stats.Responses++;
+
+    if (_expectedResponses && _responses >= _expectedResponses) {
+      finishRequest(false);
+      return;
+    }
+  }
+
+  restartResponseTimer();
+}
+
+//AT H1 or AT CAF0: id and raw bytes with pci
+void ELM327Emulator::printFrame(const VirtualCANFrame& frame, uint8_t length)
+{
+  char id[16];
+  std::string line;
+
+  if (_headers) {
+    if (frame.extended) {
+      uint8_t bytes[4] = { (uint8_t)(frame.id >> 24), (uint8_t)(frame.id >> 16), (uint8_t)(frame.id >> 8), (uint8_t)frame.id };
+      line = hex(bytes, 4);
+    } else {
+      snprintf(id, sizeof(id), "%03lX", frame.id);
+      line = id;
+    }
+    if (_spaces) line += " ";
+  }
+
+  printLine(line + hex(frame.data, length));
+}
+
+//sent at once, the chip answers a first frame with 30 00 00 (AT FC defaults)
+void ELM327Emulator::flowControl(long responseId)
+{
+  VirtualCANFrame frame;
+  //7E8 -> 7E0, 18DAF110 -> 18DA10F1
+  frame.id = responseId > 0x7FF ? (responseId & 0x1FFF0000) | ((responseId & 0xFF) << 8) | ((responseId >> 8) & 0xFF) : responseId - 8;
+  frame.extended = responseId > 0x7FF;
+  frame.rtr = false;
+  frame.dlc = 8;
+  memset(frame.data, 0, sizeof(frame.data));
+  frame.data[0] = 0x30;
+
+  _bus->transmit(frame, this);
+}
+
+std::string ELM327Emulator::hex(const uint8_t* data, size_t length) const
+{
+  std::string s;
+  char byte[4];
+
+  for (size_t i = 0; i < length; i++) {
+    snprintf(byte, sizeof(byte), "%02X", data[i]);
+    if (i && _spaces) s += ' ';
+    s += byte;
+  }
+
+  return s;
+}
+
+void ELM327Emulator::schedule(uint64_t delay, std::function<void()> callback)
+{
+  std::weak_ptr<int> alive = _alive;
+
+  _clock.schedule(_clock.now() + delay, [alive, callback]() {
+    if (!alive.expired()) {
+      callback();
+    }
+  });
+}
+
+//xorshift32
+uint32_t ELM327Emulator::random()
+{
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return _random;
+}
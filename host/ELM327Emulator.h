@@ -0,0 +1,123 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * ELM327 emulator: a Stream for BeginElm327() that behaves like the chip on the serial side
+ * (AT commands, echo/spaces/headers/linefeeds, multi-frame "0:"/"1:" lines, NO DATA, STOPPED,
+ * CAN ERROR, byte-rate throttling) and like a tester on a VirtualCANBus, so the vehicle behind it
+ * is made of SimulatedECU nodes. Timing runs on a VirtualClock.
+ */
+
+#ifndef ELM327_EMULATOR_H
+#define ELM327_EMULATOR_H
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+#include "VirtualCAN.h"
+
+struct ELM327EmulatorConfig {
+  uint32_t BaudRate = 38400;           //serial link, 10 bits per byte, 0 for no throttling
+  uint32_t LinkLatency = 0;            //us added in each direction (bluetooth spp packetizing)
+  uint32_t CommandTime = 500;          //us to parse a command
+  uint32_t ResetTime = 500000;         //us of AT Z
+  float CanErrorRate = 0;              //probability a request ends in CAN ERROR
+  uint32_t Seed = 1;
+  const char* Version = "ELM327 v1.5";
+};
+
+struct ELM327EmulatorStats {
+  uint64_t Commands;
+  uint64_t Requests;
+  uint64_t Responses;
+  uint64_t NoData;
+  uint64_t Stopped;
+  uint64_t CanErrors;
+  uint64_t BytesIn;
+  uint64_t BytesOut;
+};
+
+class ELM327Emulator : public Stream, public VirtualCANNode {
+public:
+  ELM327Emulator(VirtualClock& clock, const ELM327EmulatorConfig& config = ELM327EmulatorConfig());
+  virtual ~ELM327Emulator();
+
+  void attach(VirtualCANBus& bus);
+  void detach();
+
+  //serial side, seen by the host
+  using Print::write;
+  size_t write(uint8_t c) override;
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  void onBusFrame(const VirtualCANFrame& frame) override;
+
+  ELM327EmulatorConfig& config() { return _config; }
+  const ELM327EmulatorStats& stats() const { return _stats; }
+  void resetStats();
+
+private:
+  void reset();
+  void receive(char c);
+  void execute(std::string command);
+  void executeAt(const std::string& command);
+  void sendRequest(const std::string& hex);
+  void finishRequest(bool stopped);
+  void restartResponseTimer();
+  void printFrame(const VirtualCANFrame& frame, uint8_t length);
+  void flowControl(long responseId);
+  bool acceptResponse(const VirtualCANFrame& frame) const;
+  void reply(const std::string& text); //text, blank line and prompt
+  void printLine(const std::string& line);
+  void emit(const std::string& text);
+  std::string hex(const uint8_t* data, size_t length) const;
+  std::string newline() const { return _linefeeds ? "\r\n" : "\r"; }
+  void schedule(uint64_t delay, std::function<void()> callback);
+  uint32_t byteTime() const { return _config.BaudRate ? 10000000UL / _config.BaudRate : 0; }
+  uint32_t random();
+
+  VirtualClock& _clock;
+  ELM327EmulatorConfig _config;
+  ELM327EmulatorStats _stats;
+  VirtualCANBus* _bus = nullptr;
+  std::shared_ptr<int> _alive = std::make_shared<int>(0);
+  uint32_t _random;
+
+  //serial line: bytes become readable at their arrival time
+  struct Byte {
+    uint64_t Time;
+    char Value;
+  };
+  std::deque<Byte> _output;
+  uint64_t _outputFree = 0;
+  uint64_t _inputFree = 0;
+  std::string _line;
+
+  //settings
+  bool _echo;
+  bool _spaces;
+  bool _headers;
+  bool _linefeeds;
+  bool _autoFormat;
+  long _header;
+  bool _extended;
+  uint8_t _timeout;                    //AT ST, 4 ms units
+  uint8_t _protocol;
+
+  //running request
+  bool _busy = false;
+  bool _resetting = false;
+  uint32_t _generation = 0;
+  uint8_t _expectedResponses = 0;
+  uint8_t _responses = 0;
+  bool _received = false;
+  size_t _remaining = 0;               //bytes left of the running multi-frame response
+  uint8_t _lineIndex = 0;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Injectable time source behind millis()/micros()/delay(): wall clock or virtual time.
+ */
+
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <stdint.h>
+#include <functional>
+#include <map>
+
+class HostClock {
+public:
+  virtual ~HostClock() {}
+  virtual uint64_t now() = 0; //microseconds
+  virtual void sleep(uint64_t us) = 0;
+};
+
+//steady wall clock, starts at 0
+class SystemClock : public HostClock {
+public:
+  SystemClock();
+  uint64_t now() override;
+  void sleep(uint64_t us) override;
+
+private:
+  uint64_t _origin;
+};
+
+//time moves only when asked: delay() advances it instantly, runs are fast and reproducible
+class VirtualClock : public HostClock {
+public:
+  uint64_t now() override;
+  void sleep(uint64_t us) override { advance(us); }
+
+  //move time forward, running due timers in time order
+  void advance(uint64_t us);
+  void runDue() { advance(0); } //run timers already due, for polled devices in busy-wait loops
+  void set(uint64_t us) { _now = us; }
+
+  //every now() read moves time forward, so busy loops waiting for a timeout terminate;
+  //timers are not run by these reads, only by advance()/delay()
+  void setAutoAdvance(uint32_t us) { _autoAdvance = us; }
+
+  //run callback when time reaches at (simulated ECU replies, bus latency...)
+  void schedule(uint64_t at, std::function<void()> callback);
+  size_t pendingTimers() const { return _timers.size(); }
+
+private:
+  uint64_t _now = 0;
+  uint32_t _autoAdvance = 0;
+  std::multimap<uint64_t, std::function<void()>> _timers; //same time: insertion order
+};
+
+//clock used by millis()/micros()/delay(), default is a SystemClock
+void setHostClock(HostClock* clock);
+HostClock& hostClock();
+
+#endif
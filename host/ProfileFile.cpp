@@ -0,0 +1,118 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <regex>
+
+#include "ProfileFile.h"
+
+//  { "Engine", "engineSpeed", false, 0x7E0, 0x01, 0x000C, 2, 0.25f, 0.0f, 200 },
+static const std::regex requestLine(
+    "^\\s*\\{\\s*\"([^\"]*)\",\\s*\"([^\"]*)\",\\s*(true|false),\\s*(0x[0-9A-Fa-f]+),\\s*(0x[0-9A-Fa-f]+),"
+    "\\s*(0x[0-9A-Fa-f]+),\\s*(\\d+),\\s*([-+0-9.eE]+)f,\\s*([-+0-9.eE]+)f,\\s*(\\d+)\\s*\\},?\\s*$");
+//static const OBD2Profile simulated_ecus_profile = { "simulated_ecus", ...
+static const std::regex profileLine("^\\s*static const OBD2Profile \\w+\\s*=\\s*\\{\\s*\"([^\"]*)\"");
+
+bool ProfileFile::open(const char* path)
+{
+  _strings.clear();
+  _requests.clear();
+  _index.clear();
+  _profile = { NULL, NULL, 0, NULL, 0 };
+  _error.clear();
+
+  std::ifstream in(path);
+  if (!in) {
+    _error = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+
+  std::string line;
+  std::string name;
+  std::smatch m;
+  int number = 0;
+
+  while (std::getline(in, line)) {
+    number++;
+
+    if (std::regex_match(line, m, profileLine)) {
+      name = m[1];
+      continue;
+    }
+
+    if (!std::regex_match(line, m, requestLine)) continue;
+
+    unsigned long header = std::stoul(m[4], NULL, 16);
+    unsigned long service = std::stoul(m[5], NULL, 16);
+    unsigned long pid = std::stoul(m[6], NULL, 16);
+    unsigned long expectedBytes = std::stoul(m[7]);
+
+    if (header > OBD2_HEADER_MASK || service > 0xFF || pid > 0xFFFF || expectedBytes == 0 || expectedBytes > 4) {
+      _error = std::string(path) + ":" + std::to_string(number) + ": invalid request " + m[2].str();
+      return false;
+    }
+
+    _requests.emplace_back(keep(m[1]), keep(m[2]), m[3] == "true", header, service, pid, expectedBytes,
+                           std::stof(m[8]), std::stof(m[9]), std::stoul(m[10]));
+  }
+
+  if (_requests.empty()) {
+    _error = std::string(path) + ": no requests, not a tools/obd2_profile.py header";
+    return false;
+  }
+
+  if (_requests.size() >= OBD2_PROFILE_EMPTY_SLOT) {
+    _error = std::string(path) + ": too many requests";
+    return false;
+  }
+
+  //the generator's order and index (build_index), find() depends on neither being edited by hand
+  std::stable_sort(_requests.begin(), _requests.end(), [](const OBD2RequestDescriptor& a, const OBD2RequestDescriptor& b) {
+    uint32_t ha = a.HeaderFlags & OBD2_HEADER_MASK;
+    uint32_t hb = b.HeaderFlags & OBD2_HEADER_MASK;
+    if (ha != hb) return ha < hb;
+    if (a.Service != b.Service) return a.Service < b.Service;
+    return a.Pid < b.Pid;
+  });
+
+  for (size_t i = 1; i < _requests.size(); i++) {
+    const OBD2RequestDescriptor& a = _requests[i - 1];
+    const OBD2RequestDescriptor& b = _requests[i];
+    if (((a.HeaderFlags ^ b.HeaderFlags) & OBD2_HEADER_MASK) == 0 && a.Service == b.Service && a.Pid == b.Pid) {
+      _error = std::string(path) + ": duplicate request " + b.Name;
+      return false;
+    }
+  }
+
+  size_t size = 4;
+  while (size < 2 * _requests.size()) size *= 2;
+  _index.assign(size, OBD2_PROFILE_EMPTY_SLOT);
+
+  for (size_t i = 0; i < _requests.size(); i++) {
+    const OBD2RequestDescriptor& r = _requests[i];
+    size_t slot = obd2ProfileHash(r.HeaderFlags & OBD2_HEADER_MASK, r.Service, r.Pid) & (size - 1);
+    while (_index[slot] != OBD2_PROFILE_EMPTY_SLOT) slot = (slot + 1) & (size - 1);
+    _index[slot] = i;
+  }
+
+  if (name.empty()) {
+    name = path;
+    size_t slash = name.find_last_of('/');
+    if (slash != std::string::npos) name.erase(0, slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos) name.erase(dot);
+  }
+
+  _profile = { keep(name), _requests.data(), (uint16_t)_requests.size(), _index.data(), (uint16_t)(size - 1) };
+  return true;
+}
+
+const char* ProfileFile::keep(const std::string& text)
+{
+  _strings.push_back(text);
+  return _strings.back().c_str();
+}
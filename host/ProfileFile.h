@@ -0,0 +1,40 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Profile headers generated by tools/obd2_profile.py, loaded at run time: host tools can decode
+ * a vehicle without being rebuilt. The request lines are parsed, sorted and indexed as the
+ * generator does, so profile() works with OBD2::setProfile() and OBD2TraceDecoder::setProfile().
+ */
+
+#ifndef PROFILE_FILE_H
+#define PROFILE_FILE_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "OBD2.h"
+
+class ProfileFile {
+public:
+  ProfileFile() {}
+
+  bool open(const char* path);
+
+  //valid until the next open()
+  const OBD2Profile* profile() const { return &_profile; }
+  const std::string& error() const { return _error; }
+
+private:
+  const char* keep(const std::string& text);
+
+  std::deque<std::string> _strings;    //names, stable addresses
+  std::vector<OBD2RequestDescriptor> _requests;
+  std::vector<uint16_t> _index;
+  OBD2Profile _profile = { NULL, NULL, 0, NULL, 0 };
+  std::string _error;
+};
+
+#endif
@@ -0,0 +1,40 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Broadcast signals of the simulated bus (obd2_trace record, obd2_trigger): the decoders a vehicle
+ * specific tool would register for its own periodic frames.
+ */
+
+#ifndef SIMULATED_BROADCASTS_H
+#define SIMULATED_BROADCASTS_H
+
+#include "OBD2TraceDecoder.h"
+
+//0x4B2 wheel speeds, bytes 0-1 front left km/h * 100
+static inline float decodeSimulatedWheelSpeed(const OBD2BroadcastPacket& packet)
+{
+  return ((packet.Byte0 << 8) | packet.Byte1) / 100.0;
+}
+
+//0x0C9 engine status, bit 7 of byte 0
+static inline float decodeSimulatedEngineRunning(const OBD2BroadcastPacket& packet)
+{
+  return (packet.Byte0 & 0x80) ? 1 : 0;
+}
+
+//0x3E9 body status, bytes 2-3
+static inline float decodeSimulatedBodyStatus(const OBD2BroadcastPacket& packet)
+{
+  return (packet.Byte2 << 8) | packet.Byte3;
+}
+
+static inline void addSimulatedBroadcasts(OBD2TraceDecoder& decoder)
+{
+  decoder.addBroadcast(0x4B2, "wheelSpeedFrontLeft", decodeSimulatedWheelSpeed);
+  decoder.addBroadcast(0x0C9, "engineRunning", decodeSimulatedEngineRunning);
+  decoder.addBroadcast(0x3E9, "bodyStatus", decodeSimulatedBodyStatus);
+}
+
+#endif
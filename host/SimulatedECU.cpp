@@ -0,0 +1,454 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "SimulatedECU.h"
+
+SimulatedECU::SimulatedECU(VirtualClock& clock, const SimulatedECUConfig& config) :
+  _clock(clock),
+  _config(config),
+  _random(config.Seed ? config.Seed : 1)
+{
+  resetStats();
+}
+
+SimulatedECU::~SimulatedECU()
+{
+  detach();
+}
+
+void SimulatedECU::attach(VirtualCANBus& bus)
+{
+  detach();
+
+  _bus = &bus;
+  _bus->attach(this);
+}
+
+void SimulatedECU::detach()
+{
+  if (_bus) {
+    _bus->detach(this);
+    _bus = nullptr;
+  }
+
+  _generation++;
+  _state = TransferState::idle;
+}
+
+SimulatedECU::Entry& SimulatedECU::entry(uint8_t service, uint16_t pid)
+{
+  return _table[((uint32_t)service << 16) | pid];
+}
+
+void SimulatedECU::setPid(uint8_t service, uint16_t pid, const std::vector<uint8_t>& data)
+{
+  Entry& e = entry(service, pid);
+  e.Data = data;
+  e.Generate = nullptr;
+  e.NegativeCode = 0;
+}
+
+void SimulatedECU::setPid(uint8_t service, uint16_t pid, Generator generator)
+{
+  Entry& e = entry(service, pid);
+  e.Generate = generator;
+  e.NegativeCode = 0;
+}
+
+void SimulatedECU::setNegative(uint8_t service, uint16_t pid, uint8_t nrc)
+{
+  entry(service, pid).NegativeCode = nrc;
+}
+
+void SimulatedECU::setPending(uint8_t service, uint16_t pid, uint8_t count)
+{
+  entry(service, pid).PendingCount = count;
+}
+
+void SimulatedECU::setDropout(uint8_t service, uint16_t pid, float rate)
+{
+  entry(service, pid).DropoutRate = rate;
+}
+
+void SimulatedECU::removePid(uint8_t service, uint16_t pid)
+{
+  _table.erase(((uint32_t)service << 16) | pid);
+}
+
+void SimulatedECU::resetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void SimulatedECU::onBusFrame(const VirtualCANFrame& frame)
+{
+  if (frame.rtr || frame.dlc < 1) {
+    return;
+  }
+
+  if (frame.id != _config.RequestId && frame.id != _config.FunctionalId) {
+    return;
+  }
+
+  switch (frame.data[0] >> 4) {
+    case 0x0:
+      onRequest(frame);
+      break;
+
+    case 0x3:
+      onFlowControl(frame);
+      break;
+  }
+}
+
+void SimulatedECU::onRequest(const VirtualCANFrame& frame)
+{
+  uint8_t length = frame.data[0];
+
+  if (length < 1 || length > 7 || length >= frame.dlc) {
+    return;
+  }
+
+  uint8_t service = frame.data[1];
+  uint8_t pidBytes = length - 1 > 2 ? 2 : length - 1;
+  uint16_t pid = pidBytes == 2 ? (frame.data[2] << 8) | frame.data[3] : pidBytes == 1 ? frame.data[2] : 0;
+  bool functional = frame.id == _config.FunctionalId;
+
+  _stats.Requests++;
+
+  //a new request ends the running transfer, like a single-session ecu
+  if (_state != TransferState::idle) {
+    _stats.Aborted++;
+  }
+  uint32_t generation = ++_generation;
+  _state = TransferState::idle;
+  _extended = _config.ResponseId > 0x7FF;
+
+  auto found = _table.find(((uint32_t)service << 16) | pid);
+  const Entry* e = found != _table.end() ? &found->second : nullptr;
+
+  float dropout = e && e->DropoutRate >= 0 ? e->DropoutRate : _config.DropoutRate;
+  if (dropout > 0 && uniform() < dropout) {
+    _stats.Dropped++;
+    return;
+  }
+
+  uint8_t nrc = 0;
+  _payload.clear();
+
+  if (e && e->NegativeCode) {
+    nrc = e->NegativeCode;
+  } else if (!buildResponse(service, pid, pidBytes, _payload)) {
+    //legislated obd services stay silent on unsupported pids, uds refuses them
+    if (service == 0x01 || service == 0x09) {
+      return;
+    }
+
+    nrc = service == 0x22 ? 0x31 : 0x11; //requestOutOfRange, serviceNotSupported
+
+    //functional requests get no "not supported" answers
+    if (functional) {
+      return;
+    }
+  }
+
+  if (nrc) {
+    _payload = { 0x7F, service, nrc };
+    _stats.Negative++;
+  }
+
+  uint64_t latency = _config.Latency;
+  if (_config.LatencyJitter) {
+    latency += random() % (_config.LatencyJitter + 1);
+  }
+
+  uint8_t pending = e && !nrc ? e->PendingCount : 0;
+  _state = TransferState::responding;
+
+  schedule(latency, [this, generation, service, pending]() {
+    if (pending) {
+      sendPending(generation, service, pending);
+    } else {
+      startTransfer(generation);
+    }
+  });
+}
+
+bool SimulatedECU::buildResponse(uint8_t service, uint16_t pid, uint8_t pidBytes, std::vector<uint8_t>& payload)
+{
+  payload.push_back(service + 0x40);
+  if (pidBytes == 2) {
+    payload.push_back(pid >> 8);
+  }
+  if (pidBytes >= 1) {
+    payload.push_back(pid & 0xFF);
+  }
+
+  auto found = _table.find(((uint32_t)service << 16) | pid);
+
+  if (found == _table.end() || (found->second.Data.empty() && !found->second.Generate)) {
+    return (service == 0x01 || service == 0x09) && pidBytes == 1 && (pid % 0x20) == 0 && supportedPids(service, pid, payload);
+  }
+
+  if (found->second.Generate) {
+    std::vector<uint8_t> data;
+    found->second.Generate(data);
+    payload.insert(payload.end(), data.begin(), data.end());
+  } else {
+    payload.insert(payload.end(), found->second.Data.begin(), found->second.Data.end());
+  }
+
+  return true;
+}
+
+//pid 00/20/40...: bitmap of the next 32 pids in the table, bit 0 is "more pids above"
+bool SimulatedECU::supportedPids(uint8_t service, uint16_t base, std::vector<uint8_t>& payload)
+{
+  uint32_t bitmap = 0;
+
+  for (auto& item : _table) {
+    if ((item.first >> 16) != service || item.second.NegativeCode) {
+      continue;
+    }
+
+    uint16_t pid = item.first & 0xFFFF;
+
+    if (pid > base && pid <= base + 0x20) {
+      bitmap |= 1UL << (0x20 - (pid - base));
+    } else if (pid > base + 0x20 && pid <= 0xFF) {
+      bitmap |= 1;
+    }
+  }
+
+  if (!bitmap && base != 0) {
+    return false;
+  }
+
+  payload.push_back(bitmap >> 24);
+  payload.push_back(bitmap >> 16);
+  payload.push_back(bitmap >> 8);
+  payload.push_back(bitmap);
+
+  return true;
+}
+
+void SimulatedECU::sendPending(uint32_t generation, uint8_t service, uint8_t count)
+{
+  if (generation != _generation) {
+    return;
+  }
+
+  uint8_t data[] = { 0x03, 0x7F, service, 0x78 };
+  sendFrame(data, sizeof(data));
+  _stats.Pending++;
+
+  schedule(_config.PendingInterval, [this, generation, service, count]() {
+    if (count > 1) {
+      sendPending(generation, service, count - 1);
+    } else {
+      startTransfer(generation);
+    }
+  });
+}
+
+void SimulatedECU::startTransfer(uint32_t generation)
+{
+  if (generation != _generation) {
+    return;
+  }
+
+  uint8_t data[8];
+  size_t length = _payload.size();
+
+  _stats.Responses++;
+
+  //single frame
+  if (length <= 7) {
+    data[0] = length;
+    memcpy(data + 1, _payload.data(), length);
+    sendFrame(data, length + 1);
+    _state = TransferState::idle;
+    return;
+  }
+
+  //first frame, then wait for the tester flow control
+  if (length > 0xFFF) {
+    length = 0xFFF;
+    _payload.resize(length);
+  }
+
+  data[0] = 0x10 | (length >> 8);
+  data[1] = length & 0xFF;
+  memcpy(data + 2, _payload.data(), 6);
+  sendFrame(data, 8);
+
+  _offset = 6;
+  _sequence = 1;
+  waitFlowControl();
+}
+
+void SimulatedECU::waitFlowControl()
+{
+  uint32_t generation = _generation;
+  uint32_t wait = ++_flowControlWait;
+
+  _state = TransferState::waitFlowControl;
+
+  schedule(_config.FlowControlTimeout, [this, generation, wait]() {
+    if (generation != _generation || wait != _flowControlWait || _state != TransferState::waitFlowControl) {
+      return;
+    }
+
+    //N_Bs timeout: the transfer is abandoned
+    _stats.FlowControlTimeouts++;
+    _state = TransferState::idle;
+  });
+}
+
+void SimulatedECU::onFlowControl(const VirtualCANFrame& frame)
+{
+  if (_state != TransferState::waitFlowControl || frame.dlc < 3) {
+    return;
+  }
+
+  _stats.FlowControls++;
+
+  switch (frame.data[0] & 0x0F) {
+    case 0x0: { //continue to send
+      uint32_t generation = _generation;
+
+      _flowControlWait++;
+      _blockSize = frame.data[1];
+      _blockCount = 0;
+      _separation = separationTime(frame.data[2]);
+      _state = TransferState::sending;
+
+      schedule(_config.FrameGap, [this, generation]() { sendConsecutiveFrame(generation); });
+      break;
+    }
+
+    case 0x1: //wait
+      waitFlowControl();
+      break;
+
+    default: //overflow or invalid
+      _flowControlWait++;
+      _stats.Aborted++;
+      _state = TransferState::idle;
+      break;
+  }
+}
+
+void SimulatedECU::sendConsecutiveFrame(uint32_t generation)
+{
+  if (generation != _generation || _state != TransferState::sending) {
+    return;
+  }
+
+  uint8_t data[8];
+  size_t length = std::min<size_t>(7, _payload.size() - _offset);
+
+  data[0] = 0x20 | (_sequence & 0x0F);
+  memcpy(data + 1, _payload.data() + _offset, length);
+  sendFrame(data, length + 1);
+
+  _offset += length;
+  _sequence++;
+
+  if (_offset >= _payload.size()) {
+    _state = TransferState::idle;
+    return;
+  }
+
+  if (_blockSize && ++_blockCount >= _blockSize) {
+    waitFlowControl();
+    return;
+  }
+
+  //STmin counts from the end of the frame on the bus
+  uint64_t now = _clock.now();
+  uint64_t end = _busFree > now ? _busFree - now : 0;
+
+  schedule(end + std::max(_separation, _config.FrameGap), [this, generation]() { sendConsecutiveFrame(generation); });
+}
+
+//frames are padded to 8 bytes and serialized on the bus, each lands after its transmission time
+void SimulatedECU::sendFrame(const uint8_t* data, uint8_t length)
+{
+  if (!_bus) {
+    return;
+  }
+
+  VirtualCANFrame frame;
+  frame.id = _config.ResponseId;
+  frame.extended = _extended;
+  frame.rtr = false;
+  frame.dlc = 8;
+  memset(frame.data, _config.Padding, sizeof(frame.data));
+  memcpy(frame.data, data, length);
+
+  uint64_t now = _clock.now();
+  uint64_t start = _busFree > now ? _busFree : now;
+  _busFree = start + frameDuration();
+  _stats.Frames++;
+
+  VirtualCANBus* bus = _bus;
+  scheduleAt(_busFree, [this, bus, frame]() {
+    if (bus == _bus) {
+      bus->transmit(frame, this);
+    }
+  });
+}
+
+void SimulatedECU::schedule(uint64_t delay, std::function<void()> callback)
+{
+  scheduleAt(_clock.now() + delay, callback);
+}
+
+void SimulatedECU::scheduleAt(uint64_t at, std::function<void()> callback)
+{
+  std::weak_ptr<int> alive = _alive;
+
+  _clock.schedule(at, [alive, callback]() {
+    if (!alive.expired()) {
+      callback();
+    }
+  });
+}
+
+//nominal length of an 8 byte data frame with interframe space, stuff bits not counted
+uint32_t SimulatedECU::frameDuration() const
+{
+  if (!_config.Bitrate) {
+    return 0;
+  }
+
+  uint32_t bits = (_extended ? 67 : 47) + 64;
+  return (uint32_t)((uint64_t)bits * 1000000 / _config.Bitrate);
+}
+
+//ISO 15765-2 STmin: 0x00-0x7F ms, 0xF1-0xF9 100-900 us, reserved values mean the maximum
+uint32_t SimulatedECU::separationTime(uint8_t stmin) const
+{
+  if (stmin <= 0x7F) {
+    return stmin * 1000UL;
+  }
+
+  if (stmin >= 0xF1 && stmin <= 0xF9) {
+    return (stmin - 0xF0) * 100UL;
+  }
+
+  return 127000UL;
+}
+
+//xorshift32, the same seed replays the same dropouts and jitter
+uint32_t SimulatedECU::random()
+{
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return _random;
+}
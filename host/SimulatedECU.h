@@ -0,0 +1,124 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Scriptable ECU on the virtual bus: answers mode 01/09 and UDS 0x22 from a table, with response
+ * latency, ISO-TP multi-frame replies honoring the tester flow control (BS/STmin), negative
+ * responses, 0x78 response pending and dropouts. Timing runs on a VirtualClock, so a run is
+ * fast and, for a given seed, always the same.
+ */
+
+#ifndef SIMULATED_ECU_H
+#define SIMULATED_ECU_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "HostClock.h"
+#include "VirtualCAN.h"
+
+struct SimulatedECUConfig {
+  long RequestId = 0x7E0;              //physical request id
+  long FunctionalId = 0x7DF;           //functional request id, -1 for none
+  long ResponseId = 0x7E8;
+  uint32_t Latency = 5000;             //us from request to first response frame
+  uint32_t LatencyJitter = 0;          //us, uniform random 0..jitter added to Latency
+  uint32_t FrameGap = 0;               //us, minimum gap between consecutive frames
+  uint32_t FlowControlTimeout = 1000000; //us the ecu waits for flow control (N_Bs)
+  uint32_t PendingInterval = 50000;    //us between 0x78 responses
+  uint32_t Bitrate = 500000;           //bus speed for frame durations, 0 for instant frames
+  float DropoutRate = 0;               //probability a request gets no answer
+  uint8_t Padding = 0xAA;
+  uint32_t Seed = 1;
+};
+
+struct SimulatedECUStats {
+  uint64_t Requests;
+  uint64_t Responses;
+  uint64_t Frames;
+  uint64_t Dropped;
+  uint64_t Negative;
+  uint64_t Pending;
+  uint64_t FlowControls;
+  uint64_t FlowControlTimeouts;
+  uint64_t Aborted;                    //transfer replaced by a new request or refused by the tester
+};
+
+class SimulatedECU : public VirtualCANNode {
+public:
+  typedef std::function<void(std::vector<uint8_t>& data)> Generator;
+
+  SimulatedECU(VirtualClock& clock, const SimulatedECUConfig& config = SimulatedECUConfig());
+  virtual ~SimulatedECU();
+
+  void attach(VirtualCANBus& bus);
+  void detach();
+
+  //table: data bytes after service and pid
+  void setPid(uint8_t service, uint16_t pid, const std::vector<uint8_t>& data);
+  void setPid(uint8_t service, uint16_t pid, Generator generator); //fresh data on every request
+  void setNegative(uint8_t service, uint16_t pid, uint8_t nrc);
+  void setPending(uint8_t service, uint16_t pid, uint8_t count); //0x78 responses before the answer
+  void setDropout(uint8_t service, uint16_t pid, float rate);    //overrides the config rate
+  void removePid(uint8_t service, uint16_t pid);
+
+  SimulatedECUConfig& config() { return _config; }
+  const SimulatedECUStats& stats() const { return _stats; }
+  void resetStats();
+
+  void onBusFrame(const VirtualCANFrame& frame) override;
+
+private:
+  struct Entry {
+    std::vector<uint8_t> Data;
+    Generator Generate;
+    uint8_t NegativeCode = 0;
+    uint8_t PendingCount = 0;
+    float DropoutRate = -1;
+  };
+
+  enum class TransferState { idle, responding, waitFlowControl, sending };
+
+  Entry& entry(uint8_t service, uint16_t pid);
+  void onRequest(const VirtualCANFrame& frame);
+  void onFlowControl(const VirtualCANFrame& frame);
+  bool buildResponse(uint8_t service, uint16_t pid, uint8_t pidBytes, std::vector<uint8_t>& payload);
+  bool supportedPids(uint8_t service, uint16_t base, std::vector<uint8_t>& payload);
+  void sendPending(uint32_t generation, uint8_t service, uint8_t count);
+  void startTransfer(uint32_t generation);
+  void sendConsecutiveFrame(uint32_t generation);
+  void waitFlowControl();
+  void sendFrame(const uint8_t* data, uint8_t length);
+  void schedule(uint64_t delay, std::function<void()> callback);
+  void scheduleAt(uint64_t at, std::function<void()> callback);
+  uint32_t frameDuration() const;
+  uint32_t separationTime(uint8_t stmin) const;
+  uint32_t random();
+  float uniform() { return (random() >> 8) * (1.0f / 16777216.0f); }
+
+  VirtualClock& _clock;
+  SimulatedECUConfig _config;
+  SimulatedECUStats _stats;
+  VirtualCANBus* _bus = nullptr;
+  std::map<uint32_t, Entry> _table;     //key: service << 16 | pid
+  uint32_t _random;
+  uint64_t _busFree = 0;                //end of the last frame we put on the bus
+  std::shared_ptr<int> _alive = std::make_shared<int>(0); //timers outliving the ecu do nothing
+
+  //current transfer, a new request or an abort bumps the generation and stale timers do nothing
+  uint32_t _generation = 0;
+  TransferState _state = TransferState::idle;
+  bool _extended = false;
+  std::vector<uint8_t> _payload;
+  size_t _offset = 0;
+  uint8_t _sequence = 0;
+  uint8_t _blockSize = 0;
+  uint8_t _blockCount = 0;
+  uint32_t _separation = 0;
+  uint32_t _flowControlWait = 0;        //serial of the running N_Bs timer
+};
+
+#endif
@@ -0,0 +1,32 @@
+// Generated by tools/obd2_profile.py from simulated_ecus.csv, do not edit.
+// Bus budget @500000 bit/s: 8.7 requests/s, 2409 bit/s, 0.48% bus load (worst case stuffing)
+
+#ifndef OBD2_PROFILE_SIMULATED_ECUS_H
+#define OBD2_PROFILE_SIMULATED_ECUS_H
+
+#include "OBD2.h"
+
+#define SIMULATED_ECUS_COOLANTTEMPERATURE 0
+#define SIMULATED_ECUS_ENGINESPEED 1
+#define SIMULATED_ECUS_VEHICLESPEED 2
+#define SIMULATED_ECUS_BATTERYVOLTAGE 3
+#define SIMULATED_ECUS_DOORLOG 4
+#define SIMULATED_ECUS_COUNT 5
+
+//Group, Name, AlwaysSendHeader, Header, Service, Pid, ExpectedBytes, ScaleFactor, AdjustFactor, ReadInterval
+static const OBD2RequestDescriptor simulated_ecus_requests[] = {
+  { "Engine", "coolantTemperature", false, 0x7E0, 0x01, 0x0005, 1, 1.0f, -40.0f, 2000 },
+  { "Engine", "engineSpeed", false, 0x7E0, 0x01, 0x000C, 2, 0.25f, 0.0f, 200 },
+  { "Engine", "vehicleSpeed", false, 0x7E0, 0x01, 0x000D, 1, 1.0f, 0.0f, 500 },
+  { "Body", "batteryVoltage", true, 0x18DA40F1, 0x22, 0x1955, 2, 0.001f, 0.0f, 1000 },
+  { "Body", "doorLog", true, 0x18DA40F1, 0x22, 0x4001, 2, 1.0f, 0.0f, 5000 },
+};
+
+static const uint16_t simulated_ecus_index[16] = {
+  0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x0002, 0xFFFF, 0xFFFF, 0xFFFF,
+  0xFFFF, 0xFFFF, 0xFFFF, 0x0000, 0x0001, 0x0003, 0xFFFF, 0x0004,
+};
+
+static const OBD2Profile simulated_ecus_profile = { "simulated_ecus", simulated_ecus_requests, 5, simulated_ecus_index, 0xF };
+
+#endif
@@ -0,0 +1,347 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TraceFile.h"
+
+TraceFile::~TraceFile()
+{
+  close();
+}
+
+bool TraceFile::open(const char* path)
+{
+  close();
+
+  _fd = ::open(path, O_RDONLY);
+  if (_fd < 0) {
+    _error = std::string(path) + ": " + strerror(errno);
+    return false;
+  }
+
+  struct stat st;
+  fstat(_fd, &st);
+  _size = st.st_size;
+
+  uint8_t header[OBD2_TRACE_HEADER_SIZE];
+  if (!readAt(0, header, sizeof(header))) {
+    _error = std::string(path) + ": not a trace";
+    close();
+    return false;
+  }
+
+  if (memcmp(header, "O2TR", 4) == 0 && header[4] == OBD2_TRACE_VERSION) {
+    _compressed = false;
+  } else if (memcmp(header, "O2TC", 4) == 0 && header[4] == OBD2_TRACE_BLOCK_VERSION) {
+    _compressed = true;
+    _dataEnd = _size;
+    loadIndex();
+  } else {
+    _error = std::string(path) + ": not a trace";
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void TraceFile::close()
+{
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
+
+  _index.clear();
+  _blocks.clear();
+  _scanned = false;
+  _size = 0;
+  _dataEnd = 0;
+}
+
+bool TraceFile::readAt(uint64_t offset, void* buffer, size_t length) const
+{
+  if (offset + length > _size) {
+    return false;
+  }
+
+  uint8_t* p = (uint8_t*)buffer;
+
+  while (length > 0) {
+    ssize_t n = pread(_fd, p, length, offset);
+    if (n <= 0) {
+      return false;
+    }
+
+    p += n;
+    offset += n;
+    length -= n;
+  }
+
+  return true;
+}
+
+//trailer and entries checked by CRC, a file cut short has none: headers are scanned instead
+bool TraceFile::loadIndex()
+{
+  uint8_t trailer[OBD2_TRACE_TRAILER_SIZE];
+  if (_size < OBD2_TRACE_HEADER_SIZE + OBD2_TRACE_TRAILER_SIZE || !readAt(_size - sizeof(trailer), trailer, sizeof(trailer))) {
+    return false;
+  }
+
+  if (memcmp(trailer, "O2IX", 4) != 0) {
+    return false;
+  }
+
+  uint32_t count = OBD2TraceFormat::getUint32(trailer + 4);
+  uint64_t offset = OBD2TraceFormat::getUint64(trailer + 8);
+  uint32_t crc = OBD2TraceFormat::getUint32(trailer + 16);
+
+  if (offset + (uint64_t)count * OBD2_TRACE_INDEX_ENTRY_SIZE + sizeof(trailer) != _size) {
+    return false;
+  }
+
+  std::vector<uint8_t> bytes(count * OBD2_TRACE_INDEX_ENTRY_SIZE);
+  if (!readAt(offset, bytes.data(), bytes.size()) || OBD2TraceFormat::crc32(bytes.data(), bytes.size()) != crc) {
+    return false;
+  }
+
+  _index.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    OBD2TraceFormat::parseIndexEntry(bytes.data() + i * OBD2_TRACE_INDEX_ENTRY_SIZE, _index[i]);
+  }
+
+  _dataEnd = offset;
+  return true;
+}
+
+bool TraceFile::readHeaderAt(uint64_t offset, TraceBlock& block) const
+{
+  uint8_t bytes[OBD2_TRACE_BLOCK_HEADER_SIZE];
+
+  if (offset + sizeof(bytes) > _dataEnd || !readAt(offset, bytes, sizeof(bytes))) {
+    return false;
+  }
+
+  if (!OBD2TraceFormat::parseHeader(bytes, block.Header)) {
+    return false;
+  }
+
+  block.Offset = offset;
+  return offset + sizeof(bytes) + block.Header.Length <= _dataEnd;
+}
+
+//next "O2BK" after damaged data
+bool TraceFile::resync(uint64_t& offset) const
+{
+  uint8_t chunk[65536];
+
+  for (uint64_t at = offset + 1; at + 4 <= _dataEnd; at += sizeof(chunk) - 3) {
+    size_t n = std::min((uint64_t)sizeof(chunk), _dataEnd - at);
+    if (!readAt(at, chunk, n)) {
+      return false;
+    }
+
+    for (size_t i = 0; i + 4 <= n; i++) {
+      if (memcmp(chunk + i, "O2BK", 4) == 0) {
+        offset = at + i;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool TraceFile::scanBlocks(uint64_t from, uint64_t to, std::vector<TraceBlock>& found, uint32_t maxBlocks) const
+{
+  uint64_t offset = from;
+
+  while (offset < to && maxBlocks > 0) {
+    TraceBlock block;
+
+    if (!readHeaderAt(offset, block)) {
+      if (!resync(offset)) {
+        break;
+      }
+      continue;
+    }
+
+    found.push_back(block);
+    offset += OBD2_TRACE_BLOCK_HEADER_SIZE + block.Header.Length;
+    maxBlocks--;
+  }
+
+  return !found.empty();
+}
+
+const std::vector<TraceBlock>& TraceFile::blocks()
+{
+  if (_compressed && !_scanned) {
+    _blocks.clear();
+    scanBlocks(OBD2_TRACE_HEADER_SIZE, _dataEnd, _blocks);
+    _scanned = true;
+  }
+
+  return _blocks;
+}
+
+bool TraceFile::readBlock(const TraceBlock& block, std::vector<TraceRecord>& records, bool checkCrc) const
+{
+  uint8_t payload[OBD2_TRACE_BLOCK_SIZE];
+
+  if (!readAt(block.Offset + OBD2_TRACE_BLOCK_HEADER_SIZE, payload, block.Header.Length)) {
+    return false;
+  }
+
+  OBD2TraceBlockDecoder decoder;
+  if (!decoder.begin(block.Header, payload, checkCrc)) {
+    return false;
+  }
+
+  TraceRecord record;
+  uint16_t frames = 0;
+
+  while (decoder.next(record.Time, record.Frame)) {
+    records.push_back(record);
+    frames++;
+  }
+
+  return frames == block.Header.Frames;
+}
+
+bool TraceFile::seek(uint64_t time, TraceBlock& block)
+{
+  if (!_compressed) {
+    return false;
+  }
+
+  uint64_t from = OBD2_TRACE_HEADER_SIZE;
+
+  //sparse index: headers are read only inside the entry holding time
+  if (!_index.empty() && !_scanned) {
+    auto entry = std::lower_bound(_index.begin(), _index.end(), time,
+      [](const OBD2TraceIndexEntry& e, uint64_t t) { return e.LastTime < t; });
+
+    if (entry == _index.end()) {
+      return false;
+    }
+
+    from = entry->Offset;
+    std::vector<TraceBlock> found;
+    scanBlocks(from, _dataEnd, found, entry->Blocks);
+
+    for (const TraceBlock& b : found) {
+      if (b.Header.lastTime() >= time) {
+        block = b;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  const std::vector<TraceBlock>& all = blocks();
+  auto it = std::lower_bound(all.begin(), all.end(), time,
+    [](const TraceBlock& b, uint64_t t) { return b.Header.lastTime() < t; });
+
+  if (it == all.end()) {
+    return false;
+  }
+
+  block = *it;
+  return true;
+}
+
+void TraceFile::findBlocks(long id, bool extended, std::vector<TraceBlock>& found)
+{
+  if (!_compressed) {
+    return;
+  }
+
+  //index entries first: a whole range is skipped when its bloom has no bit for id
+  if (!_index.empty() && !_scanned) {
+    for (const OBD2TraceIndexEntry& entry : _index) {
+      if (!entry.mayContain(id, extended)) {
+        continue;
+      }
+
+      std::vector<TraceBlock> range;
+      scanBlocks(entry.Offset, _dataEnd, range, entry.Blocks);
+
+      for (const TraceBlock& b : range) {
+        if (b.Header.mayContain(id, extended)) {
+          found.push_back(b);
+        }
+      }
+    }
+
+    return;
+  }
+
+  for (const TraceBlock& b : blocks()) {
+    if (b.Header.mayContain(id, extended)) {
+      found.push_back(b);
+    }
+  }
+}
+
+bool TraceFile::readAll(std::vector<TraceRecord>& records)
+{
+  if (_compressed) {
+    bool intact = true;
+
+    for (const TraceBlock& b : blocks()) {
+      intact &= readBlock(b, records);
+    }
+
+    return intact;
+  }
+
+  //plain format: 32 bit timestamps unwrapped on the way
+  std::vector<uint8_t> bytes(_size - OBD2_TRACE_HEADER_SIZE);
+  if (!readAt(OBD2_TRACE_HEADER_SIZE, bytes.data(), bytes.size())) {
+    return false;
+  }
+
+  size_t position = 0;
+  uint64_t time = 0;
+  uint32_t last = 0;
+  bool first = true;
+
+  while (position + 9 <= bytes.size()) {
+    TraceRecord record;
+    const uint8_t* p = bytes.data() + position;
+    uint32_t id = OBD2TraceFormat::getUint32(p + 4);
+
+    record.Frame.Timestamp = OBD2TraceFormat::getUint32(p);
+    record.Frame.Extended = (id & OBD2_TRACE_EXTENDED_FLAG) != 0;
+    record.Frame.Rtr = (id & OBD2_TRACE_RTR_FLAG) != 0;
+    record.Frame.Id = id & OBD2_HEADER_MASK;
+    record.Frame.Dlc = p[8] > 8 ? 8 : p[8];
+    memset(record.Frame.Data, 0, sizeof(record.Frame.Data));
+
+    size_t length = 9 + (record.Frame.Rtr ? 0 : record.Frame.Dlc);
+    if (position + length > bytes.size()) {
+      break;
+    }
+
+    memcpy(record.Frame.Data, p + 9, length - 9);
+
+    time = first ? record.Frame.Timestamp : time + (uint32_t)(record.Frame.Timestamp - last);
+    last = record.Frame.Timestamp;
+    first = false;
+
+    record.Time = time;
+    records.push_back(record);
+    position += length;
+  }
+
+  return position == bytes.size();
+}
@@ -0,0 +1,74 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Trace decoder for workstations: plain (O2TR) and compressed block (O2TC) traces.
+ * Compressed traces are read block by block with pread, so blocks can be decoded from several
+ * threads at once. seek() uses the sparse index at the end of the file when there is one
+ * (a file closed properly), the block headers otherwise; findBlocks() skips blocks by ID bloom filter.
+ */
+
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <string>
+#include <vector>
+
+#include "OBD2TraceBlock.h"
+
+struct TraceRecord {
+  uint64_t Time;                       //us, unwrapped micros() of the recorder
+  OBD2TraceFrame Frame;
+};
+
+struct TraceBlock {
+  uint64_t Offset;                     //file offset of the block header
+  OBD2TraceBlockHeader Header;
+};
+
+class TraceFile {
+public:
+  TraceFile() {}
+  ~TraceFile();
+
+  bool open(const char* path);
+  void close();
+
+  bool compressed() const { return _compressed; }
+  bool hasIndex() const { return !_index.empty(); }
+  const std::vector<OBD2TraceIndexEntry>& index() const { return _index; }
+  uint64_t size() const { return _size; }
+  const std::string& error() const { return _error; }
+
+  //compressed: every block, scanning the headers on first use (payloads are skipped)
+  const std::vector<TraceBlock>& blocks();
+  //compressed, thread safe: appends the frames of a block, false on a CRC mismatch or corrupt data
+  bool readBlock(const TraceBlock& block, std::vector<TraceRecord>& records, bool checkCrc = true) const;
+
+  //compressed: first block ending at or after time, false past the end
+  bool seek(uint64_t time, TraceBlock& block);
+  //compressed: blocks that may hold an id, by bloom filter
+  void findBlocks(long id, bool extended, std::vector<TraceBlock>& found);
+
+  //any format: all frames in order (blocks failing the CRC are skipped)
+  bool readAll(std::vector<TraceRecord>& records);
+
+private:
+  bool readAt(uint64_t offset, void* buffer, size_t length) const;
+  bool readHeaderAt(uint64_t offset, TraceBlock& block) const;
+  bool resync(uint64_t& offset) const;
+  bool loadIndex();
+  bool scanBlocks(uint64_t from, uint64_t to, std::vector<TraceBlock>& found, uint32_t maxBlocks = 0xFFFFFFFF) const;
+
+  int _fd = -1;
+  bool _compressed = false;
+  uint64_t _size = 0;
+  uint64_t _dataEnd = 0;               //end of the blocks: index offset or file size
+  std::vector<OBD2TraceIndexEntry> _index;
+  std::vector<TraceBlock> _blocks;
+  bool _scanned = false;
+  std::string _error;
+};
+
+#endif
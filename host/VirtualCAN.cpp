@@ -0,0 +1,250 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "VirtualCAN.h"
+
+void VirtualCANBus::attach(VirtualCANNode* node)
+{
+  if (std::find(_nodes.begin(), _nodes.end(), node) == _nodes.end()) {
+    _nodes.push_back(node);
+  }
+}
+
+void VirtualCANBus::detach(VirtualCANNode* node)
+{
+  _nodes.erase(std::remove(_nodes.begin(), _nodes.end(), node), _nodes.end());
+}
+
+void VirtualCANBus::transmit(const VirtualCANFrame& frame, VirtualCANNode* sender)
+{
+  _queue.push_back({ frame, sender });
+  _frames++;
+
+  if (_dispatching) {
+    return;
+  }
+
+  _dispatching = true;
+
+  while (!_queue.empty()) {
+    Pending p = _queue.front();
+    _queue.pop_front();
+
+    for (size_t i = 0; i < _nodes.size(); i++) {
+      if (_nodes[i] != p.sender) {
+        _nodes[i]->onBusFrame(p.frame);
+      }
+    }
+  }
+
+  _dispatching = false;
+}
+
+VirtualCANControllerClass::VirtualCANControllerClass() :
+  CANControllerClass(),
+  _bus(NULL),
+  _begun(false),
+  _loopback(false),
+  _listenOnly(false),
+  _filterExtended(false),
+  _filterId(0),
+  _filterMask(0)
+{
+}
+
+VirtualCANControllerClass::~VirtualCANControllerClass()
+{
+  if (_bus) {
+    _bus->detach(this);
+  }
+}
+
+void VirtualCANControllerClass::setBus(VirtualCANBus& bus)
+{
+  if (_bus) {
+    _bus->detach(this);
+  }
+
+  _bus = &bus;
+
+  if (_begun) {
+    _bus->attach(this);
+  }
+}
+
+int VirtualCANControllerClass::begin(long baudRate)
+{
+  CANControllerClass::begin(baudRate);
+
+  if (!_bus) {
+    _bus = &CANBus;
+  }
+
+  _bus->attach(this);
+  _begun = true;
+  _loopback = false;
+  _listenOnly = false;
+  _filterMask = 0;
+  _rxQueue.clear();
+
+  return 1;
+}
+
+void VirtualCANControllerClass::end()
+{
+  if (_bus) {
+    _bus->detach(this);
+  }
+
+  _begun = false;
+  _rxQueue.clear();
+
+  CANControllerClass::end();
+}
+
+int VirtualCANControllerClass::endPacket()
+{
+  if (!CANControllerClass::endPacket()) {
+    return 0;
+  }
+
+  if (!_begun || _listenOnly) {
+    return 0;
+  }
+
+  VirtualCANFrame frame;
+  frame.id = _txId;
+  frame.extended = _txExtended;
+  frame.rtr = _txRtr;
+  frame.dlc = _txLength;
+  memset(frame.data, 0, sizeof(frame.data));
+  if (!_txRtr) {
+    memcpy(frame.data, _txData, _txLength);
+  }
+
+  if (_loopback) {
+    onBusFrame(frame);
+  } else {
+    _bus->transmit(frame, this);
+  }
+
+  return 1;
+}
+
+int VirtualCANControllerClass::parsePacket()
+{
+  if (_rxQueue.empty()) {
+    _rxId = -1;
+    _rxExtended = false;
+    _rxRtr = false;
+    _rxLength = 0;
+    _rxIndex = 0;
+    return 0;
+  }
+
+  load(_rxQueue.front());
+  _rxQueue.pop_front();
+
+  return _rxDlc;
+}
+
+void VirtualCANControllerClass::onReceive(void(*callback)(int))
+{
+  CANControllerClass::onReceive(callback);
+}
+
+void VirtualCANControllerClass::onReceive(CANHandler* handler)
+{
+  CANControllerClass::onReceive(handler);
+}
+
+int VirtualCANControllerClass::filter(int id, int mask)
+{
+  _filterExtended = false;
+  _filterId = id & 0x7ff;
+  _filterMask = mask & 0x7ff;
+
+  return 1;
+}
+
+int VirtualCANControllerClass::filterExtended(long id, long mask)
+{
+  _filterExtended = true;
+  _filterId = id & 0x1FFFFFFF;
+  _filterMask = mask & 0x1FFFFFFF;
+
+  return 1;
+}
+
+int VirtualCANControllerClass::observe()
+{
+  _listenOnly = true;
+
+  return 1;
+}
+
+int VirtualCANControllerClass::loopback()
+{
+  _loopback = true;
+
+  return 1;
+}
+
+bool VirtualCANControllerClass::accept(const VirtualCANFrame& frame)
+{
+  if (_filterMask == 0) {
+    return true;
+  }
+
+  return frame.extended == _filterExtended && (frame.id & _filterMask) == (_filterId & _filterMask);
+}
+
+void VirtualCANControllerClass::load(const RxFrame& rx)
+{
+  const VirtualCANFrame& frame = rx.frame;
+
+  _rxId = frame.id;
+  _rxExtended = frame.extended;
+  _rxRtr = frame.rtr;
+  _rxDlc = frame.dlc;
+  _rxIndex = 0;
+  _rxLength = frame.rtr ? 0 : frame.dlc;
+  memcpy(_rxData, frame.data, sizeof(_rxData));
+  _rxTimestamp = rx.timestamp;
+}
+
+void VirtualCANControllerClass::onBusFrame(const VirtualCANFrame& frame)
+{
+  if (!_begun || !accept(frame)) {
+    return;
+  }
+
+  _rxQueue.push_back({ frame, (uint32_t)micros() });
+
+  if (_CanHandler != NULL || _onReceive != NULL) {
+    dispatch();
+  }
+}
+
+//same as the receive interrupt of the hardware drivers
+void VirtualCANControllerClass::dispatch()
+{
+  // dlc 0 frames make parsePacket() return 0
+  while (!_rxQueue.empty()) {
+    parsePacket();
+
+    if (_CanHandler != NULL) {
+      _CanHandler->onReceivePacket(available());
+    } else {
+      _onReceive(available());
+    }
+  }
+}
+
+VirtualCANBus CANBus;
+#ifndef OBD2_SOCKETCAN
+VirtualCANControllerClass CAN;
+#endif
@@ -0,0 +1,111 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * In-process CAN bus: every frame sent by a node is delivered to all other nodes.
+ * VirtualCANControllerClass is the CANControllerClass backend of the host build (global CAN).
+ */
+
+#ifndef VIRTUAL_CAN_H
+#define VIRTUAL_CAN_H
+
+#include <deque>
+#include <vector>
+
+#include "CANController.h"
+
+struct VirtualCANFrame {
+  long id;
+  bool extended;
+  bool rtr;
+  uint8_t dlc;
+  uint8_t data[8];
+};
+
+class VirtualCANNode {
+public:
+  virtual ~VirtualCANNode() {}
+  virtual void onBusFrame(const VirtualCANFrame& frame) = 0;
+};
+
+class VirtualCANBus {
+public:
+  void attach(VirtualCANNode* node);
+  void detach(VirtualCANNode* node);
+
+  //frames sent while delivering are queued, so nodes are never re-entered
+  void transmit(const VirtualCANFrame& frame, VirtualCANNode* sender);
+
+  uint64_t framesTransmitted() const { return _frames; }
+
+private:
+  struct Pending {
+    VirtualCANFrame frame;
+    VirtualCANNode* sender;
+  };
+
+  std::vector<VirtualCANNode*> _nodes;
+  std::deque<Pending> _queue;
+  bool _dispatching = false;
+  uint64_t _frames = 0;
+};
+
+class VirtualCANControllerClass : public CANControllerClass, public VirtualCANNode {
+
+public:
+  VirtualCANControllerClass();
+  virtual ~VirtualCANControllerClass();
+
+  void setBus(VirtualCANBus& bus);
+
+  virtual int begin(long baudRate);
+  virtual void end();
+
+  virtual int endPacket();
+
+  virtual int parsePacket();
+
+  virtual void onReceive(void(*callback)(int));
+  virtual void onReceive(CANHandler* handler);
+
+  using CANControllerClass::filter;
+  virtual int filter(int id, int mask);
+  using CANControllerClass::filterExtended;
+  virtual int filterExtended(long id, long mask);
+
+  virtual int observe();
+  virtual int loopback();
+
+  void onBusFrame(const VirtualCANFrame& frame) override;
+
+  size_t pendingFrames() const { return _rxQueue.size(); }
+
+private:
+  struct RxFrame {
+    VirtualCANFrame frame;
+    uint32_t timestamp; // micros() when it reached the controller
+  };
+
+  bool accept(const VirtualCANFrame& frame);
+  void load(const RxFrame& rx);
+  void dispatch();
+
+private:
+  VirtualCANBus* _bus;
+  bool _begun;
+  bool _loopback;
+  bool _listenOnly;
+  bool _filterExtended;
+  long _filterId;
+  long _filterMask;
+  std::deque<RxFrame> _rxQueue;
+};
+
+//default bus of the global CAN controller
+extern VirtualCANBus CANBus;
+#ifndef OBD2_SOCKETCAN
+extern VirtualCANControllerClass CAN;
+#endif
+
+#endif
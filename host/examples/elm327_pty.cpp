@@ -0,0 +1,95 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * ELM327 emulator on a pseudo-terminal, in real time: point any ELM327 client (or screen/minicom)
+ * at the printed device. Behind it, an engine ECU answers a few mode 01 and mode 09 pids on 7E0/7E8.
+ * Usage: elm327_pty [baudrate] [link latency us]
+ */
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "ELM327Emulator.h"
+#include "SimulatedECU.h"
+
+int main(int argc, char** argv)
+{
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    perror("posix_openpt");
+    return 1;
+  }
+
+  //raw line discipline, kept open so the terminal does not hang up between clients
+  const char* device = ptsname(master);
+  int slave = open(device, O_RDWR | O_NOCTTY);
+  if (slave < 0) {
+    perror(device);
+    return 1;
+  }
+
+  struct termios tio;
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+  VirtualClock clock;
+
+  SimulatedECU ecu(clock);
+  uint16_t rpm = 3200;
+  ecu.setPid(0x01, 0x0C, [&rpm](std::vector<uint8_t>& data) {
+    rpm = rpm >= 16000 ? 3200 : rpm + 40; //quarter rpm units: 800..4000 rpm
+    data = { (uint8_t)(rpm >> 8), (uint8_t)rpm };
+  });
+  ecu.setPid(0x01, 0x0D, { 0x32 });
+  ecu.setPid(0x01, 0x05, { 0x7B });
+  ecu.setPid(0x01, 0x11, { 0x33 });
+  ecu.setPid(0x09, 0x02, { 0x01, 'Z', 'A', 'R', 'P', 'A', 'G', 'B', 'X', '0', 'K', '7', '1', '2', '3', '4', '5', '6' });
+  ecu.attach(CANBus);
+
+  ELM327EmulatorConfig config;
+  config.BaudRate = argc > 1 ? strtoul(argv[1], NULL, 10) : 38400;
+  config.LinkLatency = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+  ELM327Emulator elm(clock, config);
+  elm.attach(CANBus);
+
+  printf("ELM327 emulator on %s\n", device);
+  fflush(stdout);
+
+  SystemClock wall;
+  uint64_t last = wall.now();
+
+  while (true) {
+    uint8_t buffer[256];
+    ssize_t n = ::read(master, buffer, sizeof(buffer));
+
+    for (ssize_t i = 0; i < n; i++) {
+      elm.write(buffer[i]);
+    }
+
+    //virtual time follows the wall clock
+    uint64_t now = wall.now();
+    clock.advance(now - last);
+    last = now;
+
+    size_t out = 0;
+    while (elm.available() && out < sizeof(buffer)) {
+      buffer[out++] = elm.read();
+    }
+
+    if (out && ::write(master, buffer, out) < 0) {
+      perror("write");
+      return 1;
+    }
+
+    wall.sleep(200);
+  }
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Microbenchmarks of the receive and decode hot paths (OBD2Bench), on the embedded recordings or on:
+ *   --candump file   candump -l log ("(time) can0 7E8#04410C1AF8") or plain "7E8#04410C1AF8" lines
+ *   --elm file       ELM327 terminal log: ">010C" lines followed by the adapter answer
+ *   --filter id      software packet filter for the candump replay (repeatable), --broadcast id likewise
+ * Usage: obd2_bench [--rounds n] [--repeats n] [--csv] [--candump file] [--elm file] [--filter id] [--broadcast id]
+ */
+
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "OBD2Bench.h"
+
+//every heap allocation of the process, String included
+static std::atomic<uint32_t> allocationCount(0);
+
+void* operator new(size_t size)
+{
+  allocationCount++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static uint32_t countAllocations()
+{
+  return allocationCount.load();
+}
+
+static bool readFile(const char* path, std::string& content)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) content.append(chunk, n);
+
+  fclose(f);
+  return true;
+}
+
+//"ID#DATA" token of a candump line, 29 bit when the id has more than 3 digits
+static bool parseCandump(const std::string& content, std::vector<OBD2BenchFrame>& frames)
+{
+  size_t start = 0;
+
+  while (start < content.size()) {
+    size_t end = content.find('\n', start);
+    if (end == std::string::npos) end = content.size();
+    std::string line = content.substr(start, end - start);
+    start = end + 1;
+
+    size_t hash = line.find('#');
+    if (hash == std::string::npos || line.compare(hash + 1, 1, "R") == 0) continue;
+
+    size_t idStart = line.find_last_of(' ', hash);
+    idStart = idStart == std::string::npos ? 0 : idStart + 1;
+
+    OBD2BenchFrame frame = {};
+    std::string id = line.substr(idStart, hash - idStart);
+    frame.Id = strtol(id.c_str(), NULL, 16);
+    frame.Extended = id.size() > 3;
+
+    for (size_t i = hash + 1; i + 1 < line.size() && frame.Dlc < 8 && isxdigit(line[i]) && isxdigit(line[i + 1]); i += 2) {
+      char byte[3] = { line[i], line[i + 1], 0 };
+      frame.Data[frame.Dlc++] = strtol(byte, NULL, 16);
+    }
+
+    frames.push_back(frame);
+  }
+
+  return !frames.empty();
+}
+
+int main(int argc, char** argv)
+{
+  OBD2 obd2;
+  OBD2Bench bench(obd2);
+  bool csv = false;
+
+  std::vector<OBD2BenchFrame> frames;
+  std::string transcript;
+
+  for (int i = 1; i < argc; i++) {
+    bool value = i + 1 < argc;
+
+    if (strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else if (strcmp(argv[i], "--rounds") == 0 && value) {
+      bench.setRounds(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--repeats") == 0 && value) {
+      bench.setRepeats(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--filter") == 0 && value) {
+      bench.addPacketFilter(strtol(argv[++i], NULL, 16));
+    } else if (strcmp(argv[i], "--broadcast") == 0 && value) {
+      bench.addBroadcastFilter(strtol(argv[++i], NULL, 16));
+    } else if (strcmp(argv[i], "--candump") == 0 && value) {
+      std::string content;
+      if (!readFile(argv[++i], content)) return 1;
+      if (!parseCandump(content, frames)) {
+        fprintf(stderr, "%s: no frames\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--elm") == 0 && value) {
+      if (!readFile(argv[++i], transcript)) return 1;
+    } else {
+      fprintf(stderr, "usage: %s [--rounds n] [--repeats n] [--csv] [--candump file] [--elm file] [--filter id] [--broadcast id]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (!frames.empty()) bench.setFrames(frames.data(), frames.size());
+  if (!transcript.empty()) bench.setElmTranscript(transcript.c_str());
+
+  bench.setAllocationCounter(countAllocations);
+  bench.run();
+  bench.print(Serial, csv);
+
+  return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Bus profile (OBD2BusProfiler) in virtual time: broadcast ids with known periods, dlcs and changing bytes,
+ * one with +-1 ms of send jitter, while OBD2 polls the engine ECU on the same bus. The snapshot is printed,
+ * then each id is checked against what was sent and the load against the unstuffed and worst case frame lengths.
+ * Usage: obd2_bus_profile [seconds]
+ */
+
+#include "OBD2.h"
+#include "OBD2BusProfiler.h"
+#include "SimulatedECU.h"
+
+struct Broadcast {
+  long id;
+  uint32_t period; //us
+  uint32_t jitter; //us, +- around the nominal send time
+  uint8_t dlc;
+  uint8_t changes; //bytes that vary
+};
+
+static const Broadcast broadcasts[] = {
+  { 0x0C9, 10000, 0, 8, 0x03 },     //rpm, bytes 0-1
+  { 0x1A0, 20000, 1000, 8, 0x80 },  //rolling counter in byte 7
+  { 0x3E9, 100000, 0, 4, 0x00 },    //static configuration
+  { 0x18FEF100, 50000, 0, 8, 0x0C }, //J1939 wheel speed, bytes 2-3
+};
+
+#define BROADCASTS (sizeof(broadcasts) / sizeof(broadcasts[0]))
+
+static const OBD2RequestDescriptor rpm("Engine", "rpm", false, 0x7E0, 0x01, 0x0C, 2, 0.25);
+
+static uint32_t lcg = 12345;
+
+static int32_t jitter(uint32_t range)
+{
+  lcg = lcg * 1103515245 + 12345;
+  return range ? (int32_t)((lcg >> 8) % (2 * range + 1)) - (int32_t)range : 0;
+}
+
+static void send(VirtualClock& clock, const Broadcast& b, uint32_t n, uint64_t end)
+{
+  uint64_t at = (uint64_t)(n + 1) * b.period + jitter(b.jitter);
+  if (at > end) return;
+
+  clock.schedule(at, [&clock, &b, n, end]() {
+    VirtualCANFrame frame = {};
+    frame.id = b.id;
+    frame.extended = b.id > 0x7FF;
+    frame.dlc = b.dlc;
+
+    for (int i = 0; i < b.dlc; i++) {
+      frame.data[i] = b.changes & (1 << i) ? (uint8_t)(n * 7 + i) : (uint8_t)(0x10 + i);
+    }
+
+    CANBus.transmit(frame, NULL);
+    send(clock, b, n + 1, end);
+  });
+}
+
+//frame length without stuff bits and with the most stuff bits a frame of this kind can have
+static void frameBounds(bool extended, uint8_t dlc, uint32_t& nominal, uint32_t& worst)
+{
+  nominal = (extended ? 67 : 47) + 8 * dlc;
+  worst = nominal + ((extended ? 54 : 34) + 8 * dlc - 1) / 4;
+}
+
+int main(int argc, char** argv)
+{
+  double seconds = argc > 1 ? atof(argv[1]) : 10;
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  SimulatedECU engine(clock);
+  engine.setPid(0x01, 0x0C, { 0x1A, 0xF8 });
+  engine.attach(CANBus);
+
+  OBD2BusProfiler profiler;
+  OBD2 obd2;
+  obd2.setProfiler(&profiler);
+  obd2.Begin(500E3);
+  obd2.addPacketFilter(0x7E8);
+
+  uint64_t end = (uint64_t)(seconds * 1e6);
+  for (size_t i = 0; i < BROADCASTS; i++) send(clock, broadcasts[i], 0, end);
+
+  OBD2RequestState state = {};
+  profiler.reset();
+
+  while (clock.now() < end) {
+    if (obd2.process() == OBD2StatusType::ready) obd2.sendRequest(&rpm, &state);
+    clock.advance(1000);
+  }
+
+  profiler.print(Serial);
+
+  bool ok = profiler.getUntracked() == 0;
+  uint64_t nominalBits = 0, worstBits = 0;
+  OBD2BusIdStats s;
+
+  for (uint16_t i = 0; i < profiler.getIdCount(); i++) {
+    if (!profiler.getIdStats(i, s)) continue;
+
+    uint32_t nominal, worst;
+    frameBounds(s.Extended, s.DlcMax, nominal, worst);
+    nominalBits += (uint64_t)nominal * s.Count;
+    worstBits += (uint64_t)worst * s.Count;
+  }
+
+  for (size_t i = 0; i < BROADCASTS; i++) {
+    const Broadcast& b = broadcasts[i];
+    int index = profiler.findId(b.id, b.id > 0x7FF);
+
+    if (index < 0 || !profiler.getIdStats(index, s)) {
+      printf("%lX: not seen\n", b.id);
+      ok = false;
+      continue;
+    }
+
+    //mean within 1%, jitter seen only where there is some
+    bool good = fabs((double)s.PeriodMean - b.period) <= b.period / 100.0 && s.ChangeMask == b.changes && s.DlcMin == b.dlc &&
+                s.DlcMax == b.dlc && (b.jitter ? s.Jitter > b.jitter / 4 && s.PeriodMax - s.PeriodMin <= 4 * b.jitter : s.Jitter < 1);
+
+    if (!good) {
+      printf("%lX: period %u (sent %u), jitter %.1f, changes %02X (sent %02X), dlc %u-%u (sent %u)\n", b.id, s.PeriodMean, b.period,
+             s.Jitter, s.ChangeMask, b.changes, s.DlcMin, s.DlcMax, b.dlc);
+      ok = false;
+    }
+  }
+
+  ok = ok && profiler.findId(0x7E8, false) >= 0 && state.Status == OBD2StatusType::received;
+
+  double elapsed = profiler.getElapsed() / 1e6;
+  double load = profiler.getLoad();
+  double low = nominalBits / (500E3 * elapsed), high = worstBits / (500E3 * elapsed);
+  ok = ok && load >= low && load <= high;
+
+  printf("load %.2f%% (unstuffed %.2f%%, worst case stuffing %.2f%%), peak %.2f%%, headroom %.2f%%: %s\n", load * 100, low * 100,
+         high * 100, profiler.getPeakLoad() * 100, (1 - profiler.getPeakLoad()) * 100, ok ? "ok" : "FAILED");
+
+  CAN.end();
+  setHostClock(NULL);
+  return ok ? 0 : 1;
+}
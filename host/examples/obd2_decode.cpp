@@ -0,0 +1,418 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Trace decoder (OBD2TraceDecoder): diagnostic responses and broadcast signals of a trace, decoded
+ * on all cores and written one file per signal:
+ *   csv     <dir>/<name>.csv, "time,value" rows, time in seconds from the start of the trace
+ *   binary  <dir>/<name>.u64 (times, us) and <dir>/<name>.f32 (values), little endian arrays
+ * Block traces are split into runs of blocks read with pread by each thread, plain traces are loaded
+ * and split by frame. Each run starts decoding one block (1024 frames) early, so responses crossing
+ * the boundary are reassembled; values are written in trace order.
+ * Without an output directory only the per signal summary is printed.
+ *
+ * The signals are chosen at run time: --profile loads a header generated by tools/obd2_profile.py,
+ * each --broadcast adds a broadcast signal, big endian bytes [start, start+bytes) * scale + offset
+ * of frame id (hex). Without either, the simulated ECUs profile and broadcasts (obd2_trace record).
+ * Usage: obd2_decode <trace> [dir] [--binary] [--threads n] [--profile file.h]
+ *                    [--broadcast id,name,start,bytes[,scale[,offset]]]...
+ */
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "OBD2TraceDecoder.h"
+#include "ProfileFile.h"
+#include "SimulatedBroadcasts.h"
+#include "SimulatedProfile.h"
+#include "TraceFile.h"
+
+//blocks (block traces) or frames (plain traces) per work item
+#define DECODE_CHUNK_BLOCKS 16
+#define DECODE_CHUNK_FRAMES 65536
+#define DECODE_WARMUP_FRAMES 1024
+
+struct BroadcastSignal {
+  long Id;
+  std::string Name;
+  uint8_t StartByte;
+  uint8_t Length;
+  float Scale;
+  float Offset;
+};
+
+//signals of every decoder, set up by main() before the threads start
+struct DecoderSetup {
+  const OBD2Profile* Profile = &simulated_ecus_profile;
+  std::vector<BroadcastSignal> Broadcasts;
+  bool Simulated = true;               //simulated broadcasts, no --profile nor --broadcast
+};
+
+static DecoderSetup setup;
+
+static bool setupDecoder(OBD2TraceDecoder& decoder)
+{
+  decoder.setProfile(setup.Profile);
+  if (setup.Simulated) addSimulatedBroadcasts(decoder);
+
+  for (const BroadcastSignal& b : setup.Broadcasts) {
+    if (decoder.addBroadcast(b.Id, b.Name.c_str(), b.StartByte, b.Length, b.Scale, b.Offset) < 0) return false;
+  }
+
+  return true;
+}
+
+//id,name,start,bytes[,scale[,offset]], id in hex
+static bool parseBroadcast(const char* text, BroadcastSignal& signal)
+{
+  char name[64];
+  unsigned long id;
+  unsigned start, length;
+  float scale = 1.0, offset = 0.0;
+
+  int n = sscanf(text, "%lx,%63[^,],%u,%u,%f,%f", &id, name, &start, &length, &scale, &offset);
+  if (n < 4 || id > OBD2_HEADER_MASK || length == 0 || length > 4 || start + length > 8) return false;
+
+  signal = { (long)id, name, (uint8_t)start, (uint8_t)length, scale, offset };
+  return true;
+}
+
+struct ColumnOutput {
+  std::string Bytes;                   //csv text or times
+  std::string Values;                  //binary values
+  uint64_t Count = 0;
+  double Sum = 0;
+};
+
+struct ChunkResult {
+  std::vector<ColumnOutput> Columns;
+  uint64_t Frames = 0;
+  bool Intact = true;
+  bool Done = false;
+};
+
+class TraceDecodeJob {
+public:
+  TraceDecodeJob(TraceFile& file, uint16_t columns, bool binary, bool output)
+      : _file(file), _columns(columns), _binary(binary), _output(output)
+  {
+  }
+
+  bool prepare()
+  {
+    if (_file.compressed()) {
+      const std::vector<TraceBlock>& blocks = _file.blocks();
+      if (blocks.empty()) return false;
+
+      _start = blocks.front().Header.Time;
+      _units = blocks.size();
+      _chunkUnits = DECODE_CHUNK_BLOCKS;
+    } else {
+      bool intact = _file.readAll(_records);
+      if (_records.empty()) return false;
+
+      _start = _records.front().Time;
+      _units = _records.size();
+      _chunkUnits = DECODE_CHUNK_FRAMES;
+      _intact = intact;
+    }
+
+    _results.resize((_units + _chunkUnits - 1) / _chunkUnits);
+    return true;
+  }
+
+  size_t chunks() const { return _results.size(); }
+
+  //threads decode chunks in any order, at most window ahead of the writer
+  void run(unsigned threads, size_t window, void (*write)(ChunkResult& result, void* context), void* context)
+  {
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([this, window]() {
+        size_t chunk;
+
+        while ((chunk = _next.fetch_add(1)) < _results.size()) {
+          {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this, chunk, window]() { return chunk < _written + window; });
+          }
+
+          ChunkResult result;
+          decodeChunk(chunk, result);
+
+          std::lock_guard<std::mutex> lock(_mutex);
+          _results[chunk] = std::move(result);
+          _results[chunk].Done = true;
+          _wake.notify_all();
+        }
+      });
+    }
+
+    for (size_t chunk = 0; chunk < _results.size(); chunk++) {
+      {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _wake.wait(lock, [this, chunk]() { return _results[chunk].Done; });
+      }
+
+      write(_results[chunk], context);
+      _intact &= _results[chunk].Intact;
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      _results[chunk] = ChunkResult();
+      _written = chunk + 1;
+      _wake.notify_all();
+    }
+
+    for (std::thread& worker : workers) worker.join();
+  }
+
+  bool intact() const { return _intact; }
+  uint64_t start() const { return _start; }
+
+private:
+  void decodeChunk(size_t chunk, ChunkResult& result)
+  {
+    OBD2TraceDecoder decoder;
+    setupDecoder(decoder);
+    result.Columns.resize(_columns);
+
+    size_t begin = chunk * _chunkUnits;
+    size_t end = std::min(begin + _chunkUnits, _units);
+
+    if (_file.compressed()) {
+      const std::vector<TraceBlock>& blocks = _file.blocks();
+      std::vector<TraceRecord> records;
+
+      //warm up: responses started in the previous block, its own values belong to the previous chunk
+      if (begin > 0) {
+        _file.readBlock(blocks[begin - 1], records);
+        decodeRecords(decoder, records.data(), records.size(), NULL);
+      }
+
+      for (size_t b = begin; b < end; b++) {
+        records.clear();
+        result.Intact &= _file.readBlock(blocks[b], records);
+        decodeRecords(decoder, records.data(), records.size(), &result);
+      }
+    } else {
+      size_t warmup = begin > DECODE_WARMUP_FRAMES ? begin - DECODE_WARMUP_FRAMES : 0;
+
+      decodeRecords(decoder, _records.data() + warmup, begin - warmup, NULL);
+      decodeRecords(decoder, _records.data() + begin, end - begin, &result);
+    }
+  }
+
+  void decodeRecords(OBD2TraceDecoder& decoder, const TraceRecord* records, size_t count, ChunkResult* result)
+  {
+    OBD2DecodedValue values[OBD2_TRACE_DECODER_BROADCASTS];
+    char line[48];
+
+    for (size_t i = 0; i < count; i++) {
+      uint8_t n = decoder.decode(records[i].Frame, values, OBD2_TRACE_DECODER_BROADCASTS);
+      if (result == NULL) continue;
+
+      result->Frames++;
+      uint64_t time = records[i].Time - _start;
+
+      for (uint8_t v = 0; v < n; v++) {
+        ColumnOutput& column = result->Columns[values[v].Column];
+        column.Count++;
+        column.Sum += values[v].Value;
+
+        if (!_output) continue;
+
+        if (_binary) {
+          column.Bytes.append((const char*)&time, sizeof(time));
+          column.Values.append((const char*)&values[v].Value, sizeof(float));
+        } else {
+          int length = snprintf(line, sizeof(line), "%llu.%06llu,%.9g\n", (unsigned long long)(time / 1000000),
+                                (unsigned long long)(time % 1000000), values[v].Value);
+          column.Bytes.append(line, length);
+        }
+      }
+    }
+  }
+
+  TraceFile& _file;
+  uint16_t _columns;
+  bool _binary;
+  bool _output;
+
+  std::vector<TraceRecord> _records;   //plain traces
+  uint64_t _start = 0;
+  size_t _units = 0;
+  size_t _chunkUnits = 1;
+  bool _intact = true;
+
+  std::vector<ChunkResult> _results;
+  std::atomic<size_t> _next{ 0 };
+  size_t _written = 0;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+};
+
+struct DecodeOutput {
+  std::vector<FILE*> Files;            //csv or times
+  std::vector<FILE*> ValueFiles;       //binary values
+  std::vector<uint64_t> Counts;
+  std::vector<double> Sums;
+  uint64_t Frames = 0;
+};
+
+static void writeChunk(ChunkResult& result, void* context)
+{
+  DecodeOutput* output = (DecodeOutput*)context;
+  output->Frames += result.Frames;
+
+  for (size_t c = 0; c < result.Columns.size(); c++) {
+    ColumnOutput& column = result.Columns[c];
+    output->Counts[c] += column.Count;
+    output->Sums[c] += column.Sum;
+
+    if (!output->Files.empty()) {
+      fwrite(column.Bytes.data(), 1, column.Bytes.size(), output->Files[c]);
+    }
+
+    if (!output->ValueFiles.empty()) {
+      fwrite(column.Values.data(), 1, column.Values.size(), output->ValueFiles[c]);
+    }
+  }
+}
+
+static FILE* openColumn(const char* dir, const char* name, const char* extension)
+{
+  std::string path = std::string(dir) + "/" + name + extension;
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) perror(path.c_str());
+  return f;
+}
+
+int main(int argc, char** argv)
+{
+  const char* path = NULL;
+  const char* dir = NULL;
+  const char* profilePath = NULL;
+  bool binary = false;
+  unsigned threads = std::thread::hardware_concurrency();
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--binary") == 0) {
+      binary = true;
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+      profilePath = argv[++i];
+      setup.Simulated = false;
+    } else if (strcmp(argv[i], "--broadcast") == 0 && i + 1 < argc) {
+      BroadcastSignal signal;
+      if (!parseBroadcast(argv[++i], signal)) {
+        fprintf(stderr, "%s: bad broadcast, expected id,name,start,bytes[,scale[,offset]]\n", argv[i]);
+        return 1;
+      }
+      setup.Broadcasts.push_back(signal);
+      setup.Simulated = false;
+    } else if (!path) {
+      path = argv[i];
+    } else if (!dir) {
+      dir = argv[i];
+    } else {
+      path = NULL;
+      break;
+    }
+  }
+
+  if (!path) {
+    fprintf(stderr,
+            "usage: %s <trace> [dir] [--binary] [--threads n] [--profile file.h]\n"
+            "       [--broadcast id,name,start,bytes[,scale[,offset]]]...\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (threads == 0) threads = 1;
+
+  ProfileFile profile;
+  if (profilePath) {
+    if (!profile.open(profilePath)) {
+      fprintf(stderr, "%s\n", profile.error().c_str());
+      return 1;
+    }
+    setup.Profile = profile.profile();
+  } else if (!setup.Simulated) {
+    setup.Profile = NULL;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  TraceFile file;
+  if (!file.open(path)) {
+    fprintf(stderr, "%s\n", file.error().c_str());
+    return 1;
+  }
+
+  OBD2TraceDecoder decoder;
+  if (!setupDecoder(decoder)) {
+    fprintf(stderr, "more than %d broadcast signals\n", OBD2_TRACE_DECODER_BROADCASTS);
+    return 1;
+  }
+  uint16_t columns = decoder.getColumns();
+
+  DecodeOutput output;
+  output.Counts.resize(columns);
+  output.Sums.resize(columns);
+
+  if (dir) {
+    mkdir(dir, 0755);
+
+    for (uint16_t c = 0; c < columns; c++) {
+      output.Files.push_back(openColumn(dir, decoder.getColumnName(c), binary ? ".u64" : ".csv"));
+      if (binary) output.ValueFiles.push_back(openColumn(dir, decoder.getColumnName(c), ".f32"));
+
+      if (!output.Files.back() || (binary && !output.ValueFiles.back())) return 1;
+      if (!binary) fputs("time,value\n", output.Files.back());
+    }
+  }
+
+  TraceDecodeJob job(file, columns, binary, dir != NULL);
+  if (!job.prepare()) {
+    fprintf(stderr, "%s: no frames\n", path);
+    return 1;
+  }
+
+  job.run(threads, 4 * threads, writeChunk, &output);
+
+  for (FILE* f : output.Files) fclose(f);
+  for (FILE* f : output.ValueFiles) fclose(f);
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  long received = 0;
+  double valueSum = 0;
+
+  printf("%-22s %10s %18s\n", "signal", "values", "sum");
+
+  for (uint16_t c = 0; c < columns; c++) {
+    printf("%-22s %10llu %18.3f\n", decoder.getColumnName(c), (unsigned long long)output.Counts[c], output.Sums[c]);
+
+    //diagnostic columns: the totals obd2_trace prints for the recording session
+    if (decoder.getColumnGroup(c) != NULL) {
+      received += output.Counts[c];
+      valueSum += output.Sums[c];
+    }
+  }
+
+  printf("%ld responses (value sum %.3f)\n", received, valueSum);
+  printf("%llu frames, %llu bytes in %.3f s (%.1f MB/s, %.1f Mframes/s), %u threads, %zu chunks%s\n",
+         (unsigned long long)output.Frames, (unsigned long long)file.size(), seconds, file.size() / seconds / 1e6,
+         output.Frames / seconds / 1e6, threads, job.chunks(), job.intact() ? "" : ", damaged trace");
+
+  return 0;
+}
@@ -0,0 +1,184 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Two OBD2 instances on two controllers, in virtual time: the engine ECU on the powertrain bus (global CAN),
+ * the body ECU on the body bus (a second VirtualCANControllerClass). Compared with both ECUs behind one
+ * controller, where requests to the two ECUs wait for each other.
+ * Usage: obd2_dual_bus [requests per bus]
+ */
+
+#include "OBD2.h"
+#include "SimulatedECU.h"
+
+static const OBD2RequestDescriptor engineRequests[] = {
+  OBD2RequestDescriptor("Engine", "rpm", false, 0x7E0, 0x01, 0x0C, 2, 0.25),
+  OBD2RequestDescriptor("Engine", "speed", false, 0x7E0, 0x01, 0x0D, 1),
+  OBD2RequestDescriptor("Engine", "coolant", false, 0x7E0, 0x01, 0x05, 1, 1, -40),
+};
+
+static const OBD2RequestDescriptor bodyRequests[] = {
+  OBD2RequestDescriptor("Body", "battery", true, 0x18DA40F1, 0x22, 0x1955, 2, 0.001),
+  OBD2RequestDescriptor("Body", "odometer", true, 0x18DA40F1, 0x22, 0x2002, 3),
+};
+
+//the callback does not tell the instances apart: one per bus
+static long engineReceived, bodyReceived, singleReceived, wrongValues;
+
+static void check(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, long& received)
+{
+  if (state->Status != OBD2StatusType::received) return;
+
+  received++;
+
+  //rpm 0x1AF8, battery 0x319C: a response routed to the wrong instance would not decode to these
+  if ((request->Pid == 0x0C && value != 1726) || (request->Pid == 0x1955 && fabsf(value - 12.7) > 0.001)) {
+    wrongValues++;
+  }
+}
+
+static void onEngineValue(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t*)
+{
+  check(request, state, value, engineReceived);
+}
+
+static void onBodyValue(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t*)
+{
+  check(request, state, value, bodyReceived);
+}
+
+static void onSingleBusValue(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t*)
+{
+  check(request, state, value, singleReceived);
+}
+
+static void setupEcus(SimulatedECU& engine, SimulatedECU& body)
+{
+  engine.setPid(0x01, 0x0C, { 0x1A, 0xF8 });
+  engine.setPid(0x01, 0x0D, { 0x32 });
+  engine.setPid(0x01, 0x05, { 0x7B });
+
+  body.setPid(0x22, 0x1955, { 0x31, 0x9C });
+  body.setPid(0x22, 0x2002, { 0x01, 0xE2, 0x40 });
+}
+
+static SimulatedECUConfig bodyConfig()
+{
+  SimulatedECUConfig config;
+  config.RequestId = 0x18DA40F1;
+  config.FunctionalId = 0x18DB33F1;
+  config.ResponseId = 0x18DAF140;
+
+  return config;
+}
+
+//sends the next request of the table when the instance is ready, false once all are sent
+static bool step(OBD2& obd2, const OBD2RequestDescriptor* requests, size_t count, OBD2RequestState* states, long& sent, long total)
+{
+  if (obd2.process() != OBD2StatusType::ready) return true;
+  if (sent >= total) return false;
+
+  size_t i = sent++ % count;
+  obd2.sendRequest(&requests[i], &states[i]);
+
+  return true;
+}
+
+//both ECUs behind the global CAN, requests alternate between them
+static double singleBus(VirtualClock& clock, long requests)
+{
+  SimulatedECU engine(clock), body(clock, bodyConfig());
+  setupEcus(engine, body);
+  engine.attach(CANBus);
+  body.attach(CANBus);
+
+  OBD2 obd2;
+  obd2.Begin(500E3);
+  obd2.addPacketFilter(0x7E8);
+  obd2.addPacketFilter(0x18DAF140);
+  obd2.onHandleValue(onSingleBusValue);
+
+  const OBD2RequestDescriptor* schedule[] = { &engineRequests[0], &bodyRequests[0], &engineRequests[1], &bodyRequests[1], &engineRequests[2] };
+  OBD2RequestState states[5] = {};
+  long sent = 0;
+  singleReceived = 0;
+  uint64_t start = clock.now();
+
+  while (true) {
+    if (obd2.process() == OBD2StatusType::ready) {
+      if (sent >= requests * 2) break;
+
+      size_t i = sent++ % 5;
+      obd2.sendRequest(schedule[i], &states[i]);
+    }
+
+    clock.advance(1000);
+  }
+
+  double seconds = (clock.now() - start) / 1e6;
+  CAN.end();
+
+  printf("%-12s %8ld %8ld %9.1f %9.1f\n", "one bus", sent, singleReceived, seconds, singleReceived / seconds);
+  return singleReceived / seconds;
+}
+
+static double dualBus(VirtualClock& clock, long requests)
+{
+  VirtualCANBus bodyBus;
+  VirtualCANControllerClass bodyCan;
+  bodyCan.setBus(bodyBus);
+
+  SimulatedECU engine(clock), body(clock, bodyConfig());
+  setupEcus(engine, body);
+  engine.attach(CANBus);
+  body.attach(bodyBus);
+
+  OBD2 powertrain(CAN);
+  powertrain.Begin(500E3);
+  powertrain.addPacketFilter(0x7E8);
+  powertrain.onHandleValue(onEngineValue);
+
+  OBD2 comfort(bodyCan);
+  comfort.Begin(500E3);
+  comfort.addPacketFilter(0x18DAF140);
+  comfort.onHandleValue(onBodyValue);
+
+  OBD2RequestState engineStates[3] = {}, bodyStates[2] = {};
+  long engineSent = 0, bodySent = 0;
+  engineReceived = bodyReceived = wrongValues = 0;
+  uint64_t start = clock.now();
+
+  while (true) {
+    bool engineBusy = step(powertrain, engineRequests, 3, engineStates, engineSent, requests);
+    bool bodyBusy = step(comfort, bodyRequests, 2, bodyStates, bodySent, requests);
+    if (!engineBusy && !bodyBusy) break;
+
+    clock.advance(1000);
+  }
+
+  double seconds = (clock.now() - start) / 1e6;
+  long received = engineReceived + bodyReceived;
+  CAN.end();
+  bodyCan.end();
+
+  printf("%-12s %8ld %8ld %9.1f %9.1f   (powertrain %ld, body %ld, %ld wrong values)\n", "two buses",
+         engineSent + bodySent, received, seconds, received / seconds, engineReceived, bodyReceived, wrongValues);
+  return received / seconds;
+}
+
+int main(int argc, char** argv)
+{
+  long requests = argc > 1 ? atol(argv[1]) : 1000;
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  printf("%-12s %8s %8s %9s %9s\n", "setup", "sent", "ok", "seconds", "pids/s");
+  double one = singleBus(clock, requests);
+  double two = dualBus(clock, requests);
+  printf("two buses: %.2fx the pids/s of one\n", two / one);
+
+  setHostClock(NULL);
+  return wrongValues == 0 && engineReceived == requests && bodyReceived == requests ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Achievable PIDs/s of the protocol engine against simulated ECUs, in virtual time.
+ * Every scenario is deterministic for a given seed, so the numbers can be compared between builds.
+ * Usage: obd2_ecu_throughput [requests per scenario] [seed]
+ */
+
+#include "OBD2.h"
+#include "SimulatedECU.h"
+
+//engine ecu, 11 bit: mode 01 and mode 09 vin (multi-frame)
+static const OBD2RequestDescriptor engineRequests[] = {
+  OBD2RequestDescriptor("Engine", "rpm", false, 0x7E0, 0x01, 0x0C, 2, 0.25),
+  OBD2RequestDescriptor("Engine", "speed", false, 0x7E0, 0x01, 0x0D, 1),
+  OBD2RequestDescriptor("Engine", "coolant", false, 0x7E0, 0x01, 0x05, 1, 1, -40),
+  OBD2RequestDescriptor("Engine", "intakeAir", false, 0x7E0, 0x01, 0x0F, 1, 1, -40),
+  OBD2RequestDescriptor("Engine", "throttle", false, 0x7E0, 0x01, 0x11, 1, 100.0 / 255),
+  OBD2RequestDescriptor("Engine", "load", false, 0x7E0, 0x01, 0x04, 1, 100.0 / 255),
+};
+
+static const OBD2RequestDescriptor vinRequest("Engine", "vin", false, 0x7E0, 0x09, 0x02, 1);
+
+//body ecu, 29 bit uds: short and long (multi-frame) data identifiers
+static const OBD2RequestDescriptor bodyRequests[] = {
+  OBD2RequestDescriptor("Body", "battery", true, 0x18DA40F1, 0x22, 0x1955, 2, 0.001),
+  OBD2RequestDescriptor("Body", "odometer", true, 0x18DA40F1, 0x22, 0x2002, 3),
+  OBD2RequestDescriptor("Body", "tires", true, 0x18DA40F1, 0x22, 0x31D0, 2, 0.001),
+  OBD2RequestDescriptor("Body", "doorLog", true, 0x18DA40F1, 0x22, 0x4001, 2),
+};
+
+struct Outcomes {
+  long Received;
+  long Timeout;
+  long NoData;
+  long Error;
+};
+
+static Outcomes outcomes;
+
+static void onValue(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t* responseBytes)
+{
+  switch (state->Status) {
+    case OBD2StatusType::received: outcomes.Received++; break;
+    case OBD2StatusType::timeout: outcomes.Timeout++; break;
+    case OBD2StatusType::nodata: outcomes.NoData++; break;
+    default: outcomes.Error++; break;
+  }
+}
+
+struct Scenario {
+  const char* Name;
+  uint32_t LoopPeriod;         //us between process() calls
+  uint32_t Latency;
+  uint32_t LatencyJitter;
+  float DropoutRate;
+  uint8_t Pending;             //0x78 responses before each body answer
+  bool Negative;               //body ecu refuses one identifier
+  bool MultiFrame;             //mix in vin and long identifiers
+};
+
+static const Scenario scenarios[] = {
+  { "single frame, 1 ms loop", 1000, 5000, 0, 0, 0, false, false },
+  { "single frame, 10 ms loop", 10000, 5000, 0, 0, 0, false, false },
+  { "single frame, jitter 0-20 ms", 1000, 5000, 20000, 0, 0, false, false },
+  { "multi-frame mix", 1000, 5000, 0, 0, 0, false, true },
+  { "0x78 pending x2", 1000, 5000, 0, 0, 2, false, false },
+  { "negative responses", 1000, 5000, 0, 0, 0, true, false },
+  { "2% dropouts", 1000, 5000, 0, 0.02, 0, false, false },
+};
+
+static void run(const Scenario& scenario, long requests, uint32_t seed, VirtualClock& clock)
+{
+  SimulatedECUConfig config;
+  config.Latency = scenario.Latency;
+  config.LatencyJitter = scenario.LatencyJitter;
+  config.DropoutRate = scenario.DropoutRate;
+  config.Seed = seed;
+
+  SimulatedECU engine(clock, config);
+  engine.setPid(0x01, 0x0C, { 0x1A, 0xF8 });
+  engine.setPid(0x01, 0x0D, { 0x32 });
+  engine.setPid(0x01, 0x05, { 0x7B });
+  engine.setPid(0x01, 0x0F, { 0x41 });
+  engine.setPid(0x01, 0x11, { 0x33 });
+  engine.setPid(0x01, 0x04, { 0x80 });
+  engine.setPid(0x09, 0x02, { 0x01, 'Z', 'A', 'R', 'P', 'A', 'G', 'B', 'X', '0', 'K', '7', '1', '2', '3', '4', '5', '6' });
+  engine.attach(CANBus);
+
+  config.RequestId = 0x18DA40F1;
+  config.FunctionalId = 0x18DB33F1;
+  config.ResponseId = 0x18DAF140;
+  config.Seed = seed * 31 + 7;
+
+  SimulatedECU body(clock, config);
+  body.setPid(0x22, 0x1955, { 0x31, 0x9C });
+  body.setPid(0x22, 0x2002, { 0x01, 0xE2, 0x40 });
+  body.setPid(0x22, 0x31D0, { 0x09, 0x60 });
+  body.setPid(0x22, 0x4001, std::vector<uint8_t>(20, 0x11));
+  for (const OBD2RequestDescriptor& r : bodyRequests) {
+    if (scenario.Pending) body.setPending(0x22, r.Pid, scenario.Pending);
+  }
+  if (scenario.Negative) body.setNegative(0x22, 0x2002, 0x33); //securityAccessDenied
+  body.attach(CANBus);
+
+  //request schedule: short requests round robin, long ones only in the multi-frame mix
+  std::vector<const OBD2RequestDescriptor*> schedule;
+  for (const OBD2RequestDescriptor& r : engineRequests) schedule.push_back(&r);
+  for (const OBD2RequestDescriptor& r : bodyRequests) {
+    if (r.Pid != 0x4001 || scenario.MultiFrame) schedule.push_back(&r);
+  }
+  if (scenario.MultiFrame) schedule.push_back(&vinRequest);
+
+  OBD2 obd2;
+  obd2.Begin(5, 4, 500E3);
+  obd2.addPacketFilter(0x7E8);
+  obd2.addPacketFilter(0x18DAF140);
+  obd2.onHandleValue(onValue);
+
+  std::vector<OBD2RequestState> states(schedule.size(), OBD2RequestState());
+  outcomes = Outcomes();
+
+  uint64_t start = clock.now();
+  long sent = 0;
+
+  while (true) {
+    OBD2StatusType status = obd2.process();
+
+    if (status == OBD2StatusType::ready) {
+      if (sent >= requests) break;
+
+      size_t i = sent++ % schedule.size();
+      obd2.sendRequest(schedule[i], &states[i]);
+    }
+
+    clock.advance(scenario.LoopPeriod);
+  }
+
+  double seconds = (clock.now() - start) / 1e6;
+
+  printf("%-30s %8ld %8ld %6ld %6ld %6ld %9.1f %9.1f %9llu\n", scenario.Name, sent, outcomes.Received,
+         outcomes.Timeout + outcomes.NoData, outcomes.Error, (long)(engine.stats().Pending + body.stats().Pending),
+         seconds, seconds > 0 ? outcomes.Received / seconds : 0.0,
+         (unsigned long long)(engine.stats().Frames + body.stats().Frames));
+
+  CAN.end();
+}
+
+int main(int argc, char** argv)
+{
+  long requests = argc > 1 ? atol(argv[1]) : 2000;
+  uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  printf("%-30s %8s %8s %6s %6s %6s %9s %9s %9s\n", "scenario", "sent", "ok", "lost", "nrc", "0x78", "seconds", "pids/s", "frames");
+
+  for (const Scenario& scenario : scenarios) {
+    run(scenario, requests, seed, clock);
+  }
+
+  setHostClock(NULL);
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Achievable PIDs/s of the ELM327 path (BeginElm327) over emulated serial links, in virtual time.
+ * The emulated ELM327 talks to simulated ECUs on the virtual bus.
+ * Usage: obd2_elm_throughput [requests per scenario] [seed]
+ */
+
+#include "OBD2.h"
+#include "ELM327Emulator.h"
+#include "SimulatedECU.h"
+
+//engine ecu, functional 7DF requests
+static const OBD2RequestDescriptor engineRequests[] = {
+  OBD2RequestDescriptor("Engine", "rpm", false, 0x7DF, 0x01, 0x0C, 2, 0.25),
+  OBD2RequestDescriptor("Engine", "speed", false, 0x7DF, 0x01, 0x0D, 1),
+  OBD2RequestDescriptor("Engine", "coolant", false, 0x7DF, 0x01, 0x05, 1, 1, -40),
+  OBD2RequestDescriptor("Engine", "throttle", false, 0x7DF, 0x01, 0x11, 1, 100.0 / 255),
+};
+
+static const OBD2RequestDescriptor unsupportedRequest("Engine", "fuelRate", false, 0x7DF, 0x01, 0x5E, 2, 0.05);
+
+//body ecu, 29 bit uds, the last identifier is a multi-frame answer
+static const OBD2RequestDescriptor bodyRequests[] = {
+  OBD2RequestDescriptor("Body", "battery", true, 0x18DA40F1, 0x22, 0x1955, 2, 0.001),
+  OBD2RequestDescriptor("Body", "tires", true, 0x18DA40F1, 0x22, 0x31D0, 2, 0.001),
+  OBD2RequestDescriptor("Body", "doorLog", true, 0x18DA40F1, 0x22, 0x4001, 2),
+};
+
+struct Outcomes {
+  long Received;
+  long NoData;
+  long Error;
+};
+
+static Outcomes outcomes;
+
+static void onValue(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t* responseBytes)
+{
+  switch (state->Status) {
+    case OBD2StatusType::received: outcomes.Received++; break;
+    case OBD2StatusType::timeout:
+    case OBD2StatusType::nodata: outcomes.NoData++; break;
+    default: outcomes.Error++; break;
+  }
+}
+
+struct Scenario {
+  const char* Name;
+  uint32_t BaudRate;
+  uint32_t LinkLatency;
+  uint32_t LoopPeriod;         //us between process() calls, the parser reads one byte per call
+  float CanErrorRate;
+  bool Unsupported;            //mix in a pid the ecu does not answer (NO DATA)
+  uint8_t Pending;             //0x78 responses before every tires answer
+};
+
+static const Scenario scenarios[] = {
+  { "uart 38400, 1 ms loop", 38400, 0, 1000, 0, false, 0 },
+  { "uart 115200, 1 ms loop", 115200, 0, 1000, 0, false, 0 },
+  { "uart 115200, 100 us loop", 115200, 0, 100, 0, false, 0 },
+  { "bluetooth spp, 1 ms loop", 115200, 15000, 1000, 0, false, 0 },
+  { "unthrottled, 100 us loop", 0, 0, 100, 0, false, 0 },
+  { "uart 38400, NO DATA mix", 38400, 0, 1000, 0, true, 0 },
+  { "uart 38400, 2% CAN ERROR", 38400, 0, 1000, 0.02, false, 0 },
+  { "uart 38400, 0x78 pending", 38400, 0, 1000, 0, false, 2 },
+};
+
+//runs requests round robin until count responses are in
+static long runRequests(OBD2& obd2, VirtualClock& clock, const Scenario& scenario, const OBD2RequestDescriptor* const* requests, size_t n, long count)
+{
+  OBD2RequestState state = {};
+  long sent = 0;
+
+  while (true) {
+    OBD2StatusType status = obd2.process();
+
+    if (status == OBD2StatusType::ready) {
+      if (sent >= count) break;
+      obd2.sendRequest(requests[sent++ % n], &state);
+    }
+
+    clock.advance(scenario.LoopPeriod);
+  }
+
+  return sent;
+}
+
+static void run(const Scenario& scenario, long requests, uint32_t seed, VirtualClock& clock)
+{
+  SimulatedECUConfig config;
+  config.Seed = seed;
+
+  SimulatedECU engine(clock, config);
+  engine.setPid(0x01, 0x0C, { 0x1A, 0xF8 });
+  engine.setPid(0x01, 0x0D, { 0x32 });
+  engine.setPid(0x01, 0x05, { 0x7B });
+  engine.setPid(0x01, 0x11, { 0x33 });
+  engine.attach(CANBus);
+
+  config.RequestId = 0x18DA40F1;
+  config.FunctionalId = 0x18DB33F1;
+  config.ResponseId = 0x18DAF140;
+
+  SimulatedECU body(clock, config);
+  body.setPid(0x22, 0x1955, { 0x31, 0x9C });
+  body.setPid(0x22, 0x31D0, { 0x09, 0x60 });
+  if (scenario.Pending) body.setPending(0x22, 0x31D0, scenario.Pending);
+  body.setPid(0x22, 0x4001, std::vector<uint8_t>(20, 0x11));
+  body.attach(CANBus);
+
+  ELM327EmulatorConfig elmConfig;
+  elmConfig.BaudRate = scenario.BaudRate;
+  elmConfig.LinkLatency = scenario.LinkLatency;
+  elmConfig.CanErrorRate = scenario.CanErrorRate;
+  elmConfig.Seed = seed;
+
+  ELM327Emulator elm(clock, elmConfig);
+  elm.attach(CANBus);
+
+  //blocking setup commands spin on the port: let time run while they wait
+  OBD2 obd2;
+  clock.setAutoAdvance(10);
+  if (!obd2.BeginElm327(elm)) {
+    printf("%-30s elm initialization failed\n", scenario.Name);
+    return;
+  }
+  clock.setAutoAdvance(0);
+
+  obd2.onHandleValue(onValue);
+  outcomes = Outcomes();
+
+  std::vector<const OBD2RequestDescriptor*> engineSchedule;
+  for (const OBD2RequestDescriptor& r : engineRequests) engineSchedule.push_back(&r);
+  if (scenario.Unsupported) engineSchedule.push_back(&unsupportedRequest);
+
+  std::vector<const OBD2RequestDescriptor*> bodySchedule;
+  for (const OBD2RequestDescriptor& r : bodyRequests) bodySchedule.push_back(&r);
+
+  uint64_t start = clock.now();
+  long sent = runRequests(obd2, clock, scenario, engineSchedule.data(), engineSchedule.size(), requests / 2);
+
+  clock.setAutoAdvance(10);
+  obd2.sendElmHeader(0x18DA40F1);
+  clock.setAutoAdvance(0);
+
+  sent += runRequests(obd2, clock, scenario, bodySchedule.data(), bodySchedule.size(), requests - requests / 2);
+
+  double seconds = (clock.now() - start) / 1e6;
+
+  printf("%-30s %8ld %8ld %6ld %6ld %9.1f %9.1f %9llu\n", scenario.Name, sent, outcomes.Received,
+         outcomes.NoData, outcomes.Error, seconds, seconds > 0 ? outcomes.Received / seconds : 0.0,
+         (unsigned long long)(elm.stats().BytesIn + elm.stats().BytesOut));
+}
+
+int main(int argc, char** argv)
+{
+  long requests = argc > 1 ? atol(argv[1]) : 1000;
+  uint32_t seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  printf("%-30s %8s %8s %6s %6s %9s %9s %9s\n", "scenario", "sent", "ok", "nodata", "error", "seconds", "pids/s", "bytes");
+
+  for (const Scenario& scenario : scenarios) {
+    run(scenario, requests, seed, clock);
+  }
+
+  setHostClock(NULL);
+
+  return 0;
+}
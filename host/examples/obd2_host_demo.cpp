@@ -0,0 +1,56 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Runs the protocol engine against a minimal responder on the virtual bus and prints requests/s.
+ * Usage: obd2_host_demo [requests]
+ */
+
+#include "OBD2.h"
+
+//answers every service 22 request of 0x18DAC7F1 with two data bytes
+class TirePressureEcu : public VirtualCANNode {
+public:
+  void onBusFrame(const VirtualCANFrame& frame) override {
+    if (frame.id != 0x18DAC7F1 || frame.data[1] != 0x22) return;
+
+    VirtualCANFrame response = { 0x18DAF1C7, true, false, 8, { 0x05, 0x62, frame.data[2], frame.data[3], 0x09, 0x60, 0xAA, 0xAA } };
+    CANBus.transmit(response, this);
+  }
+};
+
+static const OBD2RequestDescriptor tirePressure("Tires PIDS", "tireFrontLeft", true, 0x18DAC7F1, 0x22, 0x31D0, 0x02, 0.001);
+
+int main(int argc, char** argv)
+{
+  long requests = argc > 1 ? atol(argv[1]) : 100000;
+  TirePressureEcu ecu;
+  CANBus.attach(&ecu);
+
+  OBD2 obd2;
+  OBD2RequestState state = {};
+  obd2.Begin(5, 4, 500E3);
+  obd2.addPacketFilter(0x18DAF1C7);
+
+  uint64_t start = hostClock().now();
+  long completed = 0;
+
+  while (completed < requests) {
+    OBD2StatusType status = obd2.process();
+
+    if (status == OBD2StatusType::ready) {
+      if (state.Status == OBD2StatusType::received) completed++;
+      state.Status = OBD2StatusType::undefined;
+      obd2.sendRequest(&tirePressure, &state);
+    } else if (status == OBD2StatusType::timeout) {
+      fprintf(stderr, "timeout\n");
+      return 1;
+    }
+  }
+
+  double seconds = (hostClock().now() - start) / 1e6;
+  printf("%ld requests, last value %.3f, %.0f requests/s\n", completed, state.Value, seconds > 0 ? completed / seconds : 0.0);
+
+  return 0;
+}
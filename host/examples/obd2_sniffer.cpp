@@ -0,0 +1,238 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Listen-only capture (OBD2Sniffer) of a bus at 100% load in virtual time: one frame every 250 us on 500 kbit/s,
+ * 11 and 29 bit ids, all dlcs, rtr frames. The capture goes to <file>, then is read back and compared
+ * frame by frame with what was sent. A slow loop shows the ring overflowing: the drops are counted.
+ * Usage: obd2_sniffer <file> [candump|slcan|binary] [seconds] [loop ms]
+ */
+
+#include "OBD2Sniffer.h"
+#include "SimulatedECU.h"
+
+#define FRAME_PERIOD 250
+
+class FilePrint : public Print {
+public:
+  FilePrint(FILE* f) : _f(f) {}
+  using Print::write;
+  size_t write(uint8_t c) override { return fputc(c, _f) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, _f); }
+
+private:
+  FILE* _f;
+};
+
+class FileStream : public Stream {
+public:
+  FileStream(FILE* f) : _f(f) {}
+  size_t write(uint8_t) override { return 0; }
+  int available() override { return feof(_f) ? 0 : 1; }
+  int read() override { return fgetc(_f); }
+  int peek() override { int c = fgetc(_f); if (c != EOF) ungetc(c, _f); return c; }
+
+private:
+  FILE* _f;
+};
+
+//frame n of the generated traffic
+static VirtualCANFrame generate(uint32_t n)
+{
+  static const long ids[] = { 0x0C9, 0x1A0, 0x3E9, 0x4B2, 0x7E8, 0x18DAF140, 0x0CF00400, 0x18FEF100 };
+
+  VirtualCANFrame frame = {};
+  frame.id = ids[n % 8];
+  frame.extended = frame.id > 0x7FF;
+  frame.rtr = n % 97 == 0;
+  frame.dlc = (n / 8) % 9;
+
+  for (int i = 0; i < frame.dlc && !frame.rtr; i++) {
+    frame.data[i] = (uint8_t)(n >> (i % 4 * 8)) ^ (uint8_t)i;
+  }
+
+  return frame;
+}
+
+static void traffic(VirtualClock& clock, uint32_t n, uint64_t end)
+{
+  uint64_t at = (uint64_t)(n + 1) * FRAME_PERIOD;
+  if (at > end) return;
+
+  clock.schedule(at, [&clock, n, end]() {
+    CANBus.transmit(generate(n), NULL);
+    traffic(clock, n + 1, end);
+  });
+}
+
+static bool same(const CANFrame& frame, uint32_t n)
+{
+  VirtualCANFrame sent = generate(n);
+
+  if (frame.id != sent.id || frame.extended != sent.extended || frame.rtr != sent.rtr || frame.dlc != sent.dlc) return false;
+  return sent.rtr || memcmp(frame.data, sent.data, sent.dlc) == 0;
+}
+
+//candump: (s.us) can0 id#data or id#R[dlc]
+static bool parseCandump(const char* line, CANFrame& frame)
+{
+  const char* p = strchr(line, ')');
+  if (!p || !(p = strchr(p + 2, ' '))) return false;
+
+  char* end;
+  frame = {};
+  frame.id = strtol(p + 1, &end, 16);
+  frame.extended = end - (p + 1) == 8;
+  if (*end++ != '#') return false;
+
+  if (*end == 'R') {
+    frame.rtr = true;
+    if (isdigit(end[1])) frame.dlc = end[1] - '0';
+    return true;
+  }
+
+  while (isxdigit(end[0]) && isxdigit(end[1]) && frame.dlc < 8) {
+    char hex[3] = { end[0], end[1], 0 };
+    frame.data[frame.dlc++] = strtol(hex, NULL, 16);
+    end += 2;
+  }
+
+  return true;
+}
+
+//slcan: t/r iii or T/R iiiiiiii, dlc, data, 4 digit timestamp
+static bool parseSlcan(const char* line, CANFrame& frame)
+{
+  char kind = line[0];
+  if (kind != 't' && kind != 'T' && kind != 'r' && kind != 'R') return false;
+
+  frame = {};
+  frame.extended = kind == 'T' || kind == 'R';
+  frame.rtr = kind == 'r' || kind == 'R';
+
+  int digits = frame.extended ? 8 : 3;
+  char id[9] = {};
+  memcpy(id, line + 1, digits);
+  frame.id = strtol(id, NULL, 16);
+  frame.dlc = line[1 + digits] - '0';
+
+  const char* data = line + 2 + digits;
+  for (int i = 0; i < frame.dlc && !frame.rtr; i++) {
+    char hex[3] = { data[i * 2], data[i * 2 + 1], 0 };
+    frame.data[i] = strtol(hex, NULL, 16);
+  }
+
+  return true;
+}
+
+//frames read back from the capture, in order; mismatches against the generated sequence
+static uint32_t readBack(const char* path, OBD2SnifferFormat format, uint32_t& mismatches)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 0;
+  }
+
+  uint32_t n = 0;
+  CANFrame frame;
+
+  if (format == OBD2SnifferFormat::binary) {
+    FileStream in(f);
+    OBD2TraceReader reader(in);
+    OBD2TraceFrame record;
+
+    if (reader.begin()) {
+      while (reader.next(record)) {
+        frame = { record.Id, record.Extended, record.Rtr, record.Dlc, {}, record.Timestamp };
+        memcpy(frame.data, record.Data, sizeof(frame.data));
+        if (!same(frame, n++)) mismatches++;
+      }
+    }
+  } else {
+    char line[128];
+    int c, length = 0;
+    char eol = format == OBD2SnifferFormat::slcan ? '\r' : '\n';
+
+    while ((c = fgetc(f)) != EOF) {
+      if (c != eol) {
+        if (length < (int)sizeof(line) - 1) line[length++] = c;
+        continue;
+      }
+
+      line[length] = 0;
+      length = 0;
+
+      bool ok = format == OBD2SnifferFormat::slcan ? parseSlcan(line, frame) : parseCandump(line, frame);
+      if (!ok || !same(frame, n)) mismatches++;
+      n++;
+    }
+  }
+
+  fclose(f);
+  return n;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <file> [candump|slcan|binary] [seconds] [loop ms]\n", argv[0]);
+    return 1;
+  }
+
+  const char* path = argv[1];
+  const char* name = argc > 2 ? argv[2] : "candump";
+  double seconds = argc > 3 ? atof(argv[3]) : 10;
+  uint32_t loop = argc > 4 ? atoi(argv[4]) * 1000 : 10000;
+
+  OBD2SnifferFormat format = OBD2SnifferFormat::candump;
+  if (!strcmp(name, "slcan")) format = OBD2SnifferFormat::slcan;
+  else if (!strcmp(name, "binary")) format = OBD2SnifferFormat::binary;
+
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  FilePrint out(f);
+  OBD2Sniffer sniffer;
+  sniffer.begin(500E3);
+  sniffer.setOutput(&out, format);
+
+  //listen-only: nothing reaches the bus
+  CAN.beginPacket(0x7DF);
+  CAN.write(0x02);
+  bool refused = CAN.endPacket() == 0;
+
+  uint64_t end = (uint64_t)(seconds * 1e6);
+  traffic(clock, 0, end);
+
+  while (clock.now() < end) {
+    clock.advance(loop);
+    sniffer.process();
+  }
+
+  sniffer.end();
+  fclose(f);
+  setHostClock(NULL);
+
+  uint64_t sent = CANBus.framesTransmitted();
+  printf("%llu frames on the bus (%.0f frames/s), %u captured, %u dropped, ring high-water %u of %u, %u bytes, transmit %s\n",
+         (unsigned long long)sent, sent / seconds, sniffer.getFrames(), sniffer.getDropped(), sniffer.getMaxPending(),
+         OBD2_SNIFFER_RING_FRAMES, sniffer.getBytesWritten(), refused ? "refused" : "sent");
+
+  uint32_t mismatches = 0;
+  uint32_t read = readBack(path, format, mismatches);
+
+  //with drops the sequence shifts, only the counts are compared
+  if (sniffer.getDropped() > 0) mismatches = 0;
+  printf("%u frames read back, %u mismatches\n", read, mismatches);
+
+  bool ok = refused && read == sniffer.getFrames() && sent == sniffer.getFrames() + sniffer.getDropped() && mismatches == 0;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * The protocol engine on a Linux SocketCAN interface. To try it without hardware:
+ *   ip link add dev vcan0 type vcan && ip link set vcan0 up
+ *   obd2_socketcan vcan0 --ecu &      (answers mode 01 rpm/speed/coolant on 7E0/7DF -> 7E8)
+ *   obd2_socketcan vcan0 1000
+ * Usage: obd2_socketcan <interface> [requests | --ecu]
+ */
+
+#include "OBD2.h"
+
+static const OBD2RequestDescriptor requests[] = {
+  OBD2RequestDescriptor("Engine", "rpm", false, 0x7DF, 0x01, 0x0C, 2, 0.25),
+  OBD2RequestDescriptor("Engine", "speed", false, 0x7DF, 0x01, 0x0D, 1),
+  OBD2RequestDescriptor("Engine", "coolant", false, 0x7DF, 0x01, 0x05, 1, 1, -40),
+};
+
+//minimal mode 01 responder, on its own socket
+static int runEcu(const char* interface)
+{
+  SocketCANClass ecu;
+  ecu.setInterface(interface);
+
+  if (!ecu.begin(500E3)) {
+    perror(interface);
+    return 1;
+  }
+
+  //functional and physical requests
+  ecu.filter(0x7DF, 0x7FF);
+  ecu.addFilter(0x7E0, 0x7FF, false);
+
+  printf("ecu on %s\n", interface);
+
+  while (true) {
+    if (!ecu.parsePacket()) {
+      hostClock().sleep(100);
+      continue;
+    }
+
+    uint8_t request[8] = { 0 };
+    int n = 0;
+    while (ecu.available() && n < 8) request[n++] = ecu.read();
+
+    if (request[0] != 0x02 || request[1] != 0x01) continue;
+
+    uint8_t data[2] = { 0x00, 0x00 };
+    uint8_t length = 1;
+
+    switch (request[2]) {
+      case 0x0C: data[0] = 0x1A; data[1] = 0xF8; length = 2; break;
+      case 0x0D: data[0] = 0x32; break;
+      case 0x05: data[0] = 0x7B; break;
+      default: continue;
+    }
+
+    ecu.beginPacket(0x7E8, 8);
+    ecu.write(2 + length);
+    ecu.write(0x41);
+    ecu.write(request[2]);
+    ecu.write(data, length);
+    ecu.endPacket();
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <interface> [requests | --ecu]\n", argv[0]);
+    return 1;
+  }
+
+  if (argc > 2 && strcmp(argv[2], "--ecu") == 0) {
+    return runEcu(argv[1]);
+  }
+
+  long count = argc > 2 ? atol(argv[2]) : 100;
+
+  CAN.setInterface(argv[1]);
+  if (!CAN.begin(500E3)) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  OBD2 obd2;
+  obd2.Begin(0, 0, 500E3);
+
+  //kernel filter: only diagnostic responses reach the process
+  CAN.filter(0x7E8, 0x7F8);
+  obd2.addPacketFilter(0x7E8);
+
+  OBD2RequestState state = {};
+  long sent = 0, received = 0;
+  uint64_t start = hostClock().now();
+
+  while (true) {
+    OBD2StatusType status = obd2.process();
+
+    if (status == OBD2StatusType::ready) {
+      if (state.Status == OBD2StatusType::received) received++;
+      if (sent >= count) break;
+
+      state.Status = OBD2StatusType::undefined;
+      obd2.sendRequest(&requests[sent++ % 3], &state);
+    }
+
+    hostClock().sleep(50);
+  }
+
+  double seconds = (hostClock().now() - start) / 1e6;
+  printf("%ld requests, %ld answered, %.0f requests/s\n", sent, received, seconds > 0 ? received / seconds : 0.0);
+
+  CAN.end();
+
+  return 0;
+}
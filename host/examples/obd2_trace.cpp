@@ -0,0 +1,444 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Binary CAN traces (OBD2Trace, OBD2TraceBlock):
+ *   record    runs the engine against simulated ECUs plus broadcast traffic in virtual time and captures
+ *             the bus it sees, --compressed writes the block format through the capture queue
+ *   replay    feeds a plain trace back through onReceivePacket() with the same request schedule:
+ *             speed 0 is as fast as possible and doubles as a throughput benchmark, 1 is recorded pace
+ *   compress  plain trace to block format
+ *   info      size, frames, blocks and index of a trace
+ *   seek      first frames at a time offset (seconds from the start), optionally of one id
+ *   dump      prints a trace (either format) in candump format
+ * Usage: obd2_trace record <file> [requests] [--compressed] | replay <file> [speed] | compress <in> <out>
+ *        | info <file> | seek <file> <seconds> [id] | dump <file>
+ */
+
+#include <chrono>
+
+#include "OBD2TraceBlock.h"
+#include "SimulatedECU.h"
+#include "SimulatedProfile.h"
+#include "TraceFile.h"
+
+static long received = 0;
+static double valueSum = 0;
+
+static void onValue(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t* responseBytes)
+{
+  if (state->Status == OBD2StatusType::received) {
+    received++;
+    valueSum += value;
+  }
+}
+
+class FilePrint : public Print {
+public:
+  FilePrint(FILE* f) : _f(f) {}
+  using Print::write;
+  size_t write(uint8_t c) override { return fputc(c, _f) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, _f); }
+
+private:
+  FILE* _f;
+};
+
+class FileStream : public Stream {
+public:
+  FileStream(FILE* f) : _f(f) {}
+  size_t write(uint8_t) override { return 0; }
+  int available() override { return feof(_f) ? 0 : 1; }
+  int read() override { return fgetc(_f); }
+  int peek() override { int c = fgetc(_f); if (c != EOF) ungetc(c, _f); return c; }
+
+private:
+  FILE* _f;
+};
+
+//periodic frames of other ecus: the traffic a logger sees on a real bus
+static void broadcast(VirtualClock& clock, uint64_t at, long id, uint32_t period, uint32_t* counter)
+{
+  clock.schedule(at, [&clock, at, id, period, counter]() {
+    uint32_t n = (*counter)++;
+    VirtualCANFrame frame = { id, false, false, 8, { 0 } };
+
+    if (id == 0x4B2) {
+      //wheel speeds, slowly changing
+      uint16_t speed = 10000 + (n / 50) % 200;
+      for (int i = 0; i < 4; i++) {
+        frame.data[2 * i] = speed >> 8;
+        frame.data[2 * i + 1] = speed + i;
+      }
+    } else if (id == 0x0C9) {
+      //engine status with a rolling counter
+      frame.data[0] = 0x80;
+      frame.data[1] = 0x1A;
+      frame.data[2] = 0xF8;
+      frame.data[7] = n & 0x0F;
+    } else {
+      //body status, constant
+      frame.data[2] = 0x12;
+      frame.data[3] = 0x34;
+    }
+
+    CANBus.transmit(frame, NULL);
+    broadcast(clock, at + period, id, period, counter);
+  });
+}
+
+static int record(const char* path, long count, bool compressed)
+{
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  SimulatedECU engine(clock);
+  uint16_t rpm = 3200;
+  engine.setPid(0x01, 0x0C, [&rpm](std::vector<uint8_t>& data) {
+    rpm = rpm >= 16000 ? 3200 : rpm + 40;
+    data = { (uint8_t)(rpm >> 8), (uint8_t)rpm };
+  });
+  engine.setPid(0x01, 0x0D, { 0x32 });
+  engine.setPid(0x01, 0x05, { 0x7B });
+  engine.attach(CANBus);
+
+  SimulatedECUConfig config;
+  config.RequestId = 0x18DA40F1;
+  config.FunctionalId = 0x18DB33F1;
+  config.ResponseId = 0x18DAF140;
+
+  SimulatedECU body(clock, config);
+  body.setPid(0x22, 0x1955, { 0x31, 0x9C });
+  body.setPid(0x22, 0x4001, std::vector<uint8_t>(20, 0x11));
+  body.attach(CANBus);
+
+  uint32_t counters[3] = { 0, 0, 0 };
+  broadcast(clock, 1000, 0x0C9, 10000, &counters[0]);
+  broadcast(clock, 3000, 0x4B2, 20000, &counters[1]);
+  broadcast(clock, 7000, 0x3E9, 100000, &counters[2]);
+
+  FilePrint out(f);
+  OBD2TraceWriter trace;
+  OBD2TraceEncoder encoder;
+
+  if (compressed) {
+    trace.begin();
+    encoder.begin(out);
+  } else {
+    trace.begin(out);
+  }
+
+  OBD2 obd2;
+  obd2.Begin(5, 4, 500E3);
+  obd2.addPacketFilter(0x7E8);
+  obd2.addPacketFilter(0x18DAF140);
+  obd2.onHandleValue(onValue);
+  obd2.setTrace(&trace);
+
+  //the profile obd2_decode reads traces with
+  OBD2RequestState states[SIMULATED_ECUS_COUNT] = {};
+  obd2.setProfile(&simulated_ecus_profile, states);
+  long sent = 0;
+
+  //one request at a time, round robin, until count are sent and the last one is over
+  while (true) {
+    if (obd2.process() == OBD2StatusType::ready) {
+      if (sent >= count) break;
+      obd2.sendProfileRequest(sent++ % SIMULATED_ECUS_COUNT);
+    }
+
+    if (compressed) {
+      encoder.flush(trace);
+    } else {
+      trace.flush();
+    }
+
+    clock.advance(1000);
+  }
+
+  obd2.setTrace(NULL);
+
+  uint64_t bytes;
+  if (compressed) {
+    encoder.flush(trace, 0xFFFF);
+    encoder.end();
+    trace.end();
+    bytes = encoder.getBytesWritten();
+  } else {
+    trace.end();
+    bytes = trace.getBytesWritten();
+  }
+
+  fclose(f);
+
+  printf("%ld requests, %ld received (value sum %.3f)\n", sent, received, valueSum);
+  printf("%lu frames, %lu dropped, %llu bytes, %.1f virtual seconds\n", (unsigned long)trace.getFrames(),
+         (unsigned long)trace.getDropped(), (unsigned long long)bytes, clock.now() / 1e6);
+
+  if (compressed) {
+    printf("%lu blocks, %.2fx smaller than the plain format\n", (unsigned long)encoder.getBlocks(), (double)encoder.getRawBytes() / bytes);
+  }
+
+  setHostClock(NULL);
+  return 0;
+}
+
+static int replay(const char* path, float speed)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  FileStream in(f);
+  OBD2 obd2;
+  OBD2TraceReplay player(obd2, in);
+
+  if (!player.begin()) {
+    fprintf(stderr, "%s: not a trace\n", path);
+    return 1;
+  }
+
+  player.setSpeed(speed);
+
+  //no Begin(): requests go to an empty virtual bus, answers come from the trace
+  obd2.status = OBD2StatusType::ready;
+  obd2.addPacketFilter(0x7E8);
+  obd2.addPacketFilter(0x18DAF140);
+  obd2.onHandleValue(onValue);
+
+  OBD2RequestState states[SIMULATED_ECUS_COUNT] = {};
+  obd2.setProfile(&simulated_ecus_profile, states);
+
+  long sent = 0;
+  uint64_t start = hostClock().now();
+
+  //the next request goes out before the frames that answered it in the recording,
+  //frames are fed while the engine waits for an answer
+  while (true) {
+    OBD2StatusType status = obd2.process();
+
+    if (status == OBD2StatusType::ready) {
+      obd2.sendProfileRequest(sent++ % SIMULATED_ECUS_COUNT);
+      continue;
+    }
+
+    if (status != OBD2StatusType::sending && status != OBD2StatusType::hadling) continue;
+
+    if (player.process() < 0) break;
+    if (speed > 0) hostClock().sleep(100);
+  }
+
+  //dispatch the last answer
+  obd2.process();
+  if (obd2.status != OBD2StatusType::ready) sent--;
+
+  double seconds = (hostClock().now() - start) / 1e6;
+  printf("%ld requests, %ld received (value sum %.3f)\n", sent, received, valueSum);
+  printf("%lu frames in %.6f s, %.0f frames/s, %.1f recorded seconds\n", (unsigned long)player.getFrames(), seconds,
+         seconds > 0 ? player.getFrames() / seconds : 0.0, player.getTraceTime() / 1e6);
+
+  fclose(f);
+  return 0;
+}
+
+static void printFrame(const OBD2TraceFrame& frame, uint64_t time)
+{
+  printf("(%llu.%06llu) can0 %0*lX#", (unsigned long long)(time / 1000000), (unsigned long long)(time % 1000000),
+         frame.Extended ? 8 : 3, frame.Id);
+
+  if (frame.Rtr) {
+    printf("R");
+  } else {
+    for (int i = 0; i < frame.Dlc; i++) printf("%02X", frame.Data[i]);
+  }
+
+  printf("\n");
+}
+
+static int dump(const char* path)
+{
+  TraceFile file;
+  std::vector<TraceRecord> records;
+
+  if (!file.open(path)) {
+    fprintf(stderr, "%s\n", file.error().c_str());
+    return 1;
+  }
+
+  bool intact = file.readAll(records);
+
+  for (const TraceRecord& r : records) {
+    printFrame(r.Frame, r.Time);
+  }
+
+  if (!intact) {
+    fprintf(stderr, "%s: damaged or truncated, %zu frames recovered\n", path, records.size());
+  }
+
+  return 0;
+}
+
+static int compress(const char* in, const char* out)
+{
+  TraceFile file;
+  std::vector<TraceRecord> records;
+
+  if (!file.open(in)) {
+    fprintf(stderr, "%s\n", file.error().c_str());
+    return 1;
+  }
+
+  file.readAll(records);
+
+  FILE* f = fopen(out, "wb");
+  if (!f) {
+    perror(out);
+    return 1;
+  }
+
+  FilePrint print(f);
+  OBD2TraceEncoder encoder;
+  encoder.begin(print);
+
+  for (const TraceRecord& r : records) {
+    encoder.encode(r.Frame);
+  }
+
+  bool written = encoder.end();
+  fclose(f);
+
+  printf("%zu frames, %llu -> %llu bytes (%.2fx), %lu blocks\n", records.size(), (unsigned long long)file.size(),
+         (unsigned long long)encoder.getBytesWritten(), (double)file.size() / encoder.getBytesWritten(),
+         (unsigned long)encoder.getBlocks());
+
+  return written ? 0 : 1;
+}
+
+static int info(const char* path)
+{
+  TraceFile file;
+  std::vector<TraceRecord> records;
+
+  if (!file.open(path)) {
+    fprintf(stderr, "%s\n", file.error().c_str());
+    return 1;
+  }
+
+  bool intact = file.readAll(records);
+  uint64_t duration = records.empty() ? 0 : records.back().Time - records.front().Time;
+
+  printf("%s: %s, %llu bytes, %zu frames, %.1f s%s\n", path, file.compressed() ? "block format" : "plain format",
+         (unsigned long long)file.size(), records.size(), duration / 1e6, intact ? "" : ", damaged");
+
+  if (file.compressed()) {
+    printf("%zu blocks, %.1f bytes/frame, index: %zu entries%s\n", file.blocks().size(),
+           records.empty() ? 0.0 : (double)file.size() / records.size(), file.index().size(),
+           file.hasIndex() ? "" : " (none, headers scanned)");
+  }
+
+  return 0;
+}
+
+static int seek(const char* path, double seconds, const char* id)
+{
+  TraceFile file;
+
+  if (!file.open(path)) {
+    fprintf(stderr, "%s\n", file.error().c_str());
+    return 1;
+  }
+
+  if (!file.compressed()) {
+    fprintf(stderr, "%s: seek needs the block format (obd2_trace compress)\n", path);
+    return 1;
+  }
+
+  //times are relative to the first block
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  TraceBlock first;
+  if (!file.seek(0, first)) {
+    fprintf(stderr, "%s: no blocks\n", path);
+    return 1;
+  }
+
+  uint64_t time = first.Header.Time + (uint64_t)(seconds * 1e6);
+  long filterId = id ? strtol(id, NULL, 16) : -1;
+  bool extended = id && strlen(id) > 3;
+
+  std::vector<TraceBlock> candidates;
+  TraceBlock block;
+
+  if (filterId >= 0) {
+    file.findBlocks(filterId, extended, candidates);
+  } else if (file.seek(time, block)) {
+    candidates.push_back(block);
+  }
+
+  int printed = 0;
+  size_t blocksRead = 0;
+
+  for (const TraceBlock& b : candidates) {
+    if (b.Header.lastTime() < time) continue;
+
+    std::vector<TraceRecord> records;
+    file.readBlock(b, records);
+    blocksRead++;
+
+    for (const TraceRecord& r : records) {
+      if (r.Time < time || (filterId >= 0 && (r.Frame.Id != filterId || r.Frame.Extended != extended))) continue;
+
+      printFrame(r.Frame, r.Time - first.Header.Time);
+      if (++printed == 10) break;
+    }
+
+    if (printed == 10) break;
+  }
+
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%d frames, %zu blocks decoded, %.3f ms\n", printed, blocksRead, ms);
+
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc >= 3 && strcmp(argv[1], "record") == 0) {
+    bool compressed = strcmp(argv[argc - 1], "--compressed") == 0;
+    int args = compressed ? argc - 1 : argc;
+    return record(argv[2], args > 3 ? atol(argv[3]) : 1000, compressed);
+  }
+
+  if (argc >= 3 && strcmp(argv[1], "replay") == 0) {
+    return replay(argv[2], argc > 3 ? atof(argv[3]) : 0);
+  }
+
+  if (argc >= 4 && strcmp(argv[1], "compress") == 0) {
+    return compress(argv[2], argv[3]);
+  }
+
+  if (argc >= 3 && strcmp(argv[1], "info") == 0) {
+    return info(argv[2]);
+  }
+
+  if (argc >= 4 && strcmp(argv[1], "seek") == 0) {
+    return seek(argv[2], atof(argv[3]), argc > 4 ? argv[4] : NULL);
+  }
+
+  if (argc >= 3 && strcmp(argv[1], "dump") == 0) {
+    return dump(argv[2]);
+  }
+
+  fprintf(stderr, "usage: %s record <file> [requests] [--compressed] | replay <file> [speed] | compress <in> <out>\n"
+                  "       | info <file> | seek <file> <seconds> [id] | dump <file>\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,245 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Event triggered capture (OBD2TriggerCapture): polls the simulated ECUs profile during a drive in
+ * virtual time, with broadcast traffic, and writes one trace per trigger event to <dir>:
+ *   overRev      engineSpeed rising over 2800 rpm (hysteresis 300)
+ *   lowBattery   batteryVoltage falling under 13.5 V (hysteresis 0.3)
+ *   gearChange   gear, derived from speed and rpm, fed with update()
+ * Each event file is then read back and checked against its window. Event files are plain traces:
+ * obd2_trace dump and obd2_decode read them.
+ * Usage: obd2_trigger <dir> [minutes]
+ */
+
+#include <math.h>
+
+#include <map>
+
+#include "OBD2Trigger.h"
+#include "SimulatedECU.h"
+#include "SimulatedProfile.h"
+
+class FilePrint : public Print {
+public:
+  FilePrint(FILE* f) : _f(f) {}
+  using Print::write;
+  size_t write(uint8_t c) override { return fputc(c, _f) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, _f); }
+  FILE* file() { return _f; }
+
+private:
+  FILE* _f;
+};
+
+class FileStream : public Stream {
+public:
+  FileStream(FILE* f) : _f(f) {}
+  size_t write(uint8_t) override { return 0; }
+  int available() override { return feof(_f) ? 0 : 1; }
+  int read() override { return fgetc(_f); }
+  int peek() override { int c = fgetc(_f); if (c != EOF) ungetc(c, _f); return c; }
+
+private:
+  FILE* _f;
+};
+
+struct WrittenEvent {
+  std::string Path;
+  OBD2TriggerEvent Info;
+};
+
+//one file per event, events may overlap
+class EventFiles : public IOBD2TriggerSink {
+public:
+  EventFiles(const char* dir) : _dir(dir) {}
+
+  Print* onTriggerStart(const OBD2TriggerEvent& event) override
+  {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/event_%03u_%s.o2tr", _dir, event.Sequence, event.Name);
+
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+      perror(path);
+      return NULL;
+    }
+
+    _paths[event.Sequence] = path;
+    return new FilePrint(f);
+  }
+
+  void onTriggerEnd(const OBD2TriggerEvent& event, Print* out) override
+  {
+    FilePrint* file = (FilePrint*)out;
+    fclose(file->file());
+    delete file;
+
+    printf("event %3u %-11s value %8.2f at %7.3f s: %5u frames, %u lost, %u ms truncated\n", event.Sequence, event.Name,
+           event.Value, event.Time / 1000.0, event.Frames, event.Lost, event.Truncated);
+    events.push_back({ _paths[event.Sequence], event });
+    _paths.erase(event.Sequence);
+  }
+
+  std::vector<WrittenEvent> events;
+
+private:
+  const char* _dir;
+  std::map<uint32_t, std::string> _paths;
+};
+
+//periodic frames of other ecus
+static void broadcast(VirtualClock& clock, uint64_t at, long id, uint32_t period)
+{
+  clock.schedule(at, [&clock, at, id, period]() {
+    VirtualCANFrame frame = { id, false, false, 8, { 0 } };
+    frame.data[0] = (uint8_t)(at / period);
+    CANBus.transmit(frame, NULL);
+    broadcast(clock, at + period, id, period);
+  });
+}
+
+//frames in the window (fired at a millisecond boundary in virtual time), in order, as many as reported
+static bool check(const WrittenEvent& event, uint32_t preTrigger, uint32_t postTrigger)
+{
+  FILE* f = fopen(event.Path.c_str(), "rb");
+  if (!f) {
+    perror(event.Path.c_str());
+    return false;
+  }
+
+  FileStream in(f);
+  OBD2TraceReader reader(in);
+  bool ok = reader.begin();
+
+  OBD2TraceFrame frame;
+  uint32_t frames = 0, previous = 0;
+  uint32_t start = (event.Info.Time - preTrigger) * 1000, end = (event.Info.Time + postTrigger) * 1000;
+
+  while (ok && reader.next(frame)) {
+    ok = (int32_t)(frame.Timestamp - start) >= 0 && (int32_t)(frame.Timestamp - end) <= 0 &&
+         (frames == 0 || (int32_t)(frame.Timestamp - previous) >= 0);
+    previous = frame.Timestamp;
+    frames++;
+  }
+
+  fclose(f);
+
+  if (!ok || frames != event.Info.Frames) {
+    fprintf(stderr, "%s: %u frames read, %u written, window %s\n", event.Path.c_str(), frames, event.Info.Frames,
+            ok ? "ok" : "violated");
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <dir> [minutes]\n", argv[0]);
+    return 1;
+  }
+
+  const char* dir = argv[1];
+  double minutes = argc > 2 ? atof(argv[2]) : 10;
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  //speed and rpm follow a slow cycle with quick revs, the battery sags now and then
+  SimulatedECU engine(clock);
+  engine.setPid(0x01, 0x0C, [&clock](std::vector<uint8_t>& data) {
+    double t = clock.now() / 1e6;
+    uint16_t raw = (uint16_t)((1800 + 900 * sin(t / 40) + 400 * sin(t / 3)) * 4);
+    data = { (uint8_t)(raw >> 8), (uint8_t)raw };
+  });
+  engine.setPid(0x01, 0x0D, [&clock](std::vector<uint8_t>& data) {
+    double t = clock.now() / 1e6;
+    data = { (uint8_t)(70 + 50 * sin(t / 40)) };
+  });
+  engine.setPid(0x01, 0x05, { 0x7B });
+  engine.attach(CANBus);
+
+  SimulatedECUConfig config;
+  config.RequestId = 0x18DA40F1;
+  config.FunctionalId = 0x18DB33F1;
+  config.ResponseId = 0x18DAF140;
+
+  SimulatedECU body(clock, config);
+  body.setPid(0x22, 0x1955, [&clock](std::vector<uint8_t>& data) {
+    uint32_t s = clock.now() / 1000000;
+    uint16_t mv = s % 97 < 4 ? 13000 : 14100;
+    data = { (uint8_t)(mv >> 8), (uint8_t)mv };
+  });
+  body.setPid(0x22, 0x4001, std::vector<uint8_t>(20, 0x11));
+  body.attach(CANBus);
+
+  broadcast(clock, 1000, 0x0C9, 10000);
+  broadcast(clock, 3000, 0x4B2, 20000);
+  broadcast(clock, 7000, 0x3E9, 100000);
+
+  OBD2TraceWriter trace;
+  trace.begin();
+
+  OBD2 obd2;
+  obd2.Begin(5, 4, 500E3);
+  obd2.addPacketFilter(0x7E8);
+  obd2.addPacketFilter(0x18DAF140);
+  obd2.setTrace(&trace);
+
+  OBD2RequestState states[SIMULATED_ECUS_COUNT] = {};
+  obd2.setProfile(&simulated_ecus_profile, states);
+
+  OBD2TriggerCapture capture(trace);
+  int overRev = capture.addTrigger("overRev", &simulated_ecus_requests[SIMULATED_ECUS_ENGINESPEED],
+                                   OBD2TriggerType::rising, 2800, 300, 2000, 3000);
+  int lowBattery = capture.addTrigger("lowBattery", &simulated_ecus_requests[SIMULATED_ECUS_BATTERYVOLTAGE],
+                                      OBD2TriggerType::falling, 13.5, 0.3, 3000, 2000);
+  int gearChange = capture.addTrigger("gearChange", OBD2TriggerType::change, 0.5, 0, 1000, 1000);
+
+  EventFiles files(dir);
+  capture.setSink(&files);
+  capture.attach(obd2);
+
+  uint64_t end = (uint64_t)(minutes * 60e6);
+  uint64_t nextGear = 0;
+
+  while (clock.now() < end || capture.getActiveEvents() > 0) {
+    if (obd2.process() == OBD2StatusType::ready && clock.now() < end) {
+      obd2.sendNextProfileRequest();
+    }
+
+    //gear from speed over rpm, 5 times a second
+    if (clock.now() >= nextGear && clock.now() < end) {
+      float rpm = states[SIMULATED_ECUS_ENGINESPEED].Value;
+      float speed = states[SIMULATED_ECUS_VEHICLESPEED].Value;
+      float gear = rpm > 0 ? fminf(6, roundf(speed / rpm * 1000 / 8)) : 0;
+      capture.update(gearChange, gear);
+      nextGear += 200000;
+    }
+
+    capture.process();
+    clock.advance(1000);
+  }
+
+  obd2.setTrace(NULL);
+  trace.end();
+  setHostClock(NULL);
+
+  printf("%.0f minutes, %u frames captured, %u overRev, %u lowBattery, %u gearChange, %u skipped\n", minutes,
+         capture.getCaptured(), capture.getFired(overRev), capture.getFired(lowBattery), capture.getFired(gearChange),
+         capture.getSkipped());
+
+  //windows as passed to addTrigger(), by trigger id
+  const uint32_t pre[] = { 2000, 3000, 1000 }, post[] = { 3000, 2000, 1000 };
+  size_t bad = 0;
+
+  for (const WrittenEvent& event : files.events) {
+    if (!check(event, pre[event.Info.Trigger], post[event.Info.Trigger])) bad++;
+  }
+
+  printf("%zu event traces checked, %zu bad\n", files.events.size(), bad);
+  return bad == 0 ? 0 : 1;
+}
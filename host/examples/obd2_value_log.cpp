@@ -0,0 +1,238 @@
+/**
+ * Obd2Reader - host build
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Decoded value logging (OBD2ValueLogger):
+ *   record  polls the simulated ECUs profile at its ReadInterval rates in virtual time, logs every
+ *           response (plus a quantized trip distance channel), then reads the log back and checks
+ *           every sample against the values the engine reported
+ *   dump    prints a log as "channel,time,value" rows (time in seconds, empty value for gaps)
+ * Usage: obd2_value_log record <file> [minutes] | dump <file>
+ */
+
+#include <math.h>
+
+#include <vector>
+
+#include "OBD2ValueLogger.h"
+#include "SimulatedECU.h"
+#include "SimulatedProfile.h"
+
+struct ExpectedSample {
+  int Channel;
+  uint32_t Timestamp;
+  bool Valid;
+  float Value;
+};
+
+static std::vector<ExpectedSample> expected;
+static int channelOfRequest[SIMULATED_ECUS_COUNT];
+
+static void onValue(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t* responseBytes)
+{
+  int channel = channelOfRequest[request - simulated_ecus_requests];
+  bool valid = state->Status != OBD2StatusType::timeout && state->Status != OBD2StatusType::nodata &&
+               state->Status != OBD2StatusType::error;
+
+  expected.push_back({ channel, (uint32_t)millis(), valid, valid ? value : 0.0f });
+}
+
+class FilePrint : public Print {
+public:
+  FilePrint(FILE* f) : _f(f) {}
+  using Print::write;
+  size_t write(uint8_t c) override { return fputc(c, _f) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, _f); }
+
+private:
+  FILE* _f;
+};
+
+class FileStream : public Stream {
+public:
+  FileStream(FILE* f) : _f(f) {}
+  size_t write(uint8_t) override { return 0; }
+  int available() override { return feof(_f) ? 0 : 1; }
+  int read() override { return fgetc(_f); }
+  int peek() override { int c = fgetc(_f); if (c != EOF) ungetc(c, _f); return c; }
+
+private:
+  FILE* _f;
+};
+
+static int record(const char* path, double minutes)
+{
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  VirtualClock clock;
+  setHostClock(&clock);
+
+  //a drive: speed and rpm follow a slow cycle, coolant warms up, battery ripples
+  SimulatedECU engine(clock);
+  engine.setPid(0x01, 0x0C, [&clock](std::vector<uint8_t>& data) {
+    double t = clock.now() / 1e6;
+    uint16_t raw = (uint16_t)((1800 + 1200 * sin(t / 40) + 300 * sin(t / 3)) * 4);
+    data = { (uint8_t)(raw >> 8), (uint8_t)raw };
+  });
+  engine.setPid(0x01, 0x0D, [&clock](std::vector<uint8_t>& data) {
+    double t = clock.now() / 1e6;
+    data = { (uint8_t)(70 + 50 * sin(t / 40)) };
+  });
+  engine.setPid(0x01, 0x05, [&clock](std::vector<uint8_t>& data) {
+    double t = clock.now() / 1e6;
+    data = { (uint8_t)(40 + 90 - 70 * exp(-t / 600)) };
+  });
+  engine.attach(CANBus);
+
+  SimulatedECUConfig config;
+  config.RequestId = 0x18DA40F1;
+  config.FunctionalId = 0x18DB33F1;
+  config.ResponseId = 0x18DAF140;
+
+  SimulatedECU body(clock, config);
+  body.setPid(0x22, 0x1955, [&clock](std::vector<uint8_t>& data) {
+    uint16_t mv = 14100 + (clock.now() / 1000000) % 7 * 10;
+    data = { (uint8_t)(mv >> 8), (uint8_t)mv };
+  });
+  body.setPid(0x22, 0x4001, std::vector<uint8_t>(20, 0x11));
+  body.attach(CANBus);
+
+  OBD2 obd2;
+  obd2.Begin(5, 4, 500E3);
+  obd2.addPacketFilter(0x7E8);
+  obd2.addPacketFilter(0x18DAF140);
+
+  OBD2RequestState states[SIMULATED_ECUS_COUNT] = {};
+  obd2.setProfile(&simulated_ecus_profile, states);
+
+  OBD2ValueLogger logger;
+  for (int i = 0; i < SIMULATED_ECUS_COUNT; i++) {
+    channelOfRequest[i] = logger.addRequest(&simulated_ecus_requests[i]);
+  }
+  int distance = logger.addChannel("tripDistance", 0.01); //km
+
+  FilePrint out(f);
+  if (!logger.begin(out)) {
+    fprintf(stderr, "%s: header not written\n", path);
+    fclose(f);
+    return 1;
+  }
+  logger.attach(obd2);
+  obd2.onHandleValue(onValue);
+
+  double km = 0;
+  uint64_t end = (uint64_t)(minutes * 60e6);
+  uint64_t nextSecond = 1000000;
+
+  while (clock.now() < end) {
+    if (obd2.process() == OBD2StatusType::ready) {
+      obd2.sendNextProfileRequest();
+    }
+
+    //derived value once a second, quantized to 10 m
+    if (clock.now() >= nextSecond) {
+      km += states[SIMULATED_ECUS_VEHICLESPEED].Value / 3600.0;
+      float logged = (float)km;
+      logger.log(distance, logged);
+      expected.push_back({ distance, (uint32_t)millis(), true, roundf(logged / 0.01f) * 0.01f });
+      nextSecond += 1000000;
+    }
+
+    logger.flush();
+    clock.advance(1000);
+  }
+
+  logger.end();
+  fclose(f);
+  setHostClock(NULL);
+
+  uint32_t bytes = logger.getBytesWritten();
+  printf("%.0f minutes, %u samples, %u channels, %u bytes (%.2f bytes/sample, %.0f KB/hour), %u blocks dropped\n",
+         minutes, logger.getSamples(), logger.getChannels(), bytes, (double)bytes / logger.getSamples(),
+         bytes / (minutes / 60) / 1024, logger.getDroppedBlocks());
+
+  //read back: every sample, same time, same float bits
+  f = fopen(path, "rb");
+  FileStream in(f);
+  OBD2ValueLogReader reader(in);
+
+  if (!reader.begin()) {
+    fprintf(stderr, "%s: not a value log\n", path);
+    return 1;
+  }
+
+  OBD2LoggedSample sample;
+  size_t n = 0, mismatches = 0;
+
+  while (reader.next(sample)) {
+    bool same = n < expected.size() && expected[n].Channel == sample.Channel && expected[n].Timestamp == sample.Timestamp &&
+                expected[n].Valid == sample.Valid && memcmp(&expected[n].Value, &sample.Value, sizeof(float)) == 0;
+
+    if (!same && mismatches++ < 5) {
+      fprintf(stderr, "sample %zu: channel %d at %u = %.9g, expected channel %d at %u = %.9g\n", n, sample.Channel,
+              sample.Timestamp, sample.Value, expected[n].Channel, expected[n].Timestamp, expected[n].Value);
+    }
+
+    n++;
+  }
+
+  fclose(f);
+
+  printf("read back %zu of %zu samples, %zu mismatches, %u damaged blocks\n", n, expected.size(), mismatches,
+         reader.getDamagedBlocks());
+
+  return n == expected.size() && mismatches == 0 ? 0 : 1;
+}
+
+static int dump(const char* path)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  FileStream in(f);
+  OBD2ValueLogReader reader(in);
+
+  if (!reader.begin()) {
+    fprintf(stderr, "%s: not a value log\n", path);
+    return 1;
+  }
+
+  OBD2LoggedSample sample;
+
+  printf("channel,time,value\n");
+
+  while (reader.next(sample)) {
+    printf("%s,%u.%03u,", reader.getChannel(sample.Channel).Name, sample.Timestamp / 1000, sample.Timestamp % 1000);
+
+    if (sample.Valid) {
+      printf("%.9g", sample.Value);
+    }
+
+    printf("\n");
+  }
+
+  fclose(f);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc >= 3 && strcmp(argv[1], "record") == 0) {
+    return record(argv[2], argc > 3 ? atof(argv[3]) : 60);
+  }
+
+  if (argc >= 3 && strcmp(argv[1], "dump") == 0) {
+    return dump(argv[2]);
+  }
+
+  fprintf(stderr, "usage: %s record <file> [minutes] | dump <file>\n", argv[0]);
+  return 1;
+}
@@ -4,7 +4,11 @@
 #ifndef CAN_H
 #define CAN_H
 
-#ifdef ARDUINO_ARCH_ESP32
+#if defined(OBD2_SOCKETCAN)
+#include "SocketCAN.h"
+#elif defined(OBD2_HOST)
+#include "VirtualCAN.h"
+#elif defined(ARDUINO_ARCH_ESP32)
 #include "ESP32SJA1000.h"
 #else
 #include "MCP2515.h"
@@ -5,20 +5,27 @@
 
 CANControllerClass::CANControllerClass() :
   _onReceive(NULL),
-  
+  _CanHandler(NULL),
+
   _packetBegun(false),
   _txId(-1),
   _txExtended(-1),
   _txRtr(false),
   _txDlc(0),
   _txLength(0),
+  _txHead(0),
+  _txTail(0),
+  _txCompleted(0),
+  _txFailed(0),
+  _txAborted(0),
 
   _rxId(-1),
   _rxExtended(false),
   _rxRtr(false),
   _rxDlc(0),
   _rxLength(0),
-  _rxIndex(0)
+  _rxIndex(0),
+  _rxTimestamp(0)
 {
   // overide Stream timeout value
   setTimeout(0);
@@ -35,6 +42,8 @@ int CANControllerClass::begin(long /*baudRate*/)
   _txRtr =false;
   _txDlc = 0;
   _txLength = 0;
+  _txHead = 0;
+  _txTail = 0;
 
   _rxId = -1;
   _rxRtr = false;
@@ -112,6 +121,112 @@ int CANControllerClass::parsePacket()
   return 0;
 }
 
+int CANControllerClass::injectPacket(long id, bool extended, bool rtr, int dlc, const uint8_t* data)
+{
+  if (dlc < 0 || dlc > 8) {
+    return 0;
+  }
+
+  CANFrame frame = {};
+  frame.id = id;
+  frame.extended = extended;
+  frame.rtr = rtr;
+  frame.dlc = dlc;
+  frame.timestamp = micros();
+
+  if (!rtr) {
+    memcpy(frame.data, data, dlc);
+  }
+
+  return injectPacket(frame);
+}
+
+int CANControllerClass::injectPacket(const CANFrame& frame)
+{
+  if (frame.dlc > 8) {
+    return 0;
+  }
+
+  _rxId = frame.id;
+  _rxExtended = frame.extended;
+  _rxRtr = frame.rtr;
+  _rxDlc = frame.dlc;
+  _rxIndex = 0;
+  _rxTimestamp = frame.timestamp;
+
+  if (frame.rtr) {
+    _rxLength = 0;
+  } else {
+    _rxLength = frame.dlc;
+    memcpy(_rxData, frame.data, frame.dlc);
+  }
+
+  return _rxDlc;
+}
+
+int CANControllerClass::readFrame(CANFrame& frame)
+{
+  if (_rxId < 0) {
+    return 0;
+  }
+
+  frame.id = _rxId;
+  frame.extended = _rxExtended;
+  frame.rtr = _rxRtr;
+  frame.dlc = _rxDlc;
+  frame.timestamp = _rxTimestamp;
+  memcpy(frame.data, _rxData, _rxLength);
+  memset(&frame.data[_rxLength], 0x00, sizeof(frame.data) - _rxLength);
+
+  _rxIndex = _rxLength;
+
+  return 1;
+}
+
+int CANControllerClass::writeFrame(const CANFrame& frame)
+{
+  if (frame.id < 0 || frame.id > (frame.extended ? 0x1FFFFFFF : 0x7FF)) {
+    return 0;
+  }
+
+  if (frame.dlc > 8) {
+    return 0;
+  }
+
+  _packetBegun = true;
+  _txId = frame.id;
+  _txExtended = frame.extended;
+  _txRtr = frame.rtr;
+  _txDlc = frame.dlc;
+  _txLength = frame.dlc;
+
+  memcpy(_txData, frame.data, sizeof(_txData));
+
+  return endPacket();
+}
+
+int CANControllerClass::readFrames(CANFrame* frames, int count)
+{
+  int n = 0;
+
+  while (n < count && parsePacket()) {
+    readFrame(frames[n++]);
+  }
+
+  return n;
+}
+
+int CANControllerClass::writeFrames(const CANFrame* frames, int count)
+{
+  int n = 0;
+
+  while (n < count && writeFrame(frames[n])) {
+    n++;
+  }
+
+  return n;
+}
+
 long CANControllerClass::packetId()
 {
   return _rxId;
@@ -180,6 +295,56 @@ void CANControllerClass::flush()
 {
 }
 
+bool CANControllerClass::pushTx()
+{
+  if ((uint8_t)(_txHead - _txTail) >= CAN_TX_QUEUE_SIZE) {
+    return false;
+  }
+
+  CANFrame& frame = _txQueue[_txHead & (CAN_TX_QUEUE_SIZE - 1)];
+
+  frame.id = _txId;
+  frame.extended = _txExtended;
+  frame.rtr = _txRtr;
+  frame.dlc = _txLength;
+  memcpy(frame.data, _txData, sizeof(frame.data));
+
+  _txHead++;
+
+  return true;
+}
+
+bool CANControllerClass::popTx(CANFrame& frame)
+{
+  if (_txHead == _txTail) {
+    return false;
+  }
+
+  frame = _txQueue[_txTail & (CAN_TX_QUEUE_SIZE - 1)];
+  _txTail++;
+
+  return true;
+}
+
+void CANControllerClass::txDone(long id, CANTxResult result)
+{
+  switch (result) {
+    case CANTxResult::complete:
+      _txCompleted++;
+      break;
+    case CANTxResult::failed:
+      _txFailed++;
+      break;
+    case CANTxResult::aborted:
+      _txAborted++;
+      break;
+  }
+
+  if (_CanHandler != NULL) {
+    _CanHandler->onTransmitDone(id, result);
+  }
+}
+
 void CANControllerClass::onReceive(void(*callback)(int))
 {
   _onReceive = callback;
@@ -205,6 +370,15 @@ int CANControllerClass::observe()
   return 0;
 }
 
+int CANControllerClass::beginObserve(long baudRate)
+{
+  if (!begin(baudRate)) {
+    return 0;
+  }
+
+  return observe();
+}
+
 int CANControllerClass::loopback()
 {
   return 0;
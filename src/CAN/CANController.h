@@ -7,21 +7,56 @@
 #include <Arduino.h>
 #include "CANHandler.h"
 
+// frames waiting for a free hardware TX buffer, power of two
+#ifndef CAN_TX_QUEUE_SIZE
+#define CAN_TX_QUEUE_SIZE 8
+#endif
+
+// a whole frame, copied in one go by readFrame()/writeFrame() instead of byte by byte through Stream
+struct CANFrame {
+  long id;
+  bool extended;
+  bool rtr;
+  uint8_t dlc;
+  uint8_t data[8]; // dlc bytes, the rest zero (all zero for rtr)
+  uint32_t timestamp; // micros() at arrival, ignored by writeFrame()
+};
+
 class CANControllerClass : public Stream {
 
 public:
   virtual int begin(long baudRate);
   virtual void end();
 
+  // rx/tx on the ESP32, cs/irq on the MCP2515, unused by the host backends
+  virtual void setPins(int /*pin1*/, int /*pin2*/) {}
+
   int beginPacket(int id, int dlc = -1, bool rtr = false);
   int beginExtendedPacket(long id, int dlc = -1, bool rtr = false);
   virtual int endPacket();
 
   virtual int parsePacket();
+  // load a frame as if parsePacket() had received it (replay, benchmarks), returns its dlc
+  int injectPacket(long id, bool extended, bool rtr, int dlc, const uint8_t* data);
+  // same, arrival time from frame.timestamp (a recorded one) instead of micros()
+  int injectPacket(const CANFrame& frame);
   long packetId();
   bool packetExtended();
   bool packetRtr();
   int packetDlc();
+  // payload of the current packet (packetDlc() bytes, none for rtr), unaffected by read()
+  const uint8_t* packetData() { return _rxData; }
+  // micros() when the current packet arrived: taken in the receive interrupt, or when polled
+  uint32_t packetTimestamp() { return _rxTimestamp; }
+
+  // the current packet, its payload is consumed: returns 0 if there is none
+  int readFrame(CANFrame& frame);
+  // same as beginPacket()/write()/endPacket(), returns the endPacket() result
+  int writeFrame(const CANFrame& frame);
+  // polled receive: parsePacket() and readFrame() up to count frames, returns the frames read
+  int readFrames(CANFrame* frames, int count);
+  // stops at the first frame not sent (eg. TX queue full), returns the frames sent
+  int writeFrames(const CANFrame* frames, int count);
 
   // from Print
   virtual size_t write(uint8_t byte);
@@ -35,6 +70,17 @@ public:
 
   virtual void onReceive(void(*callback)(int));
   virtual void onReceive(CANHandler* handler);
+  // receive work deferred by the interrupt (MCP2515): call it from loop, returns frames dispatched.
+  // On the MCP2515 the onReceive() callbacks only run from here
+  virtual int poll() { return 0; }
+
+  // queued transmit (MCP2515, ESP32): endPacket() returns once the frame is queued (0 if the queue
+  // is full), results go to CANHandler::onTransmitDone() and the counters
+  virtual int abortTransmit() { return 0; } // queued and in flight frames
+  virtual int txPending() { return 0; }
+  uint32_t txCompleted() { return _txCompleted; }
+  uint32_t txFailed() { return _txFailed; }
+  uint32_t txAborted() { return _txAborted; }
 
   virtual int filter(int id) { return filter(id, 0x7ff); }
   virtual int filter(int id, int mask);
@@ -42,6 +88,8 @@ public:
   virtual int filterExtended(long id, long mask);
 
   virtual int observe();
+  // begin() ending in listen-only: the node never acknowledges a frame or sends an error frame
+  virtual int beginObserve(long baudRate);
   virtual int loopback();
   virtual int sleep();
   virtual int wakeup();
@@ -50,6 +98,13 @@ protected:
   CANControllerClass();
   virtual ~CANControllerClass();
 
+protected:
+  // the driver serializes these with its transmit interrupt
+  bool pushTx(); // the packet ended by endPacket()
+  bool popTx(CANFrame& frame);
+  int queuedTx() { return (uint8_t)(_txHead - _txTail); }
+  void txDone(long id, CANTxResult result);
+
 protected:
   void (*_onReceive)(int);
   CANHandler* _CanHandler;
@@ -62,6 +117,13 @@ protected:
   int _txLength;
   uint8_t _txData[8];
 
+  CANFrame _txQueue[CAN_TX_QUEUE_SIZE];
+  uint8_t _txHead;
+  uint8_t _txTail;
+  uint32_t _txCompleted;
+  uint32_t _txFailed;
+  uint32_t _txAborted;
+
   long _rxId;
   bool _rxExtended;
   bool _rxRtr;
@@ -69,6 +131,7 @@ protected:
   int _rxLength;
   int _rxIndex;
   uint8_t _rxData[8];
+  uint32_t _rxTimestamp;
 
 };
 
@@ -7,9 +7,21 @@
 
 #ifndef CAN_HANDLER_H
 #define CAN_HANDLER_H
+
+#include <stdint.h>
+
+//outcome of a queued transmit
+enum class CANTxResult : uint8_t {
+    complete,
+    failed, //bus errors, given up
+    aborted //abortTransmit()
+};
+
 class CANHandler{
     public:
         virtual ~CANHandler(){}
-        virtual void onReceivePacket(int packetSize);
+        virtual void onReceivePacket(int packetSize){};
+        //drivers with a transmit queue, same context as onReceivePacket()
+        virtual void onTransmitDone(long id, CANTxResult result){};
 };
 #endif
\ No newline at end of file
@@ -31,15 +31,38 @@
 #define REG_ACRn(n)                (0x10 + n)
 #define REG_AMRn(n)                (0x14 + n)
 
+#define REG_RMC                    0x1d
+
 #define REG_CDR                    0x1F
 
+#define FLAG_RIE                   0x01
+
+// endPacket() and the transmit interrupt share the queue and the TX buffer state
+static portMUX_TYPE txMux = portMUX_INITIALIZER_UNLOCKED;
+
 
 ESP32SJA1000Class::ESP32SJA1000Class() :
   CANControllerClass(),
   _rxPin(DEFAULT_CAN_RX_PIN),
   _txPin(DEFAULT_CAN_TX_PIN),
   _loopback(false),
-  _intrHandle(NULL)
+  _listenOnly(false),
+  _intrHandle(NULL),
+  _txBusy(false),
+  _txError(false),
+  _txInFlight(0),
+  _busOff(false),
+  _autoRecover(true),
+  _rxOverflows(0),
+  _busErrors(0),
+  _arbitrationLost(0),
+  _errorWarnings(0),
+  _errorPassives(0),
+  _busOffs(0),
+  _lastErrorCode(0),
+  _lastArbitrationLost(0),
+  _interruptTimestamp(0),
+  _draining(false)
 {
 }
 
@@ -48,11 +71,25 @@ ESP32SJA1000Class::~ESP32SJA1000Class()
 }
 
 int ESP32SJA1000Class::begin(long baudRate)
+{
+  return start(baudRate, false);
+}
+
+int ESP32SJA1000Class::beginObserve(long baudRate)
+{
+  return start(baudRate, true);
+}
+
+int ESP32SJA1000Class::start(long baudRate, bool listenOnly)
 {
 
   CANControllerClass::begin(baudRate);
 
   _loopback = false;
+  _listenOnly = listenOnly;
+  _txBusy = false;
+  _txError = false;
+  _busOff = false;
 
   DPORT_CLEAR_PERI_REG_MASK(DPORT_PERIP_RST_EN_REG, DPORT_CAN_RST);
   DPORT_SET_PERI_REG_MASK(DPORT_PERIP_CLK_EN_REG, DPORT_CAN_CLK_EN);
@@ -122,7 +159,8 @@ int ESP32SJA1000Class::begin(long baudRate)
   }
 
   modifyRegister(REG_BTR1, 0x80, 0x80); // SAM = 1
-  writeRegister(REG_IER, 0xef); // enable all interrupts
+  // enable all interrupts, receive only with a receive callback: polling reads with parsePacket()
+  writeRegister(REG_IER, (_onReceive != NULL || _CanHandler != NULL) ? 0xef : 0xef & ~FLAG_RIE);
 
   // set filter to allow anything
   writeRegister(REG_ACRn(0), 0x00);
@@ -143,9 +181,14 @@ int ESP32SJA1000Class::begin(long baudRate)
   readRegister(REG_ECC);
   readRegister(REG_IR);
 
-  // normal mode
+  // normal mode, or straight from reset to listen-only: no frame is acknowledged
   modifyRegister(REG_MOD, 0x08, 0x08);
-  modifyRegister(REG_MOD, 0x17, 0x00);
+  leaveReset();
+
+  // transmit completions need the interrupt even without a receive callback
+  if (!_intrHandle) {
+    esp_intr_alloc(ETS_CAN_INTR_SOURCE, 0, ESP32SJA1000Class::onInterrupt, this, &_intrHandle);
+  }
 
   return 1;
 }
@@ -165,37 +208,62 @@ void ESP32SJA1000Class::end()
 
 int ESP32SJA1000Class::endPacket()
 {
-  if (!CANControllerClass::endPacket()) {
+  // listen only: the controller would not send it
+  if (!CANControllerClass::endPacket() || _listenOnly) {
     return 0;
   }
 
-  // wait for TX buffer to free
-  while ((readRegister(REG_SR) & 0x04) != 0x04) {
-    yield();
+  portENTER_CRITICAL(&txMux);
+
+  bool queued = pushTx();
+
+  // while bus-off the queue waits for the recovery
+  if (queued && !_txBusy && !_busOff) {
+    startTx();
+  }
+
+  portEXIT_CRITICAL(&txMux);
+
+  return queued ? 1 : 0;
+}
+
+// next queued frame into the TX buffer, under txMux
+void ESP32SJA1000Class::startTx()
+{
+  CANFrame frame;
+
+  if (!popTx(frame)) {
+    return;
   }
 
   int dataReg;
 
-  if (_txExtended) {
-    writeRegister(REG_EFF, 0x80 | (_txRtr ? 0x40 : 0x00) | (0x0f & _txLength));
-    writeRegister(REG_EFF + 1, _txId >> 21);
-    writeRegister(REG_EFF + 2, _txId >> 13);
-    writeRegister(REG_EFF + 3, _txId >> 5);
-    writeRegister(REG_EFF + 4, _txId << 3);
+  if (frame.extended) {
+    writeRegister(REG_EFF, 0x80 | (frame.rtr ? 0x40 : 0x00) | (0x0f & frame.dlc));
+    writeRegister(REG_EFF + 1, frame.id >> 21);
+    writeRegister(REG_EFF + 2, frame.id >> 13);
+    writeRegister(REG_EFF + 3, frame.id >> 5);
+    writeRegister(REG_EFF + 4, frame.id << 3);
 
     dataReg = REG_EFF + 5;
   } else {
-    writeRegister(REG_SFF, (_txRtr ? 0x40 : 0x00) | (0x0f & _txLength));
-    writeRegister(REG_SFF + 1, _txId >> 3);
-    writeRegister(REG_SFF + 2, _txId << 5);
+    writeRegister(REG_SFF, (frame.rtr ? 0x40 : 0x00) | (0x0f & frame.dlc));
+    writeRegister(REG_SFF + 1, frame.id >> 3);
+    writeRegister(REG_SFF + 2, frame.id << 5);
 
     dataReg = REG_SFF + 3;
   }
 
-  for (int i = 0; i < _txLength; i++) {
-    writeRegister(dataReg + i, _txData[i]);
+  if (!frame.rtr) {
+    for (int i = 0; i < frame.dlc; i++) {
+      writeRegister(dataReg + i, frame.data[i]);
+    }
   }
 
+  _txBusy = true;
+  _txError = false;
+  _txInFlight = frame.id;
+
   if ( _loopback) {
     // self reception request
     modifyRegister(REG_CMR, 0x1f, 0x10);
@@ -203,17 +271,40 @@ int ESP32SJA1000Class::endPacket()
     // transmit request
     modifyRegister(REG_CMR, 0x1f, 0x01);
   }
+}
 
-  // wait for TX complete
-  while ((readRegister(REG_SR) & 0x08) != 0x08) {
-    if (readRegister(REG_ECC) == 0xd9) {
-      modifyRegister(REG_CMR, 0x1f, 0x02); // error, abort
-      return 0;
-    }
-    yield();
+int ESP32SJA1000Class::abortTransmit()
+{
+  int aborted = 0;
+  CANFrame frames[CAN_TX_QUEUE_SIZE];
+
+  portENTER_CRITICAL(&txMux);
+
+  while (popTx(frames[aborted])) {
+    aborted++;
   }
 
-  return 1;
+  // the transmit interrupt reports it, unless the frame made it anyway
+  if (_txBusy) {
+    modifyRegister(REG_CMR, 0x1f, 0x02);
+  }
+
+  portEXIT_CRITICAL(&txMux);
+
+  for (int i = 0; i < aborted; i++) {
+    txDone(frames[i].id, CANTxResult::aborted);
+  }
+
+  return aborted;
+}
+
+int ESP32SJA1000Class::txPending()
+{
+  portENTER_CRITICAL(&txMux);
+  int pending = queuedTx() + (_txBusy ? 1 : 0);
+  portEXIT_CRITICAL(&txMux);
+
+  return pending;
 }
 
 int ESP32SJA1000Class::parsePacket()
@@ -223,9 +314,14 @@ int ESP32SJA1000Class::parsePacket()
     return 0;
   }
 
-  _rxExtended = (readRegister(REG_SFF) & 0x80) ? true : false;
-  _rxRtr = (readRegister(REG_SFF) & 0x40) ? true : false;
-  _rxDlc = (readRegister(REG_SFF) & 0x0f);
+  uint8_t frameInfo = readRegister(REG_SFF);
+
+  // the interrupt stamps the frames it drains, polling stamps them here
+  _rxTimestamp = _draining ? _interruptTimestamp : micros();
+
+  _rxExtended = (frameInfo & 0x80) ? true : false;
+  _rxRtr = (frameInfo & 0x40) ? true : false;
+  _rxDlc = (frameInfo & 0x0f);
   _rxIndex = 0;
 
   int dataReg;
@@ -246,7 +342,8 @@ int ESP32SJA1000Class::parsePacket()
   if (_rxRtr) {
     _rxLength = 0;
   } else {
-    _rxLength = _rxDlc;
+    // a DLC over 8 still means 8 data bytes
+    _rxLength = _rxDlc > 8 ? 8 : _rxDlc;
 
     for (int i = 0; i < _rxLength; i++) {
       _rxData[i] = readRegister(dataReg + i);
@@ -263,28 +360,14 @@ void ESP32SJA1000Class::onReceive(void(*callback)(int))
 {
   CANControllerClass::onReceive(callback);
 
-  if (_intrHandle) {
-    esp_intr_free(_intrHandle);
-    _intrHandle = NULL;
-  }
-
-  if (callback) {
-    esp_intr_alloc(ETS_CAN_INTR_SOURCE, 0, ESP32SJA1000Class::onInterrupt, this, &_intrHandle);
-  }
+  modifyRegister(REG_IER, FLAG_RIE, (callback != NULL || _CanHandler != NULL) ? FLAG_RIE : 0x00);
 }
 
 void ESP32SJA1000Class::onReceive(CANHandler* handler)
 {
   CANControllerClass::onReceive(handler);
 
-  if (_intrHandle) {
-    esp_intr_free(_intrHandle);
-    _intrHandle = NULL;
-  }
-
-  if (handler) {
-    esp_intr_alloc(ETS_CAN_INTR_SOURCE, 0, ESP32SJA1000Class::onInterrupt, this, &_intrHandle);
-  }
+  modifyRegister(REG_IER, FLAG_RIE, (handler != NULL || _onReceive != NULL) ? FLAG_RIE : 0x00);
 }
 
 int ESP32SJA1000Class::filter(int id, int mask)
@@ -304,7 +387,7 @@ int ESP32SJA1000Class::filter(int id, int mask)
   writeRegister(REG_AMRn(2), 0xff);
   writeRegister(REG_AMRn(3), 0xff);
 
-  modifyRegister(REG_MOD, 0x17, 0x00); // normal
+  leaveReset();
 
   return 1;
 }
@@ -326,22 +409,37 @@ int ESP32SJA1000Class::filterExtended(long id, long mask)
   writeRegister(REG_AMRn(2), mask >> 5);
   writeRegister(REG_AMRn(3), (mask << 3) | 0x1f);
 
-  modifyRegister(REG_MOD, 0x17, 0x00); // normal
+  leaveReset();
 
   return 1;
 }
 
 int ESP32SJA1000Class::observe()
 {
+  _listenOnly = true;
+
   modifyRegister(REG_MOD, 0x17, 0x01); // reset
-  modifyRegister(REG_MOD, 0x17, 0x02); // observe
+  leaveReset();
 
   return 1;
 }
 
+// from reset mode back to normal, or to listen-only after observe()
+void ESP32SJA1000Class::leaveReset()
+{
+  if (_listenOnly) {
+    // LOM is only writable in reset mode
+    modifyRegister(REG_MOD, 0x17, 0x03); // listen only
+    modifyRegister(REG_MOD, 0x17, 0x02); // leave reset
+  } else {
+    modifyRegister(REG_MOD, 0x17, 0x00); // normal
+  }
+}
+
 int ESP32SJA1000Class::loopback()
 {
   _loopback = true;
+  _listenOnly = false;
 
   modifyRegister(REG_MOD, 0x17, 0x01); // reset
   modifyRegister(REG_MOD, 0x17, 0x04); // self test mode
@@ -351,14 +449,15 @@ int ESP32SJA1000Class::loopback()
 
 int ESP32SJA1000Class::sleep()
 {
-  modifyRegister(REG_MOD, 0x1f, 0x10);
+  modifyRegister(REG_MOD, 0x10, 0x10);
 
   return 1;
 }
 
 int ESP32SJA1000Class::wakeup()
 {
-  modifyRegister(REG_MOD, 0x1f, 0x00);
+  // sleep bit only: LOM stays set after observe()
+  modifyRegister(REG_MOD, 0x10, 0x00);
 
   return 1;
 }
@@ -389,23 +488,170 @@ void ESP32SJA1000Class::dumpRegisters(Stream& out)
 
 void ESP32SJA1000Class::handleInterrupt()
 {
+  uint32_t now = micros();
   uint8_t ir = readRegister(REG_IR);
 
-  if (ir & 0x01) {
-    // received packet, parse and call callback
-    parsePacket();
-    
-    //switch throught function callback and method callback
-    if(_CanHandler!=NULL)
-    {
-       _CanHandler->onReceivePacket(available());
-    }   
-    else{
-      _onReceive(available());
+  if (ir & 0x80) {
+    // bus error, reading ECC re-arms the capture
+    _busErrors++;
+    _lastErrorCode = readRegister(REG_ECC);
+
+    // ack error while transmitting, give up the frame
+    if (_lastErrorCode == 0xd9 && _txBusy) {
+      _txError = true;
+      modifyRegister(REG_CMR, 0x1f, 0x02);
+    }
+  }
+
+  if (ir & 0x40) {
+    // arbitration lost, reading ALC re-arms the capture
+    _arbitrationLost++;
+    _lastArbitrationLost = readRegister(REG_ALC);
+  }
+
+  if (ir & 0x20) {
+    // error passive entered or left
+    if (readRegister(REG_TXERR) > 127 || readRegister(REG_RXERR) > 127) {
+      _errorPassives++;
+    }
+  }
+
+  if (ir & 0x04) {
+    // error warning: error or bus status changed
+    handleBusStatus(readRegister(REG_SR));
+  }
+
+  if (ir & 0x02) {
+    // TX buffer released: sent, or aborted
+    bool done = false;
+    long id = 0;
+    CANTxResult result = CANTxResult::complete;
+
+    portENTER_CRITICAL_ISR(&txMux);
+
+    if (_txBusy) {
+      done = true;
+      id = _txInFlight;
+
+      if (readRegister(REG_SR) & 0x08) {
+        result = CANTxResult::complete;
+      } else {
+        result = _txError ? CANTxResult::failed : CANTxResult::aborted;
+      }
+
+      _txBusy = false;
+    }
+
+    if (!_busOff) {
+      startTx();
+    }
+
+    portEXIT_CRITICAL_ISR(&txMux);
+
+    if (done) {
+      txDone(id, result);
+    }
+  }
+
+  if (ir & 0x08) {
+    // data overrun: the FIFO was full, frames were lost
+    _rxOverflows++;
+    modifyRegister(REG_CMR, 0x1f, 0x08);
+  }
+
+  if ((ir & 0x01) && (_CanHandler != NULL || _onReceive != NULL)) {
+    // every frame in the 64 byte RX FIFO, not only the one that raised the interrupt
+    _interruptTimestamp = now;
+    _draining = true;
+
+    // RBS, not the parsePacket() result: dlc 0 frames return 0
+    for (int n = readRegister(REG_RMC); n > 0 && (readRegister(REG_SR) & 0x01); n--) {
+      parsePacket();
+
+      //switch throught function callback and method callback
+      if(_CanHandler!=NULL)
+      {
+         _CanHandler->onReceivePacket(available());
+      }   
+      else{
+        _onReceive(available());
+      }
+    }
+
+    _draining = false;
+  }
+}
+
+void ESP32SJA1000Class::handleBusStatus(uint8_t sr)
+{
+  if (sr & 0x80) {
+    if (_busOff) {
+      return;
+    }
+
+    // bus-off: the controller went to reset mode, the frame in flight is lost
+    _busOffs++;
+
+    bool done = false;
+    long id = 0;
+
+    portENTER_CRITICAL_ISR(&txMux);
+
+    _busOff = true;
+
+    if (_txBusy) {
+      done = true;
+      id = _txInFlight;
+      _txBusy = false;
+    }
+
+    portEXIT_CRITICAL_ISR(&txMux);
+
+    if (done) {
+      txDone(id, CANTxResult::failed);
+    }
+
+    // leaving reset mode starts the recovery: 128 x 11 recessive bits, then bus-on
+    if (_autoRecover) {
+      modifyRegister(REG_MOD, 0x01, 0x00);
+    }
+  } else if (sr & 0x40) {
+    _errorWarnings++;
+  } else if (_busOff) {
+    // recovered: send what was queued meanwhile
+    portENTER_CRITICAL_ISR(&txMux);
+
+    _busOff = false;
+
+    if (!_txBusy) {
+      startTx();
     }
+
+    portEXIT_CRITICAL_ISR(&txMux);
   }
 }
 
+uint8_t ESP32SJA1000Class::txErrorCounter()
+{
+  return readRegister(REG_TXERR);
+}
+
+uint8_t ESP32SJA1000Class::rxErrorCounter()
+{
+  return readRegister(REG_RXERR);
+}
+
+int ESP32SJA1000Class::recover()
+{
+  if (!_busOff) {
+    return 0;
+  }
+
+  modifyRegister(REG_MOD, 0x01, 0x00);
+
+  return 1;
+}
+
 uint8_t ESP32SJA1000Class::readRegister(uint8_t address)
 {
   volatile uint32_t* reg = (volatile uint32_t*)(REG_BASE + address * 4);
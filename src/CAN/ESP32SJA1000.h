@@ -21,7 +21,10 @@ public:
   virtual int begin(long baudRate);
   virtual void end();
 
+  // queued, the transmit interrupt loads the next frame and reports the result
   virtual int endPacket();
+  virtual int abortTransmit();
+  virtual int txPending();
 
   virtual int parsePacket();
 
@@ -34,18 +37,40 @@ public:
   virtual int filterExtended(long id, long mask);
 
   virtual int observe();
+  virtual int beginObserve(long baudRate);
   virtual int loopback();
   virtual int sleep();
   virtual int wakeup();
 
-  void setPins(int rx, int tx);
+  virtual void setPins(int rx, int tx);
+
+  // bus health, counted by the interrupt handler
+  uint32_t rxOverflows() { return _rxOverflows; } // data overruns, each lost at least one frame
+  uint32_t busErrors() { return _busErrors; }
+  uint32_t arbitrationLost() { return _arbitrationLost; }
+  uint32_t errorWarnings() { return _errorWarnings; } // error counter over the warning limit (96)
+  uint32_t errorPassives() { return _errorPassives; }
+  uint32_t busOffs() { return _busOffs; }
+  uint8_t txErrorCounter();
+  uint8_t rxErrorCounter();
+  uint8_t lastErrorCode() { return _lastErrorCode; } // ECC of the last bus error
+  uint8_t lastArbitrationLost() { return _lastArbitrationLost; } // ALC: bit where it was lost
+  bool isBusOff() { return _busOff; }
+
+  // bus-off recovery starts by itself unless disabled, then recover() starts it
+  void setAutoRecover(bool enable) { _autoRecover = enable; }
+  int recover();
 
   void dumpRegisters(Stream& out);
 
 private:
+  int start(long baudRate, bool listenOnly);
   void reset();
+  void leaveReset();
 
   void handleInterrupt();
+  void startTx();
+  void handleBusStatus(uint8_t sr);
 
   uint8_t readRegister(uint8_t address);
   void modifyRegister(uint8_t address, uint8_t mask, uint8_t value);
@@ -57,7 +82,25 @@ private:
   gpio_num_t _rxPin;
   gpio_num_t _txPin;
   bool _loopback;
+  bool _listenOnly;
   intr_handle_t _intrHandle;
+
+  bool _txBusy;
+  bool _txError;
+  long _txInFlight;
+
+  volatile bool _busOff;
+  bool _autoRecover;
+  uint32_t _rxOverflows;
+  uint32_t _busErrors;
+  uint32_t _arbitrationLost;
+  uint32_t _errorWarnings;
+  uint32_t _errorPassives;
+  uint32_t _busOffs;
+  uint8_t _lastErrorCode;
+  uint8_t _lastArbitrationLost;
+  uint32_t _interruptTimestamp; // micros() at the interrupt entry
+  bool _draining; // interrupt reading the FIFO: frames take _interruptTimestamp
 };
 
 extern ESP32SJA1000Class CAN;
@@ -1,7 +1,7 @@
 // Copyright (c) Sandeep Mistry. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-#ifndef ARDUINO_ARCH_ESP32
+#ifndef OBD2_HOST
 
 #include "MCP2515.h"
 
@@ -16,6 +16,7 @@
 
 #define REG_CANINTE                0x2b
 #define REG_CANINTF                0x2c
+#define REG_EFLG                   0x2d
 
 #define FLAG_RXnIE(n)              (0x01 << n)
 #define FLAG_RXnIF(n)              (0x01 << n)
@@ -54,6 +55,31 @@
 
 #define FLAG_RXM0                  0x20
 #define FLAG_RXM1                  0x40
+// RXB0CTRL: a frame arriving with RXB0 full goes to RXB1 instead of overflowing
+#define FLAG_BUKT                  0x04
+
+#define FLAG_RXnOVR(n)             (0x40 << n)
+
+#define FLAG_TXREQ                 0x08
+#define FLAG_TXERR                 0x10
+
+#define INSTRUCTION_WRITE          0x02
+#define INSTRUCTION_READ           0x03
+#define INSTRUCTION_MODIFY         0x05
+// start at TXBnSIDH / RXBnSIDH, reading an RX buffer clears its RXnIF when CS goes high
+#define INSTRUCTION_LOAD_TX(n)     (0x40 | (n << 1))
+#define INSTRUCTION_RTS(n)         (0x80 | (0x01 << n))
+#define INSTRUCTION_READ_RX(n)     (0x90 | (n << 2))
+#define INSTRUCTION_READ_STATUS    0xa0
+#define INSTRUCTION_RX_STATUS      0xb0
+#define INSTRUCTION_RESET          0xc0
+
+// READ STATUS: TXREQ and CANINTF TXnIF of each TX buffer in one byte
+#define STATUS_TXnREQ(n)           (0x04 << (n * 2))
+#define STATUS_TXnIF(n)            (0x08 << (n * 2))
+
+// RX STATUS: which buffer holds a message
+#define RX_STATUS_RXB(n)           (0x40 << n)
 
 
 MCP2515Class::MCP2515Class() :
@@ -61,18 +87,51 @@ MCP2515Class::MCP2515Class() :
   _spiSettings(10E6, MSBFIRST, SPI_MODE0),
   _csPin(MCP2515_DEFAULT_CS_PIN),
   _intPin(MCP2515_DEFAULT_INT_PIN),
-  _clockFrequency(MCP2515_DEFAULT_CLOCK_FREQUENCY)
+  _clockFrequency(MCP2515_DEFAULT_CLOCK_FREQUENCY),
+  _instance(-1),
+  _txBusy(0),
+  _txError(0),
+  _listenOnly(false),
+  _rxOverflows(0),
+  _rxHead(0),
+  _rxTail(0),
+  _rxb1Older(false),
+  _interruptPending(false),
+  _interruptTimestamp(0)
 {
+#ifdef ARDUINO_ARCH_ESP32
+  _receiveTask = NULL;
+#endif
 }
 
 MCP2515Class::~MCP2515Class()
 {
+  releaseInstance();
 }
 
 int MCP2515Class::begin(long baudRate)
+{
+  return start(baudRate, false);
+}
+
+int MCP2515Class::beginObserve(long baudRate)
+{
+  return start(baudRate, true);
+}
+
+int MCP2515Class::start(long baudRate, bool listenOnly)
 {
   CANControllerClass::begin(baudRate);
 
+  if (!acquireInstance()) {
+    return 0;
+  }
+
+  _txBusy = 0;
+  _txError = 0;
+  _listenOnly = listenOnly;
+  _rxb1Older = false;
+
   pinMode(_csPin, OUTPUT);
 
   // start SPI
@@ -137,11 +196,12 @@ int MCP2515Class::begin(long baudRate)
   writeRegister(REG_CANINTE, FLAG_RXnIE(1) | FLAG_RXnIE(0));
   writeRegister(REG_BFPCTRL, 0x00);
   writeRegister(REG_TXRTSCTRL, 0x00);
-  writeRegister(REG_RXBnCTRL(0), FLAG_RXM1 | FLAG_RXM0);
+  writeRegister(REG_RXBnCTRL(0), FLAG_RXM1 | FLAG_RXM0 | FLAG_BUKT);
   writeRegister(REG_RXBnCTRL(1), FLAG_RXM1 | FLAG_RXM0);
 
-  writeRegister(REG_CANCTRL, 0x00);
-  if (readRegister(REG_CANCTRL) != 0x00) {
+  // straight from configuration mode: listen-only never acknowledges a frame
+  writeRegister(REG_CANCTRL, operatingMode());
+  if (readRegister(REG_CANCTRL) != operatingMode()) {
     return 0;
   }
 
@@ -150,129 +210,451 @@ int MCP2515Class::begin(long baudRate)
 
 void MCP2515Class::end()
 {
-  SPI.end();
+  attachReceiveInterrupt(false);
+  releaseInstance();
+
+  // the bus is shared with the other controllers
+  bool spiInUse = false;
+  for (int i = 0; i < MCP2515_MAX_INSTANCES; i++) {
+    if (_instances[i] != NULL) {
+      spiInUse = true;
+    }
+  }
+
+  if (!spiInUse) {
+    SPI.end();
+  }
 
   CANControllerClass::end();
 }
 
 int MCP2515Class::endPacket()
 {
-  if (!CANControllerClass::endPacket()) {
+  if (!CANControllerClass::endPacket() || _listenOnly) {
     return 0;
   }
 
-  int n = 0;
+  // sketches that never call poll() still free the buffers here
+  if (_txBusy) {
+    serviceTx();
+  }
 
-  if (_txExtended) {
-    writeRegister(REG_TXBnSIDH(n), _txId >> 21);
-    writeRegister(REG_TXBnSIDL(n), (((_txId >> 18) & 0x07) << 5) | FLAG_EXIDE | ((_txId >> 16) & 0x03));
-    writeRegister(REG_TXBnEID8(n), (_txId >> 8) & 0xff);
-    writeRegister(REG_TXBnEID0(n), _txId & 0xff);
-  } else {
-    writeRegister(REG_TXBnSIDH(n), _txId >> 3);
-    writeRegister(REG_TXBnSIDL(n), _txId << 5);
-    writeRegister(REG_TXBnEID8(n), 0x00);
-    writeRegister(REG_TXBnEID0(n), 0x00);
+  if (!pushTx()) {
+    return 0;
   }
 
-  if (_txRtr) {
-    writeRegister(REG_TXBnDLC(n), 0x40 | _txLength);
-  } else {
-    writeRegister(REG_TXBnDLC(n), _txLength);
+  startTx();
 
-    for (int i = 0; i < _txLength; i++) {
-      writeRegister(REG_TXBnD0(n) + i, _txData[i]);
+  return 1;
+}
+
+// queued frames into the free TX buffers. Each frame gets a lower TXP than the ones in flight,
+// so the three buffers still go out in queue order (ISO-TP consecutive frames)
+void MCP2515Class::startTx()
+{
+  CANFrame frame;
+
+  while (queuedTx() > 0) {
+    int n = -1;
+    int priority = 3;
+
+    for (int i = 0; i < 3; i++) {
+      if (_txBusy & (0x01 << i)) {
+        if (_txPriority[i] - 1 < priority) {
+          priority = _txPriority[i] - 1;
+        }
+      } else if (n < 0) {
+        n = i;
+      }
     }
+
+    if (n < 0 || priority < 0) {
+      return;
+    }
+
+    popTx(frame);
+
+    // TXBnSIDH to TXBnD7 in one LOAD TX BUFFER transfer
+    uint8_t buffer[13];
+
+    if (frame.extended) {
+      buffer[0] = frame.id >> 21;
+      buffer[1] = (((frame.id >> 18) & 0x07) << 5) | FLAG_EXIDE | ((frame.id >> 16) & 0x03);
+      buffer[2] = (frame.id >> 8) & 0xff;
+      buffer[3] = frame.id & 0xff;
+    } else {
+      buffer[0] = frame.id >> 3;
+      buffer[1] = frame.id << 5;
+      buffer[2] = 0x00;
+      buffer[3] = 0x00;
+    }
+
+    int length = 5;
+
+    if (frame.rtr) {
+      buffer[4] = 0x40 | frame.dlc;
+    } else {
+      buffer[4] = frame.dlc;
+
+      for (int i = 0; i < frame.dlc; i++) {
+        buffer[length++] = frame.data[i];
+      }
+    }
+
+    writeRegister(REG_TXBnCTRL(n), priority);
+    loadTxBuffer(n, buffer, length);
+    requestToSend(n);
+
+    _txBusy |= 0x01 << n;
+    _txPriority[n] = priority;
+    _txIds[n] = frame.id;
+    _txStart[n] = millis();
   }
+}
 
-  writeRegister(REG_TXBnCTRL(n), 0x08);
+// completions of the buffers in flight with one READ STATUS, then refill them from the queue
+void MCP2515Class::serviceTx()
+{
+  uint8_t status = readStatus();
 
-  bool aborted = false;
+  for (int n = 0; n < 3; n++) {
+    uint8_t mask = 0x01 << n;
 
-  while (readRegister(REG_TXBnCTRL(n)) & 0x08) {
-    if (readRegister(REG_TXBnCTRL(n)) & 0x10) {
-      // abort
-      aborted = true;
+    if (!(_txBusy & mask)) {
+      continue;
+    }
 
-      modifyRegister(REG_CANCTRL, 0x10, 0x10);
+    if (status & STATUS_TXnREQ(n)) {
+      // retrying after errors for too long (no ACK, no other node): give up
+      if (!(_txError & mask) && millis() - _txStart[n] > MCP2515_TX_TIMEOUT &&
+          (readRegister(REG_TXBnCTRL(n)) & FLAG_TXERR)) {
+        _txError |= mask;
+        modifyRegister(REG_TXBnCTRL(n), FLAG_TXREQ, 0x00);
+      }
+
+      continue;
     }
 
-    yield();
+    CANTxResult result;
+
+    if (status & STATUS_TXnIF(n)) {
+      modifyRegister(REG_CANINTF, FLAG_TXnIF(n), 0x00);
+      result = CANTxResult::complete;
+    } else {
+      result = (_txError & mask) ? CANTxResult::failed : CANTxResult::aborted;
+    }
+
+    _txBusy &= ~mask;
+    _txError &= ~mask;
+
+    txDone(_txIds[n], result);
   }
 
-  if (aborted) {
-    // clear abort command
-    modifyRegister(REG_CANCTRL, 0x10, 0x00);
+  startTx();
+}
+
+int MCP2515Class::abortTransmit()
+{
+  int aborted = 0;
+  CANFrame frame;
+
+  while (popTx(frame)) {
+    txDone(frame.id, CANTxResult::aborted);
+    aborted++;
   }
 
-  modifyRegister(REG_CANINTF, FLAG_TXnIF(n), 0x00);
+  // reported by serviceTx(), unless the frame made it anyway
+  for (int n = 0; n < 3; n++) {
+    if (_txBusy & (0x01 << n)) {
+      modifyRegister(REG_TXBnCTRL(n), FLAG_TXREQ, 0x00);
+      aborted++;
+    }
+  }
 
-  return (readRegister(REG_TXBnCTRL(n)) & 0x70) ? 0 : 1;
+  return aborted;
 }
 
-int MCP2515Class::parsePacket()
+int MCP2515Class::txPending()
 {
-  int n;
+  int pending = queuedTx();
 
-  uint8_t intf = readRegister(REG_CANINTF);
+  for (int n = 0; n < 3; n++) {
+    if (_txBusy & (0x01 << n)) {
+      pending++;
+    }
+  }
 
-  if (intf & FLAG_RXnIF(0)) {
-    n = 0;
-  } else if (intf & FLAG_RXnIF(1)) {
-    n = 1;
-  } else {
+  return pending;
+}
+
+int MCP2515Class::parsePacket()
+{
+  if (_rxHead == _rxTail && !receiveFrame(micros())) {
     _rxId = -1;
     _rxExtended = false;
     _rxRtr = false;
     _rxLength = 0;
+    _rxIndex = 0;
     return 0;
   }
 
-  _rxExtended = (readRegister(REG_RXBnSIDL(n)) & FLAG_IDE) ? true : false;
+  const RxFrame& frame = _rxQueue[_rxTail & (MCP2515_RX_QUEUE_SIZE - 1)];
 
-  uint32_t idA = ((readRegister(REG_RXBnSIDH(n)) << 3) & 0x07f8) | ((readRegister(REG_RXBnSIDL(n)) >> 5) & 0x07);
-  if (_rxExtended) {
-    uint32_t idB = (((uint32_t)(readRegister(REG_RXBnSIDL(n)) & 0x03) << 16) & 0x30000) | ((readRegister(REG_RXBnEID8(n)) << 8) & 0xff00) | readRegister(REG_RXBnEID0(n));
-
-    _rxId = (idA << 18) | idB;
-    _rxRtr = (readRegister(REG_RXBnDLC(n)) & FLAG_RTR) ? true : false;
-  } else {
-    _rxId = idA;
-    _rxRtr = (readRegister(REG_RXBnSIDL(n)) & FLAG_SRR) ? true : false;
-  }
-  _rxDlc = readRegister(REG_RXBnDLC(n)) & 0x0f;
+  _rxId = frame.id;
+  _rxExtended = frame.extended;
+  _rxRtr = frame.rtr;
+  _rxDlc = frame.dlc;
   _rxIndex = 0;
+  _rxTimestamp = frame.timestamp;
 
   if (_rxRtr) {
     _rxLength = 0;
   } else {
-    _rxLength = _rxDlc;
+    // a DLC over 8 still means 8 data bytes
+    _rxLength = _rxDlc > 8 ? 8 : _rxDlc;
 
-    for (int i = 0; i < _rxLength; i++) {
-      _rxData[i] = readRegister(REG_RXBnD0(n) + i);
-    }
+    memcpy(_rxData, frame.data, _rxLength);
   }
 
-  modifyRegister(REG_CANINTF, FLAG_RXnIF(n), 0x00);
+  _rxTail++;
 
   return _rxDlc;
 }
 
+// frames from the RX buffers into the queue, 0 if both are empty or the queue is full.
+// With rollover a frame only goes to RXB1 while RXB0 is full, so with both full RXB0 holds the
+// older frame, unless RXB1 was already full when RXB0 was last read: then RXB0 has refilled
+// behind it and RXB1 is read first
+int MCP2515Class::receiveFrame(uint32_t timestamp)
+{
+  uint8_t status = rxStatus();
+  bool full = (status & RX_STATUS_RXB(0)) && (status & RX_STATUS_RXB(1));
+
+  if ((status & (RX_STATUS_RXB(0) | RX_STATUS_RXB(1))) == 0 ||
+      (uint8_t)(_rxHead - _rxTail) > MCP2515_RX_QUEUE_SIZE - (full ? 2 : 1)) {
+    return 0;
+  }
+
+  int last;
+
+  if (full) {
+    last = _rxb1Older ? 0 : 1;
+
+    readRxBuffer(1 - last, timestamp);
+    readRxBuffer(last, timestamp);
+
+    // a frame can only be lost with both buffers full, which lasts until they are read
+    uint8_t eflg = readRegister(REG_EFLG);
+
+    if (eflg & (FLAG_RXnOVR(0) | FLAG_RXnOVR(1))) {
+      _rxOverflows += ((eflg & FLAG_RXnOVR(0)) ? 1 : 0) + ((eflg & FLAG_RXnOVR(1)) ? 1 : 0);
+      modifyRegister(REG_EFLG, FLAG_RXnOVR(0) | FLAG_RXnOVR(1), 0x00);
+    }
+  } else {
+    last = (status & RX_STATUS_RXB(0)) ? 0 : 1;
+
+    readRxBuffer(last, timestamp);
+  }
+
+  // RXB0 just freed: a frame already in RXB1 is older than the next one to land in RXB0
+  _rxb1Older = last == 0 && (rxStatus() & RX_STATUS_RXB(1));
+
+  return full ? 2 : 1;
+}
+
+void MCP2515Class::readRxBuffer(int n, uint32_t timestamp)
+{
+  RxFrame& frame = _rxQueue[_rxHead & (MCP2515_RX_QUEUE_SIZE - 1)];
+
+  frame.timestamp = timestamp;
+
+  // RXBnSIDH to RXBnD7 in one READ RX BUFFER transfer, which also clears RXnIF
+  uint8_t buffer[5];
+
+  SPI.beginTransaction(_spiSettings);
+  digitalWrite(_csPin, LOW);
+  SPI.transfer(INSTRUCTION_READ_RX(n));
+  for (int i = 0; i < 5; i++) {
+    buffer[i] = SPI.transfer(0x00);
+  }
+
+  frame.extended = (buffer[1] & FLAG_IDE) ? true : false;
+
+  uint32_t idA = ((buffer[0] << 3) & 0x07f8) | ((buffer[1] >> 5) & 0x07);
+  if (frame.extended) {
+    uint32_t idB = (((uint32_t)(buffer[1] & 0x03) << 16) & 0x30000) | ((buffer[2] << 8) & 0xff00) | buffer[3];
+
+    frame.id = (idA << 18) | idB;
+    frame.rtr = (buffer[4] & FLAG_RTR) ? true : false;
+  } else {
+    frame.id = idA;
+    frame.rtr = (buffer[1] & FLAG_SRR) ? true : false;
+  }
+  frame.dlc = buffer[4] & 0x0f;
+
+  if (!frame.rtr) {
+    int length = frame.dlc > 8 ? 8 : frame.dlc;
+
+    for (int i = 0; i < length; i++) {
+      frame.data[i] = SPI.transfer(0x00);
+    }
+  }
+
+  digitalWrite(_csPin, HIGH);
+  SPI.endTransaction();
+
+  _rxHead++;
+}
+
 void MCP2515Class::onReceive(void(*callback)(int))
 {
   CANControllerClass::onReceive(callback);
 
+  attachReceiveInterrupt(callback != NULL || _CanHandler != NULL);
+}
+
+void MCP2515Class::onReceive(CANHandler* handler)
+{
+  CANControllerClass::onReceive(handler);
+
+  attachReceiveInterrupt(handler != NULL || _onReceive != NULL);
+}
+
+bool MCP2515Class::acquireInstance()
+{
+  if (_instance >= 0) {
+    return true;
+  }
+
+  for (int i = 0; i < MCP2515_MAX_INSTANCES; i++) {
+    if (_instances[i] == NULL) {
+      _instances[i] = this;
+      _instance = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void MCP2515Class::releaseInstance()
+{
+  if (_instance < 0) {
+    return;
+  }
+
+  _instances[_instance] = NULL;
+  _instance = -1;
+}
+
+void MCP2515Class::attachReceiveInterrupt(bool enable)
+{
   pinMode(_intPin, INPUT);
 
-  if (callback) {
-    SPI.usingInterrupt(digitalPinToInterrupt(_intPin));
-    attachInterrupt(digitalPinToInterrupt(_intPin), MCP2515Class::onInterrupt, LOW);
-  } else {
-    detachInterrupt(digitalPinToInterrupt(_intPin));
-#ifdef SPI_HAS_NOTUSINGINTERRUPT
-    SPI.notUsingInterrupt(digitalPinToInterrupt(_intPin));
+  // no SPI in the ISR, so no need for SPI.usingInterrupt(): the pin stays low until receive() reads
+  // the buffers, a falling edge flags the first frame and receive() drains until both are empty
+  detachInterrupt(digitalPinToInterrupt(_intPin));
+
+#ifdef ARDUINO_ARCH_ESP32
+  // called from loop(), below the task priority: the task is blocked, never in a transfer
+  if (!enable && _receiveTask != NULL) {
+    vTaskDelete(_receiveTask);
+    _receiveTask = NULL;
+  }
+#endif
+
+  if (enable && acquireInstance()) {
+    _interruptPending = true;
+
+#ifdef ARDUINO_ARCH_ESP32
+    // on the core of loop(): handlers preempt it as they would in an interrupt, never run next to it
+    if (_receiveTask == NULL) {
+      xTaskCreatePinnedToCore(receiveTask, "mcp2515", MCP2515_RECEIVE_TASK_STACK, this,
+                              MCP2515_RECEIVE_TASK_PRIORITY, &_receiveTask, xPortGetCoreID());
+    }
+#endif
+
+    attachInterrupt(digitalPinToInterrupt(_intPin), _interruptHandlers[_instance], FALLING);
+
+#ifdef ARDUINO_ARCH_ESP32
+    // frames already waiting: the pin is low, no edge will come
+    xTaskNotifyGive(_receiveTask);
+#endif
+  }
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+void MCP2515Class::receiveTask(void* arg)
+{
+  MCP2515Class* mcp = (MCP2515Class*)arg;
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    mcp->receive();
+  }
+}
+#endif
+
+int MCP2515Class::poll()
+{
+  if (_txBusy) {
+    serviceTx();
+  }
+
+#ifdef ARDUINO_ARCH_ESP32
+  // receive is done by the task
+  if (_receiveTask != NULL) {
+    return 0;
+  }
 #endif
+
+  return receive();
+}
+
+int MCP2515Class::receive()
+{
+  if (!_interruptPending) {
+    return 0;
   }
+
+  // cleared first: a frame arriving while draining flags again
+  _interruptPending = false;
+
+  int dispatched = 0;
+
+  // frames read with the edge that flagged them carry its time, later ones arrived while draining
+  uint32_t timestamp = _interruptTimestamp;
+
+  // frees both RX buffers before the handlers run, then again for frames received meanwhile
+  while (receiveFrame(timestamp)) {
+    while (receiveFrame(micros()));
+
+    timestamp = micros();
+
+    dispatched += dispatch();
+  }
+
+  return dispatched;
+}
+
+int MCP2515Class::dispatch()
+{
+  int dispatched = 0;
+
+  while (_rxHead != _rxTail) {
+    parsePacket();
+
+    //switch throught function callback and method callback
+    if (_CanHandler != NULL) {
+      _CanHandler->onReceivePacket(available());
+    } else if (_onReceive != NULL) {
+      _onReceive(available());
+    }
+
+    dispatched++;
+  }
+
+  return dispatched;
 }
 
 int MCP2515Class::filter(int id, int mask)
@@ -288,8 +670,7 @@ int MCP2515Class::filter(int id, int mask)
 
   for (int n = 0; n < 2; n++) {
     // standard only
-    writeRegister(REG_RXBnCTRL(n), FLAG_RXM0);
-    writeRegister(REG_RXBnCTRL(n), FLAG_RXM0);
+    writeRegister(REG_RXBnCTRL(n), FLAG_RXM0 | (n == 0 ? FLAG_BUKT : 0));
 
     writeRegister(REG_RXMnSIDH(n), mask >> 3);
     writeRegister(REG_RXMnSIDL(n), mask << 5);
@@ -304,9 +685,9 @@ int MCP2515Class::filter(int id, int mask)
     writeRegister(REG_RXFnEID0(n), 0);
   }
 
-  // normal mode
-  writeRegister(REG_CANCTRL, 0x00);
-  if (readRegister(REG_CANCTRL) != 0x00) {
+  // normal mode, or listen-only again
+  writeRegister(REG_CANCTRL, operatingMode());
+  if (readRegister(REG_CANCTRL) != operatingMode()) {
     return 0;
   }
 
@@ -326,8 +707,7 @@ int MCP2515Class::filterExtended(long id, long mask)
 
   for (int n = 0; n < 2; n++) {
     // extended only
-    writeRegister(REG_RXBnCTRL(n), FLAG_RXM1);
-    writeRegister(REG_RXBnCTRL(n), FLAG_RXM1);
+    writeRegister(REG_RXBnCTRL(n), FLAG_RXM1 | (n == 0 ? FLAG_BUKT : 0));
 
     writeRegister(REG_RXMnSIDH(n), mask >> 21);
     writeRegister(REG_RXMnSIDL(n), (((mask >> 18) & 0x03) << 5) | FLAG_EXIDE | ((mask >> 16) & 0x03));
@@ -342,9 +722,9 @@ int MCP2515Class::filterExtended(long id, long mask)
     writeRegister(REG_RXFnEID0(n), id & 0xff);
   }
 
-  // normal mode
-  writeRegister(REG_CANCTRL, 0x00);
-  if (readRegister(REG_CANCTRL) != 0x00) {
+  // normal mode, or listen-only again
+  writeRegister(REG_CANCTRL, operatingMode());
+  if (readRegister(REG_CANCTRL) != operatingMode()) {
     return 0;
   }
 
@@ -353,11 +733,14 @@ int MCP2515Class::filterExtended(long id, long mask)
 
 int MCP2515Class::observe()
 {
-  writeRegister(REG_CANCTRL, 0x80);
-  if (readRegister(REG_CANCTRL) != 0x80) {
+  // listen-only: receives without acknowledging, transmit is refused
+  writeRegister(REG_CANCTRL, 0x60);
+  if (readRegister(REG_CANCTRL) != 0x60) {
     return 0;
   }
 
+  _listenOnly = true;
+
   return 1;
 }
 
@@ -368,6 +751,8 @@ int MCP2515Class::loopback()
     return 0;
   }
 
+  _listenOnly = false;
+
   return 1;
 }
 
@@ -383,14 +768,19 @@ int MCP2515Class::sleep()
 
 int MCP2515Class::wakeup()
 {
-  writeRegister(REG_CANCTRL, 0x00);
-  if (readRegister(REG_CANCTRL) != 0x00) {
+  writeRegister(REG_CANCTRL, operatingMode());
+  if (readRegister(REG_CANCTRL) != operatingMode()) {
     return 0;
   }
 
   return 1;
 }
 
+uint8_t MCP2515Class::errorFlags()
+{
+  return readRegister(REG_EFLG);
+}
+
 void MCP2515Class::setPins(int cs, int irq)
 {
   _csPin = cs;
@@ -429,31 +819,20 @@ void MCP2515Class::reset()
 {
   SPI.beginTransaction(_spiSettings);
   digitalWrite(_csPin, LOW);
-  SPI.transfer(0xc0);
+  SPI.transfer(INSTRUCTION_RESET);
   digitalWrite(_csPin, HIGH);
   SPI.endTransaction();
 
   delayMicroseconds(10);
 }
 
-void MCP2515Class::handleInterrupt()
-{
-  if (readRegister(REG_CANINTF) == 0) {
-    return;
-  }
-
-  while (parsePacket()) {
-    _onReceive(available());
-  }
-}
-
 uint8_t MCP2515Class::readRegister(uint8_t address)
 {
   uint8_t value;
 
   SPI.beginTransaction(_spiSettings);
   digitalWrite(_csPin, LOW);
-  SPI.transfer(0x03);
+  SPI.transfer(INSTRUCTION_READ);
   SPI.transfer(address);
   value = SPI.transfer(0x00);
   digitalWrite(_csPin, HIGH);
@@ -466,7 +845,7 @@ void MCP2515Class::modifyRegister(uint8_t address, uint8_t mask, uint8_t value)
 {
   SPI.beginTransaction(_spiSettings);
   digitalWrite(_csPin, LOW);
-  SPI.transfer(0x05);
+  SPI.transfer(INSTRUCTION_MODIFY);
   SPI.transfer(address);
   SPI.transfer(mask);
   SPI.transfer(value);
@@ -478,18 +857,90 @@ void MCP2515Class::writeRegister(uint8_t address, uint8_t value)
 {
   SPI.beginTransaction(_spiSettings);
   digitalWrite(_csPin, LOW);
-  SPI.transfer(0x02);
+  SPI.transfer(INSTRUCTION_WRITE);
   SPI.transfer(address);
   SPI.transfer(value);
   digitalWrite(_csPin, HIGH);
   SPI.endTransaction();
 }
 
+uint8_t MCP2515Class::readStatus()
+{
+  uint8_t value;
+
+  SPI.beginTransaction(_spiSettings);
+  digitalWrite(_csPin, LOW);
+  SPI.transfer(INSTRUCTION_READ_STATUS);
+  value = SPI.transfer(0x00);
+  digitalWrite(_csPin, HIGH);
+  SPI.endTransaction();
+
+  return value;
+}
+
+uint8_t MCP2515Class::rxStatus()
+{
+  uint8_t value;
+
+  SPI.beginTransaction(_spiSettings);
+  digitalWrite(_csPin, LOW);
+  SPI.transfer(INSTRUCTION_RX_STATUS);
+  value = SPI.transfer(0x00);
+  digitalWrite(_csPin, HIGH);
+  SPI.endTransaction();
+
+  return value;
+}
+
+void MCP2515Class::loadTxBuffer(int n, const uint8_t* buffer, int length)
+{
+  SPI.beginTransaction(_spiSettings);
+  digitalWrite(_csPin, LOW);
+  SPI.transfer(INSTRUCTION_LOAD_TX(n));
+  for (int i = 0; i < length; i++) {
+    SPI.transfer(buffer[i]);
+  }
+  digitalWrite(_csPin, HIGH);
+  SPI.endTransaction();
+}
+
+void MCP2515Class::requestToSend(int n)
+{
+  SPI.beginTransaction(_spiSettings);
+  digitalWrite(_csPin, LOW);
+  SPI.transfer(INSTRUCTION_RTS(n));
+  digitalWrite(_csPin, HIGH);
+  SPI.endTransaction();
+}
+
+template <int N>
 void MCP2515Class::onInterrupt()
 {
-  CAN.handleInterrupt();
+  MCP2515Class* mcp = _instances[N];
+
+  mcp->_interruptTimestamp = micros();
+  mcp->_interruptPending = true;
+
+#ifdef ARDUINO_ARCH_ESP32
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(mcp->_receiveTask, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+#endif
 }
 
+MCP2515Class* MCP2515Class::_instances[MCP2515_MAX_INSTANCES] = { NULL };
+
+void (* const MCP2515Class::_interruptHandlers[MCP2515_MAX_INSTANCES])() = {
+  MCP2515Class::onInterrupt<0>,
+  MCP2515Class::onInterrupt<1>,
+  MCP2515Class::onInterrupt<2>,
+  MCP2515Class::onInterrupt<3>
+};
+
+#ifndef ARDUINO_ARCH_ESP32
 MCP2515Class CAN;
+#endif
 
 #endif
@@ -1,7 +1,8 @@
 // Copyright (c) Sandeep Mistry. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
-#ifndef ARDUINO_ARCH_ESP32
+// on the ESP32 CAN is the built-in controller, MCP2515Class instances can run next to it
+#ifndef OBD2_HOST
 
 #ifndef MCP2515_H
 #define MCP2515_H
@@ -12,6 +13,29 @@
 
 #define MCP2515_DEFAULT_CLOCK_FREQUENCY 8e6
 
+// ms a frame may keep retrying after bus errors before it is aborted as failed
+#ifndef MCP2515_TX_TIMEOUT
+#define MCP2515_TX_TIMEOUT 10
+#endif
+
+// frames drained from the RX buffers before dispatch, power of two
+#ifndef MCP2515_RX_QUEUE_SIZE
+#define MCP2515_RX_QUEUE_SIZE 8
+#endif
+
+// controllers running at the same time, each on its own CS and INT pin
+#define MCP2515_MAX_INSTANCES 4
+
+#ifdef ARDUINO_ARCH_ESP32
+// receive task woken by the interrupt, above loop() so it preempts it like an interrupt
+#ifndef MCP2515_RECEIVE_TASK_PRIORITY
+#define MCP2515_RECEIVE_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#endif
+#ifndef MCP2515_RECEIVE_TASK_STACK
+#define MCP2515_RECEIVE_TASK_STACK 4096
+#endif
+#endif
+
 #if defined(ARDUINO_ARCH_SAMD) && defined(PIN_SPI_MISO) && defined(PIN_SPI_MOSI) && defined(PIN_SPI_SCK) && (PIN_SPI_MISO == 10) && (PIN_SPI_MOSI == 8) && (PIN_SPI_SCK == 9)
 // Arduino MKR board: MKR CAN shield CS is pin 3, INT is pin 7
 #define MCP2515_DEFAULT_CS_PIN          3
@@ -30,11 +54,19 @@ public:
   virtual int begin(long baudRate);
   virtual void end();
 
+  // queued into the three TX buffers in order, completions are collected by poll()
   virtual int endPacket();
+  virtual int abortTransmit();
+  virtual int txPending();
 
   virtual int parsePacket();
 
+  // the interrupt does no SPI. On the ESP32 it wakes a receive task that drains the RX buffers and
+  // calls the callback. Elsewhere it only flags pending frames and poll() does it, so a sketch using
+  // onReceive() must call poll() from loop() (OBD2::process() does)
   virtual void onReceive(void(*callback)(int));
+  virtual void onReceive(CANHandler* handler);
+  virtual int poll();
 
   using CANControllerClass::filter;
   virtual int filter(int id, int mask);
@@ -42,35 +74,95 @@ public:
   virtual int filterExtended(long id, long mask);
 
   virtual int observe();
+  virtual int beginObserve(long baudRate);
   virtual int loopback();
   virtual int sleep();
   virtual int wakeup();
 
-  void setPins(int cs = MCP2515_DEFAULT_CS_PIN, int irq = MCP2515_DEFAULT_INT_PIN);
+  // RX buffer overflows (RX0OVR/RX1OVR) seen while receiving, each lost at least one frame
+  uint32_t rxOverflows() { return _rxOverflows; }
+  // EFLG: overflow, error passive/warning and bus-off flags
+  uint8_t errorFlags();
+
+  virtual void setPins(int cs = MCP2515_DEFAULT_CS_PIN, int irq = MCP2515_DEFAULT_INT_PIN);
   void setSPIFrequency(uint32_t frequency);
   void setClockFrequency(long clockFrequency);
 
   void dumpRegisters(Stream& out);
 
 private:
+  int start(long baudRate, bool listenOnly);
   void reset();
+  // REQOP back from configuration mode: listen-only after observe(), normal otherwise
+  uint8_t operatingMode() { return _listenOnly ? 0x60 : 0x00; }
 
-  void handleInterrupt();
+  bool acquireInstance();
+  void releaseInstance();
+  void attachReceiveInterrupt(bool enable);
+  int receive();
+  int receiveFrame(uint32_t timestamp);
+  void readRxBuffer(int n, uint32_t timestamp);
+  int dispatch();
 
   uint8_t readRegister(uint8_t address);
   void modifyRegister(uint8_t address, uint8_t mask, uint8_t value);
   void writeRegister(uint8_t address, uint8_t value);
 
-  static void onInterrupt();
+  uint8_t readStatus();
+  uint8_t rxStatus();
+  void loadTxBuffer(int n, const uint8_t* buffer, int length);
+  void requestToSend(int n);
+  void startTx();
+  void serviceTx();
+
+  template <int N> static void onInterrupt();
+#ifdef ARDUINO_ARCH_ESP32
+  static void receiveTask(void* arg);
+#endif
+
+  // attachInterrupt() passes no argument: one handler per instance slot
+  static MCP2515Class* _instances[MCP2515_MAX_INSTANCES];
+  static void (* const _interruptHandlers[MCP2515_MAX_INSTANCES])();
 
 private:
   SPISettings _spiSettings;
   int _csPin;
   int _intPin;
   long _clockFrequency;
+  int _instance; // slot in _instances, -1 if none
+
+  struct RxFrame {
+    long id;
+    bool extended;
+    bool rtr;
+    uint8_t dlc;
+    uint8_t data[8];
+    uint32_t timestamp;
+  };
+
+  uint8_t _txBusy; // TX buffers in flight
+  uint8_t _txError; // aborted after bus errors
+  bool _listenOnly; // observe(): transmit refused
+  uint8_t _txPriority[3];
+  long _txIds[3];
+  unsigned long _txStart[3];
+
+  uint32_t _rxOverflows;
+
+  RxFrame _rxQueue[MCP2515_RX_QUEUE_SIZE];
+  uint8_t _rxHead;
+  uint8_t _rxTail;
+  bool _rxb1Older; // RXB1 was full when RXB0 was last read
+  volatile bool _interruptPending;
+  volatile uint32_t _interruptTimestamp;
+#ifdef ARDUINO_ARCH_ESP32
+  TaskHandle_t _receiveTask;
+#endif
 };
 
+#ifndef ARDUINO_ARCH_ESP32
 extern MCP2515Class CAN;
+#endif
 
 #endif
 
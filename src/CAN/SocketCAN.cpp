@@ -0,0 +1,310 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef OBD2_SOCKETCAN
+
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "SocketCAN.h"
+
+SocketCANClass::SocketCANClass() :
+  CANControllerClass(),
+  _socket(-1),
+  _listenOnly(false),
+  _loopback(false),
+  _filterCount(0),
+  _rxCount(0),
+  _rxNext(0),
+  _rxTimestampNs(0)
+{
+  setInterface(SOCKETCAN_DEFAULT_INTERFACE);
+}
+
+SocketCANClass::~SocketCANClass()
+{
+  end();
+}
+
+void SocketCANClass::setInterface(const char* name)
+{
+  snprintf(_interface, sizeof(_interface), "%s", name);
+}
+
+int SocketCANClass::begin(long baudRate)
+{
+  CANControllerClass::begin(baudRate);
+
+  end();
+
+  _socket = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (_socket < 0) {
+    return 0;
+  }
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", _interface);
+
+  if (ioctl(_socket, SIOCGIFINDEX, &ifr) < 0) {
+    end();
+    return 0;
+  }
+
+  struct sockaddr_can addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+
+  if (bind(_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    end();
+    return 0;
+  }
+
+  // kernel receive timestamps, delivered with each frame by recvmmsg
+  int enable = 1;
+  setsockopt(_socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+
+  _listenOnly = false;
+  _loopback = false;
+
+  applyFilters();
+
+  _rxCount = 0;
+  _rxNext = 0;
+
+  return 1;
+}
+
+void SocketCANClass::end()
+{
+  if (_socket >= 0) {
+    close(_socket);
+    _socket = -1;
+  }
+
+  CANControllerClass::end();
+}
+
+int SocketCANClass::endPacket()
+{
+  if (!CANControllerClass::endPacket()) {
+    return 0;
+  }
+
+  if (_socket < 0 || _listenOnly) {
+    return 0;
+  }
+
+  struct can_frame frame;
+  memset(&frame, 0, sizeof(frame));
+
+  frame.can_id = _txExtended ? ((_txId & CAN_EFF_MASK) | CAN_EFF_FLAG) : (_txId & CAN_SFF_MASK);
+
+  if (_txRtr) {
+    frame.can_id |= CAN_RTR_FLAG;
+    frame.can_dlc = _txDlc > 0 ? _txDlc : 0;
+  } else {
+    frame.can_dlc = _txLength;
+    memcpy(frame.data, _txData, _txLength);
+  }
+
+  return ::write(_socket, &frame, sizeof(frame)) == sizeof(frame) ? 1 : 0;
+}
+
+// one recvmmsg call drains up to SOCKETCAN_RX_BATCH frames
+int SocketCANClass::receiveBatch()
+{
+  for (int i = 0; i < SOCKETCAN_RX_BATCH; i++) {
+    _rxVectors[i].iov_base = &_rxFrames[i];
+    _rxVectors[i].iov_len = sizeof(_rxFrames[i]);
+
+    memset(&_rxMessages[i], 0, sizeof(_rxMessages[i]));
+    _rxMessages[i].msg_hdr.msg_iov = &_rxVectors[i];
+    _rxMessages[i].msg_hdr.msg_iovlen = 1;
+    _rxMessages[i].msg_hdr.msg_control = _rxControl[i];
+    _rxMessages[i].msg_hdr.msg_controllen = sizeof(_rxControl[i]);
+  }
+
+  int n = recvmmsg(_socket, _rxMessages, SOCKETCAN_RX_BATCH, MSG_DONTWAIT, NULL);
+  if (n <= 0) {
+    return 0;
+  }
+
+  for (int i = 0; i < n; i++) {
+    _rxTimestamps[i] = 0;
+
+    for (struct cmsghdr* c = CMSG_FIRSTHDR(&_rxMessages[i].msg_hdr); c != NULL; c = CMSG_NXTHDR(&_rxMessages[i].msg_hdr, c)) {
+      if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+        struct timespec ts;
+        memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+        _rxTimestamps[i] = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+      }
+    }
+  }
+
+  return n;
+}
+
+int SocketCANClass::parsePacket()
+{
+  if (_rxNext >= _rxCount && _socket >= 0) {
+    _rxCount = receiveBatch();
+    _rxNext = 0;
+  }
+
+  if (_rxNext >= _rxCount) {
+    _rxId = -1;
+    _rxExtended = false;
+    _rxRtr = false;
+    _rxLength = 0;
+    _rxIndex = 0;
+    return 0;
+  }
+
+  const struct can_frame& frame = _rxFrames[_rxNext];
+
+  _rxExtended = (frame.can_id & CAN_EFF_FLAG) ? true : false;
+  _rxId = frame.can_id & (_rxExtended ? CAN_EFF_MASK : CAN_SFF_MASK);
+  _rxRtr = (frame.can_id & CAN_RTR_FLAG) ? true : false;
+  _rxDlc = frame.can_dlc > 8 ? 8 : frame.can_dlc;
+  _rxIndex = 0;
+  _rxTimestampNs = _rxTimestamps[_rxNext];
+
+  // packetTimestamp() is in the micros() domain: moved back by the time since the kernel stamped it
+  _rxTimestamp = micros();
+  if (_rxTimestampNs != 0) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t nowNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    if (nowNs > _rxTimestampNs) {
+      _rxTimestamp -= (uint32_t)((nowNs - _rxTimestampNs) / 1000);
+    }
+  }
+
+  if (_rxRtr) {
+    _rxLength = 0;
+  } else {
+    _rxLength = _rxDlc;
+    memcpy(_rxData, frame.data, _rxLength);
+  }
+
+  _rxNext++;
+
+  return _rxDlc;
+}
+
+// the receive interrupt of the hardware drivers, run by the caller instead of a thread
+int SocketCANClass::poll()
+{
+  if (_socket < 0 || (_CanHandler == NULL && _onReceive == NULL)) {
+    return 0;
+  }
+
+  int dispatched = 0;
+
+  // dlc 0 frames make parsePacket() return 0, keep going while frames are left
+  while (parsePacket() || _rxId != -1) {
+    if (_CanHandler != NULL) {
+      _CanHandler->onReceivePacket(available());
+    } else if (_onReceive != NULL) {
+      _onReceive(available());
+    }
+
+    dispatched++;
+  }
+
+  return dispatched;
+}
+
+int SocketCANClass::filter(int id, int mask)
+{
+  _filterCount = 0;
+
+  return addFilter(id, mask, false);
+}
+
+int SocketCANClass::filterExtended(long id, long mask)
+{
+  _filterCount = 0;
+
+  return addFilter(id, mask, true);
+}
+
+int SocketCANClass::addFilter(long id, long mask, bool extended)
+{
+  if (_filterCount >= SOCKETCAN_MAX_FILTERS) {
+    return 0;
+  }
+
+  struct can_filter& f = _filters[_filterCount++];
+
+  if (extended) {
+    f.can_id = (id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    f.can_mask = (mask & CAN_EFF_MASK) | CAN_EFF_FLAG;
+  } else {
+    f.can_id = id & CAN_SFF_MASK;
+    f.can_mask = (mask & CAN_SFF_MASK) | CAN_EFF_FLAG;
+  }
+
+  return applyFilters();
+}
+
+int SocketCANClass::clearFilters()
+{
+  _filterCount = 0;
+
+  return applyFilters();
+}
+
+int SocketCANClass::applyFilters()
+{
+  if (_socket < 0) {
+    return 1;
+  }
+
+  // no filter: one entry matching everything
+  struct can_filter all = { 0, 0 };
+  const struct can_filter* filters = _filterCount ? _filters : &all;
+  int count = _filterCount ? _filterCount : 1;
+
+  return setsockopt(_socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters, count * sizeof(struct can_filter)) == 0 ? 1 : 0;
+}
+
+// listen-only is a property of the interface (ip link set can0 type can listen-only on),
+// here the controller just stops transmitting
+int SocketCANClass::observe()
+{
+  _listenOnly = true;
+
+  return 1;
+}
+
+int SocketCANClass::loopback()
+{
+  _loopback = true;
+
+  if (_socket >= 0) {
+    int enable = 1;
+    return setsockopt(_socket, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &enable, sizeof(enable)) == 0 ? 1 : 0;
+  }
+
+  return 1;
+}
+
+int SocketCANClass::sleep()
+{
+  return 0;
+}
+
+int SocketCANClass::wakeup()
+{
+  return 0;
+}
+
+SocketCANClass CAN;
+
+#endif
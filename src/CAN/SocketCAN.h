@@ -0,0 +1,87 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef OBD2_SOCKETCAN
+
+#ifndef SOCKET_CAN_H
+#define SOCKET_CAN_H
+
+#include <linux/can.h>
+#include <sys/socket.h>
+
+#include "CANController.h"
+#include "CANHandler.h"
+
+#define SOCKETCAN_DEFAULT_INTERFACE "can0"
+#define SOCKETCAN_RX_BATCH 32     // frames per recvmmsg call
+#define SOCKETCAN_MAX_FILTERS 16  // kernel CAN_RAW_FILTER entries
+
+// Linux SocketCAN backend (can0, vcan0, slcan0...). The bitrate belongs to the interface:
+//   ip link set can0 type can bitrate 500000 && ip link set can0 up
+// begin() only checks the interface exists. Receive callbacks run from poll() on the caller's
+// thread (OBD2::process() calls it), never next to the code using the received data.
+class SocketCANClass : public CANControllerClass {
+
+public:
+  SocketCANClass();
+  virtual ~SocketCANClass();
+
+  void setInterface(const char* name);
+
+  virtual int begin(long baudRate);
+  virtual void end();
+
+  virtual int endPacket();
+
+  virtual int parsePacket();
+
+  // recvmmsg batches dispatched to the callback, returns frames dispatched
+  virtual int poll();
+
+  // filter() and filterExtended() replace the kernel filter list, addFilter() appends to it
+  using CANControllerClass::filter;
+  virtual int filter(int id, int mask);
+  using CANControllerClass::filterExtended;
+  virtual int filterExtended(long id, long mask);
+  int addFilter(long id, long mask, bool extended);
+  int clearFilters();
+
+  virtual int observe();
+  virtual int loopback();
+  virtual int sleep();
+  virtual int wakeup();
+
+  // kernel receive time of the current packet, CLOCK_REALTIME nanoseconds
+  uint64_t packetTimestampNs() { return _rxTimestampNs; }
+
+  int fd() { return _socket; }
+
+private:
+  int receiveBatch();
+  int applyFilters();
+
+private:
+  char _interface[16];
+  int _socket;
+  bool _listenOnly;
+  bool _loopback;
+
+  struct can_filter _filters[SOCKETCAN_MAX_FILTERS];
+  int _filterCount;
+
+  // recvmmsg batch: frames are handed out one by one by parsePacket()
+  struct can_frame _rxFrames[SOCKETCAN_RX_BATCH];
+  struct mmsghdr _rxMessages[SOCKETCAN_RX_BATCH];
+  struct iovec _rxVectors[SOCKETCAN_RX_BATCH];
+  char _rxControl[SOCKETCAN_RX_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+  uint64_t _rxTimestamps[SOCKETCAN_RX_BATCH];
+  int _rxCount;
+  int _rxNext;
+  uint64_t _rxTimestampNs;
+};
+
+extern SocketCANClass CAN;
+
+#endif
+
+#endif
@@ -6,8 +6,10 @@
  * Licensed under the MIT license. See LICENSE file in the project root for full license information.
  */
 
-#include "Can.h"
+#include "CAN.h"
 #include "OBD2.h"
+#include "OBD2Trace.h"
+#include "OBD2BusProfiler.h"
 
 using namespace std;
 
@@ -15,8 +17,18 @@ void OBD2::Begin(int ctxPin, int crxPin, long baudrate){
   
     _ctxPin = ctxPin;
     _crxPin = crxPin;
+
+    _can.setPins(crxPin, ctxPin);
+
+    Begin(baudrate);
+}
+
+void OBD2::Begin(long baudrate){
+
     _baudrate = baudrate;
 
+    if(_profiler!=NULL) _profiler->setBaudrate(baudrate);
+
     if(OBD2_DEBUG)
     {
         Serial.print("Initializing CANBUS @baudrate ");
@@ -24,18 +36,16 @@ void OBD2::Begin(int ctxPin, int crxPin, long baudrate){
         Serial.print("...");
     }     
 
-    CAN.setPins(crxPin, ctxPin);
-
-    if (!CAN.begin(baudrate)) { // 1000E3 500E3
+    if (!_can.begin(baudrate)) { // 1000E3 500E3
 
-    if(OBD2_DEBUG)
-        Serial.println("[KO]"); 
+        if(OBD2_DEBUG)
+            Serial.println("[KO]");
         while (1);
     }
 
     if(_handleInterrupt)
     {
-        CAN.onReceive(this);
+        _can.onReceive(this);
     }
 
     if(OBD2_DEBUG)
@@ -82,69 +92,291 @@ bool OBD2::sendRequest(OBD2Request* request){
   {    
     if(_isElm)
     {
-        return sendElmRequest(request);
+        if(!sendElmRequest(request->Header, request->Service, request->Pid, request->ExpectedBytes)) return false;
+        _currentRequest = request;
+        return true;
     }
-    
-    //flush
-    if(CAN.available()){
-      while(CAN.available()){
-        CAN.read();
-      }
+
+    if(!sendCanRequest(request->Header, request->Service, request->Pid)) return false;
+    _currentRequest = request;
+    return true;
+  }
+  
+  return false;
+
+}
+
+bool OBD2::sendRequest(const OBD2RequestDescriptor* request, OBD2RequestState* state){
+
+  if(status==OBD2StatusType::ready)
+  {    
+    if(_isElm)
+    {
+        if(!sendElmRequest(request->getHeader(), request->Service, request->Pid, request->ExpectedBytes)) return false;
+    }
+    else if(!sendCanRequest(request->getHeader(), request->Service, request->Pid)) 
+    {
+        return false;
     }
 
+    _currentDescriptor = request;
+    _currentState = state;
+    _requestExpectedBytes = request->ExpectedBytes;
+    return true;
+  }
+  
+  return false;
+
+}
+
+void OBD2::setProfile(const OBD2Profile* profile, OBD2RequestState* states){
+  _profile = profile;
+  _profileStates = states;
+}
+
+int OBD2::findRequest(long header, uint8_t service, uint16_t pid){
+
+  if(_profile==NULL) return -1;
+
+  return _profile->findRequest(header, service, pid);
+}
+
+bool OBD2::sendProfileRequest(uint16_t index){
+
+  if(_profile==NULL || index >= _profile->Count) return false;
+
+  return sendRequest(&_profile->Requests[index], _profileStates!=NULL ? &_profileStates[index] : nullptr);
+}
+
+int OBD2::sendNextProfileRequest(){
+
+  if(_profile==NULL || _profileStates==NULL || status!=OBD2StatusType::ready) return -1;
+
+  unsigned long now = millis();
+  int next = -1;
+  unsigned long nextOverdue = 0;
+
+  for(uint16_t i=0;i<_profile->Count;i++)
+  {
+    uint32_t interval = _profile->Requests[i].ReadInterval;
+    if(interval==0) continue;
+
+    unsigned long elapsed = now - _profileStates[i].ReadTime;
+    if(elapsed < interval) continue;
+
+    if(next<0 || elapsed - interval > nextOverdue)
+    {
+      next = i;
+      nextOverdue = elapsed - interval;
+    }
+  }
+
+  if(next>=0 && !sendProfileRequest(next)) return -1;
+
+  return next;
+}
+
+//a complete response of another profile request (eg. late answer after a timeout):
+//store it into its state instead of dropping it
+bool OBD2::routeProfileResponse(){
+
+  if(_profile==NULL || _responseReadedBytes<_responseFrameBytes) return false;
+
+  int index = findRequest(obd2RequestHeaderFromResponse(_responsePacketId), _responseService, _responsePid);
+  if(index<0) return false;
+
+  const OBD2RequestDescriptor* request = &_profile->Requests[index];
+  OBD2RequestState* state = _profileStates!=NULL ? &_profileStates[index] : nullptr;
+  float value = getValue(request);
+
+  if(OBD2_DEBUG)
+    Serial.printf("\nRouted late response service: %2x pid: %4x to profile index %d\n", _responseService, _responsePid, index);
+
+  updateState(state, OBD2StatusType::received, value);
+  publishValue(index, OBD2StatusType::received, value);
+  callListener(request, state, OBD2StatusType::received, value, _responseBytes);
+
+  return true;
+}
+
+int OBD2::getBroadcastSlot(long header){
+
+  for(int i=0;i<_nbroadcastfilters;i++)
+  {
+    if(_broadcastfilters[i]==header) return (_profile!=NULL ? _profile->Count : 0) + i;
+  }
+
+  return -1;
+}
+
+void OBD2::setProfiler(OBD2BusProfiler* profiler){
+
+  _profiler = profiler;
+
+  //before Begin() the profiler gets the baudrate there
+  if(_profiler!=NULL && _baudrate > 0) _profiler->setBaudrate(_baudrate);
+}
+
+#if OBD2_STATS
+void OBD2::beginStatsWrite(){
+
+  //nested in a loop side write: the sequence is already odd
+  if(__atomic_fetch_add(&_statsWriters, 1, __ATOMIC_RELAXED) > 0) return;
+
+  __atomic_store_n(&_statsSequence, _statsSequence + 1, __ATOMIC_RELAXED);
+  //stats stores can't move above the odd sequence
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void OBD2::endStatsWrite(){
+
+  if(__atomic_sub_fetch(&_statsWriters, 1, __ATOMIC_RELAXED) > 0) return;
+
+  __atomic_store_n(&_statsSequence, _statsSequence + 1, __ATOMIC_RELEASE);
+}
+
+bool OBD2::getStats(OBD2Stats& snapshot){
+
+  for(uint8_t retry=0; retry<OBD2_STATS_READ_RETRIES; retry++)
+  {
+    uint32_t begin = __atomic_load_n(&_statsSequence, __ATOMIC_ACQUIRE);
+    if(begin & 1) continue; //write in progress
+
+    memcpy(&snapshot, &_stats, sizeof(snapshot));
+
+    //copy can't move below the second sequence load
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&_statsSequence, __ATOMIC_RELAXED) == begin) return true;
+  }
+
+  return false;
+}
+#endif
+
+void OBD2::publishValue(int index, OBD2StatusType outcome, float value){
+
+  if(_valueStore==NULL || index<0) return;
+
+  switch(outcome)
+  {
+    case OBD2StatusType::received:
+      _valueStore->write(index, value, _responseBytes, _responseDataBytes, responseMillis());
+      break;
+    case OBD2StatusType::timeout:
+      _valueStore->setQuality(index, OBD2ValueQuality::timeout, millis());
+      break;
+    case OBD2StatusType::nodata:
+      _valueStore->setQuality(index, OBD2ValueQuality::nodata, millis());
+      break;
+    default:
+      _valueStore->setQuality(index, OBD2ValueQuality::error, millis());
+      break;
+  }
+}
+
+bool OBD2::sendCanRequest(long header, uint8_t service, uint16_t pid){
+
     _flush();
     
     status=OBD2StatusType::sending;   
 
-    _currentRequest = request;
-
     _sendRequestTime = millis();
 
     _responseMultiFrames = false;
 
-    _requestPacketId = _currentRequest->Header;
-    _requestService = _currentRequest->Service;
-    _requestPid = _currentRequest->Pid;
+    _requestPacketId = header;
+    _requestService = service;
+    _requestPid = pid;
     _responseReadedBytes = 0;
     _responseFrameBytes = 0;
+    _negativeResponseCode = 0;
+
+    OBD2_STATS_RECORD(onSend(header, service, pid, micros()));
+
+    CANFrame frame = { header, false, false, 8, { 0 }, 0 };
 
     //29bit request 
-    if(_currentRequest->Pid > 0xFF)
+    if(pid > 0xFF)
     {
-      CAN.beginExtendedPacket(_currentRequest->Header, 8);
-      CAN.write(0x03); // number of additional bytes
-      CAN.write(_currentRequest->Service); //service 
-      CAN.write(_currentRequest->Pid>>8); //if 1003 then 10
-      CAN.write(_currentRequest->Pid & 0x00ff); //if 1003 then 03   
-      CAN.endPacket();
+      frame.extended = true;
+      frame.data[0] = 0x03; // number of additional bytes
+      frame.data[1] = service; //service 
+      frame.data[2] = pid>>8; //if 1003 then 10
+      frame.data[3] = pid & 0x00ff; //if 1003 then 03   
     }
     else{
-      CAN.beginPacket(_currentRequest->Header, 8);
-      CAN.write(0x02); // number of additional bytes
-      CAN.write(_currentRequest->Service);
-      CAN.write(_currentRequest->Pid); //if 1003 then 10
-      CAN.endPacket();
+      frame.data[0] = 0x02; // number of additional bytes
+      frame.data[1] = service;
+      frame.data[2] = pid; //if 1003 then 10
     }
+
+    _can.writeFrame(frame);
     
     return true;
-  }
-  
-  return false;
-
 }
 
-void OBD2::callListener(OBD2Request* request, float value, uint8_t* responseBytes){
+void OBD2::callListener(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes){
   if(_currentRequest!=NULL)
   {
-      if(_valueListener!=NULL) _valueListener->onOBD2Response(request, value, responseBytes); //listener method
+      if(_valueListener!=NULL) _valueListener->onOBD2Response(request, outcome, value, responseBytes); //listener method
 
       if(_callBackFunction!=NULL) _callBackFunction(request, value, responseBytes); //listener function
   }
 }
 
+void OBD2::callListener(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes){
+  if(request!=NULL)
+  {
+      if(_valueListener!=NULL) _valueListener->onOBD2Response(request, state, outcome, value, responseBytes); //listener method
+
+      if(_descriptorCallBackFunction!=NULL) _descriptorCallBackFunction(request, state, value, responseBytes); //listener function
+  }
+}
+
+void OBD2::updateState(OBD2RequestState* state, OBD2StatusType outcome, float value){
+
+  if(state==NULL) return;
+
+  state->Status = outcome;
+  state->ReadTime = outcome==OBD2StatusType::received ? responseMillis() : millis();
+
+  if(outcome==OBD2StatusType::received)
+  {
+      state->Value = value;
+      if(state->BindValue!=NULL) *state->BindValue = value;
+  }
+}
+
+//route the outcome of current request to its listeners, updating descriptor state if any
+void OBD2::dispatchResponse(float value){
+
+  OBD2_STATS_RECORD(onOutcome(status));
+
+  if(_currentDescriptor!=NULL)
+  {
+      updateState(_currentState, status, value);
+
+      if(_profile!=NULL && _currentDescriptor >= _profile->Requests && _currentDescriptor < _profile->Requests + _profile->Count)
+      {
+          publishValue(_currentDescriptor - _profile->Requests, status, value);
+      }
+
+      callListener(_currentDescriptor, _currentState, status, value, _responseBytes);
+  }
+  else{
+      callListener(_currentRequest, status, value, _responseBytes);
+  }
+}
+
 //need to call in loop everytime
 OBD2StatusType OBD2::process(){
-  
+
+  //deferred receive dispatch (MCP2515 over SPI) and transmit completions
+  if(!_isElm)
+  {
+      _can.poll();
+  }
+
   if(status==OBD2StatusType::sending){
       
       if(!_isElm)
@@ -152,7 +384,7 @@ OBD2StatusType OBD2::process(){
           //if we dont have interrupt we read manually
           if(!_handleInterrupt)
           {
-              int packetSize = CAN.parsePacket();
+              int packetSize = _can.parsePacket();
               if(packetSize)
               {
                 onReceivePacket(packetSize);
@@ -177,7 +409,7 @@ OBD2StatusType OBD2::process(){
   }
   else if(status==OBD2StatusType::received){
 
-      callListener(_currentRequest, getValue(_currentRequest), _responseBytes);
+      dispatchResponse(_currentDescriptor!=NULL ? getValue(_currentDescriptor) : getValue(_currentRequest));
       
       flushRequest();
       status = OBD2StatusType::ready;
@@ -187,7 +419,7 @@ OBD2StatusType OBD2::process(){
       //after a bit we return in ready state
       if(millis()-_sendRequestTime > _requestTimeout)
       {
-        callListener(_currentRequest, 0.0, _responseBytes);
+        dispatchResponse(0.0);
         _flush();
 
         status = OBD2StatusType::ready;             
@@ -197,17 +429,17 @@ OBD2StatusType OBD2::process(){
       //after a bit we return in ready state
       if(millis()-_sendRequestTime > _requestTimeout)
       {
-        callListener(_currentRequest, 0.0, _responseBytes);
+        dispatchResponse(0.0);
         _flush();
 
         status = OBD2StatusType::ready;
       }     
   }
   else if(status==OBD2StatusType::error){
-      //after a bit we return in ready state
-      if(millis()-_sendRequestTime > _requestTimeout)
+      //after a bit we return in ready state, at once if the ecu refused the request
+      if(_negativeResponseCode!=0 || millis()-_sendRequestTime > _requestTimeout)
       {
-        callListener(_currentRequest, 0.0, _responseBytes);
+        dispatchResponse(0.0);
         _flush();
 
         status = OBD2StatusType::ready;
@@ -218,27 +450,28 @@ OBD2StatusType OBD2::process(){
 
 }
 
-float OBD2::getValue(OBD2Request* request){
-
-    int n = request->ExpectedBytes-1;
-
-    /*float v =  (float)
-    ( n>=0?(_responseBytes[0]<<(8*n)):0 
-       | (n-1)>=0?(_responseBytes[1]<<(8*(n-1))):0
-       | (n-2)>=0?(_responseBytes[2]<<(8*(n-2))):0
-       | (n-3)>=0?(_responseBytes[3]<<(8*(n-3))):0
-    );*/
+float obd2DecodeValue(const uint8_t* responseBytes, uint8_t expectedBytes, float scaleFactor, float adjustFactor){
 
     float v = 0.00;
     uint8_t bitShift;
 
-    for (uint8_t i = 0; i < request->ExpectedBytes; i++)
+    for (uint8_t i = 0; i < expectedBytes; i++)
     {
-        bitShift = 8 * (request->ExpectedBytes - i - 1);
-        v = v + ((_responseBytes[i]) << bitShift);
+        bitShift = 8 * (expectedBytes - i - 1);
+        v = v + ((responseBytes[i]) << bitShift);
     }
 
-    return v>0.00?(v*request->ScaleFactor + request->AdjustFactor):0.00; 
+    return v>0.00?(v*scaleFactor + adjustFactor):0.00; 
+}
+
+float OBD2::getValue(OBD2Request* request){
+
+    return obd2DecodeValue(_responseBytes, request->ExpectedBytes, request->ScaleFactor, request->AdjustFactor);
+}
+
+float OBD2::getValue(const OBD2RequestDescriptor* request){
+
+    return obd2DecodeValue(_responseBytes, request->ExpectedBytes, request->ScaleFactor, request->AdjustFactor);
 }
 
 uint8_t* OBD2::getResponseBytes(){
@@ -269,16 +502,11 @@ void OBD2::checkTimeoutRequest(){
 }
 
 void OBD2::flowControl(long packetId){
-  CAN.beginExtendedPacket(packetId);
-  CAN.write(0x30);
-  CAN.write(0x0);
-  CAN.write(0x0);
-  CAN.write(0x0);
-  CAN.write(0x0);
-  CAN.write(0x0);
-  CAN.write(0x0);
-  CAN.write(0x0);
-  CAN.endPacket();    
+
+  //clear to send, no block size, no separation time
+  CANFrame frame = { packetId, packetId > 0x7FF, false, 8, { 0x30 }, 0 };
+
+  _can.writeFrame(frame);
 }
 
 void OBD2::getResponse(){
@@ -291,6 +519,13 @@ void OBD2::getResponse(){
 
   if(_responseService != _requestService  || _responsePid != _requestPid)
   {  
+    //response of another profile request, keep waiting for ours
+    if(routeProfileResponse())
+    {
+      status=OBD2StatusType::sending;
+      return;
+    }
+
     status=OBD2StatusType::nodata;
     return;
   }
@@ -306,13 +541,16 @@ void OBD2::getResponse(){
   {
     if(_responsePacketId>0 && _responseMultiFrames)
     {
-      if(millis() - _sendRequestTime > _consecutiveFrameTimeout)
+      //right after the first frame, again if consecutive frames stop coming
+      if(!_flowControlSent || millis() - _sendRequestTime > _consecutiveFrameTimeout)
       {
           if(OBD2_DEBUG)
             Serial.println("Sending flow control");
 
           _sendRequestTime = millis();
+          _flowControlSent = true;
           flowControl(_requestPacketId);
+          OBD2_STATS_RECORD(onFlowControl(micros()));
           status=OBD2StatusType::sending;
       }
     }  
@@ -320,6 +558,7 @@ void OBD2::getResponse(){
   else{
       //read complete
       status=OBD2StatusType::received;
+      OBD2_STATS_RECORD(onComplete(_responseTime));
       
       if(OBD2_DEBUG)
         Serial.printf("\nRequest Complete!  bytes: %02x readed: %02x\n", _responseFrameBytes, _responseReadedBytes);
@@ -334,7 +573,10 @@ void OBD2::flushRequest(){
     _requestPid = 0;
     _responsePCI = 0;
     _responseFrameBytes = 0;
+    _requestExpectedBytes = 0;
     _currentRequest = nullptr;
+    _currentDescriptor = nullptr;
+    _currentState = nullptr;
 }
 
 uint8_t OBD2::getResponseByte(int index){
@@ -342,9 +584,7 @@ uint8_t OBD2::getResponseByte(int index){
 }
 
 void OBD2::flushBuffer(){
-  for(int i=0;i<8;i++){
-    _canbuffer[i] = 0x0;
-  }
+  memset(_canframe.data, 0x0, sizeof(_canframe.data));
 }
 
 void OBD2::flushResponseBytes(){
@@ -357,29 +597,88 @@ void OBD2::flushResponseBytes(){
 void OBD2::handleBroadcastPackets(long packetId){
 
   _broadcastPacket.Header = packetId;
-  int index = 0;
   //edit: no DLC!
-  //if(CAN.available()) CAN.read(); //read first byte DLC
-  while (CAN.available()) {
-    _canbuffer[index] = CAN.read();
-    index++;
-  }
-  _broadcastPacket.Byte0 = _canbuffer[0];
-  _broadcastPacket.Byte1 = _canbuffer[1];
-  _broadcastPacket.Byte2 = _canbuffer[2];
-  _broadcastPacket.Byte3 = _canbuffer[3];
-  _broadcastPacket.Byte4 = _canbuffer[4];
-  _broadcastPacket.Byte5 = _canbuffer[5];
-  _broadcastPacket.Byte6 = _canbuffer[6];
-  _broadcastPacket.Byte7 = _canbuffer[7];
+  int length = _canframe.rtr ? 0 : _canframe.dlc;
+  _broadcastPacket.Byte0 = _canframe.data[0];
+  _broadcastPacket.Byte1 = _canframe.data[1];
+  _broadcastPacket.Byte2 = _canframe.data[2];
+  _broadcastPacket.Byte3 = _canframe.data[3];
+  _broadcastPacket.Byte4 = _canframe.data[4];
+  _broadcastPacket.Byte5 = _canframe.data[5];
+  _broadcastPacket.Byte6 = _canframe.data[6];
+  _broadcastPacket.Byte7 = _canframe.data[7];
+
+  if(_valueStore!=NULL)
+  {
+    _valueStore->write(getBroadcastSlot(packetId), 0.0, _canframe.data, length, responseMillis());
+  }
   
   flushBuffer();
 }
 
+//arrival of the last response frame in millis(), not when process() got to it
+unsigned long OBD2::responseMillis(){
+
+  return millis() - (uint32_t)(micros() - _responseTime) / 1000;
+}
+
+//7F service NRC: 0x78 (response pending) extends the request timeout, other codes end the request
+bool OBD2::handleNegativeResponse(){
+
+  if(status!=OBD2StatusType::sending || _canframe.data[2]!=_requestService) return false;
+
+  if(_canframe.data[3]==0x78)
+  {
+    if(OBD2_DEBUG)
+      Serial.println("Response pending");
+
+    _sendRequestTime = millis();
+    return false;
+  }
+
+  if(OBD2_DEBUG)
+    Serial.printf("Negative response: %02x\n", _canframe.data[3]);
+
+  _negativeResponseCode = _canframe.data[3];
+  return true;
+}
+
+//"7F service 78" line: the chip keeps waiting for the answer, the request timeout restarts as on the can path
+bool OBD2::handleElmResponsePending(){
+
+  if(!hasCurrentRequest()) return false;
+
+  char pending[7];
+  snprintf(pending, sizeof(pending), "7F%02X78", _requestService);
+  if(!(_elmBuffer == pending)) return false;
+
+  if(OBD2_DEBUG)
+    Serial.println("Response pending");
+
+  _elmBuffer = "";
+  _responseReadedBytes = 0;
+  _sendRequestTime = millis();
+  return true;
+}
+
 //called on interrupt internal callback to process raw data
 void OBD2::onReceivePacket(int packetSize){
 
-   _responsePacketId = CAN.packetId();
+  //whole frame in one copy, bytes past the payload are zero
+  if(!_can.readFrame(_canframe)) return;
+
+   _responsePacketId = _canframe.id;
+   _responseTime = _canframe.timestamp;
+
+  if(_trace!=NULL)
+  {
+    _trace->record(_responseTime, _responsePacketId, _canframe.extended, _canframe.rtr, _canframe.dlc, _canframe.data);
+  }
+
+  if(_profiler!=NULL)
+  {
+    _profiler->record(_canframe);
+  }
 
   //check if we have listen filters
   if(_nbroadcastfilters > 0)    
@@ -398,17 +697,15 @@ void OBD2::onReceivePacket(int packetSize){
     if(!accepted) return;   
   }
 
-  flushBuffer();
-
   if(OBD2_DEBUG)
   {
       Serial.println("Received ");
 
-   /*   if (CAN.packetExtended()) {
+   /*   if (_can.packetExtended()) {
         Serial.print("extended ");
       }
 
-      if (CAN.packetRtr()) {
+      if (_can.packetRtr()) {
         // Remote transmission request, packet contains no data
         Serial.print("RTR ");
       }
@@ -417,11 +714,11 @@ void OBD2::onReceivePacket(int packetSize){
       Serial.print(_responsePacketId, HEX);
   }   
 
-  if (CAN.packetRtr()) {
+  if (_canframe.rtr) {
     if(OBD2_DEBUG)
     {
       Serial.print(" and requested length ");
-      Serial.println(CAN.packetDlc());
+      Serial.println(_canframe.dlc);
     }
   } else {
     
@@ -435,36 +732,32 @@ void OBD2::onReceivePacket(int packetSize){
     {
       _responseMultiFrames = false;
       
-      int index, dataindex = 0;
-
-      while (CAN.available()) {
-        _canbuffer[index] = CAN.read();
-        index++;
-      }
+      int dataindex = 0;
       
       //multiframe response example: 10 0B 6240A4020103  
-      if(_canbuffer[0] > 8) //example: 0x10, 0x21 - 0x2F
+      if(_canframe.data[0] > 8) //example: 0x10, 0x21 - 0x2F
       {
         _responseMultiFrames = true;
-        _responsePCI = _canbuffer[0];
+        _responsePCI = _canframe.data[0];
         _consecutiveFrameSendRequestTime = millis();
 
         //only for firstframe we get service and pid
-        if(_canbuffer[0]==0x10)
+        if(_canframe.data[0]==0x10)
         {
            _responseDataBytes = 0;
-           _responseFrameBytes = _canbuffer[1];
-           _responseService = _canbuffer[2]-0x40;   //_responseService xor 40 return original service request
+           _flowControlSent = false;
+           _responseFrameBytes = _canframe.data[1];
+           _responseService = _canframe.data[2]-0x40;   //_responseService xor 40 return original service request
            _responseReadedBytes = 1;
           
-           if(CAN.packetExtended())
+           if(_canframe.extended)
            {
-              _responsePid = (_canbuffer[3]<<8)|(_canbuffer[4]);
+              _responsePid = (_canframe.data[3]<<8)|(_canframe.data[4]);
               _responseReadedBytes+=2;  
               dataindex = 5;
            }
            else{
-               _responsePid = _canbuffer[3];
+               _responsePid = _canframe.data[3];
                _responseReadedBytes+=1;  
                dataindex = 4;
            }
@@ -474,6 +767,12 @@ void OBD2::onReceivePacket(int packetSize){
           dataindex = 1;
         }
       }
+      //negative response example: 037F2278 
+      else if(_canframe.data[1]==0x7F)
+      {
+        if(handleNegativeResponse()) status = OBD2StatusType::error;
+        return;
+      }
       //single frame example: 046240A45F 
       else{ //single response
      
@@ -481,32 +780,36 @@ void OBD2::onReceivePacket(int packetSize){
         _responseDataBytes = 0;
         _responseReadedBytes = 1;
         _responsePCI = 0;
-        _responseFrameBytes = _canbuffer[0];     
-        _responseService = _canbuffer[1]-0x40;  //_responseService xor 40 return original service request
-        if(CAN.packetExtended())
+        _responseFrameBytes = _canframe.data[0];     
+        _responseService = _canframe.data[1]-0x40;  //_responseService xor 40 return original service request
+        if(_canframe.extended)
         {
-          _responsePid = (_canbuffer[2]<<8)|(_canbuffer[3]);
+          _responsePid = (_canframe.data[2]<<8)|(_canframe.data[3]);
           _responseReadedBytes+=2;  
           dataindex = 4;
         }
         else{
-          _responsePid = _canbuffer[2];
+          _responsePid = _canframe.data[2];
           _responseReadedBytes+=1;  
           dataindex = 3;
         } 
        
-        //Serial.printf("\nCan buffer s:%02x pid:%04x size %d: %02x %02x %02x %02x %02x %02x %02x %02x",_responseService, _responsePid,  packetSize,  _canbuffer[0], _canbuffer[1], _canbuffer[2], _canbuffer[3], _canbuffer[4], _canbuffer[5], _canbuffer[6], _canbuffer[7]);
+        //Serial.printf("\nCan buffer s:%02x pid:%04x size %d: %02x %02x %02x %02x %02x %02x %02x %02x",_responseService, _responsePid,  packetSize,  _canframe.data[0], _canframe.data[1], _canframe.data[2], _canframe.data[3], _canframe.data[4], _canframe.data[5], _canframe.data[6], _canframe.data[7]);
        
         flushResponseBytes(); 
       }      
       
       for(int d=dataindex;d<packetSize;d++)
       {
-        _responseBytes[_responseDataBytes] = _canbuffer[d];
+        _responseBytes[_responseDataBytes] = _canframe.data[d];
         _responseDataBytes++;
         _responseReadedBytes++;
       }
 
+      //single frames are neither
+      if(_canframe.data[0]==0x10) OBD2_STATS_RECORD(onFirstFrame(_responseTime));
+      else if((_canframe.data[0] & 0xF0)==0x20) OBD2_STATS_RECORD(onConsecutiveFrame(_responseTime));
+
       status = OBD2StatusType::hadling;
     }    
   }  
@@ -533,8 +836,11 @@ bool OBD2::initializeELM(){
 
   bool c2 = sendElmCommandBlocking("AT Z");
 	delay(100);
+
+  //reset turns echo on: the echoed query would be parsed as response bytes
+  bool c3 = sendElmCommandBlocking("AT E0");
   
-  return c1&&c2;
+  return c1&&c2&&c3;
 }
 
 void OBD2::sendElmHeader(long header){
@@ -597,6 +903,8 @@ void OBD2::sendElmCommand(String cmd){
   flushBuffer();
   flushResponseBytes();
   _currentRequest = nullptr;
+  _currentDescriptor = nullptr;
+  _currentState = nullptr;
   _responseReadedBytes = 0;
   _elmBuffer = "";
   _elmPort->print(cmd);
@@ -621,15 +929,19 @@ bool OBD2::getElmResponse(){
   else{
 
       char recChar = _elmPort->read();
+      _responseTime = micros();
+      OBD2_STATS_RECORD(onFirstFrame(_responseTime));
       if (recChar == '>')
       {
           if(OBD2_DEBUG)
             Serial.println("Elm response complete.");
 
           status = OBD2StatusType::received;
+          OBD2_STATS_RECORD(onComplete(_responseTime));
       }
       else if (!isalnum(recChar) && (recChar != ':') && (recChar != '.'))
       {
+          if(recChar == '\r') handleElmResponsePending();
           status = OBD2StatusType::hadling;
           return false;
       }
@@ -690,15 +1002,15 @@ bool OBD2::getElmResponse(){
 
 void OBD2::decodeElmResponse(){
 
-  char byte[2];
+  char byte[3] = { 0 };
   _responseReadedBytes = 0;
   _responseFrameBytes = 0;
   _responseMultiFrames = false;
 
-  if(_currentRequest!=NULL)
+  if(hasCurrentRequest())
   {
  
-    if(_currentRequest->Header >0x0 && _currentRequest->Pid > 0x0)
+    if(_requestPacketId >0x0 && _requestPid > 0x0)
     {
       //check if multiframe response
       //ex: 00B0:6201020000021:0100000000
@@ -739,21 +1051,30 @@ void OBD2::decodeElmResponse(){
       }
 
       //convert response string to hexbytes
-      for(int i=0;i<_elmBuffer.length();i++){
-        strcpy(byte, String(_elmBuffer[i]).c_str());
-        strcat(byte, String(_elmBuffer[i+1]).c_str());
+      for(unsigned int i=0;i<_elmBuffer.length();i++){
+        byte[0] = _elmBuffer[i];
+        byte[1] = _elmBuffer[i+1];
         _responseElmBytes[_responseReadedBytes] = strtol(byte, NULL, 16);
         _responseReadedBytes++;
         i++;
       }
 
+      //negative response: 7F service NRC
+      if(_responseElmBytes[0] == 0x7F && _responseElmBytes[1] == _requestService)
+      {
+        if(OBD2_DEBUG)
+          Serial.printf("Negative response: %02x\n", _responseElmBytes[2]);
+
+        _negativeResponseCode = _responseElmBytes[2];
+        status = OBD2StatusType::error;
+      }
       //check if match request
-      if(_responseElmBytes[0] > 0)
+      else if(_responseElmBytes[0] > 0)
       {
          _responseReadedBytes = 1;
          _responseService = _responseElmBytes[0]-0x40;  //_responseService xor 40 return original service request
          
-        if(_currentRequest->Pid > 0xFF){
+        if(_requestPid > 0xFF){
           _responsePid = (_responseElmBytes[1]<<8)|(_responseElmBytes[2]);
           _responseReadedBytes+=2;
         }
@@ -762,9 +1083,9 @@ void OBD2::decodeElmResponse(){
           _responseReadedBytes+=1;
         }
 
-        _responseFrameBytes = _responseMultiFrames? _responseFrameBytes :(_responseReadedBytes+_currentRequest->ExpectedBytes);
+        _responseFrameBytes = _responseMultiFrames? _responseFrameBytes :(_responseReadedBytes+_requestExpectedBytes);
   
-        if(_currentRequest->Service == _responseService && _currentRequest->Pid == _responsePid)
+        if(_requestService == _responseService && _requestPid == _responsePid)
         {
           //if(OBD2_DEBUG)
            // Serial.printf("\nResponse service: %2x Response Pid: %4x \n\nBYTES: ", _responseService, _responsePid);
@@ -779,7 +1100,7 @@ void OBD2::decodeElmResponse(){
         }
         else{
           if(OBD2_DEBUG)
-            Serial.printf("\nRequest service: %2x  and Request Pid: %4x not matches response: %2x %4x\n", _currentRequest->Service, _currentRequest->Pid, _responseService, _responsePid);
+            Serial.printf("\nRequest service: %2x  and Request Pid: %4x not matches response: %2x %4x\n", _requestService, _requestPid, _responseService, _responsePid);
           status = OBD2StatusType::nodata;
         }
 
@@ -803,7 +1124,7 @@ void OBD2::upper(char string[], uint8_t buflen)
 	}
 }
 
-bool OBD2::sendElmRequest(OBD2Request* request){
+bool OBD2::sendElmRequest(long header, uint8_t service, uint16_t pid, uint8_t expectedBytes){
   
   if(status==OBD2StatusType::ready)
   {
@@ -811,11 +1132,12 @@ bool OBD2::sendElmRequest(OBD2Request* request){
     flushRequest();
     flushResponseBytes();
 
-    _requestPacketId = request->Header;
-    _requestService = request->Service;
-    _requestPid = request->Pid;
+    _requestPacketId = header;
+    _requestService = service;
+    _requestPid = pid;
     _responseReadedBytes = 0;
     _responseFrameBytes = 0;
+    _negativeResponseCode = 0;
 
     char query[8] = { '\0' }; 
     
@@ -823,13 +1145,13 @@ bool OBD2::sendElmRequest(OBD2Request* request){
 	  query[1] = (_requestService & 0xF) + '0';
 
     //29bit request 
-    if(request->Pid > 0xFF)
+    if(pid > 0xFF)
     {
       query[2] = ((_requestPid >> 12) & 0xF) + '0';
       query[3] = ((_requestPid >> 8) & 0xF) + '0';
       query[4] = ((_requestPid >> 4) & 0xF) + '0';
       query[5] = (_requestPid & 0xF) + '0';
-      query[6] = request->ExpectedBytes + '0';
+      query[6] = '1'; //number of responses: elm returns at first answer, without waiting its timeout
       query[7] = '\0';
 
       upper(query, 6);
@@ -837,14 +1159,15 @@ bool OBD2::sendElmRequest(OBD2Request* request){
     else{
       query[2] = ((_requestPid >> 4) & 0xF) + '0';
       query[3] = (_requestPid & 0xF) + '0';
-      query[4] = request->ExpectedBytes + '0';
+      query[4] = '1';
       query[5] = '\0';
 
       upper(query, 4);
     }
 
     sendElmCommand(query);
-    _currentRequest = request;
+    _requestExpectedBytes = expectedBytes;
+    OBD2_STATS_RECORD(onSend(header, service, pid, micros()));
     return true;
   }
   
@@ -19,10 +19,27 @@
 
 
 #include "CAN.h"
+#include "OBD2Profile.h"
+#include "OBD2ValueStore.h"
+#include "OBD2Stats.h"
+
+class OBD2TraceWriter;
+class OBD2BusProfiler;
 
 //define maxbuffer lenght for response bytes
 #define OBD2_MAX_BUFFER_LENGTH 64
 
+enum class OBD2StatusType {
+    undefined,
+    ready,
+    sending,
+    hadling,
+    received,
+    timeout,
+    nodata,
+    error
+};
+
 //PID Struct
 struct OBD2Request {
   String Group;
@@ -40,6 +57,45 @@ struct OBD2Request {
   long ReadTime;
 };
 
+//mask and flag packed into OBD2RequestDescriptor::HeaderFlags
+#define OBD2_HEADER_MASK             0x1FFFFFFFUL
+#define OBD2_ALWAYS_SEND_HEADER_FLAG 0x80000000UL
+
+//Compact PID descriptor: constexpr, no heap, can be placed in flash (static const tables).
+//Group and Name are plain C strings, literals stay in read-only memory.
+//Runtime values are kept apart in OBD2RequestState.
+struct OBD2RequestDescriptor {
+  const char* Group;
+  const char* Name;
+  uint32_t HeaderFlags; //bits 0-28: header or ecu-id, bit 31: always send header
+  uint16_t Pid;
+  uint8_t  Service;
+  uint8_t  ExpectedBytes;
+  float    ScaleFactor;
+  float    AdjustFactor;
+  uint32_t ReadInterval;
+
+  constexpr OBD2RequestDescriptor(const char* group, const char* name, bool alwaysSendHeader, uint32_t header, uint8_t service, uint16_t pid, uint8_t expectedBytes, float scaleFactor = 1.0f, float adjustFactor = 0.0f, uint32_t readInterval = 0)
+    : Group(group), Name(name),
+      HeaderFlags((header & OBD2_HEADER_MASK) | (alwaysSendHeader ? OBD2_ALWAYS_SEND_HEADER_FLAG : 0)),
+      Pid(pid), Service(service), ExpectedBytes(expectedBytes),
+      ScaleFactor(scaleFactor), AdjustFactor(adjustFactor), ReadInterval(readInterval) {}
+
+  constexpr long getHeader() const { return (long)(HeaderFlags & OBD2_HEADER_MASK); }
+  constexpr bool alwaysSendHeader() const { return (HeaderFlags & OBD2_ALWAYS_SEND_HEADER_FLAG) != 0; }
+};
+
+//Mutable runtime state of a descriptor (keep it in RAM, one per descriptor)
+struct OBD2RequestState {
+  float Value;
+  float *BindValue; //optional, updated on every valid response
+  unsigned long ReadTime; //millis() of last response
+  OBD2StatusType Status; //last outcome: received, timeout, nodata, error
+};
+
+//big endian value of first expectedBytes response bytes, scaled and adjusted: the formula of getValue()
+float obd2DecodeValue(const uint8_t* responseBytes, uint8_t expectedBytes, float scaleFactor, float adjustFactor);
+
 struct OBD2BroadcastPacket {
     long Header;
     uint8_t Byte0;
@@ -52,44 +108,71 @@ struct OBD2BroadcastPacket {
     uint8_t Byte7;
 };
 
-enum class OBD2StatusType {
-    undefined,
-    ready,
-    sending,
-    hadling,
-    received,
-    timeout,
-    nodata,
-    error
-};
-
 class IOBD2MessageListener{
     public:
         virtual ~IOBD2MessageListener(){}
         virtual void onOBD2Response(OBD2Request* request, float value, uint8_t* responseBytes){};
+        //outcome tells a real 0.0 from timeout, nodata or error; defaults to the overload above
+        virtual void onOBD2Response(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes){ onOBD2Response(request, value, responseBytes); };
+        //state is nullptr when sendRequest() had none, outcome is always set
+        virtual void onOBD2Response(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes){};
 };
     
 class OBD2: CANHandler
 {
+    friend class OBD2Bench; //drives the private decode paths
     public:
-        OBD2(){};
+        //any controller: several OBD2 on different buses can run at the same time
+        OBD2(CANControllerClass& can = CAN) : _can(can) { OBD2_STATS_RECORD(reset()); };
         void Begin(int ctxPin, int crxPin, long baudrate= 500E3);
+        void Begin(long baudrate= 500E3); //pins already set on the controller (eg. MCP2515 cs and irq)
         bool sendRequest(OBD2Request* request);
+        bool sendRequest(const OBD2RequestDescriptor* request, OBD2RequestState* state = nullptr);
         OBD2StatusType process();
         void onReceivePacket(int packetSize);
         void addPacketFilter(long filter);
         void addBroadcastFilter(long filter);
 
+        //profiles: read-only descriptor tables with O(1) response lookup
+        void setProfile(const OBD2Profile* profile, OBD2RequestState* states);
+        bool sendProfileRequest(uint16_t index);
+        int sendNextProfileRequest(); //send most overdue request by ReadInterval, return its index or -1
+        int findRequest(long header, uint8_t service, uint16_t pid);
+
+        //shared value store: slot i holds profile request i, then one slot per broadcast filter
+        void setValueStore(OBD2ValueStore* store){ _valueStore = store; };
+        OBD2ValueStore* getValueStore(){ return _valueStore; };
+        int getValueSlot(long header, uint8_t service, uint16_t pid){ return findRequest(header, service, pid); };
+        int getBroadcastSlot(long header);
+
+        //capture: every frame reaching onReceivePacket() is recorded before filtering, nullptr to stop
+        void setTrace(OBD2TraceWriter* trace){ _trace = trace; };
+        //bus profile: every frame reaching onReceivePacket(), load at the Begin() baudrate, nullptr to stop
+        void setProfiler(OBD2BusProfiler* profiler);
+
+        CANControllerClass& getController(){ return _can; };
+
+#if OBD2_STATS
+        //latency histograms and outcome counters, build with -DOBD2_STATS=1
+        //consistent copy, false if the receive interrupt kept updating them through all retries
+        bool getStats(OBD2Stats& snapshot);
+        void resetStats(){ OBD2_STATS_RECORD(reset()); };
+#endif
+
         // CallBack Method
         //void(*callback)(int)
         void onHandleValue(void (*obd2listenerfn)(OBD2Request* request, float value, uint8_t* responseBytes)){_callBackFunction = obd2listenerfn;}; //simple fn
+        void onHandleValue(void (*obd2listenerfn)(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t* responseBytes)){_descriptorCallBackFunction = obd2listenerfn;}; //simple fn for descriptors
         void onHandleValue(IOBD2MessageListener* instance){_valueListener = instance;}; //interface
         
         float getValue(OBD2Request* request);
+        float getValue(const OBD2RequestDescriptor* request);
         uint8_t  getResponseByte(int index);
         uint8_t  getResponseService(){ return _responseService;}
         uint16_t getResponsePid(){ return _responsePid;}
+        uint8_t  getNegativeResponseCode(){ return _negativeResponseCode;} //NRC of the last request ended in error, 0 if none
         OBD2BroadcastPacket getBroadcastPacket(){ return _broadcastPacket;}
+        uint32_t getResponseTime(){ return _responseTime;} //micros() when the last response frame arrived, from the controller
         OBD2StatusType status = OBD2StatusType::undefined;  
         uint8_t* getResponseBytes();     
         void flush();
@@ -103,20 +186,23 @@ class OBD2: CANHandler
         
 
     private:
-        int _sendRequestTime = 0;
-        int _requestTimeout = 1000;
-        int _consecutiveFrameSendRequestTime = 0;
-        int _consecutiveFrameTimeout = 100;
+        CANControllerClass& _can;
+        unsigned long _sendRequestTime = 0;
+        unsigned long _requestTimeout = 1000;
+        unsigned long _consecutiveFrameSendRequestTime = 0;
+        unsigned long _consecutiveFrameTimeout = 100;
+        bool _flowControlSent = true;
+        uint32_t _responseTime = 0;
         int _ctxPin;
         int _crxPin;
-        long _baudrate; 
+        long _baudrate = 0;
         int _nfilters = 0; //max 10 sw filters    
         int _maxfilters = 10; //max 10 sw filters      
         long _filters[10]; //max 10 sw filters
         int _nbroadcastfilters = 0; //max 10 sw filters    
         int _maxbroadcastfilters = 10; //max 10 sw filters      
         long _broadcastfilters[10]; //max 10 sw filters
-        uint8_t _canbuffer[8];
+        CANFrame _canframe = {};
         uint8_t _responseBytes[OBD2_MAX_BUFFER_LENGTH];
         bool _handleInterrupt = true;
         bool _responseMultiFrames;
@@ -125,11 +211,13 @@ class OBD2: CANHandler
         uint8_t _requestService = 0;
         uint8_t _responseService = 0;
         uint16_t _requestPid = 0;
+        uint8_t _requestExpectedBytes = 0;
         uint16_t _responsePid = 0;
         uint8_t _responsePCI = 0;
         uint8_t _responseFrameBytes = 0;
         uint8_t _responseReadedBytes = 0;
         uint8_t _responseDataBytes = 0;
+        uint8_t _negativeResponseCode = 0;
         OBD2BroadcastPacket _broadcastPacket = {0,0,0,0,0,0,0,0,0};
         void checkTimeoutRequest();
         void flushRequest();
@@ -137,12 +225,38 @@ class OBD2: CANHandler
         void flushResponseBytes();
         void getResponse();
         void handleBroadcastPackets(long packetId);
+        bool handleNegativeResponse();
+        bool handleElmResponsePending();
         void flowControl(long packetId);
+        unsigned long responseMillis();
         void (*onReceiveCallback)();
-        IOBD2MessageListener* _valueListener;
-        void (*_callBackFunction)(OBD2Request* request, float value, uint8_t* responseBytes);
-        void callListener(OBD2Request* request, float value, uint8_t* responseBytes);
-        OBD2Request* _currentRequest; 
+        IOBD2MessageListener* _valueListener = nullptr;
+        void (*_callBackFunction)(OBD2Request* request, float value, uint8_t* responseBytes) = nullptr;
+        void (*_descriptorCallBackFunction)(const OBD2RequestDescriptor* request, OBD2RequestState* state, float value, uint8_t* responseBytes) = nullptr;
+        void callListener(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes);
+        void callListener(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes);
+        void dispatchResponse(float value);
+        bool hasCurrentRequest(){ return _currentRequest!=NULL || _currentDescriptor!=NULL; };
+        bool sendCanRequest(long header, uint8_t service, uint16_t pid);
+        OBD2Request* _currentRequest = nullptr; 
+        const OBD2RequestDescriptor* _currentDescriptor = nullptr;
+        OBD2RequestState* _currentState = nullptr;
+        const OBD2Profile* _profile = nullptr;
+        OBD2RequestState* _profileStates = nullptr;
+        void updateState(OBD2RequestState* state, OBD2StatusType outcome, float value);
+        bool routeProfileResponse();
+        OBD2ValueStore* _valueStore = nullptr;
+        void publishValue(int index, OBD2StatusType outcome, float value);
+        OBD2TraceWriter* _trace = nullptr;
+        OBD2BusProfiler* _profiler = nullptr;
+#if OBD2_STATS
+        OBD2Stats _stats;
+        //sequence lock, odd while the outermost write runs: receive interrupt writes nest in loop ones
+        uint32_t _statsSequence = 0;
+        uint32_t _statsWriters = 0;
+        void beginStatsWrite();
+        void endStatsWrite();
+#endif
 
         //elm integration
         bool _isElm = false;
@@ -150,10 +264,10 @@ class OBD2: CANHandler
         long _elmTimeout = 1000;
         String _elmBuffer;
         uint8_t _responseElmBytes[OBD2_MAX_BUFFER_LENGTH];
-        Stream* _elmPort;
+        Stream* _elmPort = nullptr;
         bool initializeELM();
         bool getElmResponse();
-        bool sendElmRequest(OBD2Request* request);
+        bool sendElmRequest(long header, uint8_t service, uint16_t pid, uint8_t expectedBytes);
         void upper(char string[], uint8_t buflen);
         void decodeElmResponse();
         void _flush();
@@ -0,0 +1,543 @@
+/**
+ * Obd2Reader - microbenchmarks
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2Bench.h"
+
+#if defined(OBD2_HOST)
+#include <chrono>
+#include <pthread.h>
+#elif defined(ARDUINO_ARCH_ESP32)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#endif
+
+//host: 64 bit nanoseconds, esp32: cpu cycles (wrap after ~17s at 240MHz), others: micros
+#if defined(OBD2_HOST)
+typedef uint64_t OBD2BenchTicks;
+static OBD2BenchTicks benchTicks(){ return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+static uint64_t benchNs(OBD2BenchTicks ticks){ return ticks; }
+#elif defined(ARDUINO_ARCH_ESP32)
+typedef uint32_t OBD2BenchTicks;
+static OBD2BenchTicks benchTicks(){ return ESP.getCycleCount(); }
+static uint64_t benchNs(OBD2BenchTicks ticks){ return (uint64_t)ticks * 1000 / ESP.getCpuFreqMHz(); }
+#else
+typedef uint32_t OBD2BenchTicks;
+static OBD2BenchTicks benchTicks(){ return micros(); }
+static uint64_t benchNs(OBD2BenchTicks ticks){ return (uint64_t)ticks * 1000; }
+#endif
+
+//calls per round of the cases without a recording
+#define OBD2_BENCH_CALLS 64
+
+//longest stripped elm answer and command line of a transcript
+#define OBD2_BENCH_ELM_LENGTH 128
+#define OBD2_BENCH_COMMAND_LENGTH 24
+
+//recorded on a 500k bus: engine answers on 7E8, body uds (29 bit) on 18DAF110 with a multi-frame
+//answer, wheel speed broadcast 4B2, and traffic of other ecus the filters drop
+static const OBD2BenchFrame benchFrames[] = {
+  { 0x7E8, false, 8, { 0x04, 0x41, 0x0C, 0x1A, 0xF8, 0xAA, 0xAA, 0xAA } },
+  { 0x0C9, false, 8, { 0x80, 0x1A, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+  { 0x4B2, false, 8, { 0x27, 0x10, 0x27, 0x12, 0x27, 0x0E, 0x27, 0x11 } },
+  { 0x7E8, false, 8, { 0x03, 0x41, 0x0D, 0x32, 0xAA, 0xAA, 0xAA, 0xAA } },
+  { 0x3E9, false, 8, { 0x00, 0x00, 0x12, 0x34, 0x00, 0x00, 0x00, 0x00 } },
+  { 0x7E8, false, 8, { 0x03, 0x41, 0x05, 0x7B, 0xAA, 0xAA, 0xAA, 0xAA } },
+  { 0x4B2, false, 8, { 0x27, 0x14, 0x27, 0x16, 0x27, 0x12, 0x27, 0x15 } },
+  { 0x18DAF110, true, 8, { 0x05, 0x62, 0x19, 0x55, 0x31, 0x9C, 0xAA, 0xAA } },
+  { 0x0C9, false, 8, { 0x80, 0x1B, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+  { 0x18DAF110, true, 8, { 0x10, 0x17, 0x62, 0x40, 0x01, 0x11, 0x11, 0x11 } },
+  { 0x18DAF110, true, 8, { 0x21, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11 } },
+  { 0x18DAF110, true, 8, { 0x22, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11 } },
+  { 0x18DAF110, true, 8, { 0x23, 0x11, 0x11, 0x11, 0xAA, 0xAA, 0xAA, 0xAA } },
+  { 0x7E8, false, 8, { 0x03, 0x41, 0x11, 0x33, 0xAA, 0xAA, 0xAA, 0xAA } },
+  { 0x3E9, false, 8, { 0x00, 0x00, 0x12, 0x36, 0x00, 0x00, 0x00, 0x00 } },
+  { 0x7E8, false, 8, { 0x03, 0x7F, 0x22, 0x31, 0xAA, 0xAA, 0xAA, 0xAA } },
+};
+
+static const long benchFilters[] = { 0x7E8, 0x18DAF110 };
+static const long benchBroadcastFilters[] = { 0x4B2 };
+
+//terminal log of an ELM327 v1.5 (E0, S1, H0) against the same ecus
+static const char benchTranscript[] =
+  ">AT SH 7DF\r"
+  "OK\r\r"
+  ">010C1\r"
+  "41 0C 1A F8 \r\r"
+  ">010D1\r"
+  "41 0D 32 \r\r"
+  ">01051\r"
+  "41 05 7B \r\r"
+  ">01111\r"
+  "41 11 33 \r\r"
+  ">015E1\r"
+  "NO DATA\r\r"
+  ">AT SH 18DA40F1\r"
+  "OK\r\r"
+  ">2219551\r"
+  "62 19 55 31 9C \r\r"
+  ">2240011\r"
+  "017 \r"
+  "0: 62 40 01 11 11 11 \r"
+  "1: 11 11 11 11 11 11 11 \r"
+  "2: 11 11 11 AA AA AA AA \r\r"
+  ">22FD011\r"
+  "7F 22 31 \r\r"
+  ">";
+
+static const OBD2RequestDescriptor benchValue1("Bench", "value1", false, 0x7DF, 0x01, 0x0D, 1);
+static const OBD2RequestDescriptor benchValue2("Bench", "value2", false, 0x7DF, 0x01, 0x0C, 2, 0.25);
+static const OBD2RequestDescriptor benchValue4("Bench", "value4", false, 0x7DF, 0x01, 0xA6, 4, 0.1);
+
+static volatile float benchSink;
+
+//serves one recorded answer to the elm parser
+class OBD2BenchStream : public Stream {
+  public:
+    void load(const char* begin, const char* end){ _cursor = begin; _end = end; };
+    int available(){ return _end - _cursor; };
+    int read(){ return _cursor < _end ? *_cursor++ : -1; };
+    int peek(){ return _cursor < _end ? *_cursor : -1; };
+    void flush(){};
+    size_t write(uint8_t c){ return 1; };
+
+  private:
+    const char* _cursor = nullptr;
+    const char* _end = nullptr;
+};
+
+static OBD2BenchStream benchStream;
+
+void OBD2Bench::addPacketFilter(long filter){
+
+  if(_nfilters < 10) _filters[_nfilters++] = filter;
+}
+
+void OBD2Bench::addBroadcastFilter(long filter){
+
+  if(_nbroadcastfilters < 10) _broadcastfilters[_nbroadcastfilters++] = filter;
+}
+
+const char* OBD2Bench::caseName(Case id){
+
+  switch(id)
+  {
+    case rxStream: return "onReceivePacket stream";
+    case rxSingleFrame: return "onReceivePacket single frame";
+    case rxMultiFrame: return "onReceivePacket multi frame";
+    case rxBroadcast: return "onReceivePacket broadcast";
+    case rxRejected: return "filter lookup (rejected)";
+    case getValue1: return "getValue 1 byte";
+    case getValue2: return "getValue 2 bytes";
+    case getValue4: return "getValue 4 bytes";
+    case flushBytes: return "flushResponseBytes";
+    case elmDecodeSingle: return "decodeElmResponse single";
+    case elmDecodeMulti: return "decodeElmResponse multi";
+    case elmParse: return "getElmResponse (per byte)";
+    default: return "empty";
+  }
+}
+
+//embedded recordings unless replay sets were given, filters go into the engine
+void OBD2Bench::prepare(){
+
+  if(_frames==NULL)
+  {
+    _frames = benchFrames;
+    _nframes = sizeof(benchFrames)/sizeof(benchFrames[0]);
+
+    if(_nfilters==0 && _nbroadcastfilters==0)
+    {
+      for(long f : benchFilters) addPacketFilter(f);
+      for(long f : benchBroadcastFilters) addBroadcastFilter(f);
+    }
+  }
+
+  if(_transcript==NULL) _transcript = benchTranscript;
+
+  _obd2._nfilters = 0;
+  _obd2._nbroadcastfilters = 0;
+  for(int i=0;i<_nfilters;i++) _obd2.addPacketFilter(_filters[i]);
+  for(int i=0;i<_nbroadcastfilters;i++) _obd2.addBroadcastFilter(_broadcastfilters[i]);
+}
+
+//0 broadcast, 1 rejected by the filters, 2 single frame, 3 first or consecutive frame
+int OBD2Bench::frameClass(const OBD2BenchFrame& frame){
+
+  if(std::find(_broadcastfilters, _broadcastfilters+_nbroadcastfilters, frame.Id) != _broadcastfilters+_nbroadcastfilters) return 0;
+  if(_nfilters > 0 && std::find(_filters, _filters+_nfilters, frame.Id) == _filters+_nfilters) return 1;
+
+  return frame.Data[0] > 8 ? 3 : 2;
+}
+
+//work=false runs the setup only: injecting frames, restoring buffers. It is measured and subtracted
+uint32_t OBD2Bench::replay(Case id, bool work){
+
+  uint32_t items = 0;
+
+  switch(id)
+  {
+    case rxStream:
+    case rxSingleFrame:
+    case rxMultiFrame:
+    case rxBroadcast:
+    case rxRejected:
+      return replayFrames(id, work);
+
+    case getValue1:
+    case getValue2:
+    case getValue4:
+    {
+      const OBD2RequestDescriptor* request = id==getValue1 ? &benchValue1 : (id==getValue2 ? &benchValue2 : &benchValue4);
+      for(int i=0;i<OBD2_BENCH_CALLS;i++)
+      {
+        _obd2._responseBytes[0] = (uint8_t)i;
+        if(work) benchSink = _obd2.getValue(request);
+        items++;
+      }
+      return items;
+    }
+
+    case flushBytes:
+      for(int i=0;i<OBD2_BENCH_CALLS;i++)
+      {
+        _obd2._responseBytes[0] = (uint8_t)i;
+        if(work) _obd2.flushResponseBytes();
+        items++;
+      }
+      return items;
+
+    case elmDecodeSingle:
+    case elmDecodeMulti:
+    case elmParse:
+      return replayTranscript(id, work);
+
+    default:
+      return 0;
+  }
+}
+
+uint32_t OBD2Bench::replayFrames(Case id, bool work){
+
+  static const int classes[] = { -1, 2, 3, 0, 1 }; //by case
+  uint32_t items = 0;
+
+  for(uint32_t i=0;i<_nframes;i++)
+  {
+    const OBD2BenchFrame& frame = _frames[i];
+    if(id!=rxStream && frameClass(frame)!=classes[id]) continue;
+
+    //a recording may start in the middle of a multi-frame answer
+    if(_obd2._responseDataBytes > OBD2_MAX_BUFFER_LENGTH-8) _obd2._responseDataBytes = 0;
+
+    int size = _obd2.getController().injectPacket(frame.Id, frame.Extended, false, frame.Dlc, frame.Data);
+    if(work) _obd2.onReceivePacket(size);
+    items++;
+  }
+
+  return items;
+}
+
+//next ">command" line that is an obd request, "AT SH" updates the header on the way.
+//The answer runs up to the next prompt, included: the parser completes on '>'
+bool OBD2Bench::nextExchange(const char*& cursor, long& header, char* command, uint8_t commandLength, const char*& response, const char*& responseEnd){
+
+  while(true)
+  {
+    const char* prompt = strchr(cursor, '>');
+    if(prompt==NULL) return false;
+
+    //command without spaces, upper case
+    const char* p = prompt+1;
+    uint8_t n = 0;
+    while(*p && *p!='\r' && *p!='\n')
+    {
+      if(*p!=' ' && n < commandLength-1) command[n++] = toupper(*p);
+      p++;
+    }
+    command[n] = 0;
+
+    response = p;
+    responseEnd = strchr(p, '>');
+    if(responseEnd==NULL) return false;
+    responseEnd++;
+    cursor = responseEnd-1;
+
+    if(strncmp(command, "ATSH", 4)==0)
+    {
+      header = strtol(command+4, NULL, 16);
+      continue;
+    }
+
+    if(n >= 4 && strncmp(command, "AT", 2)!=0 && strspn(command, "0123456789ABCDEF")==n) return true;
+  }
+}
+
+uint32_t OBD2Bench::replayTranscript(Case id, bool work){
+
+  const char* cursor = _transcript;
+  long header = 0x7DF;
+  char command[OBD2_BENCH_COMMAND_LENGTH];
+  char buffer[OBD2_BENCH_ELM_LENGTH];
+  const char* response;
+  const char* responseEnd;
+  uint32_t items = 0;
+
+  while(nextExchange(cursor, header, command, sizeof(command), response, responseEnd))
+  {
+    //odd length: trailing response count digit
+    uint8_t length = strlen(command) & ~1;
+    command[length] = 0;
+
+    uint16_t pid = strtol(command+2, NULL, 16);
+    command[2] = 0;
+    uint8_t service = strtol(command, NULL, 16);
+    uint8_t pidBytes = (length-2)/2;
+
+    //what getElmResponse keeps of the answer
+    uint8_t n = 0;
+    bool multi = false;
+    for(const char* c=response;c<responseEnd-1 && n < sizeof(buffer)-1;c++)
+    {
+      if(isalnum(*c) || *c==':' || *c=='.') buffer[n++] = *c;
+      if(*c==':') multi = true;
+    }
+    buffer[n] = 0;
+
+    if(id==elmDecodeSingle && multi) continue;
+    if(id==elmDecodeMulti && !multi) continue;
+
+    _obd2._currentDescriptor = &benchValue1;
+    _obd2._requestPacketId = header;
+    _obd2._requestService = service;
+    _obd2._requestPid = pid;
+    _obd2._requestExpectedBytes = n/2 > 1+pidBytes ? n/2-1-pidBytes : 0;
+    _obd2._responseReadedBytes = 0;
+
+    if(id==elmParse)
+    {
+      _obd2._elmBuffer = "";
+      _obd2.status = OBD2StatusType::hadling;
+      benchStream.load(response, responseEnd);
+      items += responseEnd-response;
+
+      if(work)
+      {
+        while(benchStream.available()) _obd2.getElmResponse();
+      }
+    }
+    else{
+      _obd2._elmBuffer = buffer;
+      _obd2.status = OBD2StatusType::hadling;
+      items++;
+
+      if(work) _obd2.decodeElmResponse();
+    }
+  }
+
+  return items;
+}
+
+//setup pass, then full pass: the difference is the cost of the measured call
+//both repeated, the fastest of each is the one nothing else ran in
+void OBD2Bench::measureCase(Measure& m){
+
+  m.SetupNs = UINT64_MAX;
+  m.TotalNs = UINT64_MAX;
+
+  for(uint16_t i=0;i<2*_repeats;i++)
+  {
+    bool work = i & 1;
+    uint32_t items = 0;
+    uint32_t allocs = allocations();
+    OBD2BenchTicks start = benchTicks();
+
+    for(uint16_t r=0;r<_rounds;r++) items += replay(m.Id, work);
+
+    uint64_t ns = benchNs(benchTicks()-start);
+    allocs = allocations()-allocs;
+
+    if(!work){
+      if(ns < m.SetupNs) m.SetupNs = ns;
+      m.SetupAllocs = allocs;
+    }
+    else{
+      if(ns < m.TotalNs) m.TotalNs = ns;
+      m.TotalAllocs = allocs;
+      m.Items = items;
+    }
+  }
+}
+
+#if defined(OBD2_HOST)
+
+//painted stack: the lowest byte still holding the pattern is the high-water mark
+#define OBD2_BENCH_HOST_STACK_SIZE (OBD2_BENCH_STACK_SIZE + 262144)
+#define OBD2_BENCH_PAINT 0xA5
+
+void OBD2Bench::caseEntry(void* measure){
+
+  Measure* m = (Measure*)measure;
+  m->Bench->measureCase(*m);
+}
+
+bool OBD2Bench::runIsolated(Measure& m){
+
+  m.Bench = this;
+  m.StackUsed = -1;
+
+  uint8_t* stack = NULL;
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  if(posix_memalign((void**)&stack, 4096, OBD2_BENCH_HOST_STACK_SIZE)!=0)
+  {
+    measureCase(m);
+    return false;
+  }
+
+  memset(stack, OBD2_BENCH_PAINT, OBD2_BENCH_HOST_STACK_SIZE);
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, stack, OBD2_BENCH_HOST_STACK_SIZE);
+
+  void* (*entry)(void*) = [](void* measure) -> void* { caseEntry(measure); return NULL; };
+  bool isolated = pthread_create(&thread, &attr, entry, &m)==0;
+  pthread_attr_destroy(&attr);
+
+  if(isolated)
+  {
+    pthread_join(thread, NULL);
+
+    //the stack grows down from the top, thread descriptor and tls included
+    size_t untouched = 0;
+    while(untouched < OBD2_BENCH_HOST_STACK_SIZE && stack[untouched]==OBD2_BENCH_PAINT) untouched++;
+    m.StackUsed = OBD2_BENCH_HOST_STACK_SIZE-untouched;
+  }
+  else{
+    measureCase(m);
+  }
+
+  free(stack);
+  return isolated;
+}
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+void OBD2Bench::caseEntry(void* measure){
+
+  Measure* m = (Measure*)measure;
+  m->Bench->measureCase(*m);
+
+  //stack depth is in bytes on the esp32
+  m->StackUsed = OBD2_BENCH_STACK_SIZE - uxTaskGetStackHighWaterMark(NULL);
+  xSemaphoreGive((SemaphoreHandle_t)m->Done);
+  vTaskDelete(NULL);
+}
+
+bool OBD2Bench::runIsolated(Measure& m){
+
+  m.Bench = this;
+  m.StackUsed = -1;
+
+  SemaphoreHandle_t done = xSemaphoreCreateBinary();
+  m.Done = done;
+
+  if(done==NULL || xTaskCreate(caseEntry, "obd2bench", OBD2_BENCH_STACK_SIZE, &m, uxTaskPriorityGet(NULL), NULL)!=pdPASS)
+  {
+    if(done!=NULL) vSemaphoreDelete(done);
+    measureCase(m);
+    return false;
+  }
+
+  xSemaphoreTake(done, portMAX_DELAY);
+  vSemaphoreDelete(done);
+  return true;
+}
+
+#else
+
+void OBD2Bench::caseEntry(void* measure){
+
+  Measure* m = (Measure*)measure;
+  m->Bench->measureCase(*m);
+}
+
+//no threads: timing and allocations only
+bool OBD2Bench::runIsolated(Measure& m){
+
+  m.Bench = this;
+  m.StackUsed = -1;
+  caseEntry(&m);
+  return false;
+}
+
+#endif
+
+int OBD2Bench::run(){
+
+  prepare();
+
+  Stream* elmPort = _obd2._elmPort;
+  _obd2._elmPort = &benchStream;
+
+  Measure base = {};
+  base.Id = empty;
+  runIsolated(base);
+
+  _nresults = 0;
+
+  for(int id=rxStream;id<empty && _nresults<OBD2_BENCH_MAX_RESULTS;id++)
+  {
+    //warm-up on the caller: caches, lazy symbol binding (its stack use is not the case's)
+    replay((Case)id, true);
+
+    Measure m = {};
+    m.Id = (Case)id;
+    runIsolated(m);
+
+    if(m.Items==0) continue;
+
+    OBD2BenchResult& result = _results[_nresults++];
+    result.Name = caseName(m.Id);
+    result.Items = m.Items;
+    result.NsPerItem = m.TotalNs > m.SetupNs ? (float)(m.TotalNs-m.SetupNs)/m.Items : 0;
+    result.AllocsPerItem = _allocationCounter ? (float)(int32_t)(m.TotalAllocs-m.SetupAllocs)/m.Items : -1;
+    result.StackBytes = m.StackUsed>=0 && base.StackUsed>=0 ? std::max(0, (int)(m.StackUsed-base.StackUsed)) : -1;
+  }
+
+  //leave the engine idle
+  _obd2._elmPort = elmPort;
+  _obd2.flush();
+
+  return _nresults;
+}
+
+void OBD2Bench::print(Print& out, bool csv){
+
+  if(csv)
+    out.println("case,items,ns_per_item,allocs_per_item,stack_bytes");
+  else
+    out.printf("%-30s %9s %11s %12s %7s\n", "case", "items", "ns/item", "allocs/item", "stack");
+
+  for(int i=0;i<_nresults;i++)
+  {
+    const OBD2BenchResult& r = _results[i];
+
+    if(csv)
+    {
+      out.printf("%s,%lu,%.1f,%.2f,%ld\n", r.Name, (unsigned long)r.Items, r.NsPerItem, r.AllocsPerItem, (long)r.StackBytes);
+      continue;
+    }
+
+    out.printf("%-30s %9lu %11.1f ", r.Name, (unsigned long)r.Items, r.NsPerItem);
+
+    if(r.AllocsPerItem < 0) out.printf("%12s ", "-");
+    else out.printf("%12.2f ", r.AllocsPerItem);
+
+    if(r.StackBytes < 0) out.printf("%7s\n", "-");
+    else out.printf("%7ld\n", (long)r.StackBytes);
+  }
+}
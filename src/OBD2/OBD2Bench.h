@@ -0,0 +1,128 @@
+/**
+ * Obd2Reader - microbenchmarks
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Per-frame cost of the receive and decode hot paths: onReceivePacket (with the filter lookup),
+ * getValue, flushResponseBytes, decodeElmResponse and the ELM byte parser.
+ * Recorded CAN frames and ELM transcripts are replayed through the engine, for every case it reports
+ * ns per frame (or per byte), heap allocations per frame and stack high-water. Timings are the fastest of
+ * OBD2_BENCH_REPEATS setup and full passes, so interrupts and preemption don't inflate a single pass.
+ * Host: steady clock, each case on its own thread with a painted stack.
+ * ESP32: ESP.getCycleCount(), each case on its own FreeRTOS task.
+ * Run it on an OBD2 that has not called Begin(): frames are injected into CAN, the bus must stay quiet.
+ */
+
+#ifndef Obd2Bench_H
+#define Obd2Bench_H
+
+#include "OBD2.h"
+
+//stack given to every case, high-water is reported relative to an empty case
+#ifndef OBD2_BENCH_STACK_SIZE
+#define OBD2_BENCH_STACK_SIZE 16384
+#endif
+
+//setup and full passes of every case, the fastest of each is kept
+#ifndef OBD2_BENCH_REPEATS
+#define OBD2_BENCH_REPEATS 7
+#endif
+
+#define OBD2_BENCH_MAX_RESULTS 16
+
+//recorded frame, candump style
+struct OBD2BenchFrame {
+    long Id;
+    bool Extended;
+    uint8_t Dlc;
+    uint8_t Data[8];
+};
+
+struct OBD2BenchResult {
+    const char* Name;
+    uint32_t Items;          //frames (or bytes) replayed, all rounds of one pass
+    float NsPerItem;         //setup cost subtracted
+    float AllocsPerItem;     //-1 without allocation counter
+    int32_t StackBytes;      //above an empty case, -1 if not measured
+};
+
+class OBD2Bench
+{
+    public:
+        OBD2Bench(OBD2& obd2) : _obd2(obd2) {};
+
+        //replay sets, default to the embedded recordings
+        void setFrames(const OBD2BenchFrame* frames, uint32_t count){ _frames = frames; _nframes = count; };
+        //terminal log: ">" + command lines, then the adapter output; "AT SH" lines set the header
+        void setElmTranscript(const char* transcript){ _transcript = transcript; };
+        //software filters of the rx cases, the defaults match the embedded recording
+        void addPacketFilter(long filter);
+        void addBroadcastFilter(long filter);
+
+        void setRounds(uint16_t rounds){ _rounds = rounds > 0 ? rounds : 1; };
+        void setRepeats(uint8_t repeats){ _repeats = repeats > 0 ? repeats : 1; };
+        //cumulative allocation count (operator new hook, malloc wrapper...), optional
+        void setAllocationCounter(uint32_t (*counter)()){ _allocationCounter = counter; };
+
+        int run(); //number of results
+        const OBD2BenchResult& getResult(int index){ return _results[index]; };
+        int getResultCount(){ return _nresults; };
+        void print(Print& out, bool csv = false);
+
+    private:
+        enum Case {
+            rxStream,
+            rxSingleFrame,
+            rxMultiFrame,
+            rxBroadcast,
+            rxRejected,
+            getValue1,
+            getValue2,
+            getValue4,
+            flushBytes,
+            elmDecodeSingle,
+            elmDecodeMulti,
+            elmParse,
+            empty
+        };
+
+        struct Measure {
+            OBD2Bench* Bench;
+            void* Done; //esp32: completion semaphore
+            Case Id;
+            uint32_t Items;
+            uint64_t SetupNs;
+            uint64_t TotalNs;
+            uint32_t SetupAllocs;
+            uint32_t TotalAllocs;
+            int32_t StackUsed;
+        };
+
+        OBD2& _obd2;
+        const OBD2BenchFrame* _frames = nullptr;
+        uint32_t _nframes = 0;
+        const char* _transcript = nullptr;
+        long _filters[10];
+        int _nfilters = 0;
+        long _broadcastfilters[10];
+        int _nbroadcastfilters = 0;
+        uint16_t _rounds = 100;
+        uint8_t _repeats = OBD2_BENCH_REPEATS;
+        uint32_t (*_allocationCounter)() = nullptr;
+        OBD2BenchResult _results[OBD2_BENCH_MAX_RESULTS];
+        int _nresults = 0;
+
+        static const char* caseName(Case id);
+        static void caseEntry(void* measure);
+        void measureCase(Measure& m);
+        bool runIsolated(Measure& m);
+        void prepare();
+        uint32_t replay(Case id, bool work);
+        uint32_t replayFrames(Case id, bool work);
+        uint32_t replayTranscript(Case id, bool work);
+        int frameClass(const OBD2BenchFrame& frame);
+        bool nextExchange(const char*& cursor, long& header, char* command, uint8_t commandLength, const char*& response, const char*& responseEnd);
+        uint32_t allocations(){ return _allocationCounter ? _allocationCounter() : 0; };
+};
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ * Obd2Reader - bus profiler
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2BusProfiler.h"
+#include <math.h>
+
+//crc delimiter, ack slot and delimiter, end of frame, interframe space: never stuffed
+#define FRAME_TAIL_BITS 13
+
+//stuffed part of a frame, crc computed on the fly as the controller does
+struct FrameBits {
+  uint16_t Crc = 0;
+  uint8_t Count = 0;
+  uint8_t Run = 0;
+  uint8_t Last = 2;
+
+  void stuff(uint8_t bit){
+    Count++;
+
+    if(bit == Last) Run++;
+    else{
+      Last = bit;
+      Run = 1;
+    }
+
+    //five equal bits: the complement is inserted and starts the next run
+    if(Run == 5)
+    {
+      Count++;
+      Last = !bit;
+      Run = 1;
+    }
+  }
+
+  void push(uint32_t value, uint8_t bits, bool crc = true){
+    for(int8_t i=bits-1;i>=0;i--)
+    {
+      uint8_t bit = (value >> i) & 1;
+
+      if(crc)
+      {
+        bool next = bit ^ ((Crc >> 14) & 1);
+        Crc = (Crc << 1) & 0x7FFF;
+        if(next) Crc ^= 0x4599;
+      }
+
+      stuff(bit);
+    }
+  }
+};
+
+uint8_t OBD2BusProfiler::frameBits(const CANFrame& frame){
+
+  uint8_t dlc = frame.dlc > 8 ? 8 : frame.dlc;
+  FrameBits f;
+
+  f.push(0, 1); //sof
+
+  if(frame.extended)
+  {
+    f.push(frame.id >> 18, 11);
+    f.push(0x03, 2); //srr, ide
+    f.push(frame.id & 0x3FFFF, 18);
+    f.push(frame.rtr, 1);
+    f.push(0, 2); //r1, r0
+  }
+  else{
+    f.push(frame.id & 0x7FF, 11);
+    f.push(frame.rtr, 1);
+    f.push(0, 2); //ide, r0
+  }
+
+  f.push(dlc, 4);
+
+  if(!frame.rtr)
+  {
+    for(uint8_t i=0;i<dlc;i++) f.push(frame.data[i], 8);
+  }
+
+  f.push(f.Crc, 15, false);
+
+  return f.Count + FRAME_TAIL_BITS;
+}
+
+OBD2BusProfiler::OBD2BusProfiler(){
+  static_assert(OBD2_PROFILER_HASH_SLOTS >= 2*OBD2_PROFILER_MAX_IDS, "OBD2_PROFILER_HASH_SLOTS too small for OBD2_PROFILER_MAX_IDS");
+
+  _resetAt = micros();
+  clear();
+}
+
+//only record() clears the table: clearing it from loop() could race a frame being recorded in the
+//interrupt, which would keep a stale slot index or merge two ids
+void OBD2BusProfiler::reset(){
+
+  __atomic_store_n(&_resetAt, (uint32_t)micros(), __ATOMIC_RELAXED);
+  __atomic_store_n(&_resetRequested, true, __ATOMIC_RELEASE);
+}
+
+//record() side, inside its odd sequence
+void OBD2BusProfiler::clear(){
+
+  memset(_entries, 0, sizeof(_entries));
+  memset(_slots, 0xFF, sizeof(_slots));
+  _nentries = 0;
+
+  _start = _resetAt;
+  _frames = 0;
+  _untracked = 0;
+  _bits = 0;
+
+  _windowStart = _start;
+  _windowBits = 0;
+  _peakWindowBits = 0;
+}
+
+//open addressing on the id, extended ids in their own key space
+int OBD2BusProfiler::lookup(long id, bool extended, bool insert){
+
+  uint32_t key = (uint32_t)id ^ (extended ? 0x80000000 : 0);
+  uint32_t slot = ((key * 2654435761u) >> 16) & (OBD2_PROFILER_HASH_SLOTS-1);
+
+  for(uint16_t n=0;n<OBD2_PROFILER_HASH_SLOTS;n++)
+  {
+    int16_t index = _slots[slot];
+
+    if(index < 0)
+    {
+      if(!insert || _nentries >= OBD2_PROFILER_MAX_IDS) return -1;
+
+      index = _nentries++;
+      _slots[slot] = index;
+
+      Entry& e = _entries[index];
+      e.Id = id;
+      e.Extended = extended;
+      e.PeriodMin = UINT32_MAX;
+      return index;
+    }
+
+    if(_entries[index].Id == id && _entries[index].Extended == extended) return index;
+
+    slot = (slot + 1) & (OBD2_PROFILER_HASH_SLOTS-1);
+  }
+
+  return -1;
+}
+
+void OBD2BusProfiler::closeWindows(uint32_t now){
+
+  uint32_t elapsed = now - _windowStart;
+  if(elapsed < OBD2_PROFILER_LOAD_WINDOW) return;
+
+  if(_windowBits > _peakWindowBits) _peakWindowBits = _windowBits;
+
+  _windowBits = 0;
+  _windowStart += elapsed - elapsed % OBD2_PROFILER_LOAD_WINDOW;
+}
+
+void OBD2BusProfiler::record(const CANFrame& frame){
+
+  uint8_t bits = frameBits(frame);
+  uint8_t dlc = frame.dlc > 8 ? 8 : frame.dlc;
+
+  uint32_t seq = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&_sequence, seq + 1, __ATOMIC_RELAXED);
+  //updates can't move above the odd sequence
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  if(__atomic_exchange_n(&_resetRequested, false, __ATOMIC_ACQ_REL)) clear();
+
+  closeWindows(frame.timestamp);
+  _windowBits += bits;
+  _bits += bits;
+  _frames++;
+
+  int index = lookup(frame.id, frame.extended, true);
+
+  if(index < 0)
+  {
+    _untracked++;
+  }
+  else{
+    Entry& e = _entries[index];
+
+    if(e.Count == 0)
+    {
+      e.FirstSeen = frame.timestamp;
+      e.DlcMin = dlc;
+      e.DlcMax = dlc;
+    }
+    else{
+      uint32_t period = frame.timestamp - e.LastSeen;
+
+      if(period < e.PeriodMin) e.PeriodMin = period;
+      if(period > e.PeriodMax) e.PeriodMax = period;
+      e.PeriodSum += period;
+      e.PeriodSquares += (uint64_t)period * period;
+
+      if(dlc < e.DlcMin) e.DlcMin = dlc;
+      if(dlc > e.DlcMax) e.DlcMax = dlc;
+    }
+
+    //rtr frames carry no payload to compare
+    if(!frame.rtr)
+    {
+      for(uint8_t i=0;i<dlc;i++)
+      {
+        if(e.Count > 0 && e.Data[i] != frame.data[i]) e.ChangeMask |= 1 << i;
+        e.Data[i] = frame.data[i];
+      }
+    }
+
+    e.Count++;
+    e.LastSeen = frame.timestamp;
+    e.Bits += bits;
+  }
+
+  __atomic_store_n(&_sequence, seq + 2, __ATOMIC_RELEASE);
+}
+
+uint32_t OBD2BusProfiler::beginRead(){
+
+  uint32_t begin;
+  while((begin = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE)) & 1);
+  return begin;
+}
+
+bool OBD2BusProfiler::endRead(uint32_t begin){
+
+  //copies can't move below the second sequence load
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&_sequence, __ATOMIC_RELAXED) == begin;
+}
+
+float OBD2BusProfiler::load(uint64_t bits, uint32_t elapsed){
+
+  if(_baudrate <= 0 || elapsed == 0) return 0;
+  return (float)((double)bits * 1E6 / ((double)_baudrate * elapsed));
+}
+
+uint16_t OBD2BusProfiler::getIdCount(){
+  return resetPending() ? 0 : __atomic_load_n(&_nentries, __ATOMIC_ACQUIRE);
+}
+
+uint32_t OBD2BusProfiler::getElapsed(){
+  return micros() - __atomic_load_n(&_resetAt, __ATOMIC_RELAXED);
+}
+
+uint32_t OBD2BusProfiler::getFrames(){
+  return resetPending() ? 0 : __atomic_load_n(&_frames, __ATOMIC_RELAXED);
+}
+
+uint32_t OBD2BusProfiler::getUntracked(){
+  return resetPending() ? 0 : __atomic_load_n(&_untracked, __ATOMIC_RELAXED);
+}
+
+int OBD2BusProfiler::findId(long id, bool extended){
+
+  if(resetPending()) return -1;
+
+  for(uint8_t retry=0; retry<OBD2_PROFILER_READ_RETRIES; retry++)
+  {
+    uint32_t begin = beginRead();
+    int index = lookup(id, extended, false);
+    if(endRead(begin)) return index;
+  }
+
+  return -1;
+}
+
+bool OBD2BusProfiler::getIdStats(uint16_t index, OBD2BusIdStats& stats){
+
+  if(index >= getIdCount()) return false;
+
+  Entry e;
+  uint32_t elapsed = 0;
+  bool copied = false;
+
+  for(uint8_t retry=0; retry<OBD2_PROFILER_READ_RETRIES && !copied; retry++)
+  {
+    uint32_t begin = beginRead();
+    memcpy(&e, &_entries[index], sizeof(e));
+    elapsed = micros() - _start;
+    copied = endRead(begin);
+  }
+
+  if(!copied || e.Count == 0) return false;
+
+  stats.Id = e.Id;
+  stats.Extended = e.Extended;
+  stats.Count = e.Count;
+  stats.FirstSeen = e.FirstSeen;
+  stats.LastSeen = e.LastSeen;
+  stats.DlcMin = e.DlcMin;
+  stats.DlcMax = e.DlcMax;
+  stats.ChangeMask = e.ChangeMask;
+  memcpy(stats.Data, e.Data, sizeof(stats.Data));
+  stats.Load = load(e.Bits, elapsed);
+
+  uint32_t periods = e.Count - 1;
+
+  if(periods == 0)
+  {
+    stats.Rate = 0;
+    stats.PeriodMean = 0;
+    stats.PeriodMin = 0;
+    stats.PeriodMax = 0;
+    stats.Jitter = 0;
+    return true;
+  }
+
+  double mean = (double)e.PeriodSum / periods;
+  double variance = (double)e.PeriodSquares / periods - mean * mean;
+
+  stats.Rate = (float)(1E6 / mean);
+  stats.PeriodMean = (uint32_t)(mean + 0.5);
+  stats.PeriodMin = e.PeriodMin;
+  stats.PeriodMax = e.PeriodMax;
+  stats.Jitter = variance > 0 ? (float)sqrt(variance) : 0;
+
+  return true;
+}
+
+float OBD2BusProfiler::getLoad(){
+
+  if(resetPending()) return 0;
+
+  uint64_t bits = 0;
+  uint32_t elapsed = 0;
+
+  for(uint8_t retry=0; retry<OBD2_PROFILER_READ_RETRIES; retry++)
+  {
+    uint32_t begin = beginRead();
+    bits = _bits;
+    elapsed = micros() - _start;
+    if(endRead(begin)) break;
+  }
+
+  return load(bits, elapsed);
+}
+
+float OBD2BusProfiler::getPeakLoad(){
+
+  if(resetPending()) return 0;
+
+  uint32_t peak = 0;
+
+  for(uint8_t retry=0; retry<OBD2_PROFILER_READ_RETRIES; retry++)
+  {
+    uint32_t begin = beginRead();
+    peak = _peakWindowBits;
+
+    //the current window is closed by the next frame, it counts once complete
+    if(micros() - _windowStart >= OBD2_PROFILER_LOAD_WINDOW && _windowBits > peak) peak = _windowBits;
+
+    if(endRead(begin)) break;
+  }
+
+  return load(peak, OBD2_PROFILER_LOAD_WINDOW);
+}
+
+size_t OBD2BusProfiler::print(Print& out){
+
+  size_t n = 0;
+  uint16_t count = getIdCount();
+
+  n += out.printf("profile,%lu us,%lu frames,%u ids,%lu untracked,load %.1f%%,peak %.1f%%,%ld bit/s\n",
+                  (unsigned long)getElapsed(), (unsigned long)getFrames(), count, (unsigned long)getUntracked(),
+                  getLoad() * 100, getPeakLoad() * 100, _baudrate);
+  n += out.print("id,count,hz,period_us,min_us,max_us,jitter_us,dlc,changes,load\n");
+
+  OBD2BusIdStats s;
+
+  for(uint16_t i=0;i<count;i++)
+  {
+    if(!getIdStats(i, s)) continue;
+
+    n += out.printf(s.Extended ? "%08lX," : "%03lX,", (unsigned long)s.Id);
+    n += out.printf("%lu,%.1f,%lu,%lu,%lu,%.1f,", (unsigned long)s.Count, s.Rate, (unsigned long)s.PeriodMean,
+                    (unsigned long)s.PeriodMin, (unsigned long)s.PeriodMax, s.Jitter);
+
+    if(s.DlcMin == s.DlcMax) n += out.printf("%u,", s.DlcMin);
+    else n += out.printf("%u-%u,", s.DlcMin, s.DlcMax);
+
+    n += out.printf("%02X,%.2f%%\n", s.ChangeMask, s.Load * 100);
+  }
+
+  return n;
+}
@@ -0,0 +1,127 @@
+/**
+ * Obd2Reader - bus profiler
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * OBD2BusProfiler keeps statistics per CAN id of every frame seen on the receive path (OBD2::setProfiler()
+ * or OBD2Sniffer::setProfiler() for a listen-only survey): count, mean/min/max period and its jitter
+ * (standard deviation), dlc range and which payload bytes change. Bus load is the length in bits of each
+ * frame, stuff bits included, over the bit time at the controller baudrate: the whole profile and the
+ * busiest OBD2_PROFILER_LOAD_WINDOW. record() runs in the receive interrupt, integer only, no heap;
+ * readers in loop() get consistent copies through a sequence lock like OBD2ValueStore.
+ */
+
+#ifndef Obd2BusProfiler_H
+#define Obd2BusProfiler_H
+
+#include "CAN.h"
+
+//ids tracked, frames of further ids are only counted in the load
+#ifndef OBD2_PROFILER_MAX_IDS
+#define OBD2_PROFILER_MAX_IDS 64
+#endif
+
+//peak load window, us
+#ifndef OBD2_PROFILER_LOAD_WINDOW
+#define OBD2_PROFILER_LOAD_WINDOW 100000
+#endif
+
+//hash slots, power of two at least twice OBD2_PROFILER_MAX_IDS
+#define OBD2_PROFILER_HASH_SLOTS 256
+
+#define OBD2_PROFILER_READ_RETRIES 16
+
+struct OBD2BusIdStats {
+    long Id;
+    bool Extended;
+    uint32_t Count;
+    uint32_t FirstSeen; //micros() of the first and last frame
+    uint32_t LastSeen;
+    float Rate; //frames/s between first and last frame
+    uint32_t PeriodMean; //us, 0 before the second frame
+    uint32_t PeriodMin;
+    uint32_t PeriodMax;
+    float Jitter; //us, standard deviation of the period
+    uint8_t DlcMin;
+    uint8_t DlcMax;
+    uint8_t ChangeMask; //bit i: data byte i took more than one value
+    uint8_t Data[8]; //last payload
+    float Load; //share of the bus capacity used by this id over the profile
+};
+
+class OBD2BusProfiler
+{
+    public:
+        OBD2BusProfiler();
+
+        //load needs the bit rate: OBD2::setProfiler() and OBD2Sniffer::setProfiler() pass theirs
+        void setBaudrate(long baudrate){ _baudrate = baudrate; };
+        long getBaudrate(){ return _baudrate; };
+        //profile restarts now: the next record() clears it, readers see it empty meanwhile
+        void reset();
+
+        //receive interrupt side, frame.timestamp is its arrival
+        void record(const CANFrame& frame);
+
+        //loop side
+        uint16_t getIdCount();
+        bool getIdStats(uint16_t index, OBD2BusIdStats& stats); //index in order of first appearance
+        int findId(long id, bool extended);
+        float getLoad(); //whole profile, 0-1
+        float getPeakLoad(); //busiest complete window
+        uint32_t getFrames();
+        uint32_t getUntracked(); //frames of ids past OBD2_PROFILER_MAX_IDS
+        uint32_t getElapsed(); //us since reset()
+
+        //compact snapshot: one summary line, one CSV line per id, returns bytes written
+        size_t print(Print& out);
+
+        //bits on the wire: sof to interframe space, stuff bits of this frame exactly
+        static uint8_t frameBits(const CANFrame& frame);
+
+    private:
+        struct Entry {
+            long Id;
+            bool Extended;
+            uint8_t DlcMin;
+            uint8_t DlcMax;
+            uint8_t ChangeMask;
+            uint8_t Data[8];
+            uint32_t Count;
+            uint32_t FirstSeen;
+            uint32_t LastSeen;
+            uint32_t PeriodMin;
+            uint32_t PeriodMax;
+            uint64_t PeriodSum;
+            uint64_t PeriodSquares; //variance without floats in the interrupt
+            uint64_t Bits;
+        };
+
+        void clear();
+        bool resetPending(){ return __atomic_load_n(&_resetRequested, __ATOMIC_ACQUIRE); };
+        int lookup(long id, bool extended, bool insert);
+        void closeWindows(uint32_t now);
+        uint32_t beginRead();
+        bool endRead(uint32_t begin);
+        float load(uint64_t bits, uint32_t elapsed);
+
+        long _baudrate = 0;
+
+        Entry _entries[OBD2_PROFILER_MAX_IDS];
+        int16_t _slots[OBD2_PROFILER_HASH_SLOTS]; //entry index or -1
+        uint16_t _nentries = 0;
+
+        uint32_t _sequence = 0; //odd while record() updates
+        bool _resetRequested = false;
+        uint32_t _resetAt = 0;
+        uint32_t _start = 0;
+        uint32_t _frames = 0;
+        uint32_t _untracked = 0;
+        uint64_t _bits = 0;
+
+        uint32_t _windowStart = 0;
+        uint32_t _windowBits = 0;
+        uint32_t _peakWindowBits = 0;
+};
+
+#endif
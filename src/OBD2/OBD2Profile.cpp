@@ -0,0 +1,59 @@
+/**
+ * Obd2Reader - vehicle PID profiles
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2.h"
+#include "OBD2Profile.h"
+
+int OBD2Profile::find(long header, uint8_t service, uint16_t pid) const{
+
+  if(Index==NULL || Count==0) return -1;
+
+  uint32_t slot = obd2ProfileHash((uint32_t)header, service, pid) & IndexMask;
+
+  //linear probing, the generator keeps the table at most half full
+  for(uint16_t probe=0; probe<=IndexMask; probe++)
+  {
+    uint16_t i = Index[slot];
+    if(i==OBD2_PROFILE_EMPTY_SLOT) return -1;
+
+    const OBD2RequestDescriptor& r = Requests[i];
+    if(r.getHeader()==header && r.Service==service && r.Pid==pid) return i;
+
+    slot = (slot + 1) & IndexMask;
+  }
+
+  return -1;
+}
+
+int OBD2Profile::findRequest(long header, uint8_t service, uint16_t pid) const{
+
+  int index = find(header, service, pid);
+
+  //11bit responses may answer to functional address 0x7DF
+  if(index < 0 && header >= 0x7E0 && header <= 0x7E7)
+  {
+    index = find(0x7DF, service, pid);
+  }
+
+  return index;
+}
+
+long obd2RequestHeaderFromResponse(long responseId){
+
+  //29bit: 0x18DA<target><source>, swap target and source
+  if(responseId > 0x7FF)
+  {
+    return (responseId & 0xFFFF0000) | ((responseId & 0xFF) << 8) | ((responseId >> 8) & 0xFF);
+  }
+
+  //11bit: physical responses 0x7E8-0x7EF answer to 0x7E0-0x7E7
+  if(responseId >= 0x7E8 && responseId <= 0x7EF)
+  {
+    return responseId - 8;
+  }
+
+  return responseId;
+}
@@ -0,0 +1,45 @@
+/**
+ * Obd2Reader - vehicle PID profiles
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * A profile is a read-only table of OBD2RequestDescriptor sorted by (header, service, pid)
+ * plus an open addressing hash index, usually generated by tools/obd2_profile.py.
+ */
+
+#ifndef Obd2Profile_H
+#define Obd2Profile_H
+
+#include <stdint.h>
+
+struct OBD2RequestDescriptor;
+
+//marks an empty slot in OBD2Profile::Index
+#define OBD2_PROFILE_EMPTY_SLOT 0xFFFF
+
+struct OBD2Profile {
+  const char* Name;
+  const OBD2RequestDescriptor* Requests; //sorted by header, service, pid
+  uint16_t Count;
+  const uint16_t* Index; //hash slots holding request indexes, size IndexMask+1
+  uint16_t IndexMask;
+
+  //O(1) lookup of a request, returns its index or -1
+  int find(long header, uint8_t service, uint16_t pid) const;
+  //find(), then functional 0x7DF for 11bit physical headers (0x7E0-0x7E7)
+  int findRequest(long header, uint8_t service, uint16_t pid) const;
+};
+
+//hash used by both the runtime and the generator, keep them in sync
+inline uint32_t obd2ProfileHash(uint32_t header, uint8_t service, uint16_t pid){
+  uint32_t h = header * 0x9E3779B1UL;
+  h ^= ((uint32_t)service << 16) | pid;
+  h *= 0x85EBCA6BUL;
+  h ^= h >> 16;
+  return h;
+}
+
+//header used to query the ecu which sent responseId: 0x18DAF1C7 -> 0x18DAC7F1, 0x7E8 -> 0x7E0
+long obd2RequestHeaderFromResponse(long responseId);
+
+#endif
@@ -0,0 +1,212 @@
+/**
+ * Obd2Reader - derived signals
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2Signals.h"
+
+int OBD2SignalGraph::addNode(const char* name, OBD2SignalFormula formula){
+
+  if(_nsignals >= OBD2_MAX_SIGNALS) return -1;
+
+  int id = _nsignals;
+  _names[id] = name;
+  _formulas[id] = formula;
+  _ninputs[id] = 0;
+  _dependents[id] = 0;
+  _values[id] = 0.0;
+  _evaluations[id] = 0;
+  _nsignals++;
+
+  if(OBD2_DEBUG)
+  {
+    Serial.print("Added signal ");
+    Serial.print(id);
+    Serial.print(": ");
+    Serial.println(name);
+  }
+
+  return id;
+}
+
+int OBD2SignalGraph::addInput(const char* name){
+  return addNode(name, NULL);
+}
+
+int OBD2SignalGraph::addSignal(const char* name, OBD2SignalFormula formula, int input0, int input1, int input2, int input3){
+
+  if(formula==NULL) return -1;
+
+  int inputs[OBD2_MAX_SIGNAL_INPUTS] = { input0, input1, input2, input3 };
+
+  //inputs must already exist: keeps ids in topological order and rules out cycles
+  for(uint8_t i=0;i<OBD2_MAX_SIGNAL_INPUTS;i++)
+  {
+    if(inputs[i] >= _nsignals) return -1;
+  }
+
+  int id = addNode(name, formula);
+  if(id<0) return -1;
+
+  for(uint8_t i=0;i<OBD2_MAX_SIGNAL_INPUTS;i++)
+  {
+    if(inputs[i] < 0) continue;
+
+    _inputs[id][_ninputs[id]] = inputs[i];
+    _ninputs[id]++;
+    _dependents[inputs[i]] |= (1UL << id);
+  }
+
+  //first evaluation on next update
+  _dirty |= (1UL << id);
+
+  return id;
+}
+
+void OBD2SignalGraph::setInput(int id, float value){
+
+  if(!isValid(id) || _formulas[id]!=NULL) return;
+
+  if(_values[id] == value) return;
+
+  _values[id] = value;
+  _evaluations[id]++;
+  _dirty |= _dependents[id];
+}
+
+//each bound id from its own value store slot: two ids never overwrite each other between updates
+void OBD2SignalGraph::readBroadcasts(){
+
+  if(_source==NULL || _source->getValueStore()==NULL) return;
+
+  OBD2ValueStore* store = _source->getValueStore();
+  OBD2ValueSnapshot snapshot;
+
+  for(uint8_t i=0;i<_nbindings;i++)
+  {
+    Binding& b = _bindings[i];
+    if(b.Decoder==NULL) continue;
+
+    int slot = _source->getBroadcastSlot(b.Header);
+    if(slot<0 || !store->read(slot, snapshot) || snapshot.Version==b.Version) continue;
+
+    b.Version = snapshot.Version;
+
+    uint8_t data[8] = {0,0,0,0,0,0,0,0};
+    memcpy(data, snapshot.Raw, snapshot.RawLength < 8 ? snapshot.RawLength : 8);
+
+    OBD2BroadcastPacket packet = { b.Header, data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7] };
+    setInput(b.Input, b.Decoder(packet));
+  }
+}
+
+uint8_t OBD2SignalGraph::update(){
+
+  uint8_t evaluated = 0;
+
+  readBroadcasts();
+  float inputs[OBD2_MAX_SIGNAL_INPUTS];
+
+  //dependents always have higher ids: lowest dirty id first is a topological walk
+  while(_dirty)
+  {
+    int id = __builtin_ctz(_dirty);
+    _dirty &= ~(1UL << id);
+
+    for(uint8_t i=0;i<_ninputs[id];i++)
+    {
+      inputs[i] = _values[_inputs[id][i]];
+    }
+
+    float value = _formulas[id](inputs, _ninputs[id]);
+    _evaluations[id]++;
+    evaluated++;
+
+    if(value != _values[id])
+    {
+      _values[id] = value;
+      _dirty |= _dependents[id];
+    }
+  }
+
+  return evaluated;
+}
+
+int OBD2SignalGraph::find(const char* name){
+
+  for(uint8_t i=0;i<_nsignals;i++)
+  {
+    if(strcmp(_names[i], name)==0) return i;
+  }
+
+  return -1;
+}
+
+bool OBD2SignalGraph::addBinding(const void* request, long header, OBD2BroadcastDecoder decoder, int input){
+
+  if(_nbindings >= OBD2_MAX_SIGNAL_BINDINGS || !isValid(input) || _formulas[input]!=NULL) return false;
+
+  _bindings[_nbindings].Request = request;
+  _bindings[_nbindings].Header = header;
+  _bindings[_nbindings].Decoder = decoder;
+  _bindings[_nbindings].Input = input;
+  _bindings[_nbindings].Version = 0;
+  _nbindings++;
+
+  return true;
+}
+
+bool OBD2SignalGraph::bindRequest(OBD2Request* request, int input){
+  return addBinding(request, 0, NULL, input);
+}
+
+bool OBD2SignalGraph::bindRequest(const OBD2RequestDescriptor* request, int input){
+  return addBinding(request, 0, NULL, input);
+}
+
+bool OBD2SignalGraph::bindBroadcast(long header, OBD2BroadcastDecoder decoder, int input){
+
+  if(decoder==NULL) return false;
+
+  return addBinding(NULL, header, decoder, input);
+}
+
+void OBD2SignalGraph::onBroadcastPacket(const OBD2BroadcastPacket& packet){
+
+  if(packet.Header <= 0x0) return;
+
+  for(uint8_t i=0;i<_nbindings;i++)
+  {
+    if(_bindings[i].Decoder!=NULL && _bindings[i].Header==packet.Header)
+    {
+      setInput(_bindings[i].Input, _bindings[i].Decoder(packet));
+    }
+  }
+}
+
+void OBD2SignalGraph::setRequestInput(const void* request, float value){
+
+  for(uint8_t i=0;i<_nbindings;i++)
+  {
+    if(_bindings[i].Request==request)
+    {
+      setInput(_bindings[i].Input, value);
+    }
+  }
+}
+
+//failed outcomes come with 0.0: the input keeps its last value
+void OBD2SignalGraph::onOBD2Response(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes){
+
+  if(outcome==OBD2StatusType::received) setRequestInput(request, value);
+
+  if(_nextListener!=NULL) _nextListener->onOBD2Response(request, outcome, value, responseBytes);
+}
+
+void OBD2SignalGraph::onOBD2Response(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes){
+
+  if(outcome==OBD2StatusType::received) setRequestInput(request, value);
+
+  if(_nextListener!=NULL) _nextListener->onOBD2Response(request, state, outcome, value, responseBytes);
+}
@@ -0,0 +1,93 @@
+/**
+ * Obd2Reader - derived signals
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Dependency graph of derived values (DPF regeneration progress, consumption, ...) computed from
+ * pid responses and broadcast packets. A signal is recomputed only when one of its inputs changes.
+ */
+
+#ifndef Obd2Signals_H
+#define Obd2Signals_H
+
+#include "OBD2.h"
+
+//max signals (inputs + derived), ids fit a 32 bit dirty mask
+#define OBD2_MAX_SIGNALS 32
+#define OBD2_MAX_SIGNAL_INPUTS 4
+#define OBD2_MAX_SIGNAL_BINDINGS 16
+
+typedef float (*OBD2SignalFormula)(const float* inputs, uint8_t ninputs);
+typedef float (*OBD2BroadcastDecoder)(const OBD2BroadcastPacket& packet);
+
+class OBD2SignalGraph: public IOBD2MessageListener
+{
+    public:
+        OBD2SignalGraph(){};
+
+        //declare nodes: ids are assigned in order, a signal may only depend on existing ids,
+        //so declaration order is a topological order
+        int addInput(const char* name);
+        int addSignal(const char* name, OBD2SignalFormula formula, int input0, int input1 = -1, int input2 = -1, int input3 = -1);
+
+        //feed inputs: dependents are marked dirty only if value changes
+        void setInput(int id, float value);
+        bool bindRequest(OBD2Request* request, int input);
+        bool bindRequest(const OBD2RequestDescriptor* request, int input);
+        //with a value store on the attached obd2 update() reads each bound id from its own slot,
+        //otherwise feed packets with onBroadcastPacket()
+        bool bindBroadcast(long header, OBD2BroadcastDecoder decoder, int input);
+        void onBroadcastPacket(const OBD2BroadcastPacket& packet);
+
+        //read new broadcasts, recompute dirty signals in topological order, returns number of evaluations
+        uint8_t update();
+
+        float getValue(int id){ return isValid(id) ? _values[id] : 0.0; };
+        uint32_t getEvaluations(int id){ return isValid(id) ? _evaluations[id] : 0; }; //formula runs, or value changes for inputs
+        const char* getName(int id){ return isValid(id) ? _names[id] : NULL; };
+        int find(const char* name);
+        uint8_t count(){ return _nsignals; };
+        bool isDirty(){ return _dirty != 0; };
+
+        //register as value listener of obd2: timeout, nodata and error outcomes are then ignored
+        void attach(OBD2& obd2){ _source = &obd2; obd2.onHandleValue(this); };
+
+        //chained listener, receives every response after the graph
+        void setNextListener(IOBD2MessageListener* listener){ _nextListener = listener; };
+
+        void onOBD2Response(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes) override;
+        void onOBD2Response(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes) override;
+
+    private:
+        struct Binding {
+            const void* Request;
+            long Header;
+            OBD2BroadcastDecoder Decoder;
+            uint8_t Input;
+            uint32_t Version; //value store version of the last packet decoded
+        };
+
+        bool isValid(int id){ return id >= 0 && id < _nsignals; };
+        int addNode(const char* name, OBD2SignalFormula formula);
+        bool addBinding(const void* request, long header, OBD2BroadcastDecoder decoder, int input);
+        void setRequestInput(const void* request, float value);
+        void readBroadcasts();
+
+        uint8_t _nsignals = 0;
+        const char* _names[OBD2_MAX_SIGNALS];
+        OBD2SignalFormula _formulas[OBD2_MAX_SIGNALS];
+        uint8_t _inputs[OBD2_MAX_SIGNALS][OBD2_MAX_SIGNAL_INPUTS];
+        uint8_t _ninputs[OBD2_MAX_SIGNALS];
+        uint32_t _dependents[OBD2_MAX_SIGNALS]; //bitmask of signals reading this id
+        float _values[OBD2_MAX_SIGNALS];
+        uint32_t _evaluations[OBD2_MAX_SIGNALS];
+        uint32_t _dirty = 0;
+
+        uint8_t _nbindings = 0;
+        Binding _bindings[OBD2_MAX_SIGNAL_BINDINGS];
+
+        IOBD2MessageListener* _nextListener = nullptr;
+        OBD2* _source = nullptr;
+};
+
+#endif
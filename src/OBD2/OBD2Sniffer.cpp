@@ -0,0 +1,291 @@
+/**
+ * Obd2Reader - listen-only bus sniffer
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2Sniffer.h"
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static char* putHex(char* p, uint32_t value, uint8_t digits){
+  for(int8_t i=digits-1;i>=0;i--)
+  {
+    p[i] = HEX_DIGITS[value & 0x0F];
+    value >>= 4;
+  }
+  return p + digits;
+}
+
+static char* putDecimal(char* p, uint32_t value, uint8_t minDigits){
+  char digits[10];
+  uint8_t n = 0;
+
+  do
+  {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while(value > 0 || n < minDigits);
+
+  while(n > 0) *p++ = digits[--n];
+  return p;
+}
+
+OBD2Sniffer::OBD2Sniffer(CANControllerClass& can) : _can(can){
+  static_assert((OBD2_SNIFFER_RING_FRAMES & (OBD2_SNIFFER_RING_FRAMES-1)) == 0, "OBD2_SNIFFER_RING_FRAMES must be a power of two");
+
+  setInterfaceName("can0");
+}
+
+bool OBD2Sniffer::begin(long baudrate){
+
+  _head = 0;
+  _tail = 0;
+  _frames = 0;
+  _dropped = 0;
+  _filtered = 0;
+  _maxPending = 0;
+  _pendingLength = 0;
+  _pendingSent = 0;
+  _written = 0;
+  _timeStarted = false;
+  _baudrate = baudrate;
+
+  if(_profiler!=NULL) _profiler->setBaudrate(baudrate);
+
+  //straight to listen-only: no frame is acknowledged, not even while starting
+  if(!_can.beginObserve(baudrate)) return false;
+
+  _can.onReceive(this);
+
+  if(OBD2_DEBUG)
+    Serial.println("Sniffer listening");
+
+  return true;
+}
+
+void OBD2Sniffer::end(){
+
+  while(process() > 0);
+
+  _can.onReceive((CANHandler*)NULL);
+  _can.end();
+}
+
+bool OBD2Sniffer::addFilter(long id, long mask){
+
+  if(_nfilters >= OBD2_SNIFFER_MAX_FILTERS) return false;
+
+  _filterIds[_nfilters] = id & mask;
+  _filterMasks[_nfilters] = mask;
+  _nfilters++;
+
+  return true;
+}
+
+void OBD2Sniffer::setOutput(Print* out, OBD2SnifferFormat format){
+
+  _out = out;
+  _format = format;
+  _pendingLength = 0;
+  _pendingSent = 0;
+
+  //binary output is a trace file: header first
+  if(_out!=NULL && _format==OBD2SnifferFormat::binary)
+  {
+    OBD2TraceWriter::encodeHeader(_pending);
+    _pendingLength = OBD2_TRACE_HEADER_SIZE;
+    writePending();
+  }
+}
+
+void OBD2Sniffer::setInterfaceName(const char* name){
+
+  strncpy(_interface, name, sizeof(_interface)-1);
+  _interface[sizeof(_interface)-1] = 0;
+}
+
+void OBD2Sniffer::setProfiler(OBD2BusProfiler* profiler){
+
+  _profiler = profiler;
+  if(_profiler!=NULL && _baudrate > 0) _profiler->setBaudrate(_baudrate);
+}
+
+bool OBD2Sniffer::accept(long id){
+
+  if(_nfilters==0) return true;
+
+  for(uint8_t i=0;i<_nfilters;i++)
+  {
+    if((id & _filterMasks[i]) == _filterIds[i]) return true;
+  }
+
+  return false;
+}
+
+//single producer: the frame is copied once, straight into its ring slot
+void OBD2Sniffer::onReceivePacket(int packetSize){
+
+  //the profile sees the whole bus, the filters only limit the capture
+  if(_profiler!=NULL)
+  {
+    CANFrame frame;
+    _can.readFrame(frame);
+    _profiler->record(frame);
+  }
+
+  if(!accept(_can.packetId()))
+  {
+    _filtered++;
+    return;
+  }
+
+  uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+  uint32_t pending = head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+  if(pending >= OBD2_SNIFFER_RING_FRAMES)
+  {
+    _dropped++;
+    return;
+  }
+
+  _can.readFrame(_ring[head & (OBD2_SNIFFER_RING_FRAMES-1)]);
+  __atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+
+  _frames++;
+  if(pending + 1 > _maxPending) _maxPending = pending + 1;
+}
+
+uint32_t OBD2Sniffer::getPending(){
+  return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+}
+
+bool OBD2Sniffer::read(CANFrame& frame){
+
+  uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+  if(tail == __atomic_load_n(&_head, __ATOMIC_ACQUIRE)) return false;
+
+  frame = _ring[tail & (OBD2_SNIFFER_RING_FRAMES-1)];
+  __atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+//candump -L: (seconds.micros) interface id#data, id#R and the dlc when not 0 for rtr, as can-utils
+uint8_t OBD2Sniffer::formatCandump(const CANFrame& frame, uint64_t time, const char* interface, char* line){
+
+  char* p = line;
+
+  *p++ = '(';
+  p = putDecimal(p, (uint32_t)(time / 1000000), 1);
+  *p++ = '.';
+  p = putDecimal(p, (uint32_t)(time % 1000000), 6);
+  *p++ = ')';
+  *p++ = ' ';
+  while(*interface) *p++ = *interface++;
+  *p++ = ' ';
+  p = putHex(p, frame.id, frame.extended ? 8 : 3);
+  *p++ = '#';
+
+  if(frame.rtr)
+  {
+    *p++ = 'R';
+    if(frame.dlc > 0 && frame.dlc <= 8) *p++ = HEX_DIGITS[frame.dlc];
+  }
+  else{
+    for(uint8_t i=0;i<frame.dlc && i<8;i++) p = putHex(p, frame.data[i], 2);
+  }
+
+  *p++ = '\n';
+  return p - line;
+}
+
+//LAWICEL: t/r iii, T/R iiiiiiii, then dlc, data and the timestamp (ms, 0-59999)
+uint8_t OBD2Sniffer::formatSlcan(const CANFrame& frame, char* line){
+
+  char* p = line;
+
+  if(frame.extended)
+  {
+    *p++ = frame.rtr ? 'R' : 'T';
+    p = putHex(p, frame.id, 8);
+  }
+  else{
+    *p++ = frame.rtr ? 'r' : 't';
+    p = putHex(p, frame.id, 3);
+  }
+
+  uint8_t dlc = frame.dlc > 8 ? 8 : frame.dlc;
+  *p++ = HEX_DIGITS[dlc];
+
+  if(!frame.rtr)
+  {
+    for(uint8_t i=0;i<dlc;i++) p = putHex(p, frame.data[i], 2);
+  }
+
+  p = putHex(p, (frame.timestamp / 1000) % 60000, 4);
+  *p++ = '\r';
+  return p - line;
+}
+
+uint8_t OBD2Sniffer::encode(const CANFrame& frame, uint8_t* bytes){
+
+  switch(_format)
+  {
+    case OBD2SnifferFormat::candump:
+      //extended in the consumer, frames are in arrival order
+      if(!_timeStarted)
+      {
+        _time = frame.timestamp;
+        _timeStarted = true;
+      }
+      else{
+        _time += (uint32_t)(frame.timestamp - _lastTimestamp);
+      }
+      _lastTimestamp = frame.timestamp;
+      return formatCandump(frame, _time, _interface, (char*)bytes);
+    case OBD2SnifferFormat::slcan:
+      return formatSlcan(frame, (char*)bytes);
+    default:
+      return OBD2TraceWriter::encodeRecord(frame.timestamp, frame.id, frame.extended, frame.rtr, frame.dlc, frame.data, bytes);
+  }
+}
+
+//false while the output still has not taken the whole line
+bool OBD2Sniffer::writePending(){
+
+  while(_pendingSent < _pendingLength)
+  {
+    size_t n = _out->write(_pending + _pendingSent, _pendingLength - _pendingSent);
+    if(n==0) return false;
+
+    _pendingSent += n;
+    _written += n;
+  }
+
+  _pendingLength = 0;
+  _pendingSent = 0;
+  return true;
+}
+
+uint16_t OBD2Sniffer::process(uint16_t maxFrames){
+
+  //receive work deferred by the interrupt (MCP2515)
+  _can.poll();
+
+  if(_out==NULL) return 0;
+  if(!writePending()) return 0;
+
+  uint16_t written = 0;
+  CANFrame frame;
+
+  while(written < maxFrames && read(frame))
+  {
+    _pendingLength = encode(frame, _pending);
+    written++;
+
+    if(!writePending()) break;
+  }
+
+  return written;
+}
@@ -0,0 +1,115 @@
+/**
+ * Obd2Reader - listen-only bus sniffer
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * OBD2Sniffer starts a controller in listen-only mode (beginObserve(): no ack, no error frames, nothing sent)
+ * and captures every frame from the receive interrupt into a RAM ring with timestamps: a single copy
+ * per frame, never blocking, frames arriving with the ring full are counted as dropped.
+ * process() streams the ring from loop() to any Print (Serial, SD file...) as:
+ *   candump   candump -L log lines, "(1.234567) can0 7E8#0441057B", seconds since boot: canplayer, SavvyCAN...
+ *   slcan     LAWICEL ASCII with the 16 bit millisecond timestamp, "t7E880441057B000000001F40\r"
+ *   binary    OBD2 trace file (OBD2Trace.h): obd2_trace and obd2_decode read it
+ * At 100% load on 500 kbit/s (about 4000 frames/s) the text formats need about 160 KB/s:
+ * a SD card keeps up, a UART does not, use binary there.
+ */
+
+#ifndef Obd2Sniffer_H
+#define Obd2Sniffer_H
+
+#include "OBD2Trace.h"
+#include "OBD2BusProfiler.h"
+
+//frames between the receive interrupt and process(), power of two
+#ifndef OBD2_SNIFFER_RING_FRAMES
+#define OBD2_SNIFFER_RING_FRAMES 512
+#endif
+
+#ifndef OBD2_SNIFFER_MAX_FILTERS
+#define OBD2_SNIFFER_MAX_FILTERS 8
+#endif
+
+//longest text line: candump with an extended id, 8 bytes and a 15 chars interface name
+#define OBD2_SNIFFER_MAX_LINE 64
+
+enum class OBD2SnifferFormat : uint8_t {
+    candump,
+    slcan,
+    binary
+};
+
+class OBD2Sniffer: public CANHandler
+{
+    public:
+        OBD2Sniffer(CANControllerClass& can = CAN);
+
+        //controller started listen-only with the receive callback, false if it refused
+        bool begin(long baudrate = 500E3);
+        void end(); //writes what is buffered, then stops the controller
+
+        //frames pass when (id & mask) == (filter & mask) for any filter, all frames without filters
+        bool addFilter(long id, long mask = OBD2_HEADER_MASK);
+        void clearFilters(){ _nfilters = 0; };
+
+        //nullptr: frames stay in the ring for read()
+        void setOutput(Print* out, OBD2SnifferFormat format = OBD2SnifferFormat::candump);
+        void setInterfaceName(const char* name); //candump interface column, "can0" by default
+        //passive bus profile: every frame, filtered or not, nullptr to stop
+        void setProfiler(OBD2BusProfiler* profiler);
+
+        //loop side: polls the controller and writes up to maxFrames frames, returns frames written
+        uint16_t process(uint16_t maxFrames = OBD2_SNIFFER_RING_FRAMES);
+        //loop side, without output: next buffered frame
+        bool read(CANFrame& frame);
+
+        //receive interrupt side
+        void onReceivePacket(int packetSize) override;
+
+        uint32_t getFrames(){ return _frames; }; //captured
+        uint32_t getDropped(){ return _dropped; }; //ring full
+        uint32_t getFiltered(){ return _filtered; };
+        uint32_t getPending();
+        uint32_t getMaxPending(){ return _maxPending; }; //ring high-water mark, to size OBD2_SNIFFER_RING_FRAMES
+        uint32_t getBytesWritten(){ return _written; };
+
+        //line formats, for writers of their own: return the line length
+        static uint8_t formatCandump(const CANFrame& frame, uint64_t time, const char* interface, char* line);
+        static uint8_t formatSlcan(const CANFrame& frame, char* line);
+
+    private:
+        bool accept(long id);
+        bool writePending();
+        uint8_t encode(const CANFrame& frame, uint8_t* bytes);
+
+        CANControllerClass& _can;
+        Print* _out = nullptr;
+        OBD2BusProfiler* _profiler = nullptr;
+        long _baudrate = 0;
+        OBD2SnifferFormat _format = OBD2SnifferFormat::candump;
+        char _interface[16];
+
+        long _filterIds[OBD2_SNIFFER_MAX_FILTERS];
+        long _filterMasks[OBD2_SNIFFER_MAX_FILTERS];
+        uint8_t _nfilters = 0;
+
+        CANFrame _ring[OBD2_SNIFFER_RING_FRAMES];
+        uint32_t _head = 0; //written by onReceivePacket()
+        uint32_t _tail = 0; //written by process()/read()
+        uint32_t _frames = 0;
+        uint32_t _dropped = 0;
+        uint32_t _filtered = 0;
+        uint32_t _maxPending = 0;
+
+        //record or line the output took only in part, finished first by the next process()
+        uint8_t _pending[OBD2_SNIFFER_MAX_LINE];
+        uint8_t _pendingLength = 0;
+        uint8_t _pendingSent = 0;
+        uint32_t _written = 0;
+
+        //micros() extended to 64 bit for the candump column, from the first frame written
+        uint64_t _time = 0;
+        uint32_t _lastTimestamp = 0;
+        bool _timeStarted = false;
+};
+
+#endif
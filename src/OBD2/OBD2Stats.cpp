@@ -0,0 +1,156 @@
+/**
+ * Obd2Reader - request statistics
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2.h"
+#include "OBD2Stats.h"
+
+void OBD2Stats::reset(){
+  memset(this, 0, sizeof(*this));
+  _request = -1;
+  _ecu = -1;
+}
+
+void OBD2LatencyHistogram::add(uint32_t us){
+
+  uint8_t bucket = 0;
+  while(bucket < OBD2_STATS_BUCKETS-1 && us >= bucketLimit(bucket))
+  {
+    bucket++;
+  }
+
+  if(Buckets[bucket] < 0xFFFF) Buckets[bucket]++;
+
+  if(Count==0 || us < Min) Min = us;
+  if(us > Max) Max = us;
+  Sum += us;
+  Count++;
+}
+
+uint32_t OBD2LatencyHistogram::percentile(uint8_t p) const{
+
+  uint32_t total = 0;
+  for(uint8_t i=0;i<OBD2_STATS_BUCKETS;i++) total += Buckets[i];
+  if(total==0) return 0;
+
+  uint32_t target = (total * p + 99) / 100;
+  uint32_t seen = 0;
+
+  for(uint8_t i=0;i<OBD2_STATS_BUCKETS-1;i++)
+  {
+    seen += Buckets[i];
+    if(seen >= target) return bucketLimit(i) < Max ? bucketLimit(i) : Max;
+  }
+
+  return Max;
+}
+
+int8_t OBD2Stats::entry(OBD2StatsEntry* table, uint8_t& n, uint8_t max, long header, uint8_t service, uint16_t pid){
+
+  for(uint8_t i=0;i<n;i++)
+  {
+    if(table[i].Header==header && table[i].Service==service && table[i].Pid==pid) return i;
+  }
+
+  if(n >= max)
+  {
+    Untracked++;
+    return -1;
+  }
+
+  OBD2StatsEntry& e = table[n];
+  memset(&e, 0, sizeof(e));
+  e.Header = header;
+  e.Service = service;
+  e.Pid = pid;
+
+  return n++;
+}
+
+void OBD2Stats::addLatency(OBD2LatencyHistogram OBD2StatsEntry::* histogram, uint32_t us){
+  if(_request>=0) (Requests[_request].*histogram).add(us);
+  if(_ecu>=0) (Ecus[_ecu].*histogram).add(us);
+}
+
+void OBD2Stats::onSend(long header, uint8_t service, uint16_t pid, uint32_t now){
+
+  _request = entry(Requests, NRequests, OBD2_STATS_MAX_REQUESTS, header, service, pid);
+  _ecu = entry(Ecus, NEcus, OBD2_STATS_MAX_ECUS, header, 0, 0);
+  _sendTime = now;
+  _firstFrame = true;
+  _waitingFlowControl = false;
+
+  if(_request>=0) Requests[_request].Outcomes.Sent++;
+  if(_ecu>=0) Ecus[_ecu].Outcomes.Sent++;
+}
+
+void OBD2Stats::onFirstFrame(uint32_t now){
+
+  if(!_firstFrame) return;
+
+  _firstFrame = false;
+  addLatency(&OBD2StatsEntry::FirstFrame, now - _sendTime);
+}
+
+void OBD2Stats::onFlowControl(uint32_t now){
+  _flowControlTime = now;
+  _waitingFlowControl = true;
+}
+
+void OBD2Stats::onConsecutiveFrame(uint32_t now){
+
+  if(!_waitingFlowControl) return;
+
+  _waitingFlowControl = false;
+  addLatency(&OBD2StatsEntry::FlowControl, now - _flowControlTime);
+}
+
+void OBD2Stats::onComplete(uint32_t now){
+  addLatency(&OBD2StatsEntry::Complete, now - _sendTime);
+}
+
+void OBD2Stats::onOutcome(OBD2StatusType outcome){
+
+  OBD2OutcomeCounters* counters[2] = {
+    _request>=0 ? &Requests[_request].Outcomes : NULL,
+    _ecu>=0 ? &Ecus[_ecu].Outcomes : NULL
+  };
+
+  for(uint8_t i=0;i<2;i++)
+  {
+    if(counters[i]==NULL) continue;
+
+    switch(outcome)
+    {
+      case OBD2StatusType::received: counters[i]->Received++; break;
+      case OBD2StatusType::timeout: counters[i]->Timeout++; break;
+      case OBD2StatusType::nodata: counters[i]->NoData++; break;
+      default: counters[i]->Error++; break;
+    }
+  }
+
+  _request = -1;
+  _ecu = -1;
+}
+
+const OBD2StatsEntry* OBD2Stats::findRequest(long header, uint8_t service, uint16_t pid) const{
+
+  for(uint8_t i=0;i<NRequests;i++)
+  {
+    if(Requests[i].Header==header && Requests[i].Service==service && Requests[i].Pid==pid) return &Requests[i];
+  }
+
+  return NULL;
+}
+
+const OBD2StatsEntry* OBD2Stats::findEcu(long header) const{
+
+  for(uint8_t i=0;i<NEcus;i++)
+  {
+    if(Ecus[i].Header==header) return &Ecus[i];
+  }
+
+  return NULL;
+}
@@ -0,0 +1,105 @@
+/**
+ * Obd2Reader - request statistics
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Latency histograms and outcome counters per request and per ECU.
+ * Enabled with build flag -DOBD2_STATS=1 (it changes OBD2 layout: set it for the whole build,
+ * not with a #define in the sketch). When disabled nothing is compiled in.
+ */
+
+#ifndef Obd2Stats_H
+#define Obd2Stats_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef OBD2_STATS
+#define OBD2_STATS 0
+#endif
+
+//used inside OBD2 members, expands to nothing when disabled. Writes go through the OBD2 sequence lock:
+//the receive interrupt records frames while loop() copies the stats with getStats()
+#if OBD2_STATS
+#define OBD2_STATS_RECORD(call) do { beginStatsWrite(); _stats.call; endStatsWrite(); } while(0)
+#else
+#define OBD2_STATS_RECORD(call)
+#endif
+
+enum class OBD2StatusType;
+
+#define OBD2_STATS_MAX_REQUESTS 16
+#define OBD2_STATS_MAX_ECUS 4
+
+//getStats() gives up after this many torn copies
+#define OBD2_STATS_READ_RETRIES 16
+
+//bucket i counts latencies below 256us << i, last bucket is overflow (>= ~1s)
+#define OBD2_STATS_BUCKETS 14
+#define OBD2_STATS_FIRST_BUCKET_US 256UL
+
+struct OBD2LatencyHistogram {
+    uint16_t Buckets[OBD2_STATS_BUCKETS]; //saturating
+    uint32_t Count;
+    uint32_t Min;
+    uint32_t Max;
+    uint32_t Sum; //us, wraps after ~71 minutes of accumulated latency
+
+    void add(uint32_t us);
+    uint32_t mean() const { return Count ? Sum / Count : 0; };
+    uint32_t percentile(uint8_t p) const; //upper bound of bucket holding percentile p
+    static uint32_t bucketLimit(uint8_t bucket){ return OBD2_STATS_FIRST_BUCKET_US << bucket; };
+};
+
+struct OBD2OutcomeCounters {
+    uint32_t Sent;
+    uint32_t Received;
+    uint32_t Timeout;
+    uint32_t NoData;
+    uint32_t Error;
+};
+
+struct OBD2StatsEntry {
+    long Header; //request header or ecu-id
+    uint8_t Service; //0 for ecu entries
+    uint16_t Pid;
+    OBD2OutcomeCounters Outcomes;
+    OBD2LatencyHistogram FirstFrame; //send -> first frame (PCI 0x10) of a multi-frame response, any response on ELM
+    OBD2LatencyHistogram Complete; //send -> response complete
+    OBD2LatencyHistogram FlowControl; //flow control sent -> next consecutive frame (PCI 0x2N)
+};
+
+struct OBD2Stats {
+    OBD2StatsEntry Requests[OBD2_STATS_MAX_REQUESTS];
+    uint8_t NRequests;
+    OBD2StatsEntry Ecus[OBD2_STATS_MAX_ECUS];
+    uint8_t NEcus;
+    uint32_t Untracked; //events of requests or ecus not fitting the tables
+
+    void reset();
+
+    //recording, called by OBD2
+    void onSend(long header, uint8_t service, uint16_t pid, uint32_t now);
+    void onFirstFrame(uint32_t now);
+    void onFlowControl(uint32_t now);
+    void onConsecutiveFrame(uint32_t now);
+    void onComplete(uint32_t now);
+    void onOutcome(OBD2StatusType outcome);
+
+    const OBD2StatsEntry* findRequest(long header, uint8_t service, uint16_t pid) const;
+    const OBD2StatsEntry* findEcu(long header) const;
+
+  private:
+    int8_t entry(OBD2StatsEntry* table, uint8_t& n, uint8_t max, long header, uint8_t service, uint16_t pid);
+    void addLatency(OBD2LatencyHistogram OBD2StatsEntry::* histogram, uint32_t us);
+
+    //in-flight request, -1 when untracked
+    int8_t _request;
+    int8_t _ecu;
+    uint32_t _sendTime;
+    uint32_t _flowControlTime;
+    bool _firstFrame;
+    bool _waitingFlowControl;
+};
+
+#endif
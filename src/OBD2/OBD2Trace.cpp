@@ -0,0 +1,271 @@
+/**
+ * Obd2Reader - CAN trace capture and replay
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2Trace.h"
+
+static void putUint32(uint8_t* bytes, uint32_t value){
+  bytes[0] = value;
+  bytes[1] = value >> 8;
+  bytes[2] = value >> 16;
+  bytes[3] = value >> 24;
+}
+
+static uint32_t getUint32(const uint8_t* bytes){
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+OBD2TraceWriter::OBD2TraceWriter(){
+  static_assert((OBD2_TRACE_BUFFER_SIZE & (OBD2_TRACE_BUFFER_SIZE-1)) == 0, "OBD2_TRACE_BUFFER_SIZE must be a power of two");
+}
+
+void OBD2TraceWriter::begin(Print& out){
+
+  begin();
+  _out = &out;
+
+  uint8_t header[OBD2_TRACE_HEADER_SIZE];
+  encodeHeader(header);
+  push(header, sizeof(header));
+}
+
+void OBD2TraceWriter::begin(){
+
+  _out = nullptr;
+  _head = 0;
+  _tail = 0;
+  _frames = 0;
+  _dropped = 0;
+  _written = 0;
+  _active = true;
+}
+
+uint32_t OBD2TraceWriter::getPending(){
+  return __atomic_load_n(&_head, __ATOMIC_ACQUIRE) - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+}
+
+//whole record or nothing, the reader never sees half of it
+bool OBD2TraceWriter::push(const uint8_t* bytes, uint8_t length){
+
+  uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+  uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+  if(OBD2_TRACE_BUFFER_SIZE - (head - tail) < length) return false;
+
+  for(uint8_t i=0;i<length;i++)
+  {
+    _buffer[(head + i) & (OBD2_TRACE_BUFFER_SIZE-1)] = bytes[i];
+  }
+
+  __atomic_store_n(&_head, head + length, __ATOMIC_RELEASE);
+  return true;
+}
+
+uint8_t OBD2TraceWriter::encodeRecord(uint32_t timestamp, long id, bool extended, bool rtr, uint8_t dlc, const uint8_t* data, uint8_t* bytes){
+
+  if(dlc > 8) dlc = 8;
+
+  putUint32(bytes, timestamp);
+  putUint32(bytes + 4, ((uint32_t)id & OBD2_HEADER_MASK) | (extended ? OBD2_TRACE_EXTENDED_FLAG : 0) | (rtr ? OBD2_TRACE_RTR_FLAG : 0));
+  bytes[8] = dlc;
+
+  uint8_t length = 9;
+  if(!rtr)
+  {
+    memcpy(bytes + 9, data, dlc);
+    length += dlc;
+  }
+
+  return length;
+}
+
+void OBD2TraceWriter::encodeHeader(uint8_t* bytes){
+
+  const uint8_t header[OBD2_TRACE_HEADER_SIZE] = { 'O', '2', 'T', 'R', OBD2_TRACE_VERSION, 0, 0, 0 };
+  memcpy(bytes, header, sizeof(header));
+}
+
+bool OBD2TraceWriter::record(uint32_t timestamp, long id, bool extended, bool rtr, uint8_t dlc, const uint8_t* data){
+
+  if(!_active) return false;
+
+  uint8_t bytes[OBD2_TRACE_MAX_RECORD_SIZE];
+  uint8_t length = encodeRecord(timestamp, id, extended, rtr, dlc, data, bytes);
+
+  if(!push(bytes, length))
+  {
+    _dropped++;
+    return false;
+  }
+
+  _frames++;
+  return true;
+}
+
+size_t OBD2TraceWriter::flush(size_t maxBytes){
+
+  if(_out==NULL) return 0;
+
+  size_t total = 0;
+
+  //at most two chunks: up to the end of the buffer, then from the start
+  while(total < maxBytes)
+  {
+    uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    if(head == tail) break;
+
+    uint32_t offset = tail & (OBD2_TRACE_BUFFER_SIZE-1);
+    size_t chunk = std::min((size_t)(head - tail), (size_t)(OBD2_TRACE_BUFFER_SIZE - offset));
+    chunk = std::min(chunk, maxBytes - total);
+
+    size_t n = _out->write(_buffer + offset, chunk);
+
+    __atomic_store_n(&_tail, tail + (uint32_t)n, __ATOMIC_RELEASE);
+    total += n;
+    _written += n;
+
+    //sink full (card full, partition end): keep the rest buffered
+    if(n < chunk) break;
+  }
+
+  return total;
+}
+
+void OBD2TraceWriter::end(){
+
+  while(getPending() > 0 && flush() > 0);
+  _out = nullptr;
+  _active = false;
+}
+
+//record() only publishes whole records, a non empty buffer starts with one
+bool OBD2TraceWriter::read(OBD2TraceFrame& frame){
+
+  uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+  uint32_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+  if(head == tail) return false;
+
+  uint8_t bytes[OBD2_TRACE_MAX_RECORD_SIZE];
+  for(uint8_t i=0;i<9;i++) bytes[i] = peekByte(tail + i);
+
+  uint32_t id = getUint32(bytes + 4);
+
+  frame.Timestamp = getUint32(bytes);
+  frame.Extended = (id & OBD2_TRACE_EXTENDED_FLAG) != 0;
+  frame.Rtr = (id & OBD2_TRACE_RTR_FLAG) != 0;
+  frame.Id = id & OBD2_HEADER_MASK;
+  frame.Dlc = bytes[8];
+
+  uint8_t length = 9;
+  memset(frame.Data, 0, sizeof(frame.Data));
+  if(!frame.Rtr)
+  {
+    for(uint8_t i=0;i<frame.Dlc;i++) frame.Data[i] = peekByte(tail + 9 + i);
+    length += frame.Dlc;
+  }
+
+  __atomic_store_n(&_tail, tail + length, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool OBD2TraceReader::readBytes(uint8_t* bytes, uint8_t length){
+
+  for(uint8_t i=0;i<length;i++)
+  {
+    int c = _in.read();
+    if(c < 0) return false;
+    bytes[i] = c;
+  }
+
+  return true;
+}
+
+bool OBD2TraceReader::begin(){
+
+  uint8_t header[OBD2_TRACE_HEADER_SIZE];
+  if(!readBytes(header, sizeof(header))) return false;
+
+  return memcmp(header, "O2TR", 4)==0 && header[4]==OBD2_TRACE_VERSION;
+}
+
+bool OBD2TraceReader::next(OBD2TraceFrame& frame){
+
+  uint8_t bytes[9];
+  if(!readBytes(bytes, sizeof(bytes))) return false;
+
+  uint32_t id = getUint32(bytes + 4);
+
+  frame.Timestamp = getUint32(bytes);
+  frame.Extended = (id & OBD2_TRACE_EXTENDED_FLAG) != 0;
+  frame.Rtr = (id & OBD2_TRACE_RTR_FLAG) != 0;
+  frame.Id = id & OBD2_HEADER_MASK;
+  frame.Dlc = bytes[8] > 8 ? 8 : bytes[8];
+
+  memset(frame.Data, 0, sizeof(frame.Data));
+  return frame.Rtr || readBytes(frame.Data, frame.Dlc);
+}
+
+bool OBD2TraceReplay::begin(){
+
+  _frames = 0;
+  _traceTime = 0;
+  _elapsed = 0;
+  _lastMicros = micros();
+
+  if(!_reader.begin()) return false;
+
+  _hasNext = _reader.next(_next);
+  _lastTimestamp = _next.Timestamp;
+
+  return true;
+}
+
+//as the receive interrupt does: frame in the controller, then the handler.
+//the recorded arrival time goes along, so a trace replayed at any speed keeps its frame spacing
+void OBD2TraceReplay::deliver(const OBD2TraceFrame& frame){
+
+  CANFrame packet = {};
+  packet.id = frame.Id;
+  packet.extended = frame.Extended;
+  packet.rtr = frame.Rtr;
+  packet.dlc = frame.Dlc;
+  packet.timestamp = frame.Timestamp;
+  memcpy(packet.data, frame.Data, sizeof(packet.data));
+
+  int size = _obd2.getController().injectPacket(packet);
+  _obd2.onReceivePacket(size);
+  _frames++;
+}
+
+int OBD2TraceReplay::process(){
+
+  if(!_hasNext) return -1;
+
+  uint32_t now = micros();
+  _elapsed += now - _lastMicros;
+  _lastMicros = now;
+
+  int delivered = 0;
+
+  while(_hasNext)
+  {
+    uint64_t traceTime = _traceTime + (uint32_t)(_next.Timestamp - _lastTimestamp);
+
+    if(_speed > 0 && traceTime > _elapsed * _speed) break;
+
+    _traceTime = traceTime;
+    _lastTimestamp = _next.Timestamp;
+
+    deliver(_next);
+    delivered++;
+
+    _hasNext = _reader.next(_next);
+
+    if(_speed <= 0) break;
+  }
+
+  return delivered;
+}
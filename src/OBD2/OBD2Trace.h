@@ -0,0 +1,126 @@
+/**
+ * Obd2Reader - CAN trace capture and replay
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * OBD2TraceWriter records every frame reaching OBD2::onReceivePacket() into a bounded ring buffer
+ * (interrupt side, never blocks) and streams it to any Print (SD file, flash partition...) from loop().
+ * OBD2TraceReplay feeds a recorded trace back through onReceivePacket(), in real time or as fast as possible.
+ *
+ * File layout, little endian:
+ *   header  "O2TR", version, 3 reserved bytes
+ *   record  uint32 timestamp (micros), uint32 id (bit 31 extended, bit 30 rtr), uint8 dlc, dlc data bytes (none for rtr)
+ */
+
+#ifndef Obd2Trace_H
+#define Obd2Trace_H
+
+#include "OBD2.h"
+
+//ring buffer between the receive interrupt and flush(), power of two
+#ifndef OBD2_TRACE_BUFFER_SIZE
+#define OBD2_TRACE_BUFFER_SIZE 4096
+#endif
+
+#define OBD2_TRACE_VERSION 1
+#define OBD2_TRACE_HEADER_SIZE 8
+#define OBD2_TRACE_MAX_RECORD_SIZE 17
+
+#define OBD2_TRACE_EXTENDED_FLAG 0x80000000UL
+#define OBD2_TRACE_RTR_FLAG      0x40000000UL
+
+struct OBD2TraceFrame {
+    uint32_t Timestamp; //micros() at reception, wraps after ~71 minutes
+    long Id;
+    bool Extended;
+    bool Rtr;
+    uint8_t Dlc;
+    uint8_t Data[8];
+};
+
+class OBD2TraceWriter
+{
+    public:
+        OBD2TraceWriter();
+
+        void begin(Print& out); //queues the file header
+        void begin(); //queue only: records are taken with read() (OBD2TraceEncoder)
+        //receive side, single producer: false (and counted) when the buffer is full
+        bool record(uint32_t timestamp, long id, bool extended, bool rtr, uint8_t dlc, const uint8_t* data);
+        bool record(const OBD2TraceFrame& frame){ return record(frame.Timestamp, frame.Id, frame.Extended, frame.Rtr, frame.Dlc, frame.Data); };
+        //loop side: writes up to maxBytes of buffered records, returns bytes written
+        size_t flush(size_t maxBytes = OBD2_TRACE_BUFFER_SIZE);
+        void end(); //flush everything and detach
+        //loop side, queue only: next buffered record
+        bool read(OBD2TraceFrame& frame);
+
+        uint32_t getFrames(){ return _frames; };
+        uint32_t getDropped(){ return _dropped; };
+        uint32_t getBytesWritten(){ return _written; };
+        uint32_t getPending();
+
+        //file format, for writers of their own (OBD2TriggerCapture): returns the record length
+        static uint8_t encodeRecord(uint32_t timestamp, long id, bool extended, bool rtr, uint8_t dlc, const uint8_t* data, uint8_t* bytes);
+        static uint8_t encodeRecord(const OBD2TraceFrame& frame, uint8_t* bytes){ return encodeRecord(frame.Timestamp, frame.Id, frame.Extended, frame.Rtr, frame.Dlc, frame.Data, bytes); };
+        static void encodeHeader(uint8_t* bytes);
+
+    private:
+        bool push(const uint8_t* bytes, uint8_t length);
+        uint8_t peekByte(uint32_t offset){ return _buffer[offset & (OBD2_TRACE_BUFFER_SIZE-1)]; };
+
+        bool _active = false;
+        Print* _out = nullptr;
+        uint8_t _buffer[OBD2_TRACE_BUFFER_SIZE];
+        uint32_t _head = 0; //written by record()
+        uint32_t _tail = 0; //written by flush()
+        uint32_t _frames = 0;
+        uint32_t _dropped = 0;
+        uint32_t _written = 0;
+};
+
+class OBD2TraceReader
+{
+    public:
+        OBD2TraceReader(Stream& in) : _in(in) {};
+
+        bool begin(); //false if the header is missing or of another version
+        bool next(OBD2TraceFrame& frame); //false at the end (or on a truncated record)
+
+    private:
+        bool readBytes(uint8_t* bytes, uint8_t length);
+
+        Stream& _in;
+};
+
+class OBD2TraceReplay
+{
+    public:
+        OBD2TraceReplay(OBD2& obd2, Stream& in) : _obd2(obd2), _reader(in) {};
+
+        bool begin();
+        //1.0 recorded pace, 2.0 twice as fast, 0 as fast as possible (one frame per process() call)
+        void setSpeed(float speed){ _speed = speed; };
+        //delivers the frames due through CAN and onReceivePacket(), call it next to OBD2::process().
+        //Returns frames delivered, -1 when the trace is over
+        int process();
+
+        uint32_t getFrames(){ return _frames; };
+        uint64_t getTraceTime(){ return _traceTime; }; //recorded us replayed so far
+
+    private:
+        OBD2& _obd2;
+        OBD2TraceReader _reader;
+        OBD2TraceFrame _next;
+        bool _hasNext = false;
+        float _speed = 1.0;
+        //both clocks accumulate 32 bit deltas, traces may be longer than the micros() wrap
+        uint64_t _traceTime = 0;
+        uint32_t _lastTimestamp = 0;
+        uint64_t _elapsed = 0;
+        uint32_t _lastMicros = 0;
+        uint32_t _frames = 0;
+
+        void deliver(const OBD2TraceFrame& frame);
+};
+
+#endif
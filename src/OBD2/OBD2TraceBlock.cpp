@@ -0,0 +1,681 @@
+/**
+ * Obd2Reader - compressed block traces
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2TraceBlock.h"
+
+#define OBD2_TRACE_TAG_LITERAL  63
+#define OBD2_TRACE_KIND_MASK    0xC0
+#define OBD2_TRACE_KIND_SAME    0x00
+#define OBD2_TRACE_KIND_BYTE    0x40
+#define OBD2_TRACE_KIND_CHANGED 0x80
+#define OBD2_TRACE_KIND_CONTROL 0xC0
+
+#define OBD2_TRACE_CONTROL_SLOT 0x07
+#define OBD2_TRACE_CONTROL_DLC  0x08
+#define OBD2_TRACE_CONTROL_RTR  0x10
+#define OBD2_TRACE_CONTROL_MASK 0x20
+
+//a periodic id arrives within this many us of its predicted time
+#define OBD2_TRACE_PERIOD_JITTER 64
+
+uint64_t OBD2TraceFormat::getUint64(const uint8_t* bytes){
+  return (uint64_t)getUint32(bytes) | ((uint64_t)getUint32(bytes + 4) << 32);
+}
+
+uint32_t OBD2TraceFormat::getUint32(const uint8_t* bytes){
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+void OBD2TraceFormat::putUint64(uint8_t* bytes, uint64_t value){
+  putUint32(bytes, (uint32_t)value);
+  putUint32(bytes + 4, (uint32_t)(value >> 32));
+}
+
+void OBD2TraceFormat::putUint32(uint8_t* bytes, uint32_t value){
+  bytes[0] = value;
+  bytes[1] = value >> 8;
+  bytes[2] = value >> 16;
+  bytes[3] = value >> 24;
+}
+
+#if OBD2_HOST
+//workstation decoders read whole logs: byte table, built once
+struct OBD2TraceCrcTable {
+  uint32_t Entries[256];
+
+  OBD2TraceCrcTable(){
+    for(uint32_t i=0;i<256;i++)
+    {
+      uint32_t crc = i;
+      for(uint8_t b=0;b<8;b++) crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320UL : 0);
+      Entries[i] = crc;
+    }
+  }
+};
+
+uint32_t OBD2TraceFormat::crc32(const uint8_t* bytes, size_t length, uint32_t crc){
+
+  static const OBD2TraceCrcTable table;
+
+  crc = ~crc;
+  for(size_t i=0;i<length;i++)
+  {
+    crc = table.Entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+#else
+//crc32 (ieee, reflected), nibble table: 64 bytes of flash
+uint32_t OBD2TraceFormat::crc32(const uint8_t* bytes, size_t length, uint32_t crc){
+
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+
+  crc = ~crc;
+  for(size_t i=0;i<length;i++)
+  {
+    crc = table[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+    crc = table[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+
+  return ~crc;
+}
+#endif
+
+//three bits out of 128 per id
+static uint32_t bloomHash(long id, bool extended){
+  uint32_t h = ((uint32_t)id & OBD2_HEADER_MASK) | (extended ? 0x80000000UL : 0);
+  h ^= h >> 16;
+  h *= 0x85EBCA6B;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35;
+  h ^= h >> 16;
+  return h;
+}
+
+void OBD2TraceFormat::bloomAdd(uint8_t* bloom, long id, bool extended){
+
+  uint32_t h = bloomHash(id, extended);
+  for(uint8_t k=0;k<3;k++)
+  {
+    uint8_t bit = (h >> (k*7)) & 0x7F;
+    bloom[bit >> 3] |= 1 << (bit & 7);
+  }
+}
+
+bool OBD2TraceFormat::bloomTest(const uint8_t* bloom, long id, bool extended){
+
+  uint32_t h = bloomHash(id, extended);
+  for(uint8_t k=0;k<3;k++)
+  {
+    uint8_t bit = (h >> (k*7)) & 0x7F;
+    if(!(bloom[bit >> 3] & (1 << (bit & 7)))) return false;
+  }
+
+  return true;
+}
+
+bool OBD2TraceBlockHeader::mayContain(long id, bool extended) const{
+  return OBD2TraceFormat::bloomTest(Bloom, id, extended);
+}
+
+bool OBD2TraceIndexEntry::mayContain(long id, bool extended) const{
+  return OBD2TraceFormat::bloomTest(Bloom, id, extended);
+}
+
+bool OBD2TraceFormat::parseHeader(const uint8_t* bytes, OBD2TraceBlockHeader& header){
+
+  if(memcmp(bytes, "O2BK", 4)!=0) return false;
+
+  header.Length = bytes[4] | (bytes[5] << 8);
+  header.Frames = bytes[6] | (bytes[7] << 8);
+  header.Time = getUint64(bytes + 8);
+  header.Duration = getUint32(bytes + 16);
+  memcpy(header.Bloom, bytes + 20, OBD2_TRACE_BLOOM_SIZE);
+  header.Sequence = getUint32(bytes + 36);
+  header.Crc = getUint32(bytes + 40);
+
+  return header.Length <= OBD2_TRACE_BLOCK_SIZE;
+}
+
+void OBD2TraceFormat::writeHeader(uint8_t* bytes, const OBD2TraceBlockHeader& header){
+
+  memcpy(bytes, "O2BK", 4);
+  bytes[4] = header.Length;
+  bytes[5] = header.Length >> 8;
+  bytes[6] = header.Frames;
+  bytes[7] = header.Frames >> 8;
+  putUint64(bytes + 8, header.Time);
+  putUint32(bytes + 16, header.Duration);
+  memcpy(bytes + 20, header.Bloom, OBD2_TRACE_BLOOM_SIZE);
+  putUint32(bytes + 36, header.Sequence);
+  putUint32(bytes + 40, header.Crc);
+}
+
+void OBD2TraceFormat::parseIndexEntry(const uint8_t* bytes, OBD2TraceIndexEntry& entry){
+
+  entry.Offset = getUint64(bytes);
+  entry.FirstTime = getUint64(bytes + 8);
+  entry.LastTime = getUint64(bytes + 16);
+  entry.FirstBlock = getUint32(bytes + 24);
+  entry.Blocks = getUint32(bytes + 28);
+  memcpy(entry.Bloom, bytes + 32, OBD2_TRACE_BLOOM_SIZE);
+}
+
+void OBD2TraceFormat::writeIndexEntry(uint8_t* bytes, const OBD2TraceIndexEntry& entry){
+
+  putUint64(bytes, entry.Offset);
+  putUint64(bytes + 8, entry.FirstTime);
+  putUint64(bytes + 16, entry.LastTime);
+  putUint32(bytes + 24, entry.FirstBlock);
+  putUint32(bytes + 28, entry.Blocks);
+  memcpy(bytes + 32, entry.Bloom, OBD2_TRACE_BLOOM_SIZE);
+}
+
+int OBD2TraceDictionary::find(long id, bool extended) const{
+
+  for(uint8_t i=0;i<Count;i++)
+  {
+    if(Ids[i]==id && Extended[i]==extended) return i;
+  }
+
+  return -1;
+}
+
+int OBD2TraceDictionary::add(long id, bool extended){
+
+  if(Count >= OBD2_TRACE_DICTIONARY_SIZE) return -1;
+
+  Ids[Count] = id;
+  Extended[Count] = extended;
+  Payloads[Count] = 0;
+  Position[Count] = -1;
+  Seen[Count] = 0;
+  Periodic[Count] = false;
+
+  return Count++;
+}
+
+bool OBD2TraceDictionary::reference(int entry, uint8_t slot, uint8_t& dlc, const uint8_t*& data) const{
+
+  static const uint8_t empty[8] = { 0 };
+
+  if(entry < 0 || Payloads[entry]==0)
+  {
+    dlc = 0;
+    data = empty;
+    return slot==0;
+  }
+
+  if(slot >= Payloads[entry]) return false;
+
+  dlc = Dlc[entry][slot];
+  data = Data[entry][slot];
+  return true;
+}
+
+void OBD2TraceDictionary::remember(int entry, uint8_t dlc, const uint8_t* data, uint8_t mask){
+
+  if(entry < 0) return;
+
+  if(mask!=0 && (mask & (mask - 1))==0)
+  {
+    int8_t position = 0;
+    while(!(mask & (1 << position))) position++;
+    Position[entry] = position;
+  }
+
+  //move to front: an older copy, or the oldest payload when the history is full, makes room
+  uint8_t slot = 0;
+  while(slot < Payloads[entry] && (Dlc[entry][slot]!=dlc || memcmp(Data[entry][slot], data, 8)!=0)) slot++;
+
+  if(slot == Payloads[entry])
+  {
+    if(Payloads[entry] < OBD2_TRACE_HISTORY) Payloads[entry]++;
+    else slot--;
+  }
+
+  for(;slot>0;slot--)
+  {
+    Dlc[entry][slot] = Dlc[entry][slot-1];
+    memcpy(Data[entry][slot], Data[entry][slot-1], 8);
+  }
+
+  Dlc[entry][0] = dlc;
+  memcpy(Data[entry][0], data, 8);
+}
+
+//periodic: the last arrival matched the prediction of the one before
+void OBD2TraceDictionary::arrived(int entry, uint64_t time){
+
+  if(entry < 0) return;
+
+  if(Seen[entry] >= 2)
+  {
+    int64_t error = (int64_t)(time - predict(entry));
+    Periodic[entry] = error >= -OBD2_TRACE_PERIOD_JITTER && error < OBD2_TRACE_PERIOD_JITTER;
+  }
+
+  if(Seen[entry] >= 1) Interval[entry] = time - LastTime[entry];
+  if(Seen[entry] < 2) Seen[entry]++;
+
+  LastTime[entry] = time;
+}
+
+//encoder
+
+void OBD2TraceEncoder::begin(Print& out){
+
+  _out = &out;
+  _offset = 0;
+  _failed = false;
+  _length = 0;
+  _sequence = 0;
+  _started = false;
+  _indexCount = 0;
+  _blocksPerEntry = 1;
+  _frames = 0;
+  _rawBytes = OBD2_TRACE_HEADER_SIZE;
+  _dictionary.clear();
+
+  const uint8_t header[OBD2_TRACE_HEADER_SIZE] = { 'O', '2', 'T', 'C', OBD2_TRACE_BLOCK_VERSION, 0, 0, 0 };
+  write(header, sizeof(header));
+}
+
+bool OBD2TraceEncoder::write(const uint8_t* bytes, size_t length){
+
+  size_t n = _out->write(bytes, length);
+  _offset += n;
+
+  if(n < length) _failed = true;
+  return n == length;
+}
+
+void OBD2TraceEncoder::putVarint(uint64_t value){
+
+  while(value >= 0x80)
+  {
+    _payload[_length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+
+  _payload[_length++] = (uint8_t)value;
+}
+
+bool OBD2TraceEncoder::encode(const OBD2TraceFrame& frame){
+
+  if(_out==NULL) return false;
+
+  bool written = true;
+
+  if(_length + OBD2_TRACE_MAX_ENCODED_FRAME > OBD2_TRACE_BLOCK_SIZE) written = closeBlock();
+
+  //64 bit time from 32 bit micros deltas
+  if(!_started)
+  {
+    _time = frame.Timestamp;
+    _started = true;
+  }
+  else{
+    _time += (uint32_t)(frame.Timestamp - _lastTimestamp);
+  }
+  _lastTimestamp = frame.Timestamp;
+
+  bool first = _length==0;
+  if(first)
+  {
+    memset(&_header, 0, sizeof(_header));
+    _header.Time = _time;
+    _header.Sequence = _sequence;
+    _dictionary.clear();
+  }
+
+  uint8_t dlc = frame.Dlc > 8 ? 8 : frame.Dlc;
+  int entry = _dictionary.find(frame.Id, frame.Extended);
+  bool literal = entry < 0;
+  if(literal) entry = _dictionary.add(frame.Id, frame.Extended);
+
+  uint8_t data[8] = { 0 };
+  if(!frame.Rtr) memcpy(data, frame.Data, dlc);
+
+  uint8_t kind = OBD2_TRACE_KIND_CONTROL;
+  uint8_t control = OBD2_TRACE_CONTROL_DLC | OBD2_TRACE_CONTROL_RTR;
+  uint8_t mask = 0;
+
+  //cheapest reference in the history of this id
+  uint8_t cost = 0xFF;
+  for(uint8_t slot=0;slot<OBD2_TRACE_HISTORY && !frame.Rtr;slot++)
+  {
+    uint8_t referenceDlc;
+    const uint8_t* reference;
+    if(!_dictionary.reference(entry, slot, referenceDlc, reference)) break;
+
+    uint8_t changedMask = 0, changed = 0;
+    for(uint8_t i=0;i<dlc;i++)
+    {
+      if(data[i]!=reference[i])
+      {
+        changedMask |= 1 << i;
+        changed++;
+      }
+    }
+
+    uint8_t slotKind, slotCost;
+    if(slot==0 && referenceDlc==dlc)
+    {
+      if(changed==0)
+      {
+        slotKind = OBD2_TRACE_KIND_SAME;
+        slotCost = 0;
+      }
+      else if(changed==1 && entry >= 0 && _dictionary.Position[entry] >= 0 && changedMask==(1 << _dictionary.Position[entry]))
+      {
+        slotKind = OBD2_TRACE_KIND_BYTE;
+        slotCost = 1;
+      }
+      else{
+        slotKind = OBD2_TRACE_KIND_CHANGED;
+        slotCost = 1 + changed;
+      }
+    }
+    else{
+      slotKind = OBD2_TRACE_KIND_CONTROL;
+      slotCost = 1 + (referenceDlc!=dlc ? 1 : 0) + (changed ? 1 + changed : 0);
+    }
+
+    if(slotCost < cost)
+    {
+      cost = slotCost;
+      kind = slotKind;
+      mask = changedMask;
+      control = slot | (referenceDlc!=dlc ? OBD2_TRACE_CONTROL_DLC : 0) | (changed ? OBD2_TRACE_CONTROL_MASK : 0);
+    }
+  }
+
+  _payload[_length++] = (literal ? OBD2_TRACE_TAG_LITERAL : entry) | kind;
+  if(literal) putVarint(((uint64_t)((uint32_t)frame.Id & OBD2_HEADER_MASK) << 1) | (frame.Extended ? 1 : 0));
+
+  if(first)
+  {
+    putVarint(0);
+  }
+  else if(_dictionary.periodic(entry))
+  {
+    int64_t error = (int64_t)(_time - _dictionary.predict(entry));
+    putVarint(((uint64_t)error << 1) ^ (uint64_t)(error >> 63));
+  }
+  else{
+    putVarint(_time - _blockLastTime);
+  }
+  _blockLastTime = _time;
+
+  if(kind==OBD2_TRACE_KIND_CONTROL)
+  {
+    _payload[_length++] = control;
+    if(control & OBD2_TRACE_CONTROL_DLC) _payload[_length++] = dlc;
+  }
+
+  if(kind==OBD2_TRACE_KIND_BYTE) _payload[_length++] = data[_dictionary.Position[entry]];
+
+  if(kind==OBD2_TRACE_KIND_CHANGED || (kind==OBD2_TRACE_KIND_CONTROL && (control & OBD2_TRACE_CONTROL_MASK)))
+  {
+    _payload[_length++] = mask;
+    for(uint8_t i=0;i<dlc;i++)
+    {
+      if(mask & (1 << i)) _payload[_length++] = data[i];
+    }
+  }
+
+  if(!frame.Rtr) _dictionary.remember(entry, dlc, data, mask);
+  _dictionary.arrived(entry, _time);
+
+  OBD2TraceFormat::bloomAdd(_header.Bloom, frame.Id, frame.Extended);
+  _header.Frames++;
+  _header.Duration = _time - _header.Time;
+
+  _frames++;
+  _rawBytes += 9 + (frame.Rtr ? 0 : dlc);
+
+  return written;
+}
+
+uint16_t OBD2TraceEncoder::flush(OBD2TraceWriter& source, uint16_t maxFrames){
+
+  OBD2TraceFrame frame;
+  uint16_t n = 0;
+
+  while(n < maxFrames && source.read(frame))
+  {
+    encode(frame);
+    n++;
+  }
+
+  return n;
+}
+
+bool OBD2TraceEncoder::closeBlock(){
+
+  if(_out==NULL || _length==0) return true;
+
+  _header.Length = _length;
+
+  uint8_t bytes[OBD2_TRACE_BLOCK_HEADER_SIZE];
+  OBD2TraceFormat::writeHeader(bytes, _header);
+  _header.Crc = OBD2TraceFormat::crc32(_payload, _length, OBD2TraceFormat::crc32(bytes, OBD2_TRACE_BLOCK_HEADER_SIZE-4));
+  OBD2TraceFormat::writeHeader(bytes, _header);
+
+  uint64_t offset = _offset;
+  bool written = write(bytes, sizeof(bytes)) && write(_payload, _length);
+
+  indexBlock(_header, offset);
+
+  _sequence++;
+  _length = 0;
+
+  return written;
+}
+
+//one entry per _blocksPerEntry blocks, halving the resolution when the table is full
+void OBD2TraceEncoder::indexBlock(const OBD2TraceBlockHeader& header, uint64_t offset){
+
+  if(_indexCount > 0 && _index[_indexCount-1].Blocks < _blocksPerEntry)
+  {
+    OBD2TraceIndexEntry& last = _index[_indexCount-1];
+    last.LastTime = header.lastTime();
+    last.Blocks++;
+    for(uint8_t i=0;i<OBD2_TRACE_BLOOM_SIZE;i++) last.Bloom[i] |= header.Bloom[i];
+    return;
+  }
+
+  if(_indexCount == OBD2_TRACE_INDEX_ENTRIES)
+  {
+    for(uint16_t i=0;i<_indexCount/2;i++)
+    {
+      OBD2TraceIndexEntry merged = _index[2*i];
+      const OBD2TraceIndexEntry& next = _index[2*i+1];
+      merged.LastTime = next.LastTime;
+      merged.Blocks += next.Blocks;
+      for(uint8_t b=0;b<OBD2_TRACE_BLOOM_SIZE;b++) merged.Bloom[b] |= next.Bloom[b];
+      _index[i] = merged;
+    }
+
+    _indexCount /= 2;
+    _blocksPerEntry *= 2;
+  }
+
+  OBD2TraceIndexEntry& entry = _index[_indexCount++];
+  entry.Offset = offset;
+  entry.FirstTime = header.Time;
+  entry.LastTime = header.lastTime();
+  entry.FirstBlock = header.Sequence;
+  entry.Blocks = 1;
+  memcpy(entry.Bloom, header.Bloom, OBD2_TRACE_BLOOM_SIZE);
+}
+
+bool OBD2TraceEncoder::end(){
+
+  if(_out==NULL) return false;
+
+  closeBlock();
+
+  uint64_t indexOffset = _offset;
+  uint32_t crc = 0;
+
+  for(uint16_t i=0;i<_indexCount;i++)
+  {
+    uint8_t bytes[OBD2_TRACE_INDEX_ENTRY_SIZE];
+    memset(bytes, 0, sizeof(bytes));
+    OBD2TraceFormat::writeIndexEntry(bytes, _index[i]);
+    crc = OBD2TraceFormat::crc32(bytes, sizeof(bytes), crc);
+    write(bytes, sizeof(bytes));
+  }
+
+  uint8_t trailer[OBD2_TRACE_TRAILER_SIZE];
+  memcpy(trailer, "O2IX", 4);
+  OBD2TraceFormat::putUint32(trailer + 4, _indexCount);
+  OBD2TraceFormat::putUint64(trailer + 8, indexOffset);
+  OBD2TraceFormat::putUint32(trailer + 16, crc);
+  write(trailer, sizeof(trailer));
+
+  _out = nullptr;
+  return !_failed;
+}
+
+//decoder
+
+bool OBD2TraceBlockDecoder::begin(const OBD2TraceBlockHeader& header, const uint8_t* payload, bool checkCrc){
+
+  _payload = payload;
+  _length = header.Length;
+  _position = 0;
+  _remaining = header.Frames;
+  _time = header.Time;
+  _dictionary.clear();
+
+  if(checkCrc)
+  {
+    uint8_t bytes[OBD2_TRACE_BLOCK_HEADER_SIZE];
+    OBD2TraceFormat::writeHeader(bytes, header);
+    uint32_t crc = OBD2TraceFormat::crc32(payload, header.Length, OBD2TraceFormat::crc32(bytes, OBD2_TRACE_BLOCK_HEADER_SIZE-4));
+
+    if(crc != header.Crc)
+    {
+      _remaining = 0;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool OBD2TraceBlockDecoder::getVarint(uint64_t& value){
+
+  value = 0;
+  for(uint8_t shift=0;shift<64;shift+=7)
+  {
+    if(_position >= _length) return false;
+
+    uint8_t b = _payload[_position++];
+    value |= (uint64_t)(b & 0x7F) << shift;
+    if(!(b & 0x80)) return true;
+  }
+
+  return false;
+}
+
+bool OBD2TraceBlockDecoder::next(uint64_t& time, OBD2TraceFrame& frame){
+
+  if(_remaining==0) return false;
+  _remaining--;
+
+  if(_position >= _length) return (_remaining = 0);
+  uint8_t tag = _payload[_position++];
+  uint8_t kind = tag & OBD2_TRACE_KIND_MASK;
+  int entry = tag & OBD2_TRACE_TAG_LITERAL;
+
+  if(entry==OBD2_TRACE_TAG_LITERAL)
+  {
+    uint64_t id;
+    if(!getVarint(id)) return (_remaining = 0);
+
+    frame.Id = (long)(id >> 1);
+    frame.Extended = id & 1;
+    entry = _dictionary.add(frame.Id, frame.Extended);
+  }
+  else{
+    if(entry >= _dictionary.Count) return (_remaining = 0);
+
+    frame.Id = _dictionary.Ids[entry];
+    frame.Extended = _dictionary.Extended[entry];
+  }
+
+  uint64_t delta;
+  if(!getVarint(delta)) return (_remaining = 0);
+
+  if(_dictionary.periodic(entry)) _time = _dictionary.predict(entry) + (uint64_t)((int64_t)(delta >> 1) ^ -(int64_t)(delta & 1));
+  else _time += delta;
+
+  uint8_t control = 0;
+  if(kind==OBD2_TRACE_KIND_CONTROL)
+  {
+    if(_position >= _length) return (_remaining = 0);
+    control = _payload[_position++];
+    if(control & 0xC0) return (_remaining = 0);
+  }
+
+  uint8_t dlc;
+  const uint8_t* reference;
+  if(!_dictionary.reference(entry, control & OBD2_TRACE_CONTROL_SLOT, dlc, reference)) return (_remaining = 0);
+
+  if(control & OBD2_TRACE_CONTROL_DLC)
+  {
+    if(_position >= _length) return (_remaining = 0);
+    dlc = _payload[_position++];
+    if(dlc > 8) return (_remaining = 0);
+  }
+
+  frame.Rtr = (control & OBD2_TRACE_CONTROL_RTR) != 0;
+  frame.Dlc = dlc;
+  frame.Timestamp = (uint32_t)_time;
+  memset(frame.Data, 0, sizeof(frame.Data));
+
+  if(!frame.Rtr)
+  {
+    memcpy(frame.Data, reference, 8);
+    uint8_t mask = 0;
+
+    if(kind==OBD2_TRACE_KIND_BYTE)
+    {
+      if(entry < 0 || _dictionary.Position[entry] < 0 || _dictionary.Position[entry] >= dlc || _position >= _length) return (_remaining = 0);
+      frame.Data[_dictionary.Position[entry]] = _payload[_position++];
+    }
+    else if(kind==OBD2_TRACE_KIND_CHANGED || (control & OBD2_TRACE_CONTROL_MASK))
+    {
+      if(_position >= _length) return (_remaining = 0);
+      mask = _payload[_position++];
+      if(mask >> dlc) return (_remaining = 0);
+
+      for(uint8_t i=0;i<dlc;i++)
+      {
+        if(!(mask & (1 << i))) continue;
+        if(_position >= _length) return (_remaining = 0);
+        frame.Data[i] = _payload[_position++];
+      }
+    }
+
+    //only dlc bytes are part of the frame
+    memset(frame.Data + dlc, 0, 8 - dlc);
+    _dictionary.remember(entry, dlc, frame.Data, mask);
+  }
+
+  _dictionary.arrived(entry, _time);
+
+  time = _time;
+  return true;
+}
@@ -0,0 +1,188 @@
+/**
+ * Obd2Reader - compressed block traces
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Block based trace format: frames are delta/varint coded in self-contained blocks, every block
+ * header carries its time range, an ID bloom filter and a CRC32, a sparse index at the end of the
+ * file maps time ranges to file offsets. A truncated file (power loss) loses at most the open block.
+ *
+ * File layout, little endian:
+ *   header   "O2TC", version, 3 reserved bytes
+ *   block    header (44 bytes): "O2BK", uint16 payload length, uint16 frames, uint64 first time (us),
+ *            uint32 duration (us), 16 bytes id bloom filter, uint32 sequence, uint32 crc32 (header + payload)
+ *            payload, per frame:
+ *              tag: bits 0-5 id dictionary index (63: literal varint id<<1|extended follows),
+ *                   bits 6-7 kind, against the payloads of this id (history, most recent first):
+ *                     0 same dlc and data as the most recent one
+ *                     1 the most recent one with its last single changed byte replaced, the byte follows
+ *                     2 the most recent one's dlc, a mask of the changed bytes, those bytes
+ *                     3 control byte: bits 0-2 history slot, bit 3 dlc byte follows, bit 4 rtr,
+ *                       bit 5 mask and changed bytes against that slot follow
+ *              time: varint delta from the previous frame (0 for the first one), or when the id
+ *                    was periodic (last arrival within 64 us of the prediction) a zigzag varint
+ *                    from its last time plus its last interval
+ *              history: the last 8 distinct payloads of each id, rtr frames are not kept
+ *   index    entries (48 bytes): uint64 offset, uint64 first time, uint64 last time, uint32 first block,
+ *            uint32 blocks, 16 bytes bloom
+ *   trailer  "O2IX", uint32 entries, uint64 index offset, uint32 crc32 of the entries
+ * Times are micros() unwrapped to 64 bit, their low 32 bits are the recorded timestamps.
+ */
+
+#ifndef Obd2TraceBlock_H
+#define Obd2TraceBlock_H
+
+#include "OBD2Trace.h"
+
+//payload bytes per block, RAM of the encoder
+#ifndef OBD2_TRACE_BLOCK_SIZE
+#define OBD2_TRACE_BLOCK_SIZE 4096
+#endif
+
+//sparse index kept by the encoder: when full, neighbour entries are merged
+#ifndef OBD2_TRACE_INDEX_ENTRIES
+#define OBD2_TRACE_INDEX_ENTRIES 64
+#endif
+
+#define OBD2_TRACE_BLOCK_VERSION 2
+#define OBD2_TRACE_BLOCK_HEADER_SIZE 44
+#define OBD2_TRACE_INDEX_ENTRY_SIZE 48
+#define OBD2_TRACE_TRAILER_SIZE 20
+#define OBD2_TRACE_DICTIONARY_SIZE 63
+#define OBD2_TRACE_BLOOM_SIZE 16
+#define OBD2_TRACE_HISTORY 8
+#define OBD2_TRACE_MAX_ENCODED_FRAME 22 //1 tag + 5 id + 5 time + 1 control + 1 dlc + 1 mask + 8 data
+
+struct OBD2TraceBlockHeader {
+    uint16_t Length;
+    uint16_t Frames;
+    uint64_t Time;
+    uint32_t Duration;
+    uint8_t Bloom[OBD2_TRACE_BLOOM_SIZE];
+    uint32_t Sequence;
+    uint32_t Crc;
+
+    bool mayContain(long id, bool extended) const;
+    uint64_t lastTime() const { return Time + Duration; };
+};
+
+struct OBD2TraceIndexEntry {
+    uint64_t Offset; //file offset of the first block
+    uint64_t FirstTime;
+    uint64_t LastTime;
+    uint32_t FirstBlock;
+    uint32_t Blocks;
+    uint8_t Bloom[OBD2_TRACE_BLOOM_SIZE];
+
+    bool mayContain(long id, bool extended) const;
+};
+
+//helpers shared by encoder and decoders
+class OBD2TraceFormat
+{
+    public:
+        static uint32_t crc32(const uint8_t* bytes, size_t length, uint32_t crc = 0);
+        static void bloomAdd(uint8_t* bloom, long id, bool extended);
+        static bool bloomTest(const uint8_t* bloom, long id, bool extended);
+        static bool parseHeader(const uint8_t* bytes, OBD2TraceBlockHeader& header); //false without the sync marker
+        static void writeHeader(uint8_t* bytes, const OBD2TraceBlockHeader& header);
+        static void parseIndexEntry(const uint8_t* bytes, OBD2TraceIndexEntry& entry);
+        static void writeIndexEntry(uint8_t* bytes, const OBD2TraceIndexEntry& entry);
+        static uint64_t getUint64(const uint8_t* bytes);
+        static uint32_t getUint32(const uint8_t* bytes);
+        static void putUint64(uint8_t* bytes, uint64_t value);
+        static void putUint32(uint8_t* bytes, uint32_t value);
+};
+
+//per block id dictionary, rebuilt the same way by the decoder
+struct OBD2TraceDictionary {
+    long Ids[OBD2_TRACE_DICTIONARY_SIZE];
+    bool Extended[OBD2_TRACE_DICTIONARY_SIZE];
+    //distinct payloads, most recent first, bytes past dlc are 0
+    uint8_t Payloads[OBD2_TRACE_DICTIONARY_SIZE];
+    uint8_t Dlc[OBD2_TRACE_DICTIONARY_SIZE][OBD2_TRACE_HISTORY];
+    uint8_t Data[OBD2_TRACE_DICTIONARY_SIZE][OBD2_TRACE_HISTORY][8];
+    int8_t Position[OBD2_TRACE_DICTIONARY_SIZE]; //last single changed byte, -1 none
+    //time prediction
+    uint64_t LastTime[OBD2_TRACE_DICTIONARY_SIZE];
+    uint32_t Interval[OBD2_TRACE_DICTIONARY_SIZE];
+    uint8_t Seen[OBD2_TRACE_DICTIONARY_SIZE];
+    bool Periodic[OBD2_TRACE_DICTIONARY_SIZE];
+    uint8_t Count;
+
+    void clear(){ Count = 0; };
+    int find(long id, bool extended) const;
+    int add(long id, bool extended); //-1 when full
+    //payload of a history slot, an empty one for a new id or entry -1; false past the history
+    bool reference(int entry, uint8_t slot, uint8_t& dlc, const uint8_t*& data) const;
+    //moves the payload to the front, mask: bytes changed against the reference it was coded with
+    void remember(int entry, uint8_t dlc, const uint8_t* data, uint8_t mask);
+    void arrived(int entry, uint64_t time);
+    bool periodic(int entry) const { return entry >= 0 && Periodic[entry]; };
+    uint64_t predict(int entry) const { return LastTime[entry] + Interval[entry]; };
+};
+
+class OBD2TraceEncoder
+{
+    public:
+        OBD2TraceEncoder(){};
+
+        void begin(Print& out); //writes the file header
+        bool encode(const OBD2TraceFrame& frame); //false if a block could not be written
+        //loop side: encodes up to maxFrames records queued by the capture (OBD2TraceWriter::begin())
+        uint16_t flush(OBD2TraceWriter& source, uint16_t maxFrames = 256);
+        bool closeBlock(); //writes the open block, if any
+        bool end(); //last block, index and trailer
+
+        uint32_t getFrames(){ return _frames; };
+        uint32_t getBlocks(){ return _sequence; };
+        uint64_t getBytesWritten(){ return _offset; };
+        uint64_t getRawBytes(){ return _rawBytes; }; //size of the same frames in the plain format
+
+    private:
+        bool write(const uint8_t* bytes, size_t length);
+        void indexBlock(const OBD2TraceBlockHeader& header, uint64_t offset);
+        void putVarint(uint64_t value);
+
+        Print* _out = nullptr;
+        uint64_t _offset = 0;
+        bool _failed = false;
+
+        uint8_t _payload[OBD2_TRACE_BLOCK_SIZE];
+        uint16_t _length = 0;
+        OBD2TraceBlockHeader _header;
+        OBD2TraceDictionary _dictionary;
+        uint32_t _sequence = 0;
+
+        bool _started = false;
+        uint64_t _time = 0;
+        uint32_t _lastTimestamp = 0;
+        uint64_t _blockLastTime = 0;
+
+        OBD2TraceIndexEntry _index[OBD2_TRACE_INDEX_ENTRIES];
+        uint16_t _indexCount = 0;
+        uint32_t _blocksPerEntry = 1;
+
+        uint32_t _frames = 0;
+        uint64_t _rawBytes = 0;
+};
+
+//decodes one block payload, no allocation
+class OBD2TraceBlockDecoder
+{
+    public:
+        bool begin(const OBD2TraceBlockHeader& header, const uint8_t* payload, bool checkCrc = true);
+        bool next(uint64_t& time, OBD2TraceFrame& frame); //false at the end or on corrupt data
+
+    private:
+        bool getVarint(uint64_t& value);
+
+        const uint8_t* _payload = nullptr;
+        uint16_t _length = 0;
+        uint16_t _position = 0;
+        uint16_t _remaining = 0;
+        uint64_t _time = 0;
+        OBD2TraceDictionary _dictionary;
+};
+
+#endif
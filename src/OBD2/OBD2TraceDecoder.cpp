@@ -0,0 +1,204 @@
+/**
+ * Obd2Reader - trace decoding
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2TraceDecoder.h"
+
+void OBD2TraceDecoder::reset(){
+
+  for(uint8_t i=0;i<OBD2_TRACE_DECODER_SESSIONS;i++)
+  {
+    _sessions[i].Id = 0;
+  }
+
+  _nextSession = 0;
+}
+
+int OBD2TraceDecoder::addBroadcast(long header, const char* name, OBD2BroadcastDecoder decoder){
+
+  if(_nbroadcasts >= OBD2_TRACE_DECODER_BROADCASTS || decoder==NULL) return -1;
+
+  _broadcasts[_nbroadcasts] = { header, name, decoder, 0, 0, 1.0, 0.0 };
+  _nbroadcasts++;
+
+  return (_profile!=NULL ? _profile->Count : 0) + _nbroadcasts - 1;
+}
+
+int OBD2TraceDecoder::addBroadcast(long header, const char* name, uint8_t startByte, uint8_t length, float scale, float offset){
+
+  if(_nbroadcasts >= OBD2_TRACE_DECODER_BROADCASTS || length==0 || length > 4 || startByte + length > 8) return -1;
+
+  _broadcasts[_nbroadcasts] = { header, name, NULL, startByte, length, scale, offset };
+  _nbroadcasts++;
+
+  return (_profile!=NULL ? _profile->Count : 0) + _nbroadcasts - 1;
+}
+
+uint16_t OBD2TraceDecoder::getColumns(){
+  return (_profile!=NULL ? _profile->Count : 0) + _nbroadcasts;
+}
+
+const char* OBD2TraceDecoder::getColumnName(uint16_t column){
+
+  uint16_t requests = _profile!=NULL ? _profile->Count : 0;
+
+  if(column < requests) return _profile->Requests[column].Name;
+  if(column < requests + _nbroadcasts) return _broadcasts[column - requests].Name;
+
+  return NULL;
+}
+
+const char* OBD2TraceDecoder::getColumnGroup(uint16_t column){
+
+  if(_profile!=NULL && column < _profile->Count) return _profile->Requests[column].Group;
+
+  return NULL;
+}
+
+bool OBD2TraceDecoder::isResponse(long id, bool extended){
+
+  if(extended) return (id & 0xFFFF0000) == 0x18DA0000;
+
+  return id >= 0x7E8 && id <= 0x7EF;
+}
+
+OBD2TraceDecoder::Session* OBD2TraceDecoder::findSession(long id){
+
+  for(uint8_t i=0;i<OBD2_TRACE_DECODER_SESSIONS;i++)
+  {
+    if(_sessions[i].Id==id) return &_sessions[i];
+  }
+
+  return NULL;
+}
+
+//a new first frame restarts the response of its ecu, more ecus than sessions evict in turn
+OBD2TraceDecoder::Session* OBD2TraceDecoder::openSession(long id){
+
+  Session* session = findSession(id);
+  if(session==NULL) session = findSession(0);
+
+  if(session==NULL)
+  {
+    session = &_sessions[_nextSession];
+    _nextSession = (_nextSession + 1) % OBD2_TRACE_DECODER_SESSIONS;
+  }
+
+  session->Id = id;
+  session->DataBytes = 0;
+  memset(session->Data, 0, sizeof(session->Data));
+
+  return session;
+}
+
+uint8_t OBD2TraceDecoder::complete(Session* session, long id, OBD2DecodedValue* values, uint8_t maxValues){
+
+  //same lookup and formula as a response reaching OBD2::process()
+  int index = _profile->findRequest(obd2RequestHeaderFromResponse(id), session->Service, session->Pid);
+  session->Id = 0;
+
+  if(index < 0 || maxValues==0) return 0;
+
+  const OBD2RequestDescriptor& request = _profile->Requests[index];
+
+  values[0].Column = index;
+  values[0].Value = obd2DecodeValue(session->Data, request.ExpectedBytes, request.ScaleFactor, request.AdjustFactor);
+
+  return 1;
+}
+
+//byte for byte the parsing of OBD2::onReceivePacket(), per response id instead of per request
+uint8_t OBD2TraceDecoder::decode(const OBD2TraceFrame& frame, OBD2DecodedValue* values, uint8_t maxValues){
+
+  uint8_t count = 0;
+
+  for(uint8_t i=0;i<_nbroadcasts;i++)
+  {
+    if(_broadcasts[i].Header!=frame.Id) continue;
+
+    uint8_t bytes[8] = {0,0,0,0,0,0,0,0};
+    memcpy(bytes, frame.Data, frame.Rtr ? 0 : frame.Dlc);
+
+    OBD2BroadcastPacket packet = { frame.Id, bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5], bytes[6], bytes[7] };
+
+    if(count < maxValues)
+    {
+      values[count].Column = (_profile!=NULL ? _profile->Count : 0) + i;
+      const Broadcast& b = _broadcasts[i];
+      values[count].Value = b.Decoder!=NULL ? b.Decoder(packet) : obd2DecodeValue(bytes + b.StartByte, b.Length, b.Scale, b.Offset);
+      count++;
+    }
+  }
+
+  if(count > 0 || _profile==NULL || frame.Rtr || frame.Dlc==0 || !isResponse(frame.Id, frame.Extended)) return count;
+
+  const uint8_t* data = frame.Data;
+  uint8_t dlc = frame.Dlc > 8 ? 8 : frame.Dlc;
+  uint8_t dataindex;
+  Session* session;
+
+  //multiframe response example: 10 0B 6240A4020103
+  if(data[0] > 8)
+  {
+    if(data[0]==0x10)
+    {
+      session = openSession(frame.Id);
+      session->FrameBytes = data[1];
+      session->Service = data[2]-0x40;
+      session->ReadedBytes = 1;
+
+      if(frame.Extended)
+      {
+        session->Pid = (data[3]<<8)|(data[4]);
+        session->ReadedBytes+=2;
+        dataindex = 5;
+      }
+      else{
+        session->Pid = data[3];
+        session->ReadedBytes+=1;
+        dataindex = 4;
+      }
+    }
+    else{
+      session = findSession(frame.Id);
+      if(session==NULL) return 0;
+      dataindex = 1;
+    }
+  }
+  //negative response example: 037F2278, nothing to decode
+  else if(data[1]==0x7F)
+  {
+    return 0;
+  }
+  //single frame example: 046240A45F
+  else{
+    session = openSession(frame.Id);
+    session->FrameBytes = data[0];
+    session->Service = data[1]-0x40;
+    session->ReadedBytes = 1;
+
+    if(frame.Extended)
+    {
+      session->Pid = (data[2]<<8)|(data[3]);
+      session->ReadedBytes+=2;
+      dataindex = 4;
+    }
+    else{
+      session->Pid = data[2];
+      session->ReadedBytes+=1;
+      dataindex = 3;
+    }
+  }
+
+  for(uint8_t d=dataindex;d<dlc;d++)
+  {
+    if(session->DataBytes < OBD2_MAX_BUFFER_LENGTH) session->Data[session->DataBytes++] = data[d];
+    session->ReadedBytes++;
+  }
+
+  if(session->ReadedBytes < session->FrameBytes) return 0;
+
+  return complete(session, frame.Id, values, maxValues);
+}
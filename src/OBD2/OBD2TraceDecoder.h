@@ -0,0 +1,88 @@
+/**
+ * Obd2Reader - trace decoding
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Passive decoder of captured frames: ISO-TP diagnostic responses are reassembled per response id
+ * and decoded with a profile (OBD2::getValue() formula), broadcast packets with OBD2BroadcastDecoder
+ * functions or with the same formula over a byte range, so signals can be given at run time.
+ * No request state is needed, so any slice of a trace can be decoded on its own.
+ *
+ * Columns: profile request i is column i, broadcast decoder j is column profile count + j.
+ * Responses are recognized by standard addressing (0x7E8-0x7EF, 0x18DAxxxx with source and target
+ * swapped), the same rule used to route late responses to a profile.
+ */
+
+#ifndef Obd2TraceDecoder_H
+#define Obd2TraceDecoder_H
+
+#include "OBD2Signals.h"
+#include "OBD2Trace.h"
+
+//responses reassembled at the same time (one per ecu)
+#ifndef OBD2_TRACE_DECODER_SESSIONS
+#define OBD2_TRACE_DECODER_SESSIONS 8
+#endif
+
+#ifndef OBD2_TRACE_DECODER_BROADCASTS
+#define OBD2_TRACE_DECODER_BROADCASTS 16
+#endif
+
+struct OBD2DecodedValue {
+    uint16_t Column;
+    float Value;
+};
+
+class OBD2TraceDecoder
+{
+    public:
+        OBD2TraceDecoder(){ reset(); };
+
+        void setProfile(const OBD2Profile* profile){ _profile = profile; reset(); }; //before addBroadcast()
+        //column of the broadcast signal or -1, several decoders may share a header
+        int addBroadcast(long header, const char* name, OBD2BroadcastDecoder decoder);
+        //big endian bytes [startByte, startByte+length) scaled and adjusted, as profile requests are
+        int addBroadcast(long header, const char* name, uint8_t startByte, uint8_t length, float scale = 1.0, float offset = 0.0);
+
+        //up to maxValues decoded values of frame (a completed response or a broadcast packet)
+        uint8_t decode(const OBD2TraceFrame& frame, OBD2DecodedValue* values, uint8_t maxValues);
+        void reset(); //drops responses being reassembled
+
+        uint16_t getColumns();
+        const char* getColumnName(uint16_t column);
+        const char* getColumnGroup(uint16_t column); //NULL for broadcast signals
+
+    private:
+        struct Session {
+            long Id; //0 when free
+            uint8_t Service;
+            uint16_t Pid;
+            uint8_t FrameBytes;
+            uint8_t ReadedBytes;
+            uint8_t DataBytes;
+            uint8_t Data[OBD2_MAX_BUFFER_LENGTH];
+        };
+
+        struct Broadcast {
+            long Header;
+            const char* Name;
+            OBD2BroadcastDecoder Decoder; //NULL: formula below
+            uint8_t StartByte;
+            uint8_t Length;
+            float Scale;
+            float Offset;
+        };
+
+        bool isResponse(long id, bool extended);
+        Session* openSession(long id);
+        Session* findSession(long id);
+        uint8_t complete(Session* session, long id, OBD2DecodedValue* values, uint8_t maxValues);
+
+        const OBD2Profile* _profile = nullptr;
+        Session _sessions[OBD2_TRACE_DECODER_SESSIONS];
+        uint8_t _nextSession = 0;
+        Broadcast _broadcasts[OBD2_TRACE_DECODER_BROADCASTS];
+        uint8_t _nbroadcasts = 0;
+};
+
+#endif
@@ -0,0 +1,263 @@
+/**
+ * Obd2Reader - event triggered capture
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2Trigger.h"
+
+OBD2TriggerCapture::OBD2TriggerCapture(OBD2TraceWriter& source) : _trace(source){
+  static_assert((OBD2_TRIGGER_RING_FRAMES & (OBD2_TRIGGER_RING_FRAMES-1)) == 0, "OBD2_TRIGGER_RING_FRAMES must be a power of two");
+
+  for(uint8_t i=0;i<OBD2_TRIGGER_MAX_EVENTS;i++)
+  {
+    _events[i].Active = false;
+  }
+}
+
+int OBD2TriggerCapture::addTrigger(const char* name, const void* request, OBD2TriggerType type, float threshold, float hysteresis, uint32_t preTrigger, uint32_t postTrigger){
+
+  if(_ntriggers >= OBD2_TRIGGER_MAX) return -1;
+
+  _triggers[_ntriggers] = { name, request, type, threshold, hysteresis, preTrigger, postTrigger, false, false, 0.0, 0 };
+  _ntriggers++;
+
+  return _ntriggers - 1;
+}
+
+int OBD2TriggerCapture::addTrigger(const char* name, const OBD2RequestDescriptor* request, OBD2TriggerType type, float threshold, float hysteresis, uint32_t preTrigger, uint32_t postTrigger){
+
+  if(request==NULL) return -1;
+
+  return addTrigger(name, (const void*)request, type, threshold, hysteresis, preTrigger, postTrigger);
+}
+
+int OBD2TriggerCapture::addTrigger(const char* name, OBD2Request* request, OBD2TriggerType type, float threshold, float hysteresis, uint32_t preTrigger, uint32_t postTrigger){
+
+  if(request==NULL) return -1;
+
+  return addTrigger(name, (const void*)request, type, threshold, hysteresis, preTrigger, postTrigger);
+}
+
+int OBD2TriggerCapture::addTrigger(const char* name, OBD2TriggerType type, float threshold, float hysteresis, uint32_t preTrigger, uint32_t postTrigger){
+  return addTrigger(name, (const void*)NULL, type, threshold, hysteresis, preTrigger, postTrigger);
+}
+
+//edges fire once, then wait for the value to go back past the hysteresis band
+bool OBD2TriggerCapture::evaluate(Trigger& t, float value){
+
+  bool fired = false;
+
+  switch(t.Type)
+  {
+    case OBD2TriggerType::rising:
+      if(!t.Armed)
+      {
+        t.Armed = value < t.Threshold - t.Hysteresis;
+      }
+      else if(value >= t.Threshold)
+      {
+        t.Armed = false;
+        fired = true;
+      }
+      break;
+    case OBD2TriggerType::falling:
+      if(!t.Armed)
+      {
+        t.Armed = value > t.Threshold + t.Hysteresis;
+      }
+      else if(value <= t.Threshold)
+      {
+        t.Armed = false;
+        fired = true;
+      }
+      break;
+    case OBD2TriggerType::change:
+      fired = t.HasLast && fabs(value - t.Last) > t.Threshold;
+      break;
+  }
+
+  t.Last = value;
+  t.HasLast = true;
+
+  return fired;
+}
+
+bool OBD2TriggerCapture::update(int trigger, float value){
+
+  if(trigger < 0 || trigger >= _ntriggers) return false;
+
+  return evaluate(_triggers[trigger], value) && fire(trigger, value);
+}
+
+bool OBD2TriggerCapture::fire(int trigger, float value){
+
+  if(trigger < 0 || trigger >= _ntriggers) return false;
+
+  Trigger& t = _triggers[trigger];
+  t.Fired++;
+  _sequence++;
+
+  for(uint8_t i=0;i<OBD2_TRIGGER_MAX_EVENTS;i++)
+  {
+    Event& e = _events[i];
+    if(e.Active) continue;
+
+    e.Active = true;
+    e.Started = false;
+    e.Info = { (uint8_t)trigger, t.Name, value, (uint32_t)millis(), _sequence, 0, 0, 0 };
+    e.FireMicros = micros();
+    e.PreMicros = t.PreTrigger * 1000;
+    e.PostMicros = t.PostTrigger * 1000;
+    e.Out = nullptr;
+
+    if(OBD2_DEBUG)
+      Serial.printf("Trigger %s fired, value %f\n", t.Name, value);
+
+    return true;
+  }
+
+  _skipped++;
+  return false;
+}
+
+void OBD2TriggerCapture::setRequestValue(const void* request, float value){
+
+  for(uint8_t i=0;i<_ntriggers;i++)
+  {
+    if(_triggers[i].Request==request) update(i, value);
+  }
+}
+
+//failed outcomes come with 0.0, they are not values to evaluate
+void OBD2TriggerCapture::onOBD2Response(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes){
+
+  if(outcome==OBD2StatusType::received) setRequestValue(request, value);
+
+  if(_nextListener!=NULL) _nextListener->onOBD2Response(request, outcome, value, responseBytes);
+}
+
+void OBD2TriggerCapture::onOBD2Response(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes){
+
+  if(outcome==OBD2StatusType::received) setRequestValue(request, value);
+
+  if(_nextListener!=NULL) _nextListener->onOBD2Response(request, state, outcome, value, responseBytes);
+}
+
+//frames queued by the receive interrupt into the ring, overwriting the oldest
+void OBD2TriggerCapture::capture(){
+
+  OBD2TraceFrame frame;
+
+  while(_trace.read(frame))
+  {
+    _ring[_next & (OBD2_TRIGGER_RING_FRAMES-1)] = frame;
+    _next++;
+    _captured++;
+  }
+}
+
+void OBD2TriggerCapture::endEvent(Event& e){
+
+  if(_sink!=NULL && e.Out!=NULL) _sink->onTriggerEnd(e.Info, e.Out);
+
+  e.Active = false;
+  e.Out = nullptr;
+}
+
+uint16_t OBD2TriggerCapture::writeEvent(Event& e, uint16_t maxFrames){
+
+  uint32_t oldest = _next > OBD2_TRIGGER_RING_FRAMES ? _next - OBD2_TRIGGER_RING_FRAMES : 0;
+  uint32_t windowStart = e.FireMicros - e.PreMicros;
+  uint32_t windowEnd = e.FireMicros + e.PostMicros;
+
+  if(!e.Started)
+  {
+    //first frame of the pre-trigger window still in the ring
+    e.Cursor = _next;
+    while(e.Cursor > oldest && (int32_t)(_ring[(e.Cursor-1) & (OBD2_TRIGGER_RING_FRAMES-1)].Timestamp - windowStart) >= 0)
+    {
+      e.Cursor--;
+    }
+
+    //ring wrapped before reaching the window start: older frames are gone, and not counted in Lost
+    if(e.Cursor == oldest && oldest > 0 && e.Cursor != _next)
+    {
+      e.Info.Truncated = (_ring[e.Cursor & (OBD2_TRIGGER_RING_FRAMES-1)].Timestamp - windowStart) / 1000;
+
+      if(OBD2_DEBUG)
+        Serial.printf("Trigger %s pre window truncated by %lu ms\n", e.Info.Name, (unsigned long)e.Info.Truncated);
+    }
+
+    e.Out = _sink!=NULL ? _sink->onTriggerStart(e.Info) : NULL;
+    if(e.Out==NULL)
+    {
+      e.Active = false;
+      return 0;
+    }
+
+    uint8_t header[OBD2_TRACE_HEADER_SIZE];
+    OBD2TraceWriter::encodeHeader(header);
+    e.Out->write(header, sizeof(header));
+    e.Started = true;
+  }
+
+  //writer slower than the bus: the ring went past the cursor
+  if(e.Cursor < oldest)
+  {
+    e.Info.Lost += oldest - e.Cursor;
+    e.Cursor = oldest;
+  }
+
+  uint16_t written = 0;
+  uint8_t bytes[OBD2_TRACE_MAX_RECORD_SIZE];
+
+  while(written < maxFrames && e.Cursor != _next)
+  {
+    const OBD2TraceFrame& frame = _ring[e.Cursor & (OBD2_TRIGGER_RING_FRAMES-1)];
+
+    if((int32_t)(frame.Timestamp - windowEnd) > 0)
+    {
+      endEvent(e);
+      return written;
+    }
+
+    e.Out->write(bytes, OBD2TraceWriter::encodeRecord(frame, bytes));
+    e.Cursor++;
+    e.Info.Frames++;
+    written++;
+  }
+
+  if(e.Cursor == _next && (int32_t)(micros() - windowEnd) > 0)
+  {
+    endEvent(e);
+  }
+
+  return written;
+}
+
+uint16_t OBD2TriggerCapture::process(uint16_t maxFrames){
+
+  capture();
+
+  uint16_t written = 0;
+
+  for(uint8_t i=0;i<OBD2_TRIGGER_MAX_EVENTS;i++)
+  {
+    if(_events[i].Active) written += writeEvent(_events[i], maxFrames);
+  }
+
+  return written;
+}
+
+uint8_t OBD2TriggerCapture::getActiveEvents(){
+
+  uint8_t active = 0;
+
+  for(uint8_t i=0;i<OBD2_TRIGGER_MAX_EVENTS;i++)
+  {
+    if(_events[i].Active) active++;
+  }
+
+  return active;
+}
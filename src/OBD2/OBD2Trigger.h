@@ -0,0 +1,141 @@
+/**
+ * Obd2Reader - event triggered capture
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * OBD2TriggerCapture keeps the last OBD2_TRIGGER_RING_FRAMES frames in a RAM ring (oldest overwritten)
+ * and evaluates trigger conditions on decoded values. When a trigger fires, an event trace is written
+ * through IOBD2TriggerSink: the frames of the pre-trigger window, then the live frames until the
+ * post-trigger window is over. Several triggers run at once, their events may overlap.
+ *
+ * Frames come from an OBD2TraceWriter in queue mode (begin() without sink, OBD2::setTrace()), so the
+ * receive interrupt side is unchanged; process() moves them into the ring and writes the events a few
+ * frames at a time. Event files are plain traces (OBD2Trace.h): obd2_trace, obd2_decode and
+ * OBD2TraceReplay read them as they are, decoded values included.
+ */
+
+#ifndef Obd2Trigger_H
+#define Obd2Trigger_H
+
+#include "OBD2Trace.h"
+
+//pre-trigger history, power of two: the window is at most this many frames.
+//size it as bus frames/s * pre-trigger seconds: 500 kbit/s at full load is ~4000 frames/s, so the
+//default 1024 holds ~0.25 s, a 5 s window at 50% load needs 16384 (~20 bytes a frame)
+#ifndef OBD2_TRIGGER_RING_FRAMES
+#define OBD2_TRIGGER_RING_FRAMES 1024
+#endif
+
+#ifndef OBD2_TRIGGER_MAX
+#define OBD2_TRIGGER_MAX 8
+#endif
+
+//events being written at the same time
+#ifndef OBD2_TRIGGER_MAX_EVENTS
+#define OBD2_TRIGGER_MAX_EVENTS 4
+#endif
+
+enum class OBD2TriggerType : uint8_t {
+    rising, //value reaches threshold from below, re-armed under threshold - hysteresis
+    falling, //value reaches threshold from above, re-armed over threshold + hysteresis
+    change //value differs from the previous one by more than threshold (DTC count, gear...)
+};
+
+struct OBD2TriggerEvent {
+    uint8_t Trigger;
+    const char* Name;
+    float Value; //value that fired the trigger
+    uint32_t Time; //millis() when fired
+    uint32_t Sequence; //events fired so far, all triggers
+    uint32_t Frames; //frames written
+    uint32_t Lost; //frames of the window overwritten before they could be written
+    uint32_t Truncated; //ms of the pre-trigger window older than the ring, 0 if it fit
+};
+
+class IOBD2TriggerSink{
+    public:
+        virtual ~IOBD2TriggerSink(){}
+        //where to write the event trace (a new SD file...), NULL to skip the event
+        virtual Print* onTriggerStart(const OBD2TriggerEvent& event) = 0;
+        virtual void onTriggerEnd(const OBD2TriggerEvent& event, Print* out){};
+};
+
+class OBD2TriggerCapture: public IOBD2MessageListener
+{
+    public:
+        OBD2TriggerCapture(OBD2TraceWriter& source);
+
+        //triggers on a request (value listener path) or fed by update(), return the trigger id or -1.
+        //preTrigger and postTrigger in ms, the pre window is also bounded by the ring size
+        int addTrigger(const char* name, const OBD2RequestDescriptor* request, OBD2TriggerType type, float threshold, float hysteresis = 0.0, uint32_t preTrigger = 5000, uint32_t postTrigger = 5000);
+        int addTrigger(const char* name, OBD2Request* request, OBD2TriggerType type, float threshold, float hysteresis = 0.0, uint32_t preTrigger = 5000, uint32_t postTrigger = 5000);
+        int addTrigger(const char* name, OBD2TriggerType type, float threshold, float hysteresis = 0.0, uint32_t preTrigger = 5000, uint32_t postTrigger = 5000);
+
+        bool update(int trigger, float value); //true if it fired
+        bool fire(int trigger, float value = 0.0); //unconditional, false if no event slot is free
+        void setSink(IOBD2TriggerSink* sink){ _sink = sink; };
+
+        //loop: captures the queued frames and writes up to maxFrames per event, returns frames written
+        uint16_t process(uint16_t maxFrames = 64);
+
+        //register as value listener of obd2, failed outcomes are ignored
+        void attach(OBD2& obd2){ obd2.onHandleValue(this); };
+        void setNextListener(IOBD2MessageListener* listener){ _nextListener = listener; };
+
+        void onOBD2Response(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes) override;
+        void onOBD2Response(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes) override;
+
+        uint8_t getActiveEvents();
+        uint32_t getFired(int trigger){ return trigger >= 0 && trigger < _ntriggers ? _triggers[trigger].Fired : 0; };
+        uint32_t getSkipped(){ return _skipped; }; //fired with every event slot busy
+        uint32_t getCaptured(){ return _captured; };
+
+    private:
+        struct Trigger {
+            const char* Name;
+            const void* Request;
+            OBD2TriggerType Type;
+            float Threshold;
+            float Hysteresis;
+            uint32_t PreTrigger;
+            uint32_t PostTrigger;
+            bool Armed;
+            bool HasLast;
+            float Last;
+            uint32_t Fired;
+        };
+
+        struct Event {
+            bool Active;
+            bool Started; //start frame found, header written
+            OBD2TriggerEvent Info;
+            uint32_t FireMicros;
+            uint32_t PreMicros;
+            uint32_t PostMicros;
+            uint32_t Cursor; //sequence of the next frame to write
+            Print* Out;
+        };
+
+        int addTrigger(const char* name, const void* request, OBD2TriggerType type, float threshold, float hysteresis, uint32_t preTrigger, uint32_t postTrigger);
+        bool evaluate(Trigger& t, float value);
+        void setRequestValue(const void* request, float value);
+        void capture();
+        uint16_t writeEvent(Event& e, uint16_t maxFrames);
+        void endEvent(Event& e);
+
+        OBD2TraceWriter& _trace;
+        OBD2TraceFrame _ring[OBD2_TRIGGER_RING_FRAMES];
+        uint32_t _next = 0; //sequence of the next captured frame
+
+        Trigger _triggers[OBD2_TRIGGER_MAX];
+        uint8_t _ntriggers = 0;
+        Event _events[OBD2_TRIGGER_MAX_EVENTS];
+        uint32_t _sequence = 0;
+        uint32_t _skipped = 0;
+        uint32_t _captured = 0;
+
+        IOBD2TriggerSink* _sink = nullptr;
+        IOBD2MessageListener* _nextListener = nullptr;
+};
+
+#endif
@@ -0,0 +1,462 @@
+/**
+ * Obd2Reader - decoded value logging
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2ValueLogger.h"
+#include "OBD2TraceBlock.h"
+
+#define OBD2_LOGGER_PAYLOAD_SIZE (OBD2_LOGGER_BLOCK_SIZE - OBD2_LOGGER_BLOCK_HEADER_SIZE)
+
+static void putUint16(uint8_t* bytes, uint16_t value){
+  bytes[0] = value;
+  bytes[1] = value >> 8;
+}
+
+static uint16_t getUint16(const uint8_t* bytes){
+  return (uint16_t)bytes[0] | ((uint16_t)bytes[1] << 8);
+}
+
+static void putFloat(uint8_t* bytes, float value){
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  OBD2TraceFormat::putUint32(bytes, bits);
+}
+
+static float getFloat(const uint8_t* bytes){
+  uint32_t bits = OBD2TraceFormat::getUint32(bytes);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+//value of a sample: request channels as OBD2::getValue(), bit for bit
+static float channelValue(const OBD2LoggerChannel& channel, int64_t value){
+
+  if(channel.Kind==OBD2LoggerChannelKind::quantized) return (float)value * channel.Scale + channel.Offset;
+
+  uint8_t bytes[4];
+  for(uint8_t i=0;i<channel.ExpectedBytes;i++)
+  {
+    bytes[i] = (uint8_t)(value >> (8 * (channel.ExpectedBytes - i - 1)));
+  }
+
+  return obd2DecodeValue(bytes, channel.ExpectedBytes, channel.Scale, channel.Offset);
+}
+
+OBD2ValueLogger::OBD2ValueLogger(){
+  static_assert((OBD2_LOGGER_QUEUE_BLOCKS & (OBD2_LOGGER_QUEUE_BLOCKS-1)) == 0, "OBD2_LOGGER_QUEUE_BLOCKS must be a power of two");
+  static_assert(OBD2_LOGGER_CHANNELS <= 63, "channel ids are 6 bits");
+}
+
+int OBD2ValueLogger::addChannel(const void* request, const OBD2LoggerChannel& info){
+
+  if(_nchannels >= OBD2_LOGGER_CHANNELS || _out!=NULL) return -1;
+
+  _channels[_nchannels].Request = request;
+  _channels[_nchannels].Info = info;
+  _channels[_nchannels].Last = 0;
+  _channels[_nchannels].InBlock = false;
+  _nchannels++;
+
+  return _nchannels - 1;
+}
+
+//raw integers are at most 4 bytes, as in the profile generator
+int OBD2ValueLogger::addRequest(const OBD2RequestDescriptor* request){
+
+  if(request==NULL) return -1;
+
+  OBD2LoggerChannel info = { request->Name, OBD2LoggerChannelKind::request, (uint8_t)std::min((int)request->ExpectedBytes, 4), request->ScaleFactor, request->AdjustFactor };
+  return addChannel(request, info);
+}
+
+int OBD2ValueLogger::addRequest(OBD2Request* request){
+
+  if(request==NULL) return -1;
+
+  OBD2LoggerChannel info = { request->Name.c_str(), OBD2LoggerChannelKind::request, (uint8_t)std::min((int)request->ExpectedBytes, 4), request->ScaleFactor, request->AdjustFactor };
+  return addChannel(request, info);
+}
+
+int OBD2ValueLogger::addChannel(const char* name, float resolution, float offset){
+
+  if(resolution <= 0.0) return -1;
+
+  OBD2LoggerChannel info = { name, OBD2LoggerChannelKind::quantized, 0, resolution, offset };
+  return addChannel(NULL, info);
+}
+
+bool OBD2ValueLogger::begin(Print& out){
+
+  _out = nullptr;
+  _head = 0;
+  _tail = 0;
+  _partial = 0;
+  _length = 0;
+  _samples = 0;
+  _droppedBlocks = 0;
+  _written = 0;
+
+  //header straight to the sink, in setup()
+  uint8_t bytes[12 + OBD2_LOGGER_MAX_NAME];
+  uint16_t size = 8;
+
+  for(uint8_t i=0;i<_nchannels;i++)
+  {
+    size += 11 + std::min(strlen(_channels[i].Info.Name), (size_t)OBD2_LOGGER_MAX_NAME);
+  }
+
+  size = (size + OBD2_LOGGER_BLOCK_SIZE - 1) / OBD2_LOGGER_BLOCK_SIZE * OBD2_LOGGER_BLOCK_SIZE;
+
+  memcpy(bytes, "O2VL", 4);
+  bytes[4] = OBD2_LOGGER_VERSION;
+  bytes[5] = _nchannels;
+  putUint16(bytes + 6, size);
+
+  //a short write is a full card or a file not open: no logging rather than a broken header
+  _written += out.write(bytes, 8);
+  if(_written != 8) return false;
+
+  for(uint8_t i=0;i<_nchannels;i++)
+  {
+    const OBD2LoggerChannel& info = _channels[i].Info;
+    uint8_t nameLength = std::min(strlen(info.Name), (size_t)OBD2_LOGGER_MAX_NAME);
+
+    bytes[0] = (uint8_t)info.Kind;
+    bytes[1] = info.ExpectedBytes;
+    putFloat(bytes + 2, info.Scale);
+    putFloat(bytes + 6, info.Offset);
+    bytes[10] = nameLength;
+    memcpy(bytes + 11, info.Name, nameLength);
+
+    size_t length = 11 + nameLength;
+    size_t written = out.write(bytes, length);
+    _written += written;
+    if(written != length) return false;
+  }
+
+  while(_written < size)
+  {
+    if(out.write((uint8_t)0) != 1) return false;
+    _written++;
+  }
+
+  _out = &out;
+  return true;
+}
+
+void OBD2ValueLogger::putVarint(uint64_t value){
+
+  uint8_t* payload = _block + OBD2_LOGGER_BLOCK_HEADER_SIZE;
+
+  while(value >= 0x80)
+  {
+    payload[_length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+
+  payload[_length++] = (uint8_t)value;
+}
+
+void OBD2ValueLogger::startBlock(uint32_t now){
+
+  _blockTime = now;
+  _lastTime = now;
+  _blockSamples = 0;
+
+  for(uint8_t i=0;i<_nchannels;i++)
+  {
+    _channels[i].Last = 0;
+    _channels[i].InBlock = false;
+  }
+}
+
+//header, crc and padding, then into the queue: a full queue drops the block, never waits
+void OBD2ValueLogger::seal(){
+
+  if(_length==0) return;
+
+  memcpy(_block, "O2VB", 4);
+  putUint16(_block + 4, _length);
+  putUint16(_block + 6, _blockSamples);
+  OBD2TraceFormat::putUint32(_block + 8, _blockTime);
+  OBD2TraceFormat::putUint32(_block + 12, OBD2TraceFormat::crc32(_block + OBD2_LOGGER_BLOCK_HEADER_SIZE, _length, OBD2TraceFormat::crc32(_block, 12)));
+  memset(_block + OBD2_LOGGER_BLOCK_HEADER_SIZE + _length, 0, OBD2_LOGGER_PAYLOAD_SIZE - _length);
+
+  uint32_t head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+  uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+
+  if(head - tail < OBD2_LOGGER_QUEUE_BLOCKS)
+  {
+    memcpy(_queue[head & (OBD2_LOGGER_QUEUE_BLOCKS-1)], _block, OBD2_LOGGER_BLOCK_SIZE);
+    __atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+  }
+  else{
+    _droppedBlocks++;
+  }
+
+  _length = 0;
+}
+
+void OBD2ValueLogger::sync(){
+  seal();
+}
+
+bool OBD2ValueLogger::append(int channel, bool valid, int64_t value){
+
+  if(_out==NULL || channel < 0 || channel >= _nchannels || channel >= OBD2_LOGGER_CHANNELS) return false;
+
+  uint32_t now = millis();
+
+  if(_length > 0 && (now - _blockTime > _maxBlockAge || _length + OBD2_LOGGER_MAX_SAMPLE > OBD2_LOGGER_PAYLOAD_SIZE))
+  {
+    seal();
+  }
+
+  if(_length==0) startBlock(now);
+
+  Channel& c = _channels[channel];
+  uint8_t tag = channel;
+
+  if(!valid) tag |= OBD2_LOGGER_INVALID_FLAG;
+  else if(c.InBlock && c.Last==value) tag |= OBD2_LOGGER_REPEAT_FLAG;
+
+  _block[OBD2_LOGGER_BLOCK_HEADER_SIZE + _length++] = tag;
+  putVarint(now - _lastTime);
+  _lastTime = now;
+
+  if(tag==channel)
+  {
+    int64_t delta = value - c.Last;
+    putVarint(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)); //zigzag
+    c.Last = value;
+    c.InBlock = true;
+  }
+
+  _blockSamples++;
+  _samples++;
+  return true;
+}
+
+bool OBD2ValueLogger::log(int channel, float value){
+
+  if(channel < 0 || channel >= _nchannels || _channels[channel].Info.Kind!=OBD2LoggerChannelKind::quantized) return false;
+
+  const OBD2LoggerChannel& info = _channels[channel].Info;
+  float q = roundf((value - info.Offset) / info.Scale);
+
+  //out of the int32 range: logged as a gap rather than a wrong value
+  if(!(q > -2147483648.0f && q < 2147483648.0f)) return append(channel, false, 0);
+
+  return append(channel, true, (int64_t)q);
+}
+
+bool OBD2ValueLogger::logInvalid(int channel){
+  return append(channel, false, 0);
+}
+
+//failed outcomes are logged as gaps
+void OBD2ValueLogger::onRequestResponse(const void* request, bool valid, uint8_t* responseBytes){
+
+  for(uint8_t i=0;i<_nchannels;i++)
+  {
+    if(_channels[i].Request!=request) continue;
+
+    int64_t raw = 0;
+    for(uint8_t b=0;b<_channels[i].Info.ExpectedBytes;b++)
+    {
+      raw = (raw << 8) | responseBytes[b];
+    }
+
+    append(i, valid, raw);
+  }
+}
+
+void OBD2ValueLogger::onOBD2Response(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes){
+
+  onRequestResponse(request, outcome==OBD2StatusType::received, responseBytes);
+
+  if(_nextListener!=NULL) _nextListener->onOBD2Response(request, outcome, value, responseBytes);
+}
+
+void OBD2ValueLogger::onOBD2Response(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes){
+
+  onRequestResponse(request, outcome==OBD2StatusType::received, responseBytes);
+
+  if(_nextListener!=NULL) _nextListener->onOBD2Response(request, state, outcome, value, responseBytes);
+}
+
+size_t OBD2ValueLogger::flush(uint8_t maxBlocks){
+
+  if(_out==NULL) return 0;
+
+  size_t total = 0;
+
+  while(maxBlocks > 0)
+  {
+    uint32_t tail = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    if(head == tail) break;
+
+    const uint8_t* block = _queue[tail & (OBD2_LOGGER_QUEUE_BLOCKS-1)];
+    size_t chunk = OBD2_LOGGER_BLOCK_SIZE - _partial;
+    size_t n = _out->write(block + _partial, chunk);
+
+    total += n;
+    _written += n;
+
+    //sink full (card full, partition end): the rest of the block stays queued
+    if(n < chunk)
+    {
+      _partial += n;
+      break;
+    }
+
+    _partial = 0;
+    __atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE);
+    maxBlocks--;
+  }
+
+  return total;
+}
+
+void OBD2ValueLogger::end(){
+
+  seal();
+  while(__atomic_load_n(&_head, __ATOMIC_ACQUIRE) != __atomic_load_n(&_tail, __ATOMIC_ACQUIRE) && flush() > 0);
+  _out = nullptr;
+}
+
+bool OBD2ValueLogReader::readBytes(uint8_t* bytes, size_t length){
+
+  for(size_t i=0;i<length;i++)
+  {
+    int c = _in.read();
+    if(c < 0) return false;
+    bytes[i] = c;
+  }
+
+  return true;
+}
+
+bool OBD2ValueLogReader::begin(){
+
+  uint8_t bytes[11 + OBD2_LOGGER_MAX_NAME];
+  if(!readBytes(bytes, 8) || memcmp(bytes, "O2VL", 4)!=0 || bytes[4]!=OBD2_LOGGER_VERSION || bytes[5] > OBD2_LOGGER_CHANNELS) return false;
+
+  _nchannels = bytes[5];
+  uint16_t size = getUint16(bytes + 6);
+  uint16_t position = 8;
+
+  for(uint8_t i=0;i<_nchannels;i++)
+  {
+    if(!readBytes(bytes, 11) || bytes[10] > OBD2_LOGGER_MAX_NAME || !readBytes(bytes + 11, bytes[10])) return false;
+
+    _channels[i].Kind = (OBD2LoggerChannelKind)bytes[0];
+    _channels[i].ExpectedBytes = std::min((int)bytes[1], 4);
+    _channels[i].Scale = getFloat(bytes + 2);
+    _channels[i].Offset = getFloat(bytes + 6);
+    memcpy(_names[i], bytes + 11, bytes[10]);
+    _names[i][bytes[10]] = 0;
+    _channels[i].Name = _names[i];
+    position += 11 + bytes[10];
+  }
+
+  //padding up to the first block
+  for(;position < size;position++)
+  {
+    if(_in.read() < 0) return false;
+  }
+
+  _remaining = 0;
+  return true;
+}
+
+bool OBD2ValueLogReader::readBlock(){
+
+  while(readBytes(_block, OBD2_LOGGER_BLOCK_SIZE))
+  {
+    _length = getUint16(_block + 4);
+
+    if(memcmp(_block, "O2VB", 4)!=0 || _length > OBD2_LOGGER_PAYLOAD_SIZE
+      || OBD2TraceFormat::crc32(_block + OBD2_LOGGER_BLOCK_HEADER_SIZE, _length, OBD2TraceFormat::crc32(_block, 12)) != OBD2TraceFormat::getUint32(_block + 12))
+    {
+      _damagedBlocks++;
+      continue;
+    }
+
+    _remaining = getUint16(_block + 6);
+    _time = OBD2TraceFormat::getUint32(_block + 8);
+    _position = OBD2_LOGGER_BLOCK_HEADER_SIZE;
+    _length += OBD2_LOGGER_BLOCK_HEADER_SIZE;
+
+    for(uint8_t i=0;i<_nchannels;i++) _last[i] = 0;
+
+    if(_remaining > 0) return true;
+  }
+
+  return false;
+}
+
+bool OBD2ValueLogReader::getVarint(uint64_t& value){
+
+  value = 0;
+
+  for(uint8_t shift=0;shift<64;shift+=7)
+  {
+    if(_position >= _length) return false;
+
+    uint8_t b = _block[_position++];
+    value |= (uint64_t)(b & 0x7F) << shift;
+    if((b & 0x80)==0) return true;
+  }
+
+  return false;
+}
+
+bool OBD2ValueLogReader::next(OBD2LoggedSample& sample){
+
+  while(true)
+  {
+    if(_remaining==0 && !readBlock()) return false;
+
+    uint64_t delta;
+    uint8_t tag = _position < _length ? _block[_position++] : 0xFF;
+    uint8_t channel = tag & 0x3F;
+
+    if(channel >= _nchannels || !getVarint(delta))
+    {
+      //crc matched but the payload does not parse: drop the rest of the block
+      _damagedBlocks++;
+      _remaining = 0;
+      continue;
+    }
+
+    _time += (uint32_t)delta;
+    _remaining--;
+
+    sample.Channel = channel;
+    sample.Timestamp = _time;
+    sample.Valid = (tag & OBD2_LOGGER_INVALID_FLAG)==0;
+    sample.Value = 0.0;
+
+    if(!sample.Valid) return true;
+
+    if((tag & OBD2_LOGGER_REPEAT_FLAG)==0)
+    {
+      if(!getVarint(delta))
+      {
+        _damagedBlocks++;
+        _remaining = 0;
+        continue;
+      }
+
+      _last[channel] += (int64_t)((delta >> 1) ^ (~(delta & 1) + 1)); //zigzag
+    }
+
+    sample.Value = channelValue(_channels[channel], _last[channel]);
+    return true;
+  }
+}
@@ -0,0 +1,184 @@
+/**
+ * Obd2Reader - decoded value logging
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * OBD2ValueLogger records decoded values as compact time series. It is a value listener of OBD2:
+ * request channels keep the raw response integer (lossless, the resolution of ScaleFactor), other
+ * channels are quantized to a given resolution. Samples are delta/varint coded per channel into
+ * fixed size blocks, queued in RAM and written to any Print (SD File, Stream) by flush(), which
+ * may run on another task: process() never waits for the card.
+ *
+ * File layout, little endian:
+ *   header   "O2VL", version, channels, uint16 header size (padded to a multiple of the block size),
+ *            per channel: kind (0 request, 1 quantized), expected bytes, float scale, float offset,
+ *            uint8 name length, name
+ *   block    OBD2_LOGGER_BLOCK_SIZE bytes: "O2VB", uint16 payload length, uint16 samples,
+ *            uint32 first millis(), uint32 crc32 (first 12 header bytes + payload), payload, zero padding
+ *            payload, per sample:
+ *              tag: bits 0-5 channel, bit 6 no value (timeout, nodata, error), bit 7 same value as the
+ *                   previous sample of the channel in this block
+ *              varint millis() delta from the previous sample (first one: from the block time)
+ *              unless bit 6 or 7: zigzag varint delta from the previous value of the channel
+ *              in this block (0 for the first one)
+ * Blocks do not depend on each other, a damaged block loses only its own samples.
+ */
+
+#ifndef Obd2ValueLogger_H
+#define Obd2ValueLogger_H
+
+#include "OBD2.h"
+
+//block written to the sink, a multiple of the SD sector keeps writes aligned
+#ifndef OBD2_LOGGER_BLOCK_SIZE
+#define OBD2_LOGGER_BLOCK_SIZE 512
+#endif
+
+//sealed blocks waiting for flush(), power of two
+#ifndef OBD2_LOGGER_QUEUE_BLOCKS
+#define OBD2_LOGGER_QUEUE_BLOCKS 4
+#endif
+
+//max 63
+#ifndef OBD2_LOGGER_CHANNELS
+#define OBD2_LOGGER_CHANNELS 32
+#endif
+
+//a block older than this is sealed at the next sample, so a power loss costs at most this much data
+#ifndef OBD2_LOGGER_MAX_BLOCK_AGE
+#define OBD2_LOGGER_MAX_BLOCK_AGE 60000
+#endif
+
+#define OBD2_LOGGER_VERSION 1
+#define OBD2_LOGGER_BLOCK_HEADER_SIZE 16
+#define OBD2_LOGGER_MAX_NAME 31
+#define OBD2_LOGGER_MAX_SAMPLE 11 //1 tag + 5 time + 5 value
+
+#define OBD2_LOGGER_INVALID_FLAG 0x40
+#define OBD2_LOGGER_REPEAT_FLAG  0x80
+
+enum class OBD2LoggerChannelKind : uint8_t {
+    request, //raw response integer, decoded as getValue() does
+    quantized //round((value - offset) / scale)
+};
+
+struct OBD2LoggerChannel {
+    const char* Name;
+    OBD2LoggerChannelKind Kind;
+    uint8_t ExpectedBytes;
+    float Scale;
+    float Offset;
+};
+
+struct OBD2LoggedSample {
+    uint8_t Channel;
+    uint32_t Timestamp; //millis()
+    bool Valid; //false for timeout, nodata and error outcomes
+    float Value;
+};
+
+class OBD2ValueLogger: public IOBD2MessageListener
+{
+    public:
+        OBD2ValueLogger();
+
+        //channels, before begin(): returns the channel id or -1
+        int addRequest(const OBD2RequestDescriptor* request);
+        int addRequest(OBD2Request* request);
+        int addChannel(const char* name, float resolution, float offset = 0.0);
+
+        //writes the file header, padded to the block size; false on a short write, nothing is logged then
+        bool begin(Print& out);
+        void end(); //seals the open block and writes everything (blocking)
+
+        //producer side (process() context)
+        bool log(int channel, float value); //quantized channels
+        bool logInvalid(int channel);
+        void sync(); //seals the open block, flush() then writes it
+        void setMaxBlockAge(uint32_t ms){ _maxBlockAge = ms; };
+
+        //consumer side, any task: writes up to maxBlocks sealed blocks, returns bytes written
+        size_t flush(uint8_t maxBlocks = OBD2_LOGGER_QUEUE_BLOCKS);
+
+        //register as value listener of obd2, timeout, nodata and error outcomes are logged without value
+        void attach(OBD2& obd2){ obd2.onHandleValue(this); };
+        void setNextListener(IOBD2MessageListener* listener){ _nextListener = listener; };
+
+        void onOBD2Response(OBD2Request* request, OBD2StatusType outcome, float value, uint8_t* responseBytes) override;
+        void onOBD2Response(const OBD2RequestDescriptor* request, OBD2RequestState* state, OBD2StatusType outcome, float value, uint8_t* responseBytes) override;
+
+        uint8_t getChannels(){ return _nchannels; };
+        uint32_t getSamples(){ return _samples; };
+        uint32_t getDroppedBlocks(){ return _droppedBlocks; }; //queue full, flush() too slow
+        uint32_t getBytesWritten(){ return _written; };
+
+    private:
+        struct Channel {
+            const void* Request;
+            OBD2LoggerChannel Info;
+            int64_t Last; //previous value in the open block
+            bool InBlock;
+        };
+
+        int addChannel(const void* request, const OBD2LoggerChannel& info);
+        void onRequestResponse(const void* request, bool valid, uint8_t* responseBytes);
+        bool append(int channel, bool valid, int64_t value);
+        void putVarint(uint64_t value);
+        void startBlock(uint32_t now);
+        void seal();
+
+        Channel _channels[OBD2_LOGGER_CHANNELS];
+        uint8_t _nchannels = 0;
+
+        uint8_t _block[OBD2_LOGGER_BLOCK_SIZE];
+        uint16_t _length = 0; //payload bytes of the open block
+        uint16_t _blockSamples = 0;
+        uint32_t _blockTime = 0;
+        uint32_t _lastTime = 0;
+        uint32_t _maxBlockAge = OBD2_LOGGER_MAX_BLOCK_AGE;
+
+        uint8_t _queue[OBD2_LOGGER_QUEUE_BLOCKS][OBD2_LOGGER_BLOCK_SIZE];
+        uint32_t _head = 0; //written by seal()
+        uint32_t _tail = 0; //written by flush()
+        uint16_t _partial = 0; //bytes of the tail block already written
+        Print* _out = nullptr;
+
+        uint32_t _samples = 0;
+        uint32_t _droppedBlocks = 0;
+        uint32_t _written = 0;
+
+        IOBD2MessageListener* _nextListener = nullptr;
+};
+
+class OBD2ValueLogReader
+{
+    public:
+        OBD2ValueLogReader(Stream& in) : _in(in) {};
+
+        bool begin(); //false if the header is missing or of another version
+        bool next(OBD2LoggedSample& sample); //false at the end, damaged blocks are skipped
+
+        uint8_t getChannels(){ return _nchannels; };
+        const OBD2LoggerChannel& getChannel(uint8_t channel){ return _channels[channel]; };
+        uint32_t getDamagedBlocks(){ return _damagedBlocks; };
+
+    private:
+        bool readBytes(uint8_t* bytes, size_t length);
+        bool readBlock();
+        bool getVarint(uint64_t& value);
+
+        Stream& _in;
+        OBD2LoggerChannel _channels[OBD2_LOGGER_CHANNELS];
+        char _names[OBD2_LOGGER_CHANNELS][OBD2_LOGGER_MAX_NAME + 1];
+        uint8_t _nchannels = 0;
+
+        uint8_t _block[OBD2_LOGGER_BLOCK_SIZE];
+        uint16_t _length = 0;
+        uint16_t _position = 0;
+        uint16_t _remaining = 0;
+        uint32_t _time = 0;
+        int64_t _last[OBD2_LOGGER_CHANNELS];
+        uint32_t _damagedBlocks = 0;
+};
+
+#endif
@@ -0,0 +1,111 @@
+/**
+ * Obd2Reader - shared value store
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ */
+
+#include "OBD2ValueStore.h"
+
+OBD2ValueStore::OBD2ValueStore(){
+  clear();
+}
+
+void OBD2ValueStore::clear(){
+  memset(_slots, 0, sizeof(_slots));
+}
+
+void OBD2ValueStore::beginWrite(Slot& s){
+  uint32_t seq = __atomic_load_n(&s.Sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&s.Sequence, seq + 1, __ATOMIC_RELAXED);
+  //data stores can't move above the odd sequence
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void OBD2ValueStore::endWrite(Slot& s){
+  uint32_t seq = __atomic_load_n(&s.Sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&s.Sequence, seq + 1, __ATOMIC_RELEASE);
+}
+
+void OBD2ValueStore::write(uint16_t slot, float value, const uint8_t* raw, uint8_t rawLength, uint32_t timestamp, OBD2ValueQuality quality){
+
+  if(slot >= OBD2_VALUE_STORE_SLOTS) return;
+
+  Slot& s = _slots[slot];
+
+  if(rawLength > sizeof(s.Data.Raw)) rawLength = sizeof(s.Data.Raw);
+
+  beginWrite(s);
+
+  s.Data.Value = value;
+  if(raw!=NULL) memcpy(s.Data.Raw, raw, rawLength);
+  s.Data.RawLength = raw!=NULL ? rawLength : 0;
+  s.Data.Quality = quality;
+  s.Data.Timestamp = timestamp;
+  s.Data.Version++;
+
+  endWrite(s);
+}
+
+void OBD2ValueStore::setQuality(uint16_t slot, OBD2ValueQuality quality, uint32_t timestamp){
+
+  if(slot >= OBD2_VALUE_STORE_SLOTS) return;
+
+  Slot& s = _slots[slot];
+
+  beginWrite(s);
+
+  s.Data.Quality = quality;
+  s.Data.Timestamp = timestamp;
+  s.Data.Version++;
+
+  endWrite(s);
+}
+
+bool OBD2ValueStore::read(uint16_t slot, OBD2ValueSnapshot& snapshot) const{
+
+  if(slot >= OBD2_VALUE_STORE_SLOTS) return false;
+
+  const Slot& s = _slots[slot];
+
+  for(uint8_t retry=0; retry<OBD2_VALUE_STORE_READ_RETRIES; retry++)
+  {
+    uint32_t begin = __atomic_load_n(&s.Sequence, __ATOMIC_ACQUIRE);
+    if(begin & 1) continue; //write in progress
+
+    memcpy(&snapshot, &s.Data, sizeof(snapshot));
+
+    //copy can't move below the second sequence load
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint32_t end = __atomic_load_n(&s.Sequence, __ATOMIC_RELAXED);
+
+    if(begin==end) return snapshot.Quality!=OBD2ValueQuality::empty;
+  }
+
+  return false;
+}
+
+float OBD2ValueStore::getValue(uint16_t slot, float defaultValue) const{
+
+  OBD2ValueSnapshot snapshot;
+
+  if(!read(slot, snapshot) || snapshot.Quality!=OBD2ValueQuality::good) return defaultValue;
+
+  return snapshot.Value;
+}
+
+bool OBD2ValueStore::isFresh(uint16_t slot, uint32_t maxAge, uint32_t now) const{
+
+  OBD2ValueSnapshot snapshot;
+
+  if(!read(slot, snapshot) || snapshot.Quality!=OBD2ValueQuality::good) return false;
+
+  return (now - snapshot.Timestamp) <= maxAge;
+}
+
+uint32_t OBD2ValueStore::getVersion(uint16_t slot) const{
+
+  if(slot >= OBD2_VALUE_STORE_SLOTS) return 0;
+
+  //sequence counts two steps per write, odd while writing
+  return __atomic_load_n(&_slots[slot].Sequence, __ATOMIC_ACQUIRE) >> 1;
+}
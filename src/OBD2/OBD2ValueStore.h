@@ -0,0 +1,70 @@
+/**
+ * Obd2Reader - shared value store
+ * Copyright (c) Dixtone @2025. All rights reserved.
+ * Licensed under the MIT license. See LICENSE file in the project root for full license information.
+ *
+ * Slots protected by a sequence lock: one writer per slot (process() or the CAN interrupt) never
+ * waits, readers on any core retry until they get a consistent copy.
+ */
+
+#ifndef Obd2ValueStore_H
+#define Obd2ValueStore_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef OBD2_VALUE_STORE_SLOTS
+#define OBD2_VALUE_STORE_SLOTS 32
+#endif
+
+//reader gives up after this many torn reads (writer keeps updating the slot)
+#define OBD2_VALUE_STORE_READ_RETRIES 16
+
+enum class OBD2ValueQuality : uint8_t {
+    empty,
+    good,
+    timeout,
+    nodata,
+    error
+};
+
+struct OBD2ValueSnapshot {
+    float Value;
+    uint8_t Raw[8];
+    uint8_t RawLength;
+    OBD2ValueQuality Quality;
+    uint32_t Timestamp; //millis() of last update
+    uint32_t Version; //incremented on every update
+};
+
+class OBD2ValueStore
+{
+    public:
+        OBD2ValueStore();
+
+        //writer side, never blocks
+        void write(uint16_t slot, float value, const uint8_t* raw, uint8_t rawLength, uint32_t timestamp, OBD2ValueQuality quality = OBD2ValueQuality::good);
+        void setQuality(uint16_t slot, OBD2ValueQuality quality, uint32_t timestamp); //keeps last value
+
+        //reader side, false if slot is invalid, empty or still being written after all retries
+        bool read(uint16_t slot, OBD2ValueSnapshot& snapshot) const;
+        float getValue(uint16_t slot, float defaultValue = 0.0) const;
+        bool isFresh(uint16_t slot, uint32_t maxAge, uint32_t now) const;
+        uint32_t getVersion(uint16_t slot) const; //cheap change detection, no copy
+        uint16_t size() const { return OBD2_VALUE_STORE_SLOTS; };
+
+        void clear();
+
+    private:
+        struct Slot {
+            uint32_t Sequence; //odd while a write is in progress
+            OBD2ValueSnapshot Data;
+        };
+
+        void beginWrite(Slot& s);
+        void endWrite(Slot& s);
+
+        Slot _slots[OBD2_VALUE_STORE_SLOTS];
+};
+
+#endif
@@ -0,0 +1,319 @@
+#!/usr/bin/env python3
+"""
+Obd2Reader - vehicle PID profile compiler
+Copyright (c) Dixtone @2025. All rights reserved.
+Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+Reads a profile (CSV or JSON) and emits a C++ header with a sorted, validated
+OBD2RequestDescriptor table and the OBD2Profile hash index used by OBD2::findRequest().
+
+CSV columns (header row required, optional columns may be omitted):
+    name, header, service, pid, length  required
+    group                               default: profile name
+    formula                             linear expression of A,B,C,D (response bytes) or RAW
+    scale, offset                       used when formula is empty (default 1, 0)
+    rate_ms                             ReadInterval, 0 = not scheduled
+    always_header                       1/0, default 1
+
+JSON: {"name": "...", "bitrate": 500000, "requests": [ {same keys as CSV}, ... ]}
+
+Usage:
+    obd2_profile.py giulia.csv -o GiuliaProfile.h [--name giulia] [--bitrate 500000]
+"""
+
+import argparse
+import ast
+import csv
+import json
+import math
+import os
+import random
+import re
+import struct
+import sys
+
+MASK32 = 0xFFFFFFFF
+EMPTY_SLOT = 0xFFFF
+
+
+class ProfileError(Exception):
+    pass
+
+
+def profile_hash(header, service, pid):
+    """Must match obd2ProfileHash() in src/OBD2/OBD2Profile.h."""
+    h = (header * 0x9E3779B1) & MASK32
+    h ^= ((service << 16) | pid) & MASK32
+    h = (h * 0x85EBCA6B) & MASK32
+    h ^= h >> 16
+    return h
+
+
+def parse_int(value, field, row):
+    if isinstance(value, int):
+        return value
+    text = str(value).strip()
+    if text == "":
+        raise ProfileError("%s: missing %s" % (row, field))
+    try:
+        return int(text, 0) if text.lower().startswith("0x") else int(text, 16 if field in ("header", "pid", "service") else 10)
+    except ValueError:
+        raise ProfileError("%s: invalid %s '%s'" % (row, field, value))
+
+
+def float32(value):
+    return struct.unpack("<f", struct.pack("<f", value))[0]
+
+
+ALLOWED_NODES = (ast.Expression, ast.BinOp, ast.UnaryOp, ast.Name, ast.Load, ast.Constant,
+                 ast.Add, ast.Sub, ast.Mult, ast.Div, ast.USub, ast.UAdd, ast.LShift, ast.BitOr)
+
+
+def compile_formula(formula, length, row):
+    """Reduce a linear formula to (scale, offset) over the big endian raw value, as OBD2::getValue() does."""
+    try:
+        tree = ast.parse(formula, mode="eval")
+    except SyntaxError:
+        raise ProfileError("%s: invalid formula '%s'" % (row, formula))
+    for node in ast.walk(tree):
+        if not isinstance(node, ALLOWED_NODES):
+            raise ProfileError("%s: unsupported element in formula '%s'" % (row, formula))
+        if isinstance(node, ast.Name) and node.id not in ("A", "B", "C", "D", "RAW"):
+            raise ProfileError("%s: unknown variable '%s' in formula" % (row, node.id))
+        if isinstance(node, ast.Name) and node.id in "ABCD" and len(node.id) == 1 and "ABCD".index(node.id) >= length:
+            raise ProfileError("%s: formula uses byte %s but length is %d" % (row, node.id, length))
+    code = compile(tree, "<formula>", "eval")
+
+    def evaluate(raw):
+        data = raw.to_bytes(length, "big")
+        env = {"RAW": raw}
+        for i, letter in enumerate("ABCD"):
+            env[letter] = data[i] if i < length else 0
+        try:
+            return float(eval(code, {"__builtins__": {}}, env))
+        except (ArithmeticError, NameError, TypeError) as e:
+            raise ProfileError("%s: formula '%s' fails for raw 0x%X: %s" % (row, formula, raw, e))
+
+    top = (1 << (8 * length)) - 1
+    offset = evaluate(0)
+    scale = evaluate(1) - offset
+    rng = random.Random(length)
+    samples = [top, top // 2, 0x0100 & top] + [rng.randint(0, top) for _ in range(32)]
+    for raw in samples:
+        expected = raw * scale + offset
+        if not math.isclose(evaluate(raw), expected, rel_tol=1e-9, abs_tol=1e-9):
+            raise ProfileError("%s: formula '%s' is not linear in the response bytes" % (row, formula))
+    return scale, offset
+
+
+def c_identifier(text):
+    ident = re.sub(r"[^0-9A-Za-z_]", "_", text)
+    if not ident or ident[0].isdigit():
+        ident = "_" + ident
+    return ident
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def c_float(value):
+    """Shortest fixed-notation literal that rounds to the same float32 (-40.0f, 0.25f)."""
+    target = float32(value)
+    for decimals in range(0, 60):
+        text = "%.*f" % (decimals, target)
+        if float32(float(text)) == target:
+            break
+    if "." not in text:
+        text += ".0"
+    return text + "f"
+
+
+def load_rows(path):
+    if path.lower().endswith(".json"):
+        with open(path) as f:
+            doc = json.load(f)
+        return doc.get("name"), doc.get("bitrate"), doc.get("requests", [])
+    with open(path, newline="") as f:
+        numbered = [(n, line) for n, line in enumerate(f, 1) if line.strip() and not line.lstrip().startswith("#")]
+    rows = list(csv.DictReader(line for _, line in numbered))
+    #file line of each row, for the error messages
+    for row, (n, _) in zip(rows, numbered[1:]):
+        row["__line__"] = n
+    return None, None, rows
+
+
+def build_requests(rows, profile_name, source):
+    requests = []
+    keys = {}
+    names = {}
+    for n, row in enumerate(rows, 1):
+        n = row.get("__line__", n)
+        row = {k.strip().lower(): (v.strip() if isinstance(v, str) else v) for k, v in row.items() if k is not None}
+        where = "%s:%d" % (os.path.basename(source), n)
+        name = row.get("name") or ""
+        if not name:
+            raise ProfileError("%s: missing name" % where)
+        header = parse_int(row.get("header", ""), "header", where)
+        service = parse_int(row.get("service", ""), "service", where)
+        pid = parse_int(row.get("pid", ""), "pid", where)
+        length = parse_int(row.get("length", ""), "length", where)
+        rate = parse_int(row.get("rate_ms") or 0, "rate_ms", where)
+        always = str(row.get("always_header", "1") or "1").strip().lower() not in ("0", "false", "no")
+
+        if not 0 < header <= 0x1FFFFFFF:
+            raise ProfileError("%s: header 0x%X out of range" % (where, header))
+        if not 0 < service <= 0xFF:
+            raise ProfileError("%s: service 0x%X out of range" % (where, service))
+        if not 0 <= pid <= 0xFFFF:
+            raise ProfileError("%s: pid 0x%X out of range" % (where, pid))
+        if not 1 <= length <= 4:
+            raise ProfileError("%s: length %d must be 1..4 bytes" % (where, length))
+        if rate < 0 or rate > 0xFFFFFFFF:
+            raise ProfileError("%s: rate_ms %d out of range" % (where, rate))
+        #OBD2::sendRequest sends 29bit frames only for 2 byte pids
+        if (pid > 0xFF) != (header > 0x7FF):
+            raise ProfileError("%s: pid 0x%X needs a %s header, got 0x%X" % (where, pid, "29bit" if pid > 0xFF else "11bit", header))
+
+        formula = row.get("formula") or ""
+        if formula:
+            scale, offset = compile_formula(formula, length, where)
+        else:
+            scale = float(row.get("scale") or 1.0)
+            offset = float(row.get("offset") or 0.0)
+
+        key = (header, service, pid)
+        if key in keys:
+            raise ProfileError("%s: duplicate request %06X/%02X/%04X (first at %s)" % (where, header, service, pid, keys[key]))
+        keys[key] = where
+        ident = c_identifier(name).upper()
+        if ident in names:
+            raise ProfileError("%s: duplicate name %s (first at %s)" % (where, name, names[ident]))
+        names[ident] = where
+
+        requests.append({
+            "group": row.get("group") or profile_name, "name": name, "ident": ident,
+            "always": always, "header": header, "service": service, "pid": pid,
+            "length": length, "scale": scale, "offset": offset, "rate": rate,
+        })
+    if not requests:
+        raise ProfileError("%s: profile has no requests" % source)
+    if len(requests) >= EMPTY_SLOT:
+        raise ProfileError("%s: too many requests" % source)
+    requests.sort(key=lambda r: (r["header"], r["service"], r["pid"]))
+    return requests
+
+
+def build_index(requests):
+    size = 4
+    while size < 2 * len(requests):
+        size *= 2
+    slots = [EMPTY_SLOT] * size
+    for i, r in enumerate(requests):
+        slot = profile_hash(r["header"], r["service"], r["pid"]) & (size - 1)
+        while slots[slot] != EMPTY_SLOT:
+            slot = (slot + 1) & (size - 1)
+        slots[slot] = i
+    return slots
+
+
+def frame_bits(extended):
+    """Worst case bits of a padded 8 byte frame including stuffing and interframe space."""
+    if extended:
+        return 67 + 64 + (54 + 64 - 1) // 4
+    return 47 + 64 + (34 + 64 - 1) // 4
+
+
+def bus_budget(requests, bitrate):
+    total_bits = 0.0
+    total_requests = 0.0
+    for r in requests:
+        if r["rate"] <= 0:
+            continue
+        extended = r["header"] > 0x7FF
+        payload = 1 + (2 if r["pid"] > 0xFF else 1) + r["length"]
+        if payload <= 7:
+            frames = 2  #request + single frame
+        else:
+            frames = 3 + math.ceil((payload - 6) / 7.0)  #request + first frame + flow control + consecutive
+        per_second = 1000.0 / r["rate"]
+        total_requests += per_second
+        total_bits += per_second * frames * frame_bits(extended)
+    return total_requests, total_bits, 100.0 * total_bits / bitrate
+
+
+def emit_header(requests, index, name, source, bitrate, budget):
+    ident = c_identifier(name)
+    guard = "OBD2_PROFILE_%s_H" % ident.upper()
+    rate, bits, load = budget
+    out = []
+    out.append("// Generated by tools/obd2_profile.py from %s, do not edit." % os.path.basename(source))
+    out.append("// Bus budget @%d bit/s: %.1f requests/s, %.0f bit/s, %.2f%% bus load (worst case stuffing)" % (bitrate, rate, bits, load))
+    out.append("")
+    out.append("#ifndef %s" % guard)
+    out.append("#define %s" % guard)
+    out.append("")
+    out.append('#include "OBD2.h"')
+    out.append("")
+    for i, r in enumerate(requests):
+        out.append("#define %s_%s %d" % (ident.upper(), r["ident"], i))
+    out.append("#define %s_COUNT %d" % (ident.upper(), len(requests)))
+    out.append("")
+    out.append("//Group, Name, AlwaysSendHeader, Header, Service, Pid, ExpectedBytes, ScaleFactor, AdjustFactor, ReadInterval")
+    out.append("static const OBD2RequestDescriptor %s_requests[] = {" % ident)
+    for r in requests:
+        out.append("  { %s, %s, %s, 0x%X, 0x%02X, 0x%04X, %d, %s, %s, %d }," % (
+            c_string(r["group"]), c_string(r["name"]), "true" if r["always"] else "false",
+            r["header"], r["service"], r["pid"], r["length"], c_float(r["scale"]), c_float(r["offset"]), r["rate"]))
+    out.append("};")
+    out.append("")
+    out.append("static const uint16_t %s_index[%d] = {" % (ident, len(index)))
+    for start in range(0, len(index), 8):
+        out.append("  " + ", ".join("0x%04X" % v for v in index[start:start + 8]) + ",")
+    out.append("};")
+    out.append("")
+    out.append("static const OBD2Profile %s_profile = { %s, %s_requests, %d, %s_index, 0x%X };" % (
+        ident, c_string(name), ident, len(requests), ident, len(index) - 1))
+    out.append("")
+    out.append("#endif")
+    out.append("")
+    return "\n".join(out)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="Compile an OBD2 PID profile into C++ tables")
+    parser.add_argument("profile", help="profile file (.csv or .json)")
+    parser.add_argument("-o", "--output", help="generated header, default stdout")
+    parser.add_argument("--name", help="profile name, default file name")
+    parser.add_argument("--bitrate", type=int, help="bus bitrate for budget estimate, default 500000")
+    parser.add_argument("--check", action="store_true", help="validate and report budget only")
+    args = parser.parse_args(argv)
+
+    try:
+        doc_name, doc_bitrate, rows = load_rows(args.profile)
+        name = args.name or doc_name or os.path.splitext(os.path.basename(args.profile))[0]
+        bitrate = args.bitrate or doc_bitrate or 500000
+        requests = build_requests(rows, name, args.profile)
+    except (ProfileError, OSError, ValueError) as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+
+    index = build_index(requests)
+    budget = bus_budget(requests, bitrate)
+    print("%s: %d requests, %.1f requests/s, %.0f bit/s, %.2f%% of %d bit/s" % (
+        name, len(requests), budget[0], budget[1], budget[2], bitrate), file=sys.stderr)
+
+    if args.check:
+        return 0
+
+    header = emit_header(requests, index, name, args.profile, bitrate, budget)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(header)
+    else:
+        sys.stdout.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())